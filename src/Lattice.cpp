@@ -22,6 +22,7 @@
 #include <tuple>
 
 #include "exception.hpp"
+#include "util/archive.hpp"
 
 namespace tenes {
 
@@ -70,30 +71,69 @@ void Lattice::calc_neighbors() {
       NN_Tensor[N_UNIT+ix-LX][1] = Tensor_list[(ix+LX-skew)%LX][0];
     }
   }
+  calc_move_schedules();
   logical_check();
 }
 
-int Lattice::other(int index, int dx, int dy) const {
-  while(dx != 0){
-    if(dx>0){
-      index = right(index);
-      --dx;
-    }else{
-      index = left(index);
-      ++dx;
+void Lattice::calc_move_schedules() {
+  // left move absorbing the X=ix column: i at (ix, iy)
+  // right move absorbing the X=ix column: k at (ix, iy)
+  // top move absorbing the Y=iy row: j at (ix, iy)
+  // bottom move absorbing the Y=iy row: l at (ix, iy)
+  for (auto &plaquettes : move_plaquettes) {
+    plaquettes.resize(N_UNIT);
+  }
+  for (int ix = 0; ix < LX; ++ix) {
+    for (int iy = 0; iy < LY; ++iy) {
+      const int site = Tensor_list[ix][iy];
+      Plaquette p;
+
+      p.i = site;
+      p.j = right(p.i);
+      p.k = bottom(p.j);
+      p.l = left(p.k);
+      move_plaquettes[0][ix * LY + iy] = p;
+
+      p.k = site;
+      p.l = left(p.k);
+      p.i = top(p.l);
+      p.j = right(p.i);
+      move_plaquettes[2][ix * LY + iy] = p;
+
+      p.j = site;
+      p.k = bottom(p.j);
+      p.l = left(p.k);
+      p.i = top(p.l);
+      move_plaquettes[1][iy * LX + ix] = p;
+
+      p.l = site;
+      p.i = top(p.l);
+      p.j = right(p.i);
+      p.k = bottom(p.j);
+      move_plaquettes[3][iy * LX + ix] = p;
     }
   }
 
-  while(dy != 0){
-    if(dy>0){
-      index = top(index);
-      --dy;
-    }else{
-      index = bottom(index);
-      ++dy;
+  // left and bottom moves go forward from 0,
+  // right and top moves go backward from 1
+  for (int direction = 0; direction < 4; ++direction) {
+    const int L = direction % 2 == 0 ? LX : LY;
+    const bool forward = direction == 0 || direction == 3;
+    move_lines[direction].resize(L);
+    for (int n = 0; n < L; ++n) {
+      move_lines[direction][n] = forward ? n : (1 - n + L) % L;
     }
   }
-  return index;
+}
+
+int Lattice::other(int index, int dx, int dy) const {
+  // every crossing of the top (bottom) boundary shifts x by -skew (+skew)
+  int X = x(index) + dx;
+  int Y = y(index) + dy;
+  const int wrap = (Y >= 0) ? Y / LY : -((-Y + LY - 1) / LY);
+  X -= skew * wrap;
+  Y -= wrap * LY;
+  return this->index(X, Y);
 }
 
 void Lattice::reset(int X, int Y) {
@@ -121,68 +161,35 @@ void Lattice::save(const char *filename, bool append) {
   ofs << "skew = " << skew << std::endl;
 }
 
+void Lattice::pack(util::OutArchive &ar) const {
+  ar << LX << LY << skew;
+  ar << physical_dims << virtual_dims << initial_dirs << noises;
+  ar << input_site_map;
+}
+
+void Lattice::unpack(util::InArchive &ar) {
+  ar >> LX >> LY >> skew;
+  calc_neighbors();
+  ar >> physical_dims >> virtual_dims >> initial_dirs >> noises;
+  ar >> input_site_map;
+}
+
 void Lattice::Bcast(MPI_Comm comm, int root) {
   int irank;
-  MPI_Comm_rank(MPI_COMM_WORLD, &irank);
-  std::vector<int> params_int(3);
-  std::vector<std::vector<double>> init_dirs(N_UNIT);
-  std::vector<double> ns;
-
-  int ldof = 0;
+  MPI_Comm_rank(comm, &irank);
 
+  // the whole lattice is sent by one broadcast
+  std::string buffer;
   if (irank == root) {
-    params_int[0] = LX;
-    params_int[1] = LY;
-    params_int[2] = N_UNIT;
-
-    init_dirs.assign(initial_dirs.begin(), initial_dirs.end());
-
-    MPI_Bcast(&params_int.front(), 3, MPI_INT, 0, comm);
-
-    for (int i = 0; i < N_UNIT; ++i) {
-      ldof = init_dirs[i].size();
-      MPI_Bcast(&ldof, 1, MPI_INT, 0, comm);
-      MPI_Bcast(&init_dirs[i].front(), ldof, MPI_DOUBLE, 0, comm);
-    }
-
-    ns.assign(noises.begin(), noises.end());
-    MPI_Bcast(&ns.front(), N_UNIT, MPI_DOUBLE, 0, comm);
-
-    std::vector<int> phys(physical_dims.begin(), physical_dims.end());
-    MPI_Bcast(&phys.front(), N_UNIT, MPI_INT, 0, comm);
-
-    for(int i=0; i < N_UNIT; ++i){
-      std::array<int, 4> vs = virtual_dims[i];
-      MPI_Bcast(vs.data(), 4, MPI_INT, 0, comm);
-    }
-
-  } else {
-    MPI_Bcast(&params_int.front(), 3, MPI_INT, 0, comm);
-    LX = params_int[0];
-    LY = params_int[1];
-    N_UNIT = params_int[2];
-
-    for (int i = 0; i < N_UNIT; ++i) {
-      MPI_Bcast(&ldof, 1, MPI_INT, 0, comm);
-      init_dirs[i].resize(ldof);
-      MPI_Bcast(&init_dirs[i].front(), ldof, MPI_DOUBLE, 0, comm);
-    }
-
-    ns.resize(N_UNIT);
-    MPI_Bcast(&ns.front(), N_UNIT, MPI_DOUBLE, 0, comm);
-
-    std::vector<int> phys(N_UNIT);
-    MPI_Bcast(&phys.front(), N_UNIT, MPI_INT, 0, comm);
-    physical_dims.assign(phys.begin(), phys.end());
-    for(int i=0; i < N_UNIT; ++i){
-      std::array<int, 4> vs;
-      MPI_Bcast(vs.data(), 4, MPI_INT, 0, comm);
-      virtual_dims[i] = vs;
-    }
+    util::OutArchive ar;
+    pack(ar);
+    buffer = ar.str();
+  }
+  bcast(buffer, root, comm);
+  if (irank != root) {
+    util::InArchive ar(buffer);
+    unpack(ar);
   }
-  calc_neighbors();
-  initial_dirs.assign(init_dirs.begin(), init_dirs.end());
-  noises.assign(ns.begin(), ns.end());
 }
 
 void Lattice::check_dims() const{
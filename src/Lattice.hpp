@@ -24,6 +24,23 @@
 
 namespace tenes {
 
+namespace util {
+class OutArchive;
+class InArchive;
+}  // end of namespace util
+
+/*! @brief sites of a 2x2 plaquette absorbed by a CTM move
+ *
+ *  i j
+ *  l k
+ */
+struct Plaquette {
+  int i;
+  int j;
+  int k;
+  int l;
+};
+
 // Lattice setting
 
 /*
@@ -63,13 +80,22 @@ class Lattice {
   std::vector<std::vector<double>> initial_dirs;
   std::vector<double> noises;
 
+  // schedules of the CTM moves indexed by the direction (edge index),
+  // built by calc_neighbors
+  std::array<std::vector<Plaquette>, 4> move_plaquettes;
+  std::array<std::vector<int>, 4> move_lines;
+
+  // sites of the unit cell in the input mapped onto this unit cell
+  // (empty unless the unit cell has been reduced, see reduce_unitcell.hpp)
+  std::vector<int> input_site_map;
+
   Lattice(int X, int Y, int skew=0);
 
   int x(int index) const { return index % LX; }
   int y(int index) const { return index / LX; }
   int index(int x, int y) const {
-    int X = (x < 0) ? (x % LX + LX) : x % LX;  // c++11 requires neg%pos is neg
-    int Y = (y < 0) ? (y % LY + LY) : y % LY;
+    int X = (x % LX + LX) % LX;  // c++11 requires neg%pos is neg
+    int Y = (y % LY + LY) % LY;
     return X + Y * LX;
   }
 
@@ -79,8 +105,42 @@ class Lattice {
   int top(int index) const { return neighbor(index, 1); }
   int bottom(int index) const { return neighbor(index, 3); }
 
+  int num_input_sites() const {
+    return input_site_map.empty() ? N_UNIT : input_site_map.size();
+  }
+  // site in this unit cell equivalent to the site of the input unit cell
+  int site_of_input(int input_site) const {
+    return input_site_map.empty() ? input_site : input_site_map[input_site];
+  }
+
+  // whether the site is a vacancy, which has no physical degree of freedom
+  // nor bonds. The CTM moves and the measurements take shortcuts through it
+  bool is_vacancy(int index) const {
+    if (physical_dims[index] != 1) {
+      return false;
+    }
+    for (int d : virtual_dims[index]) {
+      if (d != 1) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // site at (dx, dy) from index in O(1)
   int other(int index, int dx, int dy) const;
 
+  // number of plaquettes absorbed by one CTM move in the direction:
+  // left and right moves absorb a column, top and bottom moves a row
+  int move_length(int direction) const { return direction % 2 == 0 ? LY : LX; }
+
+  // plaquette absorbed by the CTM move in the direction
+  // at the column (left, right) or row (top, bottom) `line`
+  // whose site in the line is at `pos` along it
+  Plaquette const &move_plaquette(int direction, int line, int pos) const {
+    return move_plaquettes[direction][line * move_length(direction) + pos];
+  }
+
   void reset(int X, int Y);
   void calc_neighbors();
 
@@ -88,11 +148,15 @@ class Lattice {
 
   void save_append(const char *filename) { save(filename, true); }
 
+  void pack(util::OutArchive &ar) const;
+  void unpack(util::InArchive &ar);
+
   void Bcast(MPI_Comm comm, int root = 0);
 
   void check_dims() const;
 
 private:
+  void calc_move_schedules();
   void logical_check() const;
 };
 
@@ -190,7 +254,7 @@ public:
 
   void Bcast_parameters(MPI_Comm comm) {
     int irank;
-    MPI_Comm_rank(MPI_COMM_WORLD, &irank);
+    MPI_Comm_rank(comm, &irank);
     std::vector<int> params_int(7);
 
     if (irank == 0) {
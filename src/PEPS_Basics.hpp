@@ -26,6 +26,7 @@
 #define _PEPS_BASICS_HPP_
 
 
+#include <algorithm>
 #include <cmath>
 #include <cstdio>
 #include <cstdlib>
@@ -34,7 +35,6 @@
 #include <iostream>
 #include <sstream>
 #include <mptensor/complex.hpp>
-#include <mptensor/rsvd.hpp>
 #include <mptensor/tensor.hpp>
 #include <numeric>
 #include <vector>
@@ -44,12 +44,65 @@
 #include "printlevel.hpp"
 #include "PEPS_Parameters.hpp"
 #include "mpi.hpp"
+#include "local_tensor.hpp"
+#include "tensor.hpp"
+#include "util/philox.hpp"
 
 #include "PEPS_Basics_impl.hpp"
 
 namespace tenes {
 
 using namespace mptensor;
+
+// whether Tn is the site tensor of a vacancy,
+// which has no physical degree of freedom nor bonds (all the dimensions are 1)
+template <template <typename> class Matrix, typename C>
+bool is_vacancy(const Tensor<Matrix, C> &Tn) {
+  const Shape &shape = Tn.shape();
+  for (size_t i = 0; i < shape.size(); ++i) {
+    if (shape[i] != 1) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// relative weight of the discarded part s[n:] of the singular values
+// (of their squares if `squared`)
+inline double discarded_weight(std::vector<double> const &s, size_t n,
+                               bool squared) {
+  double total = 0.0;
+  double discarded = 0.0;
+  for (size_t i = 0; i < s.size(); ++i) {
+    const double w = squared ? s[i] * s[i] : s[i];
+    total += w;
+    if (i >= n) {
+      discarded += w;
+    }
+  }
+  return total > 0.0 ? discarded / total : 0.0;
+}
+
+// smallest number (up to max_dim) of the singular values s to be kept
+// so that the discarded weight of their squares is at most truncation_error
+inline int truncated_dimension(std::vector<double> const &s,
+                               double truncation_error, int max_dim) {
+  double total = 0.0;
+  for (double v : s) {
+    total += v * v;
+  }
+  int n = std::min<int>(max_dim, s.size());
+  double discarded = 0.0;
+  for (size_t i = s.size(); i > 0; --i) {
+    discarded += s[i - 1] * s[i - 1];
+    if (discarded > truncation_error * total) {
+      n = std::min<int>(n, i);
+      break;
+    }
+  }
+  return std::max(n, 1);
+}
+
 // Contractions
 
 template <class tensor>
@@ -493,14 +546,95 @@ class Mult_row_ud {
   const Tensor<Matrix, C> &LB_;
 };
 
+/*
+ * Random test matrices of the randomized SVD
+ *
+ * Each element is given by Philox4x32 from (seed, move, id, element index),
+ * where `move` counts the CTM moves and `id` is the plaquette in the move,
+ * so that the projectors do not depend on the number of processes
+ * nor on the groups computing them.
+ */
+struct RSVD_Random {
+  enum { stream = 2 };  // 0 and 1 are used for the initial tensors
+  util::Philox4x32 philox;
+  uint32_t id;
+
+  RSVD_Random(int seed, uint32_t move, uint32_t id)
+      : philox(util::Philox4x32::key_type{
+            {static_cast<uint32_t>(seed), move}}),
+        id(id) {}
+};
+
+// randomized SVD, A = U * diag(s) * VT (N. Halko, P. G. Martinsson, and
+// J. A. Tropp, SIAM Rev. 53, 217 (2011))
+// A is given by mult_col (A*X) and mult_row (X^T*A) for X with the shapes
+// (shape_col, k) and (shape_row, k), respectively.
+// The range of A is sampled by num_samples random vectors
+// and the largest target_rank singular values are returned.
+template <template <typename> class Matrix, typename C, class Mult_row_type,
+          class Mult_col_type>
+void random_svd(Mult_row_type &mult_row, Mult_col_type &mult_col,
+                const Shape &shape_row, const Shape &shape_col,
+                const typename Tensor<Matrix, C>::comm_type &comm,
+                const RSVD_Random &random, Tensor<Matrix, C> &U,
+                std::vector<double> &s, Tensor<Matrix, C> &VT,
+                size_t target_rank, size_t num_samples) {
+  const size_t nrow = shape_row.size();
+  const size_t ncol = shape_col.size();
+  size_t dim_row = 1, dim_col = 1;
+  for (size_t i = 0; i < nrow; ++i) {
+    dim_row *= shape_row[i];
+  }
+  for (size_t i = 0; i < ncol; ++i) {
+    dim_col *= shape_col[i];
+  }
+  const size_t k = std::min(std::min(dim_row, dim_col),
+                            std::max(num_samples, target_rank));
+
+  Shape shape_omega = shape_col;
+  shape_omega.push(k);
+  Tensor<Matrix, C> omega(comm, shape_omega);
+  const auto strides = detail::c_order_strides(shape_omega);
+  fill_local(omega, [&](Index const &index) {
+    double re, im;
+    random.philox.uniform(RSVD_Random::stream, random.id,
+                          detail::c_order_offset(index, strides), re, im);
+    return convert_complex<C>(std::complex<double>(re, im));
+  });
+
+  // orthonormal basis Q of the range of A*omega
+  Axes axes_row, axes_last;
+  for (size_t i = 0; i < nrow; ++i) {
+    axes_row.push(i);
+  }
+  axes_last.push(nrow);
+  Tensor<Matrix, C> Q, R;
+  qr(mult_col(omega), axes_row, axes_last, Q, R);
+
+  // SVD of Q^dagger * A
+  Axes axes_col;
+  for (size_t i = 0; i < ncol; ++i) {
+    axes_col.push(i + 1);
+  }
+  Tensor<Matrix, C> u;
+  svd(mult_row(conj(Q)), Axes(0), axes_col, u, s, VT);
+  U = tensordot(Q, u, axes_last, Axes(0));
+
+  if (target_rank < k) {
+    U = slice(U, nrow, 0, target_rank);
+    VT = slice(VT, 0, 0, target_rank);
+  }
+}
+
 template <template <typename> class Matrix, typename C>
 void Calc_projector_left_block(
     const Tensor<Matrix, C> &C1, const Tensor<Matrix, C> &C4,
     const Tensor<Matrix, C> &eT1, const Tensor<Matrix, C> &eT6,
     const Tensor<Matrix, C> &eT7, const Tensor<Matrix, C> &eT8,
     const Tensor<Matrix, C> &Tn1, const Tensor<Matrix, C> &Tn4,
-    const PEPS_Parameters peps_parameters, Tensor<Matrix, C> &PU,
-    Tensor<Matrix, C> &PL) {
+    const PEPS_Parameters peps_parameters, const RSVD_Random &random,
+    Tensor<Matrix, C> &PU, Tensor<Matrix, C> &PL,
+    double *discarded_weight = nullptr) {
   // Original (cheaper version of P. Corboz, T.M.Rice and M. Troyer, PRL 113,
   // 046402(2014))
 
@@ -556,8 +690,10 @@ void Calc_projector_left_block(
       Shape shape_col(t34, e56, t34);
 
       /*int info ()= */
-      rsvd(m_row, m_col, shape_row, shape_col, U, s, VT, e78,
-           static_cast<size_t>(peps_parameters.RSVD_Oversampling_factor * e78));
+      random_svd(m_row, m_col, shape_row, shape_col, LT.get_comm(), random, U,
+                 s, VT, e78,
+                 static_cast<size_t>(peps_parameters.RSVD_Oversampling_factor *
+                                     e78));
       double denom = s[0];
 
       for (int i = 0; i < e78; ++i) {
@@ -584,6 +720,10 @@ void Calc_projector_left_block(
       /* int info = */
       svd(tensordot(LT, LB, Axes(1, 3, 5), Axes(0, 2, 4)), Axes(0, 1, 2),
           Axes(3, 4, 5), U, s, VT);
+      if (discarded_weight != nullptr) {
+        *discarded_weight = std::max(*discarded_weight,
+                                     tenes::discarded_weight(s, e78, false));
+      }
       double denom = s[0];
       std::vector<double> s_c;
       s_c.resize(e78);
@@ -608,16 +748,8 @@ void Calc_projector_left_block(
                .transpose(Axes(1, 0, 2, 3));
     }
   } else {
-    Tensor<Matrix, C> identity_matrix(Shape(e78, e78));
-    Index index;
-    for (int i = 0; i < identity_matrix.local_size(); i++) {
-      index = identity_matrix.global_index(i);
-      if (index[0] == index[1]) {
-        identity_matrix.set_value(index, 1.0);
-      } else {
-        identity_matrix.set_value(index, 0.0);
-      }
-    }
+    const auto identity_matrix =
+        make_identity<Tensor<Matrix, C>>(e78, C1.get_comm());
     PU = reshape(identity_matrix, Shape(e78, t41, t41, e78));
     PL = reshape(identity_matrix, Shape(e78, t41, t41, e78));
   }
@@ -633,8 +765,9 @@ void Calc_projector_updown_blocks(
     const Tensor<Matrix, C> &eT7, const Tensor<Matrix, C> &eT8,
     const Tensor<Matrix, C> &Tn1, const Tensor<Matrix, C> &Tn2,
     const Tensor<Matrix, C> &Tn3, const Tensor<Matrix, C> &Tn4,
-    const PEPS_Parameters peps_parameters, Tensor<Matrix, C> &PU,
-    Tensor<Matrix, C> &PL) {
+    const PEPS_Parameters peps_parameters, const RSVD_Random &random,
+    Tensor<Matrix, C> &PU, Tensor<Matrix, C> &PL,
+    double *discarded_weight = nullptr) {
   // based on P. Corboz, T.M.Rice and M. Troyer, PRL 113, 046402(2014)
 
   // comment out for unused variables
@@ -719,8 +852,10 @@ void Calc_projector_updown_blocks(
       Shape shape_col(t23, e34, t23);
 
       /* int info = */
-      rsvd(m_row, m_col, shape_row, shape_col, U, s, VT, e78,
-           static_cast<size_t>(peps_parameters.RSVD_Oversampling_factor * e78));
+      random_svd(m_row, m_col, shape_row, shape_col, LT.get_comm(), random, U,
+                 s, VT, e78,
+                 static_cast<size_t>(peps_parameters.RSVD_Oversampling_factor *
+                                     e78));
       double denom = s[0];
 
       for (int i = 0; i < e78; ++i) {
@@ -752,6 +887,10 @@ void Calc_projector_updown_blocks(
       /* int info = */
       svd(tensordot(R1, R2, Axes(3, 4, 5), Axes(3, 4, 5)), Axes(0, 1, 2),
           Axes(3, 4, 5), U, s, VT);
+      if (discarded_weight != nullptr) {
+        *discarded_weight = std::max(*discarded_weight,
+                                     tenes::discarded_weight(s, e78, false));
+      }
       double denom = s[0];
       std::vector<double> s_c;
       s_c.resize(e78);
@@ -775,16 +914,8 @@ void Calc_projector_updown_blocks(
                .transpose(Axes(1, 0, 2, 3));
     }
   } else {
-    Tensor<Matrix, C> identity_matrix(Shape(e78, e78));
-    Index index;
-    for (int i = 0; i < identity_matrix.local_size(); i++) {
-      index = identity_matrix.global_index(i);
-      if (index[0] == index[1]) {
-        identity_matrix.set_value(index, 1.0);
-      } else {
-        identity_matrix.set_value(index, 0.0);
-      }
-    }
+    const auto identity_matrix =
+        make_identity<Tensor<Matrix, C>>(e78, C1.get_comm());
     PU = reshape(identity_matrix, Shape(e78, t41, t41, e78));
     PL = reshape(identity_matrix, Shape(e78, t41, t41, e78));
   }
@@ -831,13 +962,29 @@ void Calc_Next_eT(const Tensor<Matrix, C> &eT8, const Tensor<Matrix, C> &Tn1,
     ##############################
   */
 
-  eT_out = tensordot(tensordot(Tn1,
-                               tensordot(conj(Tn1),
-                                         tensordot(eT8, PL, Axes(1), Axes(0)),
-                                         Axes(0, 1), Axes(2, 4)),
-                               Axes(0, 1, 4), Axes(4, 5, 2)),
-                     PU, Axes(1, 3, 4), Axes(1, 2, 0))
-               .transpose(Axes(3, 2, 0, 1));
+  if (is_vacancy(Tn1)) {
+    // Tn1 is a scalar and only scales eT_out, which the normalization removes.
+    // The edge is just sandwiched by the projectors as matrices
+    const int e0 = eT8.shape()[0];
+    const int e1 = eT8.shape()[1];
+    const int u = PU.shape()[3];
+    const int l = PL.shape()[3];
+    eT_out = reshape(
+        tensordot(reshape(PU, Shape(e0, u)),
+                  tensordot(reshape(eT8, Shape(e0, e1)),
+                            reshape(PL, Shape(e1, l)), Axes(1), Axes(0)),
+                  Axes(0), Axes(0)),
+        Shape(u, l, 1, 1));
+  } else {
+    eT_out =
+        tensordot(tensordot(Tn1,
+                            tensordot(conj(Tn1),
+                                      tensordot(eT8, PL, Axes(1), Axes(0)),
+                                      Axes(0, 1), Axes(2, 4)),
+                            Axes(0, 1, 4), Axes(4, 5, 2)),
+                  PU, Axes(1, 3, 4), Axes(1, 2, 0))
+            .transpose(Axes(3, 2, 0, 1));
+  }
 
   // normalization
   /*
@@ -853,6 +1000,62 @@ void Calc_Next_eT(const Tensor<Matrix, C> &eT8, const Tensor<Matrix, C> &Tn1,
   eT_out /= max_all;
 }
 
+// for simple update
+// Theta = (R1*R2)*op12 and its truncated SVD
+// When truncation_error > 0, the bond dimension is chosen (up to dc)
+// as the smallest one whose discarded weight is at most truncation_error
+template <template <typename> class Matrix, typename C>
+void Simple_update_theta(const Tensor<Matrix, C> &R1,
+                         const Tensor<Matrix, C> &R2,
+                         const Tensor<Matrix, C> &op12, int dc,
+                         Tensor<Matrix, C> &Uc, Tensor<Matrix, C> &VTc,
+                         std::vector<double> &lambda_c,
+                         double truncation_error = 0.0) {
+  // connect R1, R2, op
+  /*
+    INFO:8 (1,2) Finish 7/8 script=[0, 1, -1, 2, -1]
+    ##############################
+    # ((R1*R2)*op12)
+    # cpu_cost= 22400  memory= 3216
+    # final_bond_order  (c1, c2, m1o, m2o)
+    ##############################
+  */
+  Tensor<Matrix, C> Theta = tensordot(tensordot(R1, R2, Axes(1), Axes(1)), op12,
+                                      Axes(1, 3), Axes(0, 1));
+
+  // svd
+  Tensor<Matrix, C> U, VT;
+  std::vector<double> s;
+  svd(Theta, Axes(0, 2), Axes(1, 3), U, s, VT);
+
+  if (truncation_error > 0.0) {
+    dc = truncated_dimension(s, truncation_error, dc);
+  }
+  lambda_c = std::vector<double>(s.begin(), s.begin() + dc);
+  Uc = slice(U, 2, 0, dc);
+  VTc = slice(VT, 0, 0, dc);
+
+  //  norm =
+  //  std::inner_product(lambda_c.begin(),lambda_c.end(),lambda_c.begin(),0.0);
+
+  double norm = 0.0;
+  for (int i = 0; i < dc; ++i) {
+    norm += lambda_c[i] * lambda_c[i];
+  };
+  norm = sqrt(norm);
+  for (int i = 0; i < dc; ++i) {
+    lambda_c[i] = sqrt(lambda_c[i] / norm);
+  };
+
+  /*for (int i=0; i < VTc.local_size();++i){
+    Index index = VTc.global_index(i);
+    std::cout<<"VTC[i,j]="<<index<<", "<<VTc[i]<<std::endl;
+    }*/
+
+  Uc.multiply_vector(lambda_c, 2);
+  VTc.multiply_vector(lambda_c, 0);
+}
+
 template <template <typename> class Matrix, typename C>
 void Simple_update_bond(const Tensor<Matrix, C> &Tn1,
                         const Tensor<Matrix, C> &Tn2,
@@ -861,7 +1064,8 @@ void Simple_update_bond(const Tensor<Matrix, C> &Tn1,
                         const Tensor<Matrix, C> &op12, const int connect1,
                         const PEPS_Parameters peps_parameters,
                         Tensor<Matrix, C> &Tn1_new, Tensor<Matrix, C> &Tn2_new,
-                        std::vector<double> &lambda_c) {
+                        std::vector<double> &lambda_c, int max_dim = 0) {
+  // max_dim bounds the bond dimension chosen by Simple_truncation_error
   int connect2 = (connect1 + 2) % 4;
 
   std::vector<std::vector<double>> lambda1_inv(4);
@@ -888,7 +1092,11 @@ void Simple_update_bond(const Tensor<Matrix, C> &Tn1,
     }
   };
 
+  const double truncation_error = peps_parameters.Simple_truncation_error;
   int dc = Tn1.shape()[connect1];
+  if (truncation_error > 0.0 && max_dim > 0) {
+    dc = max_dim;
+  }
   Tensor<Matrix, C> Tn1_lambda = Tn1;
   Tensor<Matrix, C> Tn2_lambda = Tn2;
 
@@ -924,46 +1132,32 @@ void Simple_update_bond(const Tensor<Matrix, C> &Tn1,
 
   info = qr(Tn2_lambda, Axes(0, 1, 2), Axes(3, 4), Q2, R2);
 
-  // connect R1, R2, op
-  /*
-    INFO:8 (1,2) Finish 7/8 script=[0, 1, -1, 2, -1]
-    ##############################
-    # ((R1*R2)*op12)
-    # cpu_cost= 22400  memory= 3216
-    # final_bond_order  (c1, c2, m1o, m2o)
-    ##############################
-  */
-  Tensor<Matrix, C> Theta = tensordot(tensordot(R1, R2, Axes(1), Axes(1)), op12,
-                                      Axes(1, 3), Axes(0, 1));
-
-  // svd
-  Tensor<Matrix, C> U, VT;
-  std::vector<double> s;
-  info = svd(Theta, Axes(0, 2), Axes(1, 3), U, s, VT);
-
-  lambda_c = std::vector<double>(s.begin(), s.begin() + dc);
-  Tensor<Matrix, C> Uc = slice(U, 2, 0, dc);
-  Tensor<Matrix, C> VTc = slice(VT, 0, 0, dc);
-
-  //  norm =
-  //  std::inner_product(lambda_c.begin(),lambda_c.end(),lambda_c.begin(),0.0);
-
-  double norm = 0.0;
-  for (int i = 0; i < dc; ++i) {
-    norm += lambda_c[i] * lambda_c[i];
-  };
-  norm = sqrt(norm);
-  for (int i = 0; i < dc; ++i) {
-    lambda_c[i] = sqrt(lambda_c[i] / norm);
-  };
-
-  /*for (int i=0; i < VTc.local_size();++i){
-    Index index = VTc.global_index(i);
-    std::cout<<"VTC[i,j]="<<index<<", "<<VTc[i]<<std::endl;
-    }*/
-
-  Uc.multiply_vector(lambda_c, 2);
-  VTc.multiply_vector(lambda_c, 0);
+  // Theta and its SVD involve only small tensors,
+  // which are computed by the root process and broadcast when small enough
+  Tensor<Matrix, C> Uc, VTc;
+  const size_t theta_size =
+      R1.shape()[0] * R2.shape()[0] * op12.shape()[2] * op12.shape()[3];
+  if (use_local_tensor(theta_size, peps_parameters.local_tensor_threshold)) {
+    const auto comm = Q1.get_comm();
+    int rank = 0;
+    MPI_Comm_rank(comm, &rank);
+    const auto R1_local = to_root(R1);
+    const auto R2_local = to_root(R2);
+    const auto op12_local = to_root(op12);
+    local_tensor_type<C> Uc_local, VTc_local;
+    if (rank == 0) {
+      Simple_update_theta(R1_local, R2_local, op12_local, dc, Uc_local,
+                          VTc_local, lambda_c, truncation_error);
+    }
+    bcast_local(Uc_local, 0, comm);
+    bcast_local(VTc_local, 0, comm);
+    bcast(lambda_c, 0, comm);
+    Uc = to_distributed<Tensor<Matrix, C>>(Uc_local, comm);
+    VTc = to_distributed<Tensor<Matrix, C>>(VTc_local, comm);
+  } else {
+    Simple_update_theta(R1, R2, op12, dc, Uc, VTc, lambda_c,
+                        truncation_error);
+  }
 
   // Remove lambda effects from Qs
   // and create new tensors
@@ -1004,6 +1198,239 @@ void Simple_update_bond(const Tensor<Matrix, C> &Tn1,
   };
 }
 
+namespace detail {
+// legs of a site tensor except for `connect`, in ascending order
+inline std::vector<int> outer_legs(std::vector<int> const &connect) {
+  std::vector<int> legs;
+  for (int leg = 0; leg < 4; ++leg) {
+    if (std::find(connect.begin(), connect.end(), leg) == connect.end()) {
+      legs.push_back(leg);
+    }
+  }
+  return legs;
+}
+
+inline Axes make_axes(std::vector<int> const &v) {
+  Axes axes;
+  for (int i : v) {
+    axes.push(i);
+  }
+  return axes;
+}
+
+// axes which bring a tensor with legs in `order` back to (0, 1, 2, 3, 4)
+inline Axes restore_axes(std::vector<int> const &order) {
+  Axes axes;
+  for (int leg = 0; leg < order.size(); ++leg) {
+    axes.push(std::find(order.begin(), order.end(), leg) - order.begin());
+  }
+  return axes;
+}
+
+// lambda = sqrt(s / |s|) of the leading n singular values
+inline std::vector<double> bond_weights(std::vector<double> const &s, int n) {
+  double norm = 0.0;
+  for (int i = 0; i < n; ++i) {
+    norm += s[i] * s[i];
+  }
+  norm = sqrt(norm);
+  std::vector<double> lambda(n);
+  for (int i = 0; i < n; ++i) {
+    lambda[i] = sqrt(s[i] / norm);
+  }
+  return lambda;
+}
+
+inline std::vector<double> inverse_weights(std::vector<double> const &lambda,
+                                           double cut) {
+  std::vector<double> inv(lambda.size());
+  for (int i = 0; i < lambda.size(); ++i) {
+    inv[i] = lambda[i] > cut ? 1.0 / lambda[i] : 0.0;
+  }
+  return inv;
+}
+
+// Tn multiplied by lambda on the legs except for `connect`
+// and transposed as (outer legs, connect legs, physical leg)
+template <template <typename> class Matrix, typename C>
+Tensor<Matrix, C>
+absorb_outer_lambda(const Tensor<Matrix, C> &Tn,
+                    const std::vector<std::vector<double>> &lambda,
+                    std::vector<int> const &connect) {
+  Tensor<Matrix, C> ret = Tn;
+  std::vector<int> order = outer_legs(connect);
+  for (int leg : order) {
+    ret.multiply_vector(lambda[leg], leg);
+  }
+  order.insert(order.end(), connect.begin(), connect.end());
+  order.push_back(4);
+  ret.transpose(make_axes(order));
+  return ret;
+}
+
+// Q multiplied by the inverse of lambda on the outer legs (leading axes)
+template <template <typename> class Matrix, typename C>
+void remove_outer_lambda(Tensor<Matrix, C> &Q,
+                         const std::vector<std::vector<double>> &lambda,
+                         std::vector<int> const &connect, double cut) {
+  const std::vector<int> outer = outer_legs(connect);
+  for (int i = 0; i < outer.size(); ++i) {
+    Q.multiply_vector(inverse_weights(lambda[outer[i]], cut), i);
+  }
+}
+} // end of namespace detail
+
+// for three-site simple update
+// Theta = (R1*R2*R3)*op123 split by two truncated SVDs into
+// X1 (c1, m1, b12), X2 (b12, c2, m2, b23), and X3 (b23, c3, m3)
+template <template <typename> class Matrix, typename C>
+void Simple_update_threesite_theta(
+    const Tensor<Matrix, C> &R1, const Tensor<Matrix, C> &R2,
+    const Tensor<Matrix, C> &R3, const Tensor<Matrix, C> &op123, int dc12,
+    int dc23, double inverse_lambda_cut, double truncation_error,
+    Tensor<Matrix, C> &X1, Tensor<Matrix, C> &X2, Tensor<Matrix, C> &X3,
+    std::vector<double> &lambda12, std::vector<double> &lambda23) {
+  // R1 (c1, e12, m1), R2 (c2, e21, e23, m2), R3 (c3, e32, m3)
+  // Theta (c1, c2, c3, m1o, m2o, m3o)
+  Tensor<Matrix, C> Theta = tensordot(
+      tensordot(tensordot(R1, R2, Axes(1), Axes(1)), R3, Axes(3), Axes(1)),
+      op123, Axes(1, 3, 5), Axes(0, 1, 2));
+
+  Tensor<Matrix, C> U, VT;
+  std::vector<double> s;
+  svd(Theta, Axes(0, 3), Axes(1, 2, 4, 5), U, s, VT);
+  if (truncation_error > 0.0) {
+    dc12 = truncated_dimension(s, truncation_error, dc12);
+  }
+  lambda12 = detail::bond_weights(s, dc12);
+  X1 = slice(U, 2, 0, dc12);
+  X1.multiply_vector(lambda12, 2);
+
+  // the rest (b12, c2, c3, m2o, m3o) carries the whole weight s / |s|
+  // so that the second SVD gives the weight of the bond 23
+  std::vector<double> w12(dc12);
+  for (int i = 0; i < dc12; ++i) {
+    w12[i] = lambda12[i] * lambda12[i];
+  }
+  Tensor<Matrix, C> M = slice(VT, 0, 0, dc12);
+  M.multiply_vector(w12, 0);
+
+  svd(M, Axes(0, 1, 3), Axes(2, 4), U, s, VT);
+  if (truncation_error > 0.0) {
+    dc23 = truncated_dimension(s, truncation_error, dc23);
+  }
+  lambda23 = detail::bond_weights(s, dc23);
+  X2 = slice(U, 3, 0, dc23);
+  X2.multiply_vector(detail::inverse_weights(lambda12, inverse_lambda_cut), 0);
+  X2.multiply_vector(lambda23, 3);
+  X3 = slice(VT, 0, 0, dc23);
+  X3.multiply_vector(lambda23, 0);
+}
+
+// Simple update of three sites Tn1 -(leg12)- Tn2 -(leg23)- Tn3
+// by a three-site operator op123 (m1, m2, m3, m1o, m2o, m3o)
+// The lambdas are absorbed and the bonds are truncated only once,
+// instead of a chain of two-site updates along the path.
+template <template <typename> class Matrix, typename C>
+void Simple_update_threesite(
+    const Tensor<Matrix, C> &Tn1, const Tensor<Matrix, C> &Tn2,
+    const Tensor<Matrix, C> &Tn3,
+    const std::vector<std::vector<double>> &lambda1,
+    const std::vector<std::vector<double>> &lambda2,
+    const std::vector<std::vector<double>> &lambda3,
+    const Tensor<Matrix, C> &op123, const int leg12, const int leg23,
+    const PEPS_Parameters peps_parameters, Tensor<Matrix, C> &Tn1_new,
+    Tensor<Matrix, C> &Tn2_new, Tensor<Matrix, C> &Tn3_new,
+    std::vector<double> &lambda12, std::vector<double> &lambda23,
+    int max_dim12 = 0, int max_dim23 = 0) {
+  const int leg21 = (leg12 + 2) % 4;
+  const int leg32 = (leg23 + 2) % 4;
+  const std::vector<int> connect1 = {leg12};
+  const std::vector<int> connect2 = {leg21, leg23};
+  const std::vector<int> connect3 = {leg32};
+  const double cut = peps_parameters.Inverse_lambda_cut;
+
+  const double truncation_error = peps_parameters.Simple_truncation_error;
+  int dc12 = Tn1.shape()[leg12];
+  int dc23 = Tn2.shape()[leg23];
+  if (truncation_error > 0.0) {
+    if (max_dim12 > 0) {
+      dc12 = max_dim12;
+    }
+    if (max_dim23 > 0) {
+      dc23 = max_dim23;
+    }
+  }
+
+  // QR
+  Tensor<Matrix, C> Q1, R1, Q2, R2, Q3, R3;
+  qr(detail::absorb_outer_lambda(Tn1, lambda1, connect1), Axes(0, 1, 2),
+     Axes(3, 4), Q1, R1);
+  qr(detail::absorb_outer_lambda(Tn2, lambda2, connect2), Axes(0, 1),
+     Axes(2, 3, 4), Q2, R2);
+  qr(detail::absorb_outer_lambda(Tn3, lambda3, connect3), Axes(0, 1, 2),
+     Axes(3, 4), Q3, R3);
+
+  Tensor<Matrix, C> X1, X2, X3;
+  const size_t theta_size = R1.shape()[0] * R2.shape()[0] * R3.shape()[0] *
+                            op123.shape()[3] * op123.shape()[4] *
+                            op123.shape()[5];
+  if (use_local_tensor(theta_size, peps_parameters.local_tensor_threshold)) {
+    // computed by the root process and broadcast
+    const auto comm = Q1.get_comm();
+    int rank = 0;
+    MPI_Comm_rank(comm, &rank);
+    const auto R1_local = to_root(R1);
+    const auto R2_local = to_root(R2);
+    const auto R3_local = to_root(R3);
+    const auto op123_local = to_root(op123);
+    local_tensor_type<C> X1_local, X2_local, X3_local;
+    if (rank == 0) {
+      Simple_update_threesite_theta(R1_local, R2_local, R3_local, op123_local,
+                                    dc12, dc23, cut, truncation_error,
+                                    X1_local, X2_local, X3_local, lambda12,
+                                    lambda23);
+    }
+    bcast_local(X1_local, 0, comm);
+    bcast_local(X2_local, 0, comm);
+    bcast_local(X3_local, 0, comm);
+    bcast(lambda12, 0, comm);
+    bcast(lambda23, 0, comm);
+    X1 = to_distributed<Tensor<Matrix, C>>(X1_local, comm);
+    X2 = to_distributed<Tensor<Matrix, C>>(X2_local, comm);
+    X3 = to_distributed<Tensor<Matrix, C>>(X3_local, comm);
+  } else {
+    Simple_update_threesite_theta(R1, R2, R3, op123, dc12, dc23, cut,
+                                  truncation_error, X1, X2, X3, lambda12,
+                                  lambda23);
+  }
+
+  // Remove lambda effects from Qs
+  // and create new tensors
+  std::vector<int> order;
+  detail::remove_outer_lambda(Q1, lambda1, connect1, cut);
+  order = detail::outer_legs(connect1);
+  order.push_back(4);
+  order.push_back(leg12);
+  Tn1_new = tensordot(Q1, X1, Axes(3), Axes(0))
+                .transpose(detail::restore_axes(order));
+
+  detail::remove_outer_lambda(Q2, lambda2, connect2, cut);
+  order = detail::outer_legs(connect2);
+  order.push_back(leg21);
+  order.push_back(4);
+  order.push_back(leg23);
+  Tn2_new = tensordot(Q2, X2, Axes(2), Axes(1))
+                .transpose(detail::restore_axes(order));
+
+  detail::remove_outer_lambda(Q3, lambda3, connect3, cut);
+  order = detail::outer_legs(connect3);
+  order.push_back(leg32);
+  order.push_back(4);
+  Tn3_new = tensordot(Q3, X3, Axes(3), Axes(1))
+                .transpose(detail::restore_axes(order));
+}
+
 // for full update
 template <template <typename> class Matrix, typename C>
 Tensor<Matrix, C> Create_Environment_two_sites(
@@ -1040,28 +1467,15 @@ Tensor<Matrix, C> Create_Environment_two_sites(
       .transpose(Axes(3, 1, 2, 0));
 }
 
+// for full update
+// optimizes R1 and R2 for the bond environment
 template <template <typename> class Matrix, typename C>
-void Full_update_bond_horizontal(
-    const Tensor<Matrix, C> &C1, const Tensor<Matrix, C> &C2,
-    const Tensor<Matrix, C> &C3, const Tensor<Matrix, C> &C4,
-    const Tensor<Matrix, C> &eT1, const Tensor<Matrix, C> &eT2,
-    const Tensor<Matrix, C> &eT3, const Tensor<Matrix, C> &eT4,
-    const Tensor<Matrix, C> &eT5, const Tensor<Matrix, C> &eT6,
-    const Tensor<Matrix, C> &Tn1, const Tensor<Matrix, C> &Tn2,
-    const Tensor<Matrix, C> &op12, const PEPS_Parameters peps_parameters,
-    Tensor<Matrix, C> &Tn1_new, Tensor<Matrix, C> &Tn2_new) {
-  Shape Tn1_shape = Tn1.shape();
-  Shape Tn2_shape = Tn2.shape();
-
-  int D_connect = Tn1_shape[2];
-
-  // Connecting [2] bond of Tn1 and [0] bond of Tn2
-  // QR decomposition
-  Tensor<Matrix, C> Q1, R1, Q2, R2;
-
-  int info = qr(Tn1, Axes(0, 1, 3), Axes(2, 4), Q1, R1);
-  info = qr(Tn2, Axes(1, 2, 3), Axes(0, 4), Q2, R2);
-
+void Full_update_optimize_bond(Tensor<Matrix, C> Environment,
+                               const Tensor<Matrix, C> &op12,
+                               const int D_connect,
+                               const PEPS_Parameters &peps_parameters,
+                               Tensor<Matrix, C> &R1, Tensor<Matrix, C> &R2) {
+  int info;
   int envR1 = R1.shape()[0];
   int envR2 = R2.shape()[0];
 
@@ -1077,13 +1491,6 @@ void Full_update_bond_horizontal(
 
   Tensor<Matrix, C> Theta = tensordot(tensordot(R1, R2, Axes(1), Axes(1)), op12,
                                       Axes(1, 3), Axes(0, 1));
-  // Environment
-  // bond order (t1, t2, tc1, tc2)
-
-  Tensor<Matrix, C> Environment =
-      Create_Environment_two_sites(C1, C2, C3, C4, eT1, eT2, eT3, eT4, eT5, eT6,
-                                   Q1, transpose(Q2, Axes(3, 0, 1, 2)));
-
   // Hermite
   Environment =
       0.5 * (Environment + conj(transpose(Environment, Axes(2, 3, 0, 1))));
@@ -1354,6 +1761,61 @@ void Full_update_bond_horizontal(
   VT.multiply_vector(s, 0);
   R1 = tensordot(q1, U, Axes(2), Axes(0));
   R2 = tensordot(q2, VT, Axes(2), Axes(1));
+}
+
+template <template <typename> class Matrix, typename C>
+void Full_update_bond_horizontal(
+    const Tensor<Matrix, C> &C1, const Tensor<Matrix, C> &C2,
+    const Tensor<Matrix, C> &C3, const Tensor<Matrix, C> &C4,
+    const Tensor<Matrix, C> &eT1, const Tensor<Matrix, C> &eT2,
+    const Tensor<Matrix, C> &eT3, const Tensor<Matrix, C> &eT4,
+    const Tensor<Matrix, C> &eT5, const Tensor<Matrix, C> &eT6,
+    const Tensor<Matrix, C> &Tn1, const Tensor<Matrix, C> &Tn2,
+    const Tensor<Matrix, C> &op12, const PEPS_Parameters peps_parameters,
+    Tensor<Matrix, C> &Tn1_new, Tensor<Matrix, C> &Tn2_new) {
+  Shape Tn1_shape = Tn1.shape();
+  Shape Tn2_shape = Tn2.shape();
+
+  int D_connect = Tn1_shape[2];
+
+  // Connecting [2] bond of Tn1 and [0] bond of Tn2
+  // QR decomposition
+  Tensor<Matrix, C> Q1, R1, Q2, R2;
+
+  int info = qr(Tn1, Axes(0, 1, 3), Axes(2, 4), Q1, R1);
+  info = qr(Tn2, Axes(1, 2, 3), Axes(0, 4), Q2, R2);
+
+  // Environment
+  // bond order (t1, t2, tc1, tc2)
+
+  Tensor<Matrix, C> Environment =
+      Create_Environment_two_sites(C1, C2, C3, C4, eT1, eT2, eT3, eT4, eT5, eT6,
+                                   Q1, transpose(Q2, Axes(3, 0, 1, 2)));
+
+  // The optimization of the bond involves only small tensors,
+  // which are computed by the root process and broadcast when small enough
+  const size_t env_size = Environment.shape()[0] * Environment.shape()[1] *
+                          Environment.shape()[2] * Environment.shape()[3];
+  if (use_local_tensor(env_size, peps_parameters.local_tensor_threshold)) {
+    const auto comm = Q1.get_comm();
+    int rank = 0;
+    MPI_Comm_rank(comm, &rank);
+    local_tensor_type<C> R1_local = to_root(R1);
+    local_tensor_type<C> R2_local = to_root(R2);
+    const auto Environment_local = to_root(Environment);
+    const auto op12_local = to_root(op12);
+    if (rank == 0) {
+      Full_update_optimize_bond(Environment_local, op12_local, D_connect,
+                                peps_parameters, R1_local, R2_local);
+    }
+    bcast_local(R1_local, 0, comm);
+    bcast_local(R2_local, 0, comm);
+    R1 = to_distributed<Tensor<Matrix, C>>(R1_local, comm);
+    R2 = to_distributed<Tensor<Matrix, C>>(R2_local, comm);
+  } else {
+    Full_update_optimize_bond(Environment, op12, D_connect, peps_parameters,
+                              R1, R2);
+  }
 
   Tn1_new = tensordot(Q1, R1, Axes(3), Axes(0)).transpose(Axes(0, 1, 4, 2, 3));
   Tn2_new = tensordot(Q2, R2, Axes(3), Axes(0)).transpose(Axes(4, 0, 1, 2, 3));
@@ -1472,6 +1934,22 @@ void Transfer(Tensor<Matrix, C> &A, const Tensor<Matrix, C> &eT1,
   // cpu_cost= 7.5e+06  memory= 192500
   // final_bond_order (e1r, e3r, n1r, n2r)
   ////////////////////////////////////////////////////////////
+  if (is_vacancy(Tn1)) {
+    // (eT1*A*eT3) as matrices scaled by |Tn1|^2
+    const int e1l = eT1.shape()[0];
+    const int e1r = eT1.shape()[1];
+    const int e3r = eT3.shape()[0];
+    const int e3l = eT3.shape()[1];
+    const C weight = trace(Tn1, conj(Tn1), Axes(0, 1, 2, 3, 4),
+                           Axes(0, 1, 2, 3, 4));
+    A = reshape(tensordot(tensordot(reshape(eT1, Shape(e1l, e1r)),
+                                    reshape(A, Shape(e1l, e3l)), Axes(0),
+                                    Axes(0)),
+                          reshape(eT3, Shape(e3r, e3l)), Axes(1), Axes(1)),
+                Shape(e1r, e3r, 1, 1));
+    A *= weight;
+    return;
+  }
   A = transpose(tensordot(eT1,
                           tensordot(Tn1,
                                     tensordot(conj(Tn1),
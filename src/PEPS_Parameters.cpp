@@ -22,6 +22,7 @@
 #include <vector>
 
 #include "mpi.hpp"
+#include "util/archive.hpp"
 
 namespace tenes {
 
@@ -35,6 +36,7 @@ PEPS_Parameters::PEPS_Parameters() {
   // Simple update
   num_simple_step = 0;
   Inverse_lambda_cut = 1e-12;
+  Simple_truncation_error = 0.0;
 
   // Environment
   Inverse_projector_cut = 1e-12;
@@ -43,6 +45,8 @@ PEPS_Parameters::PEPS_Parameters() {
   CTM_Projector_corner = true;
   Use_RSVD = false;
   RSVD_Oversampling_factor = 2.0;
+  CTM_truncation_error = 0.0;
+  CTM_Projector_groups = 1;
 
   // Full update
   num_full_step = 0;
@@ -57,6 +61,7 @@ PEPS_Parameters::PEPS_Parameters() {
 
   // random
   seed = 11;
+  random_generator = "mt19937";
 
   // general
   is_real = false;
@@ -64,129 +69,174 @@ PEPS_Parameters::PEPS_Parameters() {
   to_measure = true;
   tensor_load_dir = "";
   tensor_save_dir = "";
+  tensor_save_env_precision = "double";
+  tensor_load_groups = 1;
   outdir = "output";
+  output_binary = false;
+  measure_groups = 1;
+  local_tensor_threshold = 4096;
 }
 
 #define SAVE_PARAM(name, type) params_##type[I_##name] = static_cast<type>(name)
 #define LOAD_PARAM(name, type) \
   name = static_cast<decltype(name)>(params_##type[I_##name])
 
-void PEPS_Parameters::Bcast(MPI_Comm comm, int root) {
+namespace {
+enum PARAMS_INT_INDEX {
+  I_CHI,
+  I_print_level,
+  I_num_simple_step,
+  I_Max_CTM_Iteration,
+  I_CTM_Projector_corner,
+  I_Use_RSVD,
+  I_CTM_Projector_groups,
+  I_Full_max_iteration,
+  I_Full_Gauge_Fix,
+  I_Full_Use_FastFullUpdate,
+  I_num_full_step,
+  I_Lcor,
+  I_seed,
+  I_is_real,
+  I_to_measure,
+  I_output_binary,
+  I_measure_groups,
+  I_tensor_load_groups,
+  I_local_tensor_threshold,
+
+  N_PARAMS_INT_INDEX,
+};
+enum PARAMS_DOUBLE_INDEX {
+  I_Inverse_lambda_cut,
+  I_Inverse_projector_cut,
+  I_CTM_Convergence_Epsilon,
+  I_Inverse_Env_cut,
+  I_Full_Inverse_precision,
+  I_Full_Convergence_Epsilon,
+  I_RSVD_Oversampling_factor,
+  I_iszero_tol,
+  I_Simple_truncation_error,
+  I_CTM_truncation_error,
+
+  N_PARAMS_DOUBLE_INDEX,
+};
+
+enum PARAMS_STRING_INDEX {
+  I_tensor_load_dir,
+  I_tensor_save_dir,
+  I_outdir,
+  I_tensor_save_env_precision,
+  I_random_generator,
+
+  N_PARAMS_STRING_INDEX,
+};
+} // end of unnamed namespace
+
+void PEPS_Parameters::pack(util::OutArchive &ar) const {
   using std::string;
-
-  enum PARAMS_INT_INDEX {
-    I_CHI,
-    I_print_level,
-    I_num_simple_step,
-    I_Max_CTM_Iteration,
-    I_CTM_Projector_corner,
-    I_Use_RSVD,
-    I_Full_max_iteration,
-    I_Full_Gauge_Fix,
-    I_Full_Use_FastFullUpdate,
-    I_Lcor,
-    I_seed,
-    I_is_real,
-    I_to_measure,
-
-    N_PARAMS_INT_INDEX,
-  };
-  enum PARAMS_DOUBLE_INDEX {
-    I_Inverse_lambda_cut,
-    I_Inverse_projector_cut,
-    I_CTM_Convergence_Epsilon,
-    I_Inverse_Env_cut,
-    I_Full_Inverse_precision,
-    I_Full_Convergence_Epsilon,
-    I_RSVD_Oversampling_factor,
-    I_iszero_tol,
-
-    N_PARAMS_DOUBLE_INDEX,
-  };
-
-  enum PARAMS_STRING_INDEX {
-    I_tensor_load_dir,
-    I_tensor_save_dir,
-    I_outdir,
-
-    N_PARAMS_STRING_INDEX,
-  };
-
-  int irank;
-  MPI_Comm_rank(MPI_COMM_WORLD, &irank);
-
   std::vector<int> params_int(N_PARAMS_INT_INDEX);
   std::vector<double> params_double(N_PARAMS_DOUBLE_INDEX);
   std::vector<std::string> params_string(N_PARAMS_STRING_INDEX);
 
+  SAVE_PARAM(CHI, int);
+  SAVE_PARAM(print_level, int);
+  SAVE_PARAM(num_simple_step, int);
+  SAVE_PARAM(Max_CTM_Iteration, int);
+  SAVE_PARAM(CTM_Projector_corner, int);
+  SAVE_PARAM(Use_RSVD, int);
+  SAVE_PARAM(CTM_Projector_groups, int);
+  SAVE_PARAM(Full_max_iteration, int);
+  SAVE_PARAM(Full_Gauge_Fix, int);
+  SAVE_PARAM(Full_Use_FastFullUpdate, int);
+  SAVE_PARAM(num_full_step, int);
+  SAVE_PARAM(Lcor, int);
+  SAVE_PARAM(seed, int);
+  SAVE_PARAM(random_generator, string);
+
+  SAVE_PARAM(Inverse_lambda_cut, double);
+  SAVE_PARAM(Inverse_projector_cut, double);
+  SAVE_PARAM(CTM_Convergence_Epsilon, double);
+  SAVE_PARAM(Inverse_Env_cut, double);
+  SAVE_PARAM(Full_Inverse_precision, double);
+  SAVE_PARAM(Full_Convergence_Epsilon, double);
+  SAVE_PARAM(RSVD_Oversampling_factor, double);
+  SAVE_PARAM(Simple_truncation_error, double);
+  SAVE_PARAM(CTM_truncation_error, double);
+
+  SAVE_PARAM(is_real, int);
+  SAVE_PARAM(iszero_tol, double);
+  SAVE_PARAM(to_measure, int);
+  SAVE_PARAM(tensor_load_dir, string);
+  SAVE_PARAM(tensor_save_dir, string);
+  SAVE_PARAM(outdir, string);
+  SAVE_PARAM(output_binary, int);
+  SAVE_PARAM(tensor_save_env_precision, string);
+  SAVE_PARAM(tensor_load_groups, int);
+  SAVE_PARAM(measure_groups, int);
+  SAVE_PARAM(local_tensor_threshold, int);
+
+  ar << params_int << params_double << params_string;
+}
+
+void PEPS_Parameters::unpack(util::InArchive &ar) {
+  using std::string;
+  std::vector<int> params_int;
+  std::vector<double> params_double;
+  std::vector<std::string> params_string;
+  ar >> params_int >> params_double >> params_string;
+
+  LOAD_PARAM(CHI, int);
+  LOAD_PARAM(print_level, int);
+  LOAD_PARAM(num_simple_step, int);
+  LOAD_PARAM(Max_CTM_Iteration, int);
+  LOAD_PARAM(CTM_Projector_corner, int);
+  LOAD_PARAM(Use_RSVD, int);
+  LOAD_PARAM(CTM_Projector_groups, int);
+  LOAD_PARAM(Full_max_iteration, int);
+  LOAD_PARAM(Full_Gauge_Fix, int);
+  LOAD_PARAM(Full_Use_FastFullUpdate, int);
+  LOAD_PARAM(num_full_step, int);
+  LOAD_PARAM(Lcor, int);
+  LOAD_PARAM(seed, int);
+  LOAD_PARAM(random_generator, string);
+
+  LOAD_PARAM(Inverse_lambda_cut, double);
+  LOAD_PARAM(Inverse_projector_cut, double);
+  LOAD_PARAM(CTM_Convergence_Epsilon, double);
+  LOAD_PARAM(Inverse_Env_cut, double);
+  LOAD_PARAM(Full_Inverse_precision, double);
+  LOAD_PARAM(Full_Convergence_Epsilon, double);
+  LOAD_PARAM(RSVD_Oversampling_factor, double);
+  LOAD_PARAM(Simple_truncation_error, double);
+  LOAD_PARAM(CTM_truncation_error, double);
+
+  LOAD_PARAM(is_real, int);
+  LOAD_PARAM(iszero_tol, double);
+  LOAD_PARAM(to_measure, int);
+  LOAD_PARAM(tensor_load_dir, string);
+  LOAD_PARAM(tensor_save_dir, string);
+  LOAD_PARAM(outdir, string);
+  LOAD_PARAM(output_binary, int);
+  LOAD_PARAM(tensor_save_env_precision, string);
+  LOAD_PARAM(tensor_load_groups, int);
+  LOAD_PARAM(measure_groups, int);
+  LOAD_PARAM(local_tensor_threshold, int);
+}
+
+void PEPS_Parameters::Bcast(MPI_Comm comm, int root) {
+  int irank;
+  MPI_Comm_rank(comm, &irank);
+
+  // all the parameters are sent by one broadcast
+  std::string buffer;
   if (irank == root) {
-    SAVE_PARAM(CHI, int);
-    SAVE_PARAM(print_level, int);
-    SAVE_PARAM(num_simple_step, int);
-    SAVE_PARAM(Max_CTM_Iteration, int);
-    SAVE_PARAM(CTM_Projector_corner, int);
-    SAVE_PARAM(Use_RSVD, int);
-    SAVE_PARAM(Full_max_iteration, int);
-    SAVE_PARAM(Full_Gauge_Fix, int);
-    SAVE_PARAM(Full_Use_FastFullUpdate, int);
-    SAVE_PARAM(Lcor, int);
-    SAVE_PARAM(seed, int);
-
-    SAVE_PARAM(Inverse_lambda_cut, double);
-    SAVE_PARAM(Inverse_projector_cut, double);
-    SAVE_PARAM(CTM_Convergence_Epsilon, double);
-    SAVE_PARAM(Inverse_Env_cut, double);
-    SAVE_PARAM(Full_Inverse_precision, double);
-    SAVE_PARAM(Full_Convergence_Epsilon, double);
-    SAVE_PARAM(RSVD_Oversampling_factor, double);
-
-    SAVE_PARAM(is_real, int);
-    SAVE_PARAM(iszero_tol, double);
-    SAVE_PARAM(to_measure, int);
-    SAVE_PARAM(tensor_load_dir, string);
-    SAVE_PARAM(tensor_save_dir, string);
-    SAVE_PARAM(outdir, string);
-
-    bcast(params_int, 0, comm);
-    bcast(params_double, 0, comm);
-    bcast(params_string, 0, comm);
-    // MPI_Bcast(&params_int.front(), N_PARAMS_INT_INDEX, MPI_INT, 0, comm);
-    // MPI_Bcast(&params_double.front(), N_PARAMS_DOUBLE_INDEX, MPI_DOUBLE, 0,
-    //           comm);
-  } else {
-    bcast(params_int, 0, comm);
-    bcast(params_double, 0, comm);
-    bcast(params_string, 0, comm);
-    // MPI_Bcast(&params_int.front(), N_PARAMS_INT_INDEX, MPI_INT, 0, comm);
-    // MPI_Bcast(&params_double.front(), N_PARAMS_DOUBLE_INDEX, MPI_DOUBLE, 0,
-    //           comm);
-
-    LOAD_PARAM(CHI, int);
-    LOAD_PARAM(print_level, int);
-    LOAD_PARAM(num_simple_step, int);
-    LOAD_PARAM(Max_CTM_Iteration, int);
-    LOAD_PARAM(CTM_Projector_corner, int);
-    LOAD_PARAM(Use_RSVD, int);
-    LOAD_PARAM(Full_max_iteration, int);
-    LOAD_PARAM(Full_Gauge_Fix, int);
-    LOAD_PARAM(Full_Use_FastFullUpdate, int);
-    LOAD_PARAM(Lcor, int);
-    LOAD_PARAM(seed, int);
-
-    LOAD_PARAM(Inverse_lambda_cut, double);
-    LOAD_PARAM(Inverse_projector_cut, double);
-    LOAD_PARAM(CTM_Convergence_Epsilon, double);
-    LOAD_PARAM(Inverse_Env_cut, double);
-    LOAD_PARAM(Full_Inverse_precision, double);
-    LOAD_PARAM(Full_Convergence_Epsilon, double);
-    LOAD_PARAM(RSVD_Oversampling_factor, double);
-
-    LOAD_PARAM(is_real, int);
-    LOAD_PARAM(iszero_tol, double);
-    LOAD_PARAM(to_measure, int);
-    LOAD_PARAM(tensor_load_dir, string);
-    LOAD_PARAM(tensor_save_dir, string);
-    LOAD_PARAM(outdir, string);
+    util::OutArchive ar;
+    pack(ar);
+    buffer = ar.str();
+  }
+  bcast(buffer, root, comm);
+  if (irank != root) {
+    util::InArchive ar(buffer);
+    unpack(ar);
   }
 }
 
@@ -204,6 +254,7 @@ void PEPS_Parameters::save(const char *filename, bool append) {
   // Simple update
   ofs << "simple_num_step = " << num_simple_step << std::endl;
   ofs << "simple_inverse_lambda_cutoff = " << Inverse_lambda_cut << std::endl;
+  ofs << "simple_truncation_error = " << Simple_truncation_error << std::endl;
 
   ofs << std::endl;
 
@@ -230,16 +281,24 @@ void PEPS_Parameters::save(const char *filename, bool append) {
       << std::endl;
   ofs << "use_rsvd = " << (Use_RSVD ? "true" : "false") << std::endl;
   ofs << "rsvd_oversampling_factor = " << RSVD_Oversampling_factor << std::endl;
+  ofs << "ctm_truncation_error = " << CTM_truncation_error << std::endl;
+  ofs << "ctm_projector_groups = " << CTM_Projector_groups << std::endl;
 
   ofs << std::endl;
 
   ofs << "seed = " << seed << std::endl;
+  ofs << "random_generator = " << random_generator << std::endl;
   ofs << "is_real = " << is_real << std::endl;
   ofs << "iszero_tol = " << iszero_tol << std::endl;
   ofs << "measure = " << to_measure << std::endl;
   ofs << "tensor_load_dir = " << tensor_load_dir << std::endl;
   ofs << "tensor_save_dir = " << tensor_save_dir << std::endl;
+  ofs << "tensor_load_groups = " << tensor_load_groups << std::endl;
   ofs << "outdir = " << outdir << std::endl;
+  ofs << "measure_groups = " << measure_groups << std::endl;
+  ofs << "local_tensor_threshold = " << local_tensor_threshold << std::endl;
+  ofs << "tensor_save_env_precision = " << tensor_save_env_precision << std::endl;
+  ofs << "output_binary = " << (output_binary ? "true" : "false") << std::endl;
 
   ofs.close();
 }
@@ -24,6 +24,11 @@
 
 namespace tenes {
 
+namespace util {
+class OutArchive;
+class InArchive;
+}  // end of namespace util
+
 class PEPS_Parameters {
  public:
   // Tensor
@@ -35,6 +40,7 @@ class PEPS_Parameters {
   // Simple update
   int num_simple_step;
   double Inverse_lambda_cut;
+  double Simple_truncation_error;  // > 0 makes bond dimensions adaptive
 
   // Environment
   double Inverse_projector_cut;
@@ -43,6 +49,8 @@ class PEPS_Parameters {
   bool CTM_Projector_corner;
   bool Use_RSVD;
   double RSVD_Oversampling_factor;
+  double CTM_truncation_error;  // > 0 makes CHI adaptive
+  int CTM_Projector_groups;
 
   // Full update
   int num_full_step;
@@ -58,6 +66,7 @@ class PEPS_Parameters {
 
   // random
   int seed;
+  std::string random_generator;  // "mt19937" or "philox"
 
   // general
   bool is_real;
@@ -65,13 +74,21 @@ class PEPS_Parameters {
   bool to_measure;
   std::string tensor_load_dir;
   std::string tensor_save_dir;
+  std::string tensor_save_env_precision;
+  int tensor_load_groups;
   std::string outdir;
+  bool output_binary;
+  int measure_groups;
+  int local_tensor_threshold;
 
   PEPS_Parameters();
 
   void save(const char *filename, bool append = false);
   void save_append(const char *filename) { save(filename, true); }
 
+  void pack(util::OutArchive &ar) const;
+  void unpack(util::InArchive &ar);
+
   void Bcast(MPI_Comm comm, int root = 0);
 };
 
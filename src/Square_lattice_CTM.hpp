@@ -19,6 +19,7 @@
 
 #include <cmath>
 #include <cstdio>
+#include <algorithm>
 #include <cstdlib>
 #include <fstream>
 #include <iomanip>
@@ -33,6 +34,7 @@
 #include "PEPS_Parameters.hpp"
 #include "mpi.hpp"
 #include "printlevel.hpp"
+#include "task_groups.hpp"
 
 namespace tenes {
 
@@ -45,6 +47,272 @@ namespace tenes {
  */
 
 using namespace mptensor;
+
+/*
+ * Slots for the new tensors of a CTM move.
+ * A move writes the new tensors into the slots while it still reads the old
+ * ones from the environment, and then `commit` swaps the written slots into
+ * the environment, so that no tensors are copied.
+ * The old tensors swapped out are released by `commit`, since the contractions
+ * assign new tensors to the slots and never reuse their storage.
+ */
+template <class tensor> class CTM_Slots {
+ public:
+  void resize(int N_UNIT) {
+    next_.resize(N_UNIT);
+    written_.assign(N_UNIT, false);
+  }
+
+  tensor &operator[](int index) {
+    written_[index] = true;
+    return next_[index];
+  }
+
+  std::vector<tensor> const &tensors() const { return next_; }
+
+  void commit(std::vector<tensor> &env) {
+    for (size_t i = 0; i < next_.size(); ++i) {
+      if (written_[i]) {
+        std::swap(env[i], next_[i]);
+        next_[i] = tensor();
+        written_[i] = false;
+      }
+    }
+  }
+
+ private:
+  std::vector<tensor> next_;
+  std::vector<bool> written_;
+};
+
+/*
+ * Buffers kept over the CTM moves
+ * (the slots are empty between the moves)
+ */
+template <class tensor> struct CTM_Workspace {
+  // projectors of the plaquettes in the absorbed column or row
+  std::vector<tensor> PUs, PLs;
+
+  // new corner and edge tensors,
+  // e.g., C1, C4, and eTl for the left move
+  CTM_Slots<tensor> corner1, corner2, edge;
+
+  // largest weight discarded by the projectors in the current CTM step
+  double discarded_weight = 0.0;
+
+  // number of the CTM moves so far, which labels the random matrices of
+  // the randomized SVD (see RSVD_Random)
+  uint32_t num_moves = 0;
+
+  // groups computing the projectors of the plaquettes in parallel
+  // (nullptr or not split means that all the processes compute every one)
+  TaskGroups const *groups = nullptr;
+
+  void reset(const Lattice &lattice) {
+    const int L = std::max(lattice.LX, lattice.LY);
+    PUs.resize(L);
+    PLs.resize(L);
+    corner1.resize(lattice.N_UNIT);
+    corner2.resize(lattice.N_UNIT);
+    edge.resize(lattice.N_UNIT);
+  }
+};
+
+/*
+ * Projectors of a plaquette absorbed by the CTM move in the direction
+ * (0: left, 1: top, 2: right, 3: bottom)
+ */
+template <template <typename> class Matrix, typename C>
+void Calc_plaquette_projector(int direction, const Plaquette &p,
+                              const std::vector<Tensor<Matrix, C>> &C1,
+                              const std::vector<Tensor<Matrix, C>> &C2,
+                              const std::vector<Tensor<Matrix, C>> &C3,
+                              const std::vector<Tensor<Matrix, C>> &C4,
+                              const std::vector<Tensor<Matrix, C>> &eTt,
+                              const std::vector<Tensor<Matrix, C>> &eTr,
+                              const std::vector<Tensor<Matrix, C>> &eTb,
+                              const std::vector<Tensor<Matrix, C>> &eTl,
+                              const std::vector<Tensor<Matrix, C>> &Tn,
+                              const PEPS_Parameters &peps_parameters,
+                              const RSVD_Random &random,
+                              Tensor<Matrix, C> &PU, Tensor<Matrix, C> &PL,
+                              double *discarded_weight) {
+  const int i = p.i;
+  const int j = p.j;
+  const int k = p.k;
+  const int l = p.l;
+  const bool corner = peps_parameters.CTM_Projector_corner;
+  switch (direction) {
+    case 0:
+      if (corner) {
+        Calc_projector_left_block(C1[i], C4[l], eTt[i], eTb[l], eTl[l], eTl[i],
+                                  Tn[i], Tn[l], peps_parameters, random, PU, PL,
+                                  discarded_weight);
+      } else {
+        Calc_projector_updown_blocks(C1[i], C2[j], C3[k], C4[l], eTt[i],
+                                     eTt[j], eTr[j], eTr[k], eTb[k], eTb[l],
+                                     eTl[l], eTl[i], Tn[i], Tn[j], Tn[k],
+                                     Tn[l], peps_parameters, random, PU, PL,
+                                     discarded_weight);
+      }
+      break;
+    case 1:
+      if (corner) {
+        Calc_projector_left_block(C2[j], C1[i], eTr[j], eTl[i], eTt[i], eTt[j],
+                                  transpose(Tn[j], Axes(1, 2, 3, 0, 4)),
+                                  transpose(Tn[i], Axes(1, 2, 3, 0, 4)),
+                                  peps_parameters, random, PU, PL,
+                                  discarded_weight);
+      } else {
+        Calc_projector_updown_blocks(
+            C2[j], C3[k], C4[l], C1[i], eTr[j], eTr[k], eTb[k], eTb[l], eTl[l],
+            eTl[i], eTt[i], eTt[j], transpose(Tn[j], Axes(1, 2, 3, 0, 4)),
+            transpose(Tn[k], Axes(1, 2, 3, 0, 4)),
+            transpose(Tn[l], Axes(1, 2, 3, 0, 4)),
+            transpose(Tn[i], Axes(1, 2, 3, 0, 4)), peps_parameters, random,
+            PU, PL, discarded_weight);
+      }
+      break;
+    case 2:
+      if (corner) {
+        Calc_projector_left_block(C3[k], C2[j], eTb[k], eTt[j], eTr[j], eTr[k],
+                                  transpose(Tn[k], Axes(2, 3, 0, 1, 4)),
+                                  transpose(Tn[j], Axes(2, 3, 0, 1, 4)),
+                                  peps_parameters, random, PU, PL,
+                                  discarded_weight);
+      } else {
+        Calc_projector_updown_blocks(
+            C3[k], C4[l], C1[i], C2[j], eTb[k], eTb[l], eTl[l], eTl[i], eTt[i],
+            eTt[j], eTr[j], eTr[k], transpose(Tn[k], Axes(2, 3, 0, 1, 4)),
+            transpose(Tn[l], Axes(2, 3, 0, 1, 4)),
+            transpose(Tn[i], Axes(2, 3, 0, 1, 4)),
+            transpose(Tn[j], Axes(2, 3, 0, 1, 4)), peps_parameters, random,
+            PU, PL, discarded_weight);
+      }
+      break;
+    case 3:
+      if (corner) {
+        Calc_projector_left_block(C4[l], C3[k], eTl[l], eTr[k], eTb[k], eTb[l],
+                                  transpose(Tn[l], Axes(3, 0, 1, 2, 4)),
+                                  transpose(Tn[k], Axes(3, 0, 1, 2, 4)),
+                                  peps_parameters, random, PU, PL,
+                                  discarded_weight);
+      } else {
+        Calc_projector_updown_blocks(
+            C4[l], C1[i], C2[j], C3[k], eTl[l], eTl[i], eTt[i], eTt[j], eTr[j],
+            eTr[k], eTb[k], eTb[l], transpose(Tn[l], Axes(3, 0, 1, 2, 4)),
+            transpose(Tn[i], Axes(3, 0, 1, 2, 4)),
+            transpose(Tn[j], Axes(3, 0, 1, 2, 4)),
+            transpose(Tn[k], Axes(3, 0, 1, 2, 4)), peps_parameters, random,
+            PU, PL, discarded_weight);
+      }
+      break;
+  }
+}
+
+/*
+ * Marks the sites of the tensors used by Calc_plaquette_projector
+ * (used[0-3]: C1-C4, used[4-7]: eTt, eTr, eTb, eTl, used[8]: Tn)
+ *
+ * The four sites of the plaquette are at the positions of C1, C2, C3, and C4,
+ * and each of them brings the corner and the two edges there with its Tn.
+ * With CTM_Projector_corner, only the two sites on the absorbing side are used.
+ */
+inline void mark_projector_tensors(int direction, const Plaquette &p,
+                                   bool corner,
+                                   std::vector<std::vector<bool>> &used) {
+  const int sites[4] = {p.i, p.j, p.k, p.l};
+  const int edges[4][2] = {{4, 7}, {4, 5}, {5, 6}, {6, 7}};
+  const bool absorbing[4][4] = {{true, false, false, true},
+                                {true, true, false, false},
+                                {false, true, true, false},
+                                {false, false, true, true}};
+  for (int pos = 0; pos < 4; ++pos) {
+    if (corner && !absorbing[direction][pos]) {
+      continue;
+    }
+    const int site = sites[pos];
+    used[pos][site] = true;
+    used[edges[pos][0]][site] = true;
+    used[edges[pos][1]][site] = true;
+    used[8][site] = true;
+  }
+}
+
+/*
+ * Projectors of the plaquettes absorbed by the CTM move
+ * in the direction at the line into work.PUs and work.PLs
+ *
+ * The projectors of different plaquettes are independent.
+ * When work.groups is split, the plaquettes are assigned to the groups,
+ * each group computes its own projectors from the copies of only the tensors
+ * they use, and the projectors are copied back to all the processes.
+ */
+template <template <typename> class Matrix, typename C>
+void Calc_move_projectors(int direction, int line,
+                          const std::vector<Tensor<Matrix, C>> &C1,
+                          const std::vector<Tensor<Matrix, C>> &C2,
+                          const std::vector<Tensor<Matrix, C>> &C3,
+                          const std::vector<Tensor<Matrix, C>> &C4,
+                          const std::vector<Tensor<Matrix, C>> &eTt,
+                          const std::vector<Tensor<Matrix, C>> &eTr,
+                          const std::vector<Tensor<Matrix, C>> &eTb,
+                          const std::vector<Tensor<Matrix, C>> &eTl,
+                          const std::vector<Tensor<Matrix, C>> &Tn,
+                          const PEPS_Parameters &peps_parameters,
+                          const Lattice &lattice,
+                          CTM_Workspace<Tensor<Matrix, C>> &work) {
+  using tensor = Tensor<Matrix, C>;
+  const int L = lattice.move_length(direction);
+  const uint32_t move = work.num_moves++;
+  TaskGroups const *groups = work.groups;
+  if (groups == nullptr || !groups->is_split()) {
+    for (int pos = 0; pos < L; ++pos) {
+      Calc_plaquette_projector(direction,
+                               lattice.move_plaquette(direction, line, pos), C1,
+                               C2, C3, C4, eTt, eTr, eTb, eTl, Tn,
+                               peps_parameters,
+                               RSVD_Random(peps_parameters.seed, move, pos),
+                               work.PUs[pos], work.PLs[pos],
+                               &work.discarded_weight);
+    }
+    return;
+  }
+
+  const bool corner = peps_parameters.CTM_Projector_corner;
+  std::vector<std::vector<bool>> used(9,
+                                      std::vector<bool>(lattice.N_UNIT, false));
+  std::vector<std::vector<bool>> needed = used;
+  for (int pos = 0; pos < L; ++pos) {
+    const Plaquette &p = lattice.move_plaquette(direction, line, pos);
+    mark_projector_tensors(direction, p, corner, used);
+    if (groups->owns(pos)) {
+      mark_projector_tensors(direction, p, corner, needed);
+    }
+  }
+  const std::vector<tensor> *tensors[9] = {&C1,  &C2,  &C3,  &C4, &eTt,
+                                           &eTr, &eTb, &eTl, &Tn};
+  std::vector<std::vector<tensor>> local(9);
+  for (int a = 0; a < 9; ++a) {
+    local[a] = groups->copy_to_group(*tensors[a], used[a], needed[a]);
+  }
+
+  for (int pos = 0; pos < L; ++pos) {
+    tensor PU, PL;
+    if (groups->owns(pos)) {
+      Calc_plaquette_projector(
+          direction, lattice.move_plaquette(direction, line, pos), local[0],
+          local[1], local[2], local[3], local[4], local[5], local[6], local[7],
+          local[8], peps_parameters,
+          RSVD_Random(peps_parameters.seed, move, pos), PU, PL,
+          &work.discarded_weight);
+    }
+    work.PUs[pos] = groups->copy_from_group(PU, pos);
+    work.PLs[pos] = groups->copy_from_group(PL, pos);
+  }
+  allreduce_max(work.discarded_weight, groups->comm());
+}
+
 template <template <typename> class Matrix, typename C>
 void Left_move(std::vector<Tensor<Matrix, C>> &C1,
                const std::vector<Tensor<Matrix, C>> &C2,
@@ -55,67 +323,36 @@ void Left_move(std::vector<Tensor<Matrix, C>> &C1,
                const std::vector<Tensor<Matrix, C>> &eTb,
                std::vector<Tensor<Matrix, C>> &eTl,
                const std::vector<Tensor<Matrix, C>> &Tn, const int ix,
-               const PEPS_Parameters peps_parameters, const Lattice lattice) {
+               const PEPS_Parameters &peps_parameters, const Lattice &lattice,
+               CTM_Workspace<Tensor<Matrix, C>> &work) {
   /* Do one step left move absoving X=ix column
      part of C1, C4, eTl will be modified */
 
-  std::vector<Tensor<Matrix, C>> PUs, PLs;
-  PUs.resize(lattice.LY);
-  PLs.resize(lattice.LY);
+  std::vector<Tensor<Matrix, C>> &PUs = work.PUs;
+  std::vector<Tensor<Matrix, C>> &PLs = work.PLs;
+  Calc_move_projectors(0, ix, C1, C2, C3, C4, eTt, eTr, eTb, eTl, Tn,
+                       peps_parameters, lattice, work);
+
   int i, j, k, l;
-  for (int iy = 0; iy < lattice.LY; ++iy) {
-    i = lattice.Tensor_list[ix][iy];
-    j = lattice.NN_Tensor[i][2];
-    k = lattice.NN_Tensor[j][3];
-    l = lattice.NN_Tensor[k][0];
-
-    if (peps_parameters.CTM_Projector_corner) {
-      Calc_projector_left_block(C1[i], C4[l], eTt[i], eTb[l], eTl[l], eTl[i],
-                                Tn[i], Tn[l], peps_parameters, PUs[iy],
-                                PLs[iy]);
-    } else {
-      Calc_projector_updown_blocks(C1[i], C2[j], C3[k], C4[l], eTt[i], eTt[j],
-                                   eTr[j], eTr[k], eTb[k], eTb[l], eTl[l],
-                                   eTl[i], Tn[i], Tn[j], Tn[k], Tn[l],
-                                   peps_parameters, PUs[iy], PLs[iy]);
-      /*
-      Index index;
-      for (int i1=0; i1 < PUs[iy].local_size(); ++i1){
-        index = PUs[iy].global_index(i1);
-        if (index[0]==0 && index[1]==0 &&index[2]==0){
-          std::cout<<"PU left " << index << " "<< PUs[iy][i1]<<std::endl;
-        }
-      }
-      for (int i1=0; i1 < PLs[iy].local_size(); ++i1){
-        index = PLs[iy].global_index(i1);
-        if (index[0]==0 && index[1]==0 &&index[2]==0){
-          std::cout<<"PL left " << index << " "<< PLs[iy][i1]<<std::endl;
-        }
-        }*/
-    }
-  }
   // update
-  std::vector<Tensor<Matrix, C>> C1_bak(lattice.N_UNIT), C4_bak(lattice.N_UNIT),
-      eTl_bak(lattice.N_UNIT);
-  for (int num = 0; num < lattice.N_UNIT; num++) {
-    C1_bak[num] = C1[num];
-    C4_bak[num] = C4[num];
-    eTl_bak[num] = eTl[num];
-  }
   int iy_up, iy_down;
   for (int iy = 0; iy < lattice.LY; ++iy) {
-    i = lattice.Tensor_list[ix][iy];
-    j = lattice.NN_Tensor[i][2];
-    k = lattice.NN_Tensor[j][3];
-    l = lattice.NN_Tensor[k][0];
+    const Plaquette &p = lattice.move_plaquette(0, ix, iy);
+    i = p.i;
+    j = p.j;
+    k = p.k;
+    l = p.l;
     iy_up = (iy + 1) % lattice.LY;
     iy_down = (iy - 1 + lattice.LY) % lattice.LY;
 
-    Calc_Next_CTM(C1_bak[i], C4_bak[l], eTt[i], eTb[l], PUs[iy_up],
-                  PLs[iy_down], C1[j], C4[k]);
-    Calc_Next_eT(eTl_bak[i], Tn[i], PUs[iy], PLs[iy_up], eTl[j]);
-    Calc_Next_eT(eTl_bak[l], Tn[l], PUs[iy_down], PLs[iy], eTl[k]);
+    Calc_Next_CTM(C1[i], C4[l], eTt[i], eTb[l], PUs[iy_up], PLs[iy_down],
+                  work.corner1[j], work.corner2[k]);
+    Calc_Next_eT(eTl[i], Tn[i], PUs[iy], PLs[iy_up], work.edge[j]);
+    Calc_Next_eT(eTl[l], Tn[l], PUs[iy_down], PLs[iy], work.edge[k]);
   }
+  work.corner1.commit(C1);
+  work.corner2.commit(C4);
+  work.edge.commit(eTl);
 }
 
 template <template <typename> class Matrix, typename C>
@@ -128,62 +365,41 @@ void Right_move(const std::vector<Tensor<Matrix, C>> &C1,
                 const std::vector<Tensor<Matrix, C>> &eTb,
                 const std::vector<Tensor<Matrix, C>> &eTl,
                 const std::vector<Tensor<Matrix, C>> &Tn, const int ix,
-                const PEPS_Parameters peps_parameters, const Lattice lattice) {
+                const PEPS_Parameters &peps_parameters, const Lattice &lattice,
+                CTM_Workspace<Tensor<Matrix, C>> &work) {
   /*
     Do one step right move absobing X=ix column
     part of C2, C3, eTr will be modified
   */
-  std::vector<Tensor<Matrix, C>> PUs, PLs;
-  PUs.resize(lattice.LY);
-  PLs.resize(lattice.LY);
+  std::vector<Tensor<Matrix, C>> &PUs = work.PUs;
+  std::vector<Tensor<Matrix, C>> &PLs = work.PLs;
+  Calc_move_projectors(2, ix, C1, C2, C3, C4, eTt, eTr, eTb, eTl, Tn,
+                       peps_parameters, lattice, work);
+
   int i, j, k, l;
-  for (int iy = 0; iy < lattice.LY; ++iy) {
-    k = lattice.Tensor_list[ix][iy];
-    l = lattice.NN_Tensor[k][0];
-    i = lattice.NN_Tensor[l][1];
-    j = lattice.NN_Tensor[i][2];
-
-    if (peps_parameters.CTM_Projector_corner) {
-      Calc_projector_left_block(C3[k], C2[j], eTb[k], eTt[j], eTr[j], eTr[k],
-                                transpose(Tn[k], Axes(2, 3, 0, 1, 4)),
-                                transpose(Tn[j], Axes(2, 3, 0, 1, 4)),
-                                peps_parameters, PUs[iy], PLs[iy]);
-    } else {
-      Calc_projector_updown_blocks(
-          C3[k], C4[l], C1[i], C2[j], eTb[k], eTb[l], eTl[l], eTl[i], eTt[i],
-          eTt[j], eTr[j], eTr[k], transpose(Tn[k], Axes(2, 3, 0, 1, 4)),
-          transpose(Tn[l], Axes(2, 3, 0, 1, 4)),
-          transpose(Tn[i], Axes(2, 3, 0, 1, 4)),
-          transpose(Tn[j], Axes(2, 3, 0, 1, 4)), peps_parameters, PUs[iy],
-          PLs[iy]);
-    }
-  }
   // update
-  std::vector<Tensor<Matrix, C>> C2_bak(lattice.N_UNIT), C3_bak(lattice.N_UNIT),
-      eTr_bak(lattice.N_UNIT);
-  for (int num = 0; num < lattice.N_UNIT; num++) {
-    C2_bak[num] = C2[num];
-    C3_bak[num] = C3[num];
-    eTr_bak[num] = eTr[num];
-  }
   int iy_up, iy_down;
   for (int iy = 0; iy < lattice.LY; ++iy) {
-    k = lattice.Tensor_list[ix][iy];
-    l = lattice.NN_Tensor[k][0];
-    i = lattice.NN_Tensor[l][1];
-    j = lattice.NN_Tensor[i][2];
+    const Plaquette &p = lattice.move_plaquette(2, ix, iy);
+    i = p.i;
+    j = p.j;
+    k = p.k;
+    l = p.l;
 
     iy_up = (iy + 1) % lattice.LY;
     iy_down = (iy - 1 + lattice.LY) % lattice.LY;
 
-    Calc_Next_CTM(C3_bak[k], C2_bak[j], eTb[k], eTt[j], PUs[iy_down],
-                  PLs[iy_up], C3[l], C2[i]);
+    Calc_Next_CTM(C3[k], C2[j], eTb[k], eTt[j], PUs[iy_down], PLs[iy_up],
+                  work.corner1[l], work.corner2[i]);
 
-    Calc_Next_eT(eTr_bak[k], transpose(Tn[k], Axes(2, 3, 0, 1, 4)), PUs[iy],
-                 PLs[iy_down], eTr[l]);
-    Calc_Next_eT(eTr_bak[j], transpose(Tn[j], Axes(2, 3, 0, 1, 4)), PUs[iy_up],
-                 PLs[iy], eTr[i]);
+    Calc_Next_eT(eTr[k], transpose(Tn[k], Axes(2, 3, 0, 1, 4)), PUs[iy],
+                 PLs[iy_down], work.edge[l]);
+    Calc_Next_eT(eTr[j], transpose(Tn[j], Axes(2, 3, 0, 1, 4)), PUs[iy_up],
+                 PLs[iy], work.edge[i]);
   }
+  work.corner1.commit(C3);
+  work.corner2.commit(C2);
+  work.edge.commit(eTr);
 }
 
 template <template <typename> class Matrix, typename C>
@@ -196,77 +412,41 @@ void Top_move(std::vector<Tensor<Matrix, C>> &C1,
               const std::vector<Tensor<Matrix, C>> &eTb,
               const std::vector<Tensor<Matrix, C>> &eTl,
               const std::vector<Tensor<Matrix, C>> &Tn, const int iy,
-              const PEPS_Parameters peps_parameters, const Lattice lattice) {
+              const PEPS_Parameters &peps_parameters, const Lattice &lattice,
+              CTM_Workspace<Tensor<Matrix, C>> &work) {
   /*
     ## Do one step top move absobing Y=iy row
     ## part of C1, C2, eTt will be modified
   */
-  std::vector<Tensor<Matrix, C>> PUs, PLs;
-  PUs.resize(lattice.LX);
-  PLs.resize(lattice.LX);
+  std::vector<Tensor<Matrix, C>> &PUs = work.PUs;
+  std::vector<Tensor<Matrix, C>> &PLs = work.PLs;
+  Calc_move_projectors(1, iy, C1, C2, C3, C4, eTt, eTr, eTb, eTl, Tn,
+                       peps_parameters, lattice, work);
+
   int i, j, k, l;
-  for (int ix = 0; ix < lattice.LX; ++ix) {
-    j = lattice.Tensor_list[ix][iy];
-    k = lattice.NN_Tensor[j][3];
-    l = lattice.NN_Tensor[k][0];
-    i = lattice.NN_Tensor[l][1];
-
-    if (peps_parameters.CTM_Projector_corner) {
-      Calc_projector_left_block(C2[j], C1[i], eTr[j], eTl[i], eTt[i], eTt[j],
-                                transpose(Tn[j], Axes(1, 2, 3, 0, 4)),
-                                transpose(Tn[i], Axes(1, 2, 3, 0, 4)),
-                                peps_parameters, PUs[ix], PLs[ix]);
-    } else {
-      Calc_projector_updown_blocks(
-          C2[j], C3[k], C4[l], C1[i], eTr[j], eTr[k], eTb[k], eTb[l], eTl[l],
-          eTl[i], eTt[i], eTt[j], transpose(Tn[j], Axes(1, 2, 3, 0, 4)),
-          transpose(Tn[k], Axes(1, 2, 3, 0, 4)),
-          transpose(Tn[l], Axes(1, 2, 3, 0, 4)),
-          transpose(Tn[i], Axes(1, 2, 3, 0, 4)), peps_parameters, PUs[ix],
-          PLs[ix]);
-
-      /*
-      Index index;
-      for (int i1=0; i1 < PUs[ix].local_size(); ++i1){
-        index = PUs[ix].global_index(i1);
-        if (index[0]==0 && index[1]==0 &&index[2]==0){
-          std::cout<<"PU top " << index << " "<< PUs[ix][i1]<<std::endl;
-        }
-      }
-      for (int i1=0; i1 < PLs[ix].local_size(); ++i1){
-        index = PLs[ix].global_index(i1);
-        if (index[0]==0 && index[1]==0 &&index[2]==0){
-          std::cout<<"PL top " << index << " "<< PLs[ix][i1]<<std::endl;
-        }
-        }*/
-    }
-  }
   // update
-  std::vector<Tensor<Matrix, C>> C1_bak(lattice.N_UNIT), C2_bak(lattice.N_UNIT),
-      eTt_bak(lattice.N_UNIT);
-  for (int num = 0; num < lattice.N_UNIT; num++) {
-    C1_bak[num] = C1[num];
-    C2_bak[num] = C2[num];
-    eTt_bak[num] = eTt[num];
-  }
   int ix_right, ix_left;
   for (int ix = 0; ix < lattice.LX; ++ix) {
-    j = lattice.Tensor_list[ix][iy];
-    k = lattice.NN_Tensor[j][3];
-    l = lattice.NN_Tensor[k][0];
-    i = lattice.NN_Tensor[l][1];
+    const Plaquette &p = lattice.move_plaquette(1, iy, ix);
+    i = p.i;
+    j = p.j;
+    k = p.k;
+    l = p.l;
 
     ix_right = (ix + 1) % lattice.LX;
     ix_left = (ix - 1 + lattice.LX) % lattice.LX;
 
-    Calc_Next_CTM(C2_bak[j], C1_bak[i], eTr[j], eTl[i], PUs[ix_right],
-                  PLs[ix_left], C2[k], C1[l]);
+    Calc_Next_CTM(C2[j], C1[i], eTr[j], eTl[i], PUs[ix_right], PLs[ix_left],
+                  work.corner1[k], work.corner2[l]);
 
-    Calc_Next_eT(eTt_bak[j], transpose(Tn[j], Axes(1, 2, 3, 0, 4)), PUs[ix],
-                 PLs[ix_right], eTt[k]);
-    Calc_Next_eT(eTt_bak[i], transpose(Tn[i], Axes(1, 2, 3, 0, 4)),
-                 PUs[ix_left], PLs[ix], eTt[l]);
+    Calc_Next_eT(eTt[j], transpose(Tn[j], Axes(1, 2, 3, 0, 4)), PUs[ix],
+                 PLs[ix_right], work.edge[k]);
+    Calc_Next_eT(eTt[i], transpose(Tn[i], Axes(1, 2, 3, 0, 4)),
+                 PUs[ix_left], PLs[ix], work.edge[l]);
   }
+  work.corner1.commit(C2);
+  work.corner2.commit(C1);
+  work.edge.commit(eTt);
 }
 template <template <typename> class Matrix, typename C>
 void Bottom_move(const std::vector<Tensor<Matrix, C>> &C1,
@@ -278,64 +458,42 @@ void Bottom_move(const std::vector<Tensor<Matrix, C>> &C1,
                  std::vector<Tensor<Matrix, C>> &eTb,
                  const std::vector<Tensor<Matrix, C>> &eTl,
                  const std::vector<Tensor<Matrix, C>> &Tn, const int iy,
-                 const PEPS_Parameters peps_parameters, const Lattice lattice) {
+                 const PEPS_Parameters &peps_parameters, const Lattice &lattice,
+                 CTM_Workspace<Tensor<Matrix, C>> &work) {
   /*
     ## Do one step bottom move absobing Y=iy row
     ## part of C3, C4, eTb will be modified
   */
 
-  std::vector<Tensor<Matrix, C>> PUs, PLs;
-  PUs.resize(lattice.LX);
-  PLs.resize(lattice.LX);
-  int i, j, k, l;
-  for (int ix = 0; ix < lattice.LX; ++ix) {
-    l = lattice.Tensor_list[ix][iy];
-    i = lattice.NN_Tensor[l][1];
-    j = lattice.NN_Tensor[i][2];
-    k = lattice.NN_Tensor[j][3];
-
-    if (peps_parameters.CTM_Projector_corner) {
-      Calc_projector_left_block(C4[l], C3[k], eTl[l], eTr[k], eTb[k], eTb[l],
-                                transpose(Tn[l], Axes(3, 0, 1, 2, 4)),
-                                transpose(Tn[k], Axes(3, 0, 1, 2, 4)),
-                                peps_parameters, PUs[ix], PLs[ix]);
-    } else {
-      Calc_projector_updown_blocks(
-          C4[l], C1[i], C2[j], C3[k], eTl[l], eTl[i], eTt[i], eTt[j], eTr[j],
-          eTr[k], eTb[k], eTb[l], transpose(Tn[l], Axes(3, 0, 1, 2, 4)),
-          transpose(Tn[i], Axes(3, 0, 1, 2, 4)),
-          transpose(Tn[j], Axes(3, 0, 1, 2, 4)),
-          transpose(Tn[k], Axes(3, 0, 1, 2, 4)), peps_parameters, PUs[ix],
-          PLs[ix]);
-    }
-  }
+  std::vector<Tensor<Matrix, C>> &PUs = work.PUs;
+  std::vector<Tensor<Matrix, C>> &PLs = work.PLs;
+  Calc_move_projectors(3, iy, C1, C2, C3, C4, eTt, eTr, eTb, eTl, Tn,
+                       peps_parameters, lattice, work);
 
+  int i, j, k, l;
   // update
-  std::vector<Tensor<Matrix, C>> C3_bak(lattice.N_UNIT), C4_bak(lattice.N_UNIT),
-      eTb_bak(lattice.N_UNIT);
-  for (int num = 0; num < lattice.N_UNIT; num++) {
-    C3_bak[num] = C3[num];
-    C4_bak[num] = C4[num];
-    eTb_bak[num] = eTb[num];
-  }
   int ix_left, ix_right;
   for (int ix = 0; ix < lattice.LX; ++ix) {
-    l = lattice.Tensor_list[ix][iy];
-    i = lattice.NN_Tensor[l][1];
-    j = lattice.NN_Tensor[i][2];
-    k = lattice.NN_Tensor[j][3];
+    const Plaquette &p = lattice.move_plaquette(3, iy, ix);
+    i = p.i;
+    j = p.j;
+    k = p.k;
+    l = p.l;
 
     ix_right = (ix + 1) % lattice.LX;
     ix_left = (ix - 1 + lattice.LX) % lattice.LX;
 
-    Calc_Next_CTM(C4_bak[l], C3_bak[k], eTl[l], eTr[k], PUs[ix_left],
-                  PLs[ix_right], C4[i], C3[j]);
+    Calc_Next_CTM(C4[l], C3[k], eTl[l], eTr[k], PUs[ix_left], PLs[ix_right],
+                  work.corner1[i], work.corner2[j]);
 
-    Calc_Next_eT(eTb_bak[l], transpose(Tn[l], Axes(3, 0, 1, 2, 4)), PUs[ix],
-                 PLs[ix_left], eTb[i]);
-    Calc_Next_eT(eTb_bak[k], transpose(Tn[k], Axes(3, 0, 1, 2, 4)),
-                 PUs[ix_right], PLs[ix], eTb[j]);
+    Calc_Next_eT(eTb[l], transpose(Tn[l], Axes(3, 0, 1, 2, 4)), PUs[ix],
+                 PLs[ix_left], work.edge[i]);
+    Calc_Next_eT(eTb[k], transpose(Tn[k], Axes(3, 0, 1, 2, 4)),
+                 PUs[ix_right], PLs[ix], work.edge[j]);
   }
+  work.corner1.commit(C4);
+  work.corner2.commit(C3);
+  work.edge.commit(eTb);
 }
 
 template <template <typename> class Matrix, typename C>
@@ -347,8 +505,8 @@ bool Check_Convergence_CTM(const std::vector<Tensor<Matrix, C>> &C1,
                            const std::vector<Tensor<Matrix, C>> &C2_old,
                            const std::vector<Tensor<Matrix, C>> &C3_old,
                            const std::vector<Tensor<Matrix, C>> &C4_old,
-                           const PEPS_Parameters peps_parameters,
-                           const Lattice lattice, double &sig_max) {
+                           const PEPS_Parameters &peps_parameters,
+                           const Lattice &lattice, double &sig_max) {
   sig_max = 0.0;
   bool convergence = true;
   double sig, norm;
@@ -504,8 +662,8 @@ int Calc_CTM_Environment(
     std::vector<Tensor<Matrix, C>> &eTt, std::vector<Tensor<Matrix, C>> &eTr,
     std::vector<Tensor<Matrix, C>> &eTb, std::vector<Tensor<Matrix, C>> &eTl,
     const std::vector<Tensor<Matrix, C>> &Tn,
-    const PEPS_Parameters peps_parameters, const Lattice lattice,
-    bool initialize = true) {
+    const PEPS_Parameters &peps_parameters, const Lattice &lattice,
+    CTM_Workspace<Tensor<Matrix, C>> &work, bool initialize = true) {
   /*
     ## Calc environment tensors
     ## C1,C2,C3,C4 and eTt,eTl,eTr,eTb will be modified
@@ -732,29 +890,30 @@ int Calc_CTM_Environment(
 
   double sig_max = 0.0;
   while ((!convergence) && (count < peps_parameters.Max_CTM_Iteration)) {
+    work.discarded_weight = 0.0;
+
     // left move
-    for (int ix = 0; ix < lattice.LX; ++ix) {
+    for (int ix : lattice.move_lines[0]) {
       Left_move(C1, C2, C3, C4, eTt, eTr, eTb, eTl, Tn, ix, peps_parameters,
-                lattice);
+                lattice, work);
     };
 
     // right move
-    for (int ix = 0; ix > -lattice.LX; --ix) {
-      Right_move(C1, C2, C3, C4, eTt, eTr, eTb, eTl, Tn,
-                 (ix + 1 + lattice.LX) % lattice.LX, peps_parameters, lattice);
+    for (int ix : lattice.move_lines[2]) {
+      Right_move(C1, C2, C3, C4, eTt, eTr, eTb, eTl, Tn, ix, peps_parameters,
+                 lattice, work);
     };
 
     // top move
-    for (int iy = 0; iy > -lattice.LY; --iy) {
-      Top_move(C1, C2, C3, C4, eTt, eTr, eTb, eTl, Tn,
-               (iy + 1 + lattice.LY) % lattice.LY, peps_parameters, lattice);
+    for (int iy : lattice.move_lines[1]) {
+      Top_move(C1, C2, C3, C4, eTt, eTr, eTb, eTl, Tn, iy, peps_parameters,
+               lattice, work);
     };
 
     // bottom move
-
-    for (int iy = 0; iy < lattice.LY; ++iy) {
+    for (int iy : lattice.move_lines[3]) {
       Bottom_move(C1, C2, C3, C4, eTt, eTr, eTb, eTl, Tn, iy, peps_parameters,
-                  lattice);
+                  lattice, work);
     };
 
     convergence =
@@ -0,0 +1,301 @@
+/* TeNeS - Massively parallel tensor network solver /
+/ Copyright (C) 2019- The University of Tokyo */
+
+/* This program is free software: you can redistribute it and/or modify /
+/ it under the terms of the GNU General Public License as published by /
+/ the Free Software Foundation, either version 3 of the License, or /
+/ (at your option) any later version. */
+
+/* This program is distributed in the hope that it will be useful, /
+/ but WITHOUT ANY WARRANTY; without even the implied warranty of /
+/ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the /
+/ GNU General Public License for more details. */
+
+/* You should have received a copy of the GNU General Public License /
+/ along with this program. If not, see http://www.gnu.org/licenses/. */
+
+#ifndef TENES_COMPACT_TENSOR_HPP
+#define TENES_COMPACT_TENSOR_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <mptensor/tensor.hpp>
+
+#include "exception.hpp"
+#include "mpi.hpp"
+#include "tensor.hpp"
+#include "util/binary_array.hpp"
+#include "util/float16.hpp"
+#include "util/type_traits.hpp"
+
+namespace tenes {
+
+/*
+ * Dense tensor file used in checkpoints.
+ * See util::compact_header for the format.
+ */
+
+enum class StoragePrecision { double_precision, single_precision, half_precision };
+
+inline StoragePrecision parse_storage_precision(std::string const &name) {
+  if (name == "double") {
+    return StoragePrecision::double_precision;
+  } else if (name == "single") {
+    return StoragePrecision::single_precision;
+  } else if (name == "half") {
+    return StoragePrecision::half_precision;
+  }
+  throw tenes::input_error("unknown precision: " + name +
+                           " (double, single, or half is supported)");
+}
+
+inline std::string storage_precision_name(StoragePrecision precision) {
+  switch (precision) {
+  case StoragePrecision::double_precision:
+    return "double";
+  case StoragePrecision::single_precision:
+    return "single";
+  case StoragePrecision::half_precision:
+    return "half";
+  }
+  return "";
+}
+
+/*! @brief save a tensor as a dense file
+ *
+ *  Every process encodes the elements of its own local block in the order
+ *  of the file, and all the processes write them by one collective MPI-IO
+ *  call through a file view made of their contiguous runs,
+ *  so no process holds the whole tensor.
+ *  This is a collective operation over the communicator of `A`.
+ *
+ *  @param[in] A
+ *  @param[in] filename
+ *  @param[in] precision
+ */
+template <class ptensor>
+void save_compact(ptensor const &A, std::string const &filename,
+                  StoragePrecision precision) {
+  using value_type = typename ptensor::value_type;
+  const bool is_complex = !std::is_floating_point<value_type>::value;
+  const int ncomp = is_complex ? 2 : 1;
+  auto const &comm = A.get_comm();
+
+  const mptensor::Shape shape = A.shape();
+  const size_t rank = shape.size();
+  const auto strides = detail::c_order_strides(shape);
+
+  // local elements in the order of the file
+  const size_t n = A.local_size();
+  std::vector<std::pair<long, size_t>> offsets(n);
+  double maxabs = 0.0;
+  for (size_t lindex = 0; lindex < n; ++lindex) {
+    offsets[lindex] = std::make_pair(
+        detail::c_order_offset(A.global_index(lindex), strides), lindex);
+    const std::complex<double> v =
+        convert_complex<std::complex<double>>(A[lindex]);
+    maxabs = std::max(maxabs, std::max(std::abs(std::real(v)),
+                                       std::abs(std::imag(v))));
+  }
+  std::sort(offsets.begin(), offsets.end());
+
+  double scale = 1.0;
+  if (precision == StoragePrecision::half_precision) {
+    allreduce_max(maxabs, comm);
+    if (maxabs > 0.0) {
+      scale = maxabs;
+    }
+  }
+
+  std::vector<size_t> dims(rank);
+  for (size_t i = 0; i < rank; ++i) {
+    dims[i] = shape[i];
+  }
+  const std::string header = util::compact_header(
+      storage_precision_name(precision), is_complex, dims, scale);
+  const size_t value_size =
+      precision == StoragePrecision::double_precision
+          ? sizeof(double)
+          : (precision == StoragePrecision::single_precision
+                 ? sizeof(float)
+                 : sizeof(uint16_t));
+  const size_t element_size = ncomp * value_size;
+
+  const double inv_scale = 1.0 / scale;
+  auto encode = [&](double v, char *dst) {
+    if (precision == StoragePrecision::double_precision) {
+      std::memcpy(dst, &v, sizeof(double));
+    } else if (precision == StoragePrecision::single_precision) {
+      const float f = static_cast<float>(v);
+      std::memcpy(dst, &f, sizeof(float));
+    } else {
+      const uint16_t h = util::float_to_half(static_cast<float>(v * inv_scale));
+      std::memcpy(dst, &h, sizeof(uint16_t));
+    }
+  };
+  std::vector<char> buffer(element_size * n);
+  for (size_t k = 0; k < n; ++k) {
+    const std::complex<double> v =
+        convert_complex<std::complex<double>>(A[offsets[k].second]);
+    char *dst = &buffer[element_size * k];
+    encode(std::real(v), dst);
+    if (is_complex) {
+      encode(std::imag(v), dst + value_size);
+    }
+  }
+
+#ifdef _NO_MPI
+  // the only process has all the elements in the order of the file
+  std::ofstream ofs(filename.c_str(), std::ios::binary | std::ios::trunc);
+  ofs.write(header.data(), header.size());
+  ofs.write(buffer.data(), buffer.size());
+  if (!ofs) {
+    throw tenes::runtime_error("cannot write " + filename);
+  }
+#else
+  // contiguous runs of the local elements in the file
+  std::vector<int> lengths;
+  std::vector<MPI_Aint> displacements;
+  for (size_t first = 0; first < n;) {
+    size_t last = first + 1;
+    while (last < n && offsets[last].first == offsets[last - 1].first + 1) {
+      ++last;
+    }
+    lengths.push_back(static_cast<int>(last - first));
+    displacements.push_back(
+        static_cast<MPI_Aint>(element_size * offsets[first].first));
+    first = last;
+  }
+
+  MPI_Datatype element_type, file_type;
+  MPI_Type_contiguous(static_cast<int>(element_size), MPI_BYTE, &element_type);
+  MPI_Type_commit(&element_type);
+  if (lengths.empty()) {
+    // no elements to write
+    MPI_Type_dup(element_type, &file_type);
+  } else {
+    MPI_Type_create_hindexed(static_cast<int>(lengths.size()), lengths.data(),
+                             displacements.data(), element_type, &file_type);
+  }
+  MPI_Type_commit(&file_type);
+
+  int mpirank = 0;
+  MPI_Comm_rank(comm, &mpirank);
+  MPI_File fh;
+  int failed = MPI_File_open(comm, const_cast<char *>(filename.c_str()),
+                             MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL,
+                             &fh) != MPI_SUCCESS;
+  allreduce_sum(failed, comm);
+  if (!failed) {
+    failed = MPI_File_set_size(fh, 0) != MPI_SUCCESS;
+    if (mpirank == 0 && !failed) {
+      failed = MPI_File_write_at(fh, 0, const_cast<char *>(header.data()),
+                                 static_cast<int>(header.size()), MPI_BYTE,
+                                 MPI_STATUS_IGNORE) != MPI_SUCCESS;
+    }
+    const char native[] = "native";
+    failed |= MPI_File_set_view(fh, static_cast<MPI_Offset>(header.size()),
+                                element_type, file_type,
+                                const_cast<char *>(native),
+                                MPI_INFO_NULL) != MPI_SUCCESS;
+    failed |= MPI_File_write_all(fh, buffer.data(), static_cast<int>(n),
+                                 element_type,
+                                 MPI_STATUS_IGNORE) != MPI_SUCCESS;
+    MPI_File_close(&fh);
+    allreduce_sum(failed, comm);
+  }
+  MPI_Type_free(&file_type);
+  MPI_Type_free(&element_type);
+  if (failed) {
+    throw tenes::runtime_error("cannot write " + filename);
+  }
+#endif
+}
+
+/*! @brief whether `filename` is a file saved by save_compact
+ *
+ *  mptensor's own format has no file of this name (only the files of
+ *  each process with suffixes), so this tells the two apart.
+ */
+inline bool is_compact_file(std::string const &filename) {
+  static const std::string magic = "tenes-compact-tensor";
+  std::ifstream ifs(filename.c_str(), std::ios::binary);
+  std::string head(magic.size(), '\0');
+  ifs.read(&head[0], head.size());
+  return ifs && head == magic;
+}
+
+/*! @brief load a tensor saved by save_compact into the given shape
+ *
+ *  Every process maps the file and reads only the elements of its own local
+ *  block, so neither broadcast nor redistribution is needed.
+ *  Elements out of the stored shape are set to zero, and stored elements out
+ *  of the target shape are dropped.
+ *  Elements are promoted into double precision.
+ *
+ *  @param[in] filename
+ *  @param[in] target_shape
+ *  @param[in] comm  communicator over which the tensor is distributed
+ */
+template <class ptensor>
+ptensor load_compact(std::string const &filename,
+                     mptensor::Shape const &target_shape,
+                     typename ptensor::comm_type const &comm) {
+  using value_type = typename ptensor::value_type;
+
+  const auto array = util::BinaryArray::open_compact(filename);
+  const auto &file_shape = array.shape();
+  const size_t rank = target_shape.size();
+  if (file_shape.size() != rank) {
+    std::stringstream ss;
+    ss << "rank of the tensor in " << filename << " is " << file_shape.size()
+       << " but expected " << rank;
+    throw tenes::load_error(ss.str());
+  }
+  const auto strides = array.strides();
+
+  ptensor ret(comm, target_shape);
+  fill_local(ret, [&](mptensor::Index const &index) -> value_type {
+    size_t offset = 0;
+    for (size_t i = 0; i < rank; ++i) {
+      if (static_cast<size_t>(index[i]) >= file_shape[i]) {
+        return value_type(0.0);
+      }
+      offset += index[i] * strides[i];
+    }
+    return convert_complex<value_type>(array.at(offset));
+  });
+  return ret;
+}
+
+/*! @brief load a tensor saved by save_compact
+ *
+ *  @param[in] filename
+ *  @param[in] comm  communicator over which the tensor is distributed
+ */
+template <class ptensor>
+ptensor load_compact(std::string const &filename,
+                     typename ptensor::comm_type const &comm) {
+  const auto array = util::BinaryArray::open_compact(filename);
+  mptensor::Shape shape;
+  for (size_t d : array.shape()) {
+    shape.push(d);
+  }
+  return load_compact<ptensor>(filename, shape, comm);
+}
+
+} // end of namespace tenes
+
+#endif // TENES_COMPACT_TENSOR_HPP
@@ -20,6 +20,8 @@
 #include <tuple>
 #include <vector>
 
+#include "util/archive.hpp"
+
 namespace tenes {
 
 struct Correlation {
@@ -35,6 +37,9 @@ struct CorrelationParameter {
   CorrelationParameter() : r_max(0) {}
   CorrelationParameter(int r_max, std::vector<std::tuple<int, int>> const& ops)
       : r_max(r_max), operators(ops) {}
+
+  void pack(util::OutArchive& ar) const { ar << r_max << operators; }
+  void unpack(util::InArchive& ar) { ar >> r_max >> operators; }
 };
 
 }  // end of namespace tenes
@@ -0,0 +1,289 @@
+/* TeNeS - Massively parallel tensor network solver /
+/ Copyright (C) 2019- The University of Tokyo */
+
+/* This program is free software: you can redistribute it and/or modify /
+/ it under the terms of the GNU General Public License as published by /
+/ the Free Software Foundation, either version 3 of the License, or /
+/ (at your option) any later version. */
+
+/* This program is distributed in the hope that it will be useful, /
+/ but WITHOUT ANY WARRANTY; without even the implied warranty of /
+/ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the /
+/ GNU General Public License for more details. */
+
+/* You should have received a copy of the GNU General Public License /
+/ along with this program. If not, see http://www.gnu.org/licenses/. */
+
+#ifndef TENES_ESTIMATE_HPP
+#define TENES_ESTIMATE_HPP
+
+#include <algorithm>
+#include <cmath>
+
+#include "Lattice.hpp"
+#include "PEPS_Parameters.hpp"
+#include "correlation.hpp"
+
+namespace tenes {
+
+/*! @brief numbers of the operators which determine the cost of a run */
+struct OperatorCounts {
+  int num_simple_updates;    // two-site simple updates
+  int num_threesite_updates; // three-site simple updates
+  int num_full_column;  // full updates of horizontal bonds (left/right moves)
+  int num_full_row;     // full updates of vertical bonds (top/bottom moves)
+  int num_onesite;
+  int num_twosite;
+  OperatorCounts()
+      : num_simple_updates(0), num_threesite_updates(0), num_full_column(0),
+        num_full_row(0), num_onesite(0), num_twosite(0) {}
+};
+
+/*! @brief predicted cost of a run
+ *
+ *  The cost is counted in multiply-adds of the scalar type (real or complex)
+ *  and the memory in bytes summed over all the processes.
+ */
+struct CostEstimate {
+  double simple_update;
+  double full_update;
+  double environment;  // CTM iterations before measurement
+  double observable;
+  double ctm_iteration;  // one CTM iteration (included in the above)
+
+  double tensors;        // site tensors and environment, kept all the time
+  double peak_workspace; // largest temporaries of a kernel
+  double matrix_dim;     // dimension of the largest matrix (CHI * D^2)
+
+  CostEstimate()
+      : simple_update(0.0), full_update(0.0), environment(0.0),
+        observable(0.0), ctm_iteration(0.0), tensors(0.0),
+        peak_workspace(0.0), matrix_dim(0.0) {}
+
+  double total() const {
+    return simple_update + full_update + environment + observable;
+  }
+  double peak_memory() const { return tensors + peak_workspace; }
+};
+
+namespace estimate {
+
+// Costs of the kernels in PEPS_Basics.hpp with the environment bond
+// dimension `chi`, the virtual bond dimension `D`, and the physical
+// dimension `d`.
+// They reproduce the cpu_cost comments of the kernels.
+
+// SVD of an n x n matrix costs about svd_factor * n^3
+constexpr double svd_factor = 10.0;
+
+// (Tn1*(((C1*eT1)*eT8)*Tn1c)), e.g., LT in Calc_projector_left_block
+inline double enlarged_corner(double chi, double D, double d) {
+  return chi * chi * chi * D * D + chi * chi * chi * D * D * D * D +
+         2.0 * chi * chi * D * D * D * D * D * D * d;
+}
+
+// ((Tn1*(Tn1c*(eT8*PL)))*PU) in Calc_Next_eT
+inline double next_edge(double chi, double D, double d) {
+  return 2.0 * chi * chi * chi * D * D * D * D +
+         2.0 * chi * chi * D * D * D * D * D * D * d;
+}
+
+// two corners in Calc_Next_CTM
+inline double next_corners(double chi, double D) {
+  return 4.0 * chi * chi * chi * D * D;
+}
+
+// projectors PU and PL of one plaquette
+inline double projector(double chi, double D, double d,
+                        PEPS_Parameters const &params) {
+  const double n = chi * D * D;
+  const double rank = params.RSVD_Oversampling_factor * chi;
+  double cost = 0.0;
+  if (params.CTM_Projector_corner) {
+    cost += 2.0 * enlarged_corner(chi, D, d);
+    if (params.Use_RSVD) {
+      // products with LT and LB from both sides
+      cost += 4.0 * rank * n * n + svd_factor * rank * rank * n;
+    } else {
+      cost += n * n * n + svd_factor * n * n * n;
+    }
+    cost += 2.0 * n * n * chi;
+  } else {
+    cost += 4.0 * enlarged_corner(chi, D, d);
+    if (params.Use_RSVD) {
+      cost += 8.0 * rank * n * n + svd_factor * rank * rank * n;
+      cost += 4.0 * n * n * chi;
+    } else {
+      cost += 3.0 * n * n * n + svd_factor * n * n * n;
+      cost += 2.0 * n * n * chi;
+    }
+  }
+  return cost;
+}
+
+// one plaquette of a CTM move (projectors and new C and eT)
+inline double ctm_plaquette(double chi, double D, double d,
+                            PEPS_Parameters const &params) {
+  return projector(chi, D, d, params) + next_corners(chi, D) +
+         2.0 * next_edge(chi, D, d);
+}
+
+// two-site simple update (QR of the site tensors and SVD of Theta)
+inline double simple_update_bond(double D, double d) {
+  const double m = D * d;
+  return 4.0 * D * D * D * m * m + svd_factor * m * m * m * d * d * d;
+}
+
+// full update of a bond except the CTM moves after it
+inline double full_update_bond(double chi, double D, double d,
+                               PEPS_Parameters const &params) {
+  const double m = D * d;
+  const double environment =
+      2.0 * (chi * chi * chi * D * D + chi * chi * chi * D * D * D * D +
+             2.0 * chi * chi * D * D * D * D * D * m +
+             chi * chi * chi * D * D * m * m);
+  const double als =
+      2.0 * params.Full_max_iteration * (1.0 + svd_factor) * m * m * m * D * D * D;
+  return 2.0 * D * D * D * m * m + environment + als;
+}
+
+// contraction of a site with its environment (Contract_one_site)
+inline double site_contraction(double chi, double D, double d) {
+  return next_edge(chi, D, d);
+}
+
+} // end of namespace estimate
+
+/*! @brief predicts the cost of a run from the input
+ *
+ *  The cost is the sum of the dominant kernels with the largest bond
+ *  dimensions in the unit cell.
+ *  The CTM iterations are counted as many as Max_CTM_Iteration, so that
+ *  the environment and the full update (without the fast full update) are
+ *  upper bounds.
+ *
+ *  @param[in] params
+ *  @param[in] lattice
+ *  @param[in] corparam
+ *  @param[in] counts
+ */
+inline CostEstimate estimate_cost(PEPS_Parameters const &params,
+                                  Lattice const &lattice,
+                                  CorrelationParameter const &corparam,
+                                  OperatorCounts const &counts) {
+  double D = 1.0, d = 1.0;
+  for (int i = 0; i < lattice.N_UNIT; ++i) {
+    d = std::max(d, static_cast<double>(lattice.physical_dims[i]));
+    for (int leg = 0; leg < 4; ++leg) {
+      D = std::max(D, static_cast<double>(lattice.virtual_dims[i][leg]));
+    }
+  }
+  const double chi = params.CHI;
+  const double N = lattice.N_UNIT;
+  const double elem =
+      params.is_real ? sizeof(double) : 2.0 * sizeof(double);
+
+  const double plaquette = estimate::ctm_plaquette(chi, D, d, params);
+
+  CostEstimate ret;
+  ret.matrix_dim = chi * D * D;
+  // every site is visited once by the moves in each of the four directions
+  ret.ctm_iteration = 4.0 * N * plaquette;
+  const double ctm = params.Max_CTM_Iteration * ret.ctm_iteration;
+
+  ret.simple_update =
+      params.num_simple_step *
+      (counts.num_simple_updates * estimate::simple_update_bond(D, d) +
+       2.0 * counts.num_threesite_updates * estimate::simple_update_bond(D, d));
+
+  if (params.num_full_step > 0) {
+    const int num_full = counts.num_full_column + counts.num_full_row;
+    double step = num_full * estimate::full_update_bond(chi, D, d, params);
+    if (params.Full_Use_FastFullUpdate) {
+      // two moves of a column or a row after each bond
+      step += 2.0 * (counts.num_full_column * lattice.LY +
+                     counts.num_full_row * lattice.LX) *
+              plaquette;
+    } else {
+      step += num_full * ctm;
+    }
+    ret.full_update = ctm + params.num_full_step * step;
+  }
+
+  if (params.to_measure) {
+    ret.environment = ctm;
+    const double site = estimate::site_contraction(chi, D, d);
+    ret.observable = (N + counts.num_onesite) * site +
+                     2.0 * counts.num_twosite * site +
+                     2.0 * N * corparam.r_max * corparam.operators.size() *
+                         site;
+  }
+
+  // C, eT, their copies in the CTM iteration, and the site tensors
+  ret.tensors = elem * N *
+                (d * D * D * D * D + 4.0 * 2.0 * chi * chi +
+                 4.0 * 2.0 * chi * chi * D * D);
+
+  // The enlarged corners (chi^2 D^4 each) with a temporary of the
+  // contraction with a site tensor, or the matrix to be decomposed with
+  // U, VT, and the workspace of the SVD.
+  // Every tensordot may hold transposed copies of its operands.
+  const double corner = chi * chi * D * D * D * D;
+  const double num_corners = params.CTM_Projector_corner ? 2.0 : 4.0;
+  const double building = (num_corners + 1.0 + d) * corner;
+  double decomposition = num_corners * corner;
+  if (params.Use_RSVD) {
+    decomposition +=
+        4.0 * params.RSVD_Oversampling_factor * chi * ret.matrix_dim;
+  } else {
+    decomposition += (params.CTM_Projector_corner ? 4.0 : 6.0) * corner;
+  }
+  ret.peak_workspace = elem * 2.0 * std::max(building, decomposition);
+  return ret;
+}
+
+/*! @brief numbers of nodes, processes, and threads for a run */
+struct Layout {
+  int nodes;
+  int ranks;
+  int threads;
+};
+
+/*! @brief recommends a layout for a run
+ *
+ *  The nodes are as few as the peak memory allows (using 80% of the memory
+ *  of a node).
+ *  The processes are as many as the largest matrix keeps at least
+ *  `min_local_elements` elements on each process, beyond which ScaLAPACK
+ *  spends more time in communication than in computation.
+ *  The rest of the cores of a node run OpenMP threads.
+ *
+ *  @param[in] cost
+ *  @param[in] cores_per_node
+ *  @param[in] node_memory  memory of a node in bytes (0 if unknown)
+ *  @param[in] min_local_elements
+ */
+inline Layout recommend_layout(CostEstimate const &cost, int cores_per_node,
+                               double node_memory,
+                               double min_local_elements = 1.0e6) {
+  cores_per_node = std::max(1, cores_per_node);
+  Layout ret;
+  ret.nodes = 1;
+  if (node_memory > 0.0) {
+    ret.nodes = std::max(
+        1, static_cast<int>(std::ceil(cost.peak_memory() / (0.8 * node_memory))));
+  }
+  const double useful =
+      cost.matrix_dim * cost.matrix_dim / min_local_elements;
+  const int max_ranks = ret.nodes * cores_per_node;
+  ret.ranks = std::max(
+      ret.nodes,
+      static_cast<int>(std::min(static_cast<double>(max_ranks), useful)));
+  const int ranks_per_node = (ret.ranks + ret.nodes - 1) / ret.nodes;
+  ret.threads = std::max(1, cores_per_node / ranks_per_node);
+  return ret;
+}
+
+} // end of namespace tenes
+
+#endif // TENES_ESTIMATE_HPP
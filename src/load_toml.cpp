@@ -15,6 +15,7 @@
 / along with this program. If not, see http://www.gnu.org/licenses/. */
 
 #define _USE_MATH_DEFINES
+#include <iomanip>
 #include <random>
 #include <sys/stat.h>
 #include <tuple>
@@ -28,8 +29,10 @@
 
 #include "Lattice.hpp"
 #include "PEPS_Parameters.hpp"
+#include "compact_tensor.hpp"
 #include "correlation.hpp"
 #include "operator.hpp"
+#include "operator_pack.hpp"
 #include "exception.hpp"
 #include "util/read_tensor.hpp"
 #include "util/string.hpp"
@@ -192,8 +195,22 @@ PEPS_Parameters gen_param(decltype(cpptoml::parse_file("")) param) {
     load_if(pparam.iszero_tol, general, "iszero_tol");
     load_if(pparam.to_measure, general, "measure");
     load_if(pparam.outdir, general, "output");
+    load_if(pparam.output_binary, general, "output_binary");
     load_if(pparam.tensor_load_dir, general, "tensor_load");
     load_if(pparam.tensor_save_dir, general, "tensor_save");
+    load_if(pparam.tensor_save_env_precision, general, "tensor_save_env_precision");
+    parse_storage_precision(pparam.tensor_save_env_precision);
+    load_if(pparam.tensor_load_groups, general, "tensor_load_groups");
+    if (pparam.tensor_load_groups < 1) {
+      std::string msg = "tensor_load_groups must be >= 1";
+      throw tenes::input_error(msg);
+    }
+    load_if(pparam.measure_groups, general, "measure_groups");
+    if (pparam.measure_groups < 1) {
+      std::string msg = "measure_groups must be >= 1";
+      throw tenes::input_error(msg);
+    }
+    load_if(pparam.local_tensor_threshold, general, "local_tensor_threshold");
   }
 
   // Simple update
@@ -201,6 +218,11 @@ PEPS_Parameters gen_param(decltype(cpptoml::parse_file("")) param) {
   if (simple != nullptr) {
     load_if(pparam.num_simple_step, simple, "num_step");
     load_if(pparam.Inverse_lambda_cut, simple, "lambda_cutoff");
+    load_if(pparam.Simple_truncation_error, simple, "truncation_error");
+    if (pparam.Simple_truncation_error < 0.0) {
+      std::string msg = "truncation_error must be >= 0.0";
+      throw tenes::input_error(msg);
+    }
   }
 
   // Full update
@@ -230,17 +252,62 @@ PEPS_Parameters gen_param(decltype(cpptoml::parse_file("")) param) {
       std::string msg = "rsvd_oversampling_factor must be >= 1.0";
       throw tenes::input_error(msg);
     }
+    load_if(pparam.CTM_truncation_error, ctm, "truncation_error");
+    if (pparam.CTM_truncation_error < 0.0) {
+      std::string msg = "truncation_error must be >= 0.0";
+      throw tenes::input_error(msg);
+    }
+    load_if(pparam.CTM_Projector_groups, ctm, "projector_groups");
+    if (pparam.CTM_Projector_groups < 1) {
+      std::string msg = "projector_groups must be >= 1";
+      throw tenes::input_error(msg);
+    }
   }
 
   // random
   auto random = param->get_table("random");
   if (random != nullptr) {
     load_if(pparam.seed, random, "seed");
+    load_if(pparam.random_generator, random, "generator");
+    if (pparam.random_generator != "mt19937" &&
+        pparam.random_generator != "philox") {
+      std::string msg = "generator must be \"mt19937\" or \"philox\"";
+      throw tenes::input_error(msg);
+    }
   }
 
   return pparam;
 }
 
+// overwrites entries in [parameter] of `toml` by those in `overrides`
+// `overrides` has the same structure as [parameter], e.g., {general = {output = "out"}}
+void merge_parameter(decltype(cpptoml::parse_file("")) toml,
+                     decltype(cpptoml::parse_file("")) overrides) {
+  if (overrides == nullptr) {
+    return;
+  }
+  auto param = toml->get_table("parameter");
+  if (param == nullptr) {
+    param = cpptoml::make_table();
+    toml->insert("parameter", param);
+  }
+  for (auto &section : *overrides) {
+    if (!section.second->is_table()) {
+      std::stringstream ss;
+      ss << "parameter override \"" << section.first << "\" is not a table";
+      throw tenes::input_error(ss.str());
+    }
+    auto dst = param->get_table(section.first);
+    if (dst == nullptr) {
+      dst = cpptoml::make_table();
+      param->insert(section.first, dst);
+    }
+    for (auto &kv : *section.second->as_table()) {
+      dst->insert(kv.first, kv.second);
+    }
+  }
+}
+
 std::tuple<int, int, int> read_bond(std::string line) {
   using std::stoi;
   auto words = util::split(util::strip(line));
@@ -264,20 +331,93 @@ std::vector<std::tuple<int, int, int>> read_bonds(std::string str) {
   return ret;
 }
 
+// canonical form of the source of operator elements
+// (OperatorTable::intern does not load a source seen before again)
+std::string elements_key(std::string const &source, mptensor::Shape shape,
+                         double atol) {
+  std::stringstream ss;
+  ss << std::setprecision(17) << atol << ";";
+  for (size_t i = 0; i < shape.size(); ++i) {
+    ss << shape[i] << ",";
+  }
+  ss << ";";
+  std::stringstream ss_src(source);
+  std::string line;
+  while (std::getline(ss_src, line)) {
+    auto fields = util::split(util::strip(util::drop_comment(line)));
+    if (fields.empty()) {
+      continue;
+    }
+    for (auto const &f : fields) {
+      ss << f << " ";
+    }
+    ss << "\n";
+  }
+  return ss.str();
+}
+
+template <class tensor>
+std::shared_ptr<const tensor>
+load_elements(decltype(cpptoml::parse_file("")) param, mptensor::Shape shape,
+              double atol, const char *tablename,
+              OperatorTable<tensor> &table) {
+  auto elements = param->get_as<std::string>("elements");
+  auto elements_file = param->get_as<std::string>("elements_file");
+  if (elements && elements_file) {
+    std::stringstream ss;
+    ss << "Both elements and elements_file are defined in a section "
+       << tablename;
+    throw tenes::input_error(ss.str());
+  }
+  if (elements) {
+    return table.intern("elements:" + elements_key(*elements, shape, atol),
+                        [&]() {
+                          return util::read_tensor<tensor>(
+                              *elements, shape, table.comm(), atol,
+                              table.max_imag_ptr());
+                        });
+  }
+  if (!elements_file) {
+    throw input_error(detail::msg_cannot_find("elements", tablename));
+  }
+  const std::string filename = *elements_file;
+  const std::string ext = ".npy";
+  const bool is_npy =
+      filename.size() >= ext.size() &&
+      filename.compare(filename.size() - ext.size(), ext.size(), ext) == 0;
+  auto format =
+      find_or(param, "elements_format", std::string(is_npy ? "npy" : "raw"));
+  auto dtype = find_or(param, "elements_dtype", std::string("complex128"));
+  const std::string source = format + " " + dtype + " " + filename;
+  return table.intern("file:" + elements_key(source, shape, atol), [&]() {
+    // DenseTensor (see pack_operators) keeps only the reference to the file
+    const typename DenseTensor<double>::FileSource file{filename, format,
+                                                        dtype, atol};
+    return TensorFileReader<tensor>::read(file, shape, table.comm(),
+                                          table.max_imag_ptr());
+  });
+}
+
 template <class tensor>
 Operators<tensor> load_operator(decltype(cpptoml::parse_file("")) param,
                                 int nsites, int nbody, double atol=0.0,
-                                const char* tablename="observable.onesite") {
+                                const char* tablename="observable.onesite",
+                                OperatorTable<tensor> *table=nullptr) {
   assert(nbody == 1 || nbody == 2);
+  OperatorTable<tensor> local_table;
+  if (table == nullptr) {
+    table = &local_table;
+  }
 
-  auto elements = param->get_as<std::string>("elements");
+  const bool elements = param->contains("elements") ||
+                        param->contains("elements_file");
   auto ops = param->get_array_of<int64_t>("ops");
   if(elements && ops){
     std::stringstream ss;
     ss << "Both elements and ops are defined in a section " << tablename;
     throw tenes::input_error(ss.str());
   }
-  tensor A;
+  std::shared_ptr<const tensor> A;
   std::vector<int> op_ind;
   if(nbody==1 && !elements){
     std::stringstream ss;
@@ -307,7 +447,7 @@ Operators<tensor> load_operator(decltype(cpptoml::parse_file("")) param,
     for (int i = 0; i < nbody; ++i) {
       shape.push(shape[i]);
     }
-    A = util::read_tensor<tensor>(*elements, shape, atol);
+    A = load_elements<tensor>(param, shape, atol, tablename, *table);
   }else if(ops){
     op_ind.assign(ops->begin(), ops->end());
   }else{
@@ -360,12 +500,18 @@ template <class tensor>
 Operators<tensor> load_operators(decltype(cpptoml::parse_file("")) param,
                                  int nsites, int nbody,
                                  double atol,
-                                 std::string const &key
+                                 std::string const &key,
+                                 OperatorTable<tensor> *optable = nullptr
                                  ) {
   Operators<tensor> ret;
+  OperatorTable<tensor> local_table;
+  if (optable == nullptr) {
+    optable = &local_table;
+  }
   auto tables = param->get_table_array_qualified(key);
   for (const auto &table : *tables) {
-    auto obs = load_operator<tensor>(table, nsites, nbody, atol, key.c_str());
+    auto obs = load_operator<tensor>(table, nsites, nbody, atol, key.c_str(),
+                                     optable);
     std::copy(obs.begin(), obs.end(), std::back_inserter(ret));
     // std::move(obs.begin(), obs.end(), std::back_inserter(ret));
   }
@@ -373,46 +519,78 @@ Operators<tensor> load_operators(decltype(cpptoml::parse_file("")) param,
 }
 
 template <class tensor>
-NNOperator<tensor> load_nn_operator(decltype(cpptoml::parse_file("")) param, double atol=0.0, const char* tablename="evolution.simple") {
+NNOperator<tensor> load_nn_operator(decltype(cpptoml::parse_file("")) param,
+                                    OperatorTable<tensor> &optable,
+                                    double atol = 0.0,
+                                    const char *tablename = "evolution.simple") {
   auto source_site = find<int>(param, "source_site");
   auto source_leg = find<int>(param, "source_leg");
+
+  // three-site operator along source_site -> (source_leg) -> middle site
+  // -> (next_leg) -> last site
+  const int next_leg = param->get_as<int>("next_leg").value_or(-1);
+  const bool threesite = param->contains("next_leg");
+  if (threesite) {
+    if (std::string(tablename) != "evolution.simple") {
+      std::stringstream ss;
+      ss << tablename << ".next_leg is not supported (only for simple update)";
+      throw input_error(ss.str());
+    }
+    if (next_leg < 0 || next_leg > 3 || next_leg == (source_leg + 2) % 4) {
+      std::stringstream ss;
+      ss << tablename << ".next_leg should be one of 0 to 3 except "
+         << (source_leg + 2) % 4 << " (back to the source site)";
+      throw input_error(ss.str());
+    }
+  }
+
   auto dimensions = param->get_array_of<int64_t>("dimensions");
   if(!dimensions){
     throw input_error(detail::msg_cannot_find("dimensions", tablename));
   }
-  auto elements = find<std::string>(param, "elements");
   auto shape = mptensor::Shape();
   for (auto d : *dimensions) {
     shape.push(d);
   }
-  if(shape.size() != 4){
+  const size_t rank = threesite ? 6 : 4;
+  if(shape.size() != rank){
     std::stringstream ss;
-    ss << tablename << ".dimensions should have 4 integers";
+    ss << tablename << ".dimensions should have " << rank << " integers";
     throw input_error(ss.str());
   }
-  tensor A = util::read_tensor<tensor>(elements, shape, atol);
+  auto A = load_elements<tensor>(param, shape, atol, tablename, optable);
+  if (threesite) {
+    return NNOperator<tensor>(source_site, source_leg, next_leg, A);
+  }
   return NNOperator<tensor>(source_site, source_leg, A);
 }
 
 template <class tensor>
 NNOperators<tensor> load_updates(decltype(cpptoml::parse_file("")) param,
                                  double atol,
-                                 std::string const &key) {
+                                 std::string const &key,
+                                 OperatorTable<tensor> *optable = nullptr) {
   NNOperators<tensor> ret;
+  OperatorTable<tensor> local_table;
+  if (optable == nullptr) {
+    optable = &local_table;
+  }
   auto tables = param->get_table_array_qualified(key);
   for (const auto &table : *tables) {
-    ret.push_back(load_nn_operator<tensor>(table, atol, key.c_str()));
+    ret.push_back(load_nn_operator<tensor>(table, *optable, atol, key.c_str()));
   }
   return ret;
 }
 template <class tensor>
 NNOperators<tensor>
-load_simple_updates(decltype(cpptoml::parse_file("")) param, double atol=0.0) {
-  return load_updates<tensor>(param, atol, "evolution.simple");
+load_simple_updates(decltype(cpptoml::parse_file("")) param, double atol=0.0,
+                    OperatorTable<tensor> *optable = nullptr) {
+  return load_updates<tensor>(param, atol, "evolution.simple", optable);
 }
 template <class tensor>
-NNOperators<tensor> load_full_updates(decltype(cpptoml::parse_file("")) param, double atol=0.0) {
-  return load_updates<tensor>(param, atol, "evolution.full");
+NNOperators<tensor> load_full_updates(decltype(cpptoml::parse_file("")) param, double atol=0.0,
+                                      OperatorTable<tensor> *optable = nullptr) {
+  return load_updates<tensor>(param, atol, "evolution.full", optable);
 }
 
 } // end of namespace tenes
@@ -0,0 +1,163 @@
+/* TeNeS - Massively parallel tensor network solver /
+/ Copyright (C) 2019- The University of Tokyo */
+
+/* This program is free software: you can redistribute it and/or modify /
+/ it under the terms of the GNU General Public License as published by /
+/ the Free Software Foundation, either version 3 of the License, or /
+/ (at your option) any later version. */
+
+/* This program is distributed in the hope that it will be useful, /
+/ but WITHOUT ANY WARRANTY; without even the implied warranty of /
+/ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the /
+/ GNU General Public License for more details. */
+
+/* You should have received a copy of the GNU General Public License /
+/ along with this program. If not, see http://www.gnu.org/licenses/. */
+
+#ifndef TENES_LOCAL_TENSOR_HPP
+#define TENES_LOCAL_TENSOR_HPP
+
+#include <complex>
+#include <vector>
+
+#include <mptensor/tensor.hpp>
+
+#include "mpi.hpp"
+#include "tensor.hpp"
+#include "util/type_traits.hpp"
+
+namespace tenes {
+
+/*! @brief tensor held by one process and computed by LAPACK
+ *
+ *  Small tensors (e.g., the R parts of the site tensors in the simple and
+ *  full updates) are gathered into the root process by to_root,
+ *  and only the root computes the following operations by LAPACK,
+ *  without communication.
+ *  The results are broadcast by bcast_local and converted back by
+ *  to_distributed, so every process has exactly the same results
+ *  (independent computations on every process may differ, e.g.,
+ *  in the signs of singular vectors).
+ */
+template <class T>
+using local_tensor_type = mptensor::Tensor<mptensor::lapack::Matrix, T>;
+
+/*! @brief whether a tensor with `size` elements should be computed by the root
+ *
+ *  @param[in] size       number of elements
+ *  @param[in] threshold  maximum number of elements of local tensors
+ *                        (0 disables local tensors)
+ */
+inline bool use_local_tensor(size_t size, int threshold) {
+#ifdef _NO_MPI
+  return false;
+#else
+  return threshold > 0 && size <= static_cast<size_t>(threshold);
+#endif
+}
+
+namespace detail {
+// all the elements in C order from (offset, real, imag) records
+template <class value_type>
+std::vector<value_type> dense_elements(mptensor::Shape const &shape,
+                                       std::vector<double> const &records) {
+  size_t size = 1;
+  for (size_t i = 0; i < shape.size(); ++i) {
+    size *= shape[i];
+  }
+  std::vector<value_type> dense(size);
+  for (size_t k = 0; k + 2 < records.size(); k += 3) {
+    dense[static_cast<size_t>(records[k])] = convert_complex<value_type>(
+        std::complex<double>(records[k + 1], records[k + 2]));
+  }
+  return dense;
+}
+} // end of namespace detail
+
+/*! @brief gather a distributed tensor into the root process
+ *
+ *  Only the root process of the communicator of `A` has the elements
+ *  (the others have a tensor of the same shape filled with zeros).
+ *  This is a collective operation over the communicator of `A`
+ *  with one gatherv.
+ */
+template <template <typename> class Matrix, class C>
+local_tensor_type<C> to_root(mptensor::Tensor<Matrix, C> const &A,
+                             int root = 0) {
+#ifdef _NO_MPI
+  return A;
+#else
+  std::vector<double> all_records;
+  gatherv(detail::local_records(A), all_records, root, A.get_comm());
+
+  local_tensor_type<C> ret(A.shape());
+  int rank = 0;
+  MPI_Comm_rank(A.get_comm(), &rank);
+  if (rank == root) {
+    fill_local(ret, detail::dense_elements<C>(A.shape(), all_records));
+  }
+  return ret;
+#endif
+}
+
+/*! @brief broadcast a local tensor (including its shape) from root
+ *
+ *  This is a collective operation over `comm`.
+ */
+template <class C>
+void bcast_local(local_tensor_type<C> &A, int root, MPI_Comm comm) {
+#ifndef _NO_MPI
+  int rank = 0;
+  MPI_Comm_rank(comm, &rank);
+  std::vector<int> dims;
+  std::vector<C> dense;
+  if (rank == root) {
+    const mptensor::Shape shape = A.shape();
+    for (size_t i = 0; i < shape.size(); ++i) {
+      dims.push_back(shape[i]);
+    }
+    const auto strides = detail::c_order_strides(shape);
+    dense.resize(A.local_size());
+    for (size_t lindex = 0; lindex < A.local_size(); ++lindex) {
+      dense[detail::c_order_offset(A.global_index(lindex), strides)] =
+          A[lindex];
+    }
+  }
+  bcast(dims, root, comm);
+  bcast(dense, root, comm);
+  if (rank != root) {
+    mptensor::Shape shape;
+    for (int d : dims) {
+      shape.push(d);
+    }
+    A = local_tensor_type<C>(shape);
+    fill_local(A, dense);
+  }
+#endif
+}
+
+/*! @brief distribute a replicated tensor over `comm`
+ *
+ *  Each process takes its local block from its own replica,
+ *  so no communication occurs.
+ */
+template <class ptensor>
+ptensor to_distributed(local_tensor_type<typename ptensor::value_type> const &A,
+                       typename ptensor::comm_type const &comm) {
+#ifdef _NO_MPI
+  return A;
+#else
+  const auto strides = detail::c_order_strides(A.shape());
+  std::vector<typename ptensor::value_type> dense(A.local_size());
+  for (size_t lindex = 0; lindex < A.local_size(); ++lindex) {
+    dense[detail::c_order_offset(A.global_index(lindex), strides)] = A[lindex];
+  }
+  ptensor ret(comm, A.shape());
+  fill_local(ret, dense);
+  return ret;
+#endif
+}
+
+} // end of namespace tenes
+
+#endif // TENES_LOCAL_TENSOR_HPP
@@ -25,6 +25,12 @@
 
 namespace tenes {
 int main_impl(std::string input_filename, MPI_Comm com, PrintLevel print_level);
+int main_sweep(std::string sweep_filename, MPI_Comm com, PrintLevel print_level);
+int main_serve(std::string socket_path, MPI_Comm com, PrintLevel print_level);
+int main_scaling(std::string scaling_filename, MPI_Comm com,
+                 PrintLevel print_level);
+int main_estimate(std::string input_filename, MPI_Comm com,
+                  PrintLevel print_level);
 }
 
 int main(int argc, char **argv) {
@@ -38,6 +44,10 @@ int main(int argc, char **argv) {
     
     Usage:
       tenes [--quiet] <input_toml>
+      tenes [--quiet] --sweep <sweep_toml>
+      tenes [--quiet] --serve <socket>
+      tenes [--quiet] --scaling <scaling_toml>
+      tenes --estimate <input_toml>
       tenes --help
       tenes --version
 
@@ -45,6 +55,10 @@ int main(int argc, char **argv) {
       -h --help       Show this help message.
       -v --version    Show the version.
       -q --quiet      Do not print any messages.
+      -s --sweep      Solve the list of inputs in <sweep_toml>.
+      --serve         Keep running and solve jobs sent to <socket>.
+      --scaling       Time an input over the configurations in <scaling_toml>.
+      --estimate      Predict the cost and the memory of <input_toml> without solving it.
     )";
 
     if (argc == 1) {
@@ -74,17 +88,39 @@ int main(int argc, char **argv) {
     using PrintLevel = tenes::PrintLevel;
 
     PrintLevel print_level = PrintLevel::info;
+    bool is_sweep = false;
+    bool is_serve = false;
+    bool is_scaling = false;
+    bool is_estimate = false;
     std::string input_filename;
     for (int i = 1; i < argc; ++i) {
       std::string opt = argv[i];
       if (opt == "-q" || opt == "--quiet") {
         print_level = PrintLevel::none;
+      } else if (opt == "-s" || opt == "--sweep") {
+        is_sweep = true;
+      } else if (opt == "--serve") {
+        is_serve = true;
+      } else if (opt == "--scaling") {
+        is_scaling = true;
+      } else if (opt == "--estimate") {
+        is_estimate = true;
       } else {
         input_filename = opt;
       }
     }
 
-    status = tenes::main_impl(input_filename, MPI_COMM_WORLD, print_level);
+    if (is_serve) {
+      status = tenes::main_serve(input_filename, MPI_COMM_WORLD, print_level);
+    } else if (is_estimate) {
+      status = tenes::main_estimate(input_filename, MPI_COMM_WORLD, print_level);
+    } else if (is_scaling) {
+      status = tenes::main_scaling(input_filename, MPI_COMM_WORLD, print_level);
+    } else if (is_sweep) {
+      status = tenes::main_sweep(input_filename, MPI_COMM_WORLD, print_level);
+    } else {
+      status = tenes::main_impl(input_filename, MPI_COMM_WORLD, print_level);
+    }
   }catch(const tenes::input_error e){
     if(mpirank==0){
       std::cerr << "[INPUT ERROR]" << std::endl;
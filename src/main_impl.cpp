@@ -14,108 +14,177 @@
 /* You should have received a copy of the GNU General Public License /
 / along with this program. If not, see http://www.gnu.org/licenses/. */
 
+#include <algorithm>
 #include <complex>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <memory>
 #include <numeric>
+#include <sstream>
+#include <thread>
+
+#include <unistd.h>
 
 #include <cpptoml.h>
 
+#ifndef _NO_OMP
+#include <omp.h>
+#endif
+
 #include "printlevel.hpp"
 #include "tensor.hpp"
 #include "Lattice.hpp"
 #include "PEPS_Parameters.hpp"
 #include "load_toml.cpp"
 #include "operator.hpp"
-#include "tenes.hpp"
+#include "operator_pack.hpp"
+#include "reduce_unitcell.hpp"
+#include "task_groups.hpp"
+#include "session.hpp"
+#include "estimate.hpp"
+#include "timer.hpp"
 #include "exception.hpp"
 #include "mpi.hpp"
+#include "util/archive.hpp"
 #include "util/file.hpp"
+#include "util/socket.hpp"
+
+namespace tenes {
 
 namespace {
-tenes::Operators<mptensor::Tensor<tenes::mptensor_matrix_type, double>>
-to_real(tenes::Operators<mptensor::Tensor<tenes::mptensor_matrix_type, std::complex<double>>> const & ops){
-  tenes::Operators<mptensor::Tensor<tenes::mptensor_matrix_type, double>> ret;
-  for(auto const & op: ops){
-    if(op.is_onesite()){
-      mptensor::Tensor<tenes::mptensor_matrix_type, double> A(op.op.shape());
-      for(size_t lindex=0; lindex<op.op.local_size(); ++lindex){
-        A[lindex] = op.op[lindex].real();
-      }
-      ret.emplace_back(op.name, op.group, op.source_site, A);
-    }else if(op.ops_indices.empty()){
-      mptensor::Tensor<tenes::mptensor_matrix_type, double> A(op.op.shape());
-      for(size_t lindex=0; lindex<op.op.local_size(); ++lindex){
-        A[lindex] = op.op[lindex].real();
-      }
-      ret.emplace_back(op.name, op.group, op.source_site, op.dx, op.dy, A);
-      // ret.emplace_back(op.group, op.source_site, op.target_site, op.offset_x, op.offset_y, A);
-    }else{
-      ret.emplace_back(op.name, op.group, op.source_site, op.dx, op.dy, op.ops_indices);
-      // ret.emplace_back(op.group, op.source_site, op.target_site, op.offset_x, op.offset_y, op.ops_indices);
-    }
-  }
-  return ret;
-}
-
-bool is_real(tenes::Operators<mptensor::Tensor<tenes::mptensor_matrix_type, std::complex<double>>> const & ops, double tol){
-  for(auto const& op: ops){
-    if(!op.ops_indices.empty()){ continue; }
-    int res = 0;
-    for(size_t lindex=0; lindex<op.op.local_size(); ++lindex){
-      if(std::abs(op.op[lindex].imag()) > tol){
-        res = 1;
-        break;
-      }
+// number of OpenMP threads used by default
+int max_num_threads() {
+#ifdef _NO_OMP
+  return 1;
+#else
+  return omp_get_max_threads();
+#endif
+}
+
+void prepare_outdir(std::string const &input_filename,
+                    std::string const &outdir, MPI_Comm com) {
+  int mpirank = 0;
+  MPI_Comm_rank(com, &mpirank);
+
+  bool is_ok = true;
+  if (mpirank == 0) {
+    if(!util::isdir(outdir)){
+      is_ok = util::mkdir(outdir);
     }
-    tenes::allreduce_sum(res, op.op.get_comm());
-    if(res>0){
-      return false;
+  }
+  bcast(is_ok, 0, com);
+  if(!is_ok){
+    std::stringstream ss;
+    ss << "Cannot mkdir " << outdir;
+    throw tenes::runtime_error(ss.str());
+  }
+
+  if (mpirank == 0) {
+    std::string basename = util::basename(input_filename);
+    std::ifstream ifs(input_filename.c_str());
+    std::string dst_filename = outdir + "/" + basename;
+    std::ofstream ofs(dst_filename.c_str());
+    std::string line;
+    while (std::getline(ifs, line)){
+      ofs << line << std::endl;
     }
   }
-  return true;
 }
 
-tenes::NNOperators<mptensor::Tensor<tenes::mptensor_matrix_type, double>>
-to_real(tenes::NNOperators<mptensor::Tensor<tenes::mptensor_matrix_type, std::complex<double>>> const & ops){
-  tenes::NNOperators<mptensor::Tensor<tenes::mptensor_matrix_type, double>> ret;
-  for(auto const & op: ops){
-    mptensor::Tensor<tenes::mptensor_matrix_type, double> A(op.op.shape());
-    for(size_t lindex=0; lindex<op.op.local_size(); ++lindex){
-      A[lindex] = op.op[lindex].real();
-    }
-    ret.emplace_back(op.source_site, op.source_leg, A);
+// kinds of exceptions sent from the root process
+enum class ErrorKind : int { none, input, load, runtime, logic };
+
+// calls `f` and packs its result or the exception thrown by it
+template <class F> std::string pack_result(F f) {
+  util::OutArchive ar;
+  try {
+    const std::string result = f();
+    ar << static_cast<int>(ErrorKind::none) << result;
+  } catch (tenes::input_error const &e) {
+    ar << static_cast<int>(ErrorKind::input) << std::string(e.what());
+  } catch (tenes::load_error const &e) {
+    ar << static_cast<int>(ErrorKind::load) << std::string(e.what());
+  } catch (tenes::logic_error const &e) {
+    ar << static_cast<int>(ErrorKind::logic) << std::string(e.what());
+  } catch (std::exception const &e) {
+    ar << static_cast<int>(ErrorKind::runtime) << std::string(e.what());
   }
-  return ret;
+  return ar.str();
 }
 
-bool is_real(tenes::NNOperators<mptensor::Tensor<tenes::mptensor_matrix_type, std::complex<double>>> const & ops, double tol){
-  for(auto const& op: ops){
-    int res = 0;
-    for(size_t lindex=0; lindex<op.op.local_size(); ++lindex){
-      if(std::abs(op.op[lindex].imag()) > tol){
-        res = 1;
-        break;
-      }
-    }
-    tenes::allreduce_sum(res, op.op.get_comm());
-    if(res>0){
-      return false;
-    }
+// returns the result packed by pack_result or rethrows the exception
+std::string unpack_result(util::InArchive &ar) {
+  int kind = 0;
+  std::string result;
+  ar >> kind >> result;
+  switch (static_cast<ErrorKind>(kind)) {
+  case ErrorKind::none:
+    break;
+  case ErrorKind::input:
+    throw tenes::input_error(result);
+  case ErrorKind::load:
+    throw tenes::load_error(result);
+  case ErrorKind::logic:
+    throw tenes::logic_error(result);
+  case ErrorKind::runtime:
+    throw tenes::runtime_error(result);
   }
-  return true;
+  return result;
 }
 
-} // end of unnamed namespace
+// reads all the operators as dense tensors of `T` and serializes them
+// operators in files (elements_file) are left in the files, and each process
+// reads its own local blocks when they are unpacked
+// if `reduce` is true, the unit cell of `lattice` is reduced if possible
+template <class T>
+void pack_input_operators(util::OutArchive &ar,
+                          decltype(cpptoml::parse_file("")) input_toml,
+                          PEPS_Parameters const &peps_parameters,
+                          Lattice &lattice, bool reduce) {
+  using dense = DenseTensor<T>;
+  const double tol = peps_parameters.iszero_tol;
 
+  // operators with the same elements share one tensor
+  OperatorTable<dense> optable;
+  OperatorSet<dense> ops;
+  ops.simple_updates = load_simple_updates<dense>(input_toml, 0.0, &optable);
+  ops.full_updates = load_full_updates<dense>(input_toml, 0.0, &optable);
+  ops.onesite_operators = load_operators<dense>(input_toml, lattice.N_UNIT, 1, tol, "observable.onesite", &optable);
+  ops.twosite_operators = load_operators<dense>(input_toml, lattice.N_UNIT, 2, tol, "observable.twosite", &optable);
 
-namespace tenes {
+  // imaginary parts are dropped while loading in real mode
+  // (those of the operators in files are checked by unpack_operators)
+  if (peps_parameters.is_real) {
+    check_real_operators(optable.max_imag(), tol);
+  }
 
-int main_impl(std::string input_filename, MPI_Comm com, PrintLevel print_level=PrintLevel::info) {
-  using tensor_complex = mptensor::Tensor<mptensor_matrix_type, std::complex<double>>;
+  if (reduce) {
+    const int LX = lattice.LX;
+    const int LY = lattice.LY;
+    if (detail::has_random_site(lattice)) {
+      if (peps_parameters.print_level >= PrintLevel::info) {
+        std::cout << "WARNING: unit cell is not reduced since some sites "
+                     "have random initial states or noises"
+                  << std::endl;
+      }
+    } else if (reduce_unitcell(lattice, ops) &&
+               peps_parameters.print_level >= PrintLevel::info) {
+      std::cout << "Unit cell reduced from " << LX << "x" << LY << " to "
+                << lattice.LX << "x" << lattice.LY << " (skew "
+                << lattice.skew << ")" << std::endl;
+    }
+  }
 
-  int mpisize = 0, mpirank = 0;
-  MPI_Comm_rank(com, &mpirank);
-  MPI_Comm_size(com, &mpisize);
+  pack_operators(ar, ops, peps_parameters.is_real ? tol : -1.0);
+}
 
+// reads the input file and serializes the whole problem
+std::string read_input(std::string const &input_filename,
+                       decltype(cpptoml::parse_file("")) overrides,
+                       PrintLevel print_level) {
   if (!util::path_exists(input_filename)) {
     std::stringstream ss;
     ss << "ERROR: cannot find the input file: " << input_filename
@@ -124,20 +193,20 @@ int main_impl(std::string input_filename, MPI_Comm com, PrintLevel print_level=P
   }
 
   auto input_toml = cpptoml::parse_file(input_filename);
+  merge_parameter(input_toml, overrides);
 
   // Parameters
   auto toml_param = input_toml->get_table("parameter");
   PEPS_Parameters peps_parameters =
       (toml_param != nullptr ? gen_param(toml_param) : PEPS_Parameters());
   peps_parameters.print_level = print_level;
-  peps_parameters.Bcast(MPI_COMM_WORLD);
 
   auto toml_lattice = input_toml->get_table("tensor");
   if (toml_lattice == nullptr) {
     throw tenes::input_error("[tensor] not found");
   }
   Lattice lattice = gen_lattice(toml_lattice);
-  lattice.Bcast(MPI_COMM_WORLD);
+  const bool reduce = find_or<bool>(toml_lattice, "reduce_unitcell", false);
 
   // time evolution
   auto toml_evolution = input_toml->get_table("evolution");
@@ -145,74 +214,890 @@ int main_impl(std::string input_filename, MPI_Comm com, PrintLevel print_level=P
     throw tenes::input_error("[evolution] not found");
   }
 
-  const double tol = peps_parameters.iszero_tol;
-
-  const auto simple_updates = load_simple_updates<tensor_complex>(input_toml);
-  const auto full_updates = load_full_updates<tensor_complex>(input_toml);
-
   // observable
   auto toml_observable = input_toml->get_table("observable");
   if (toml_observable == nullptr) {
     throw tenes::input_error("[observable] not found");
   }
 
-  // onesite observable
-  const auto onesite_obs = load_operators<tensor_complex>(input_toml, lattice.N_UNIT, 1, tol, "observable.onesite");
-  const auto twosite_obs = load_operators<tensor_complex>(input_toml, lattice.N_UNIT, 2, tol, "observable.twosite");
-
   // correlation
   auto toml_correlation = input_toml->get_table("correlation");
   const auto corparam = (toml_correlation != nullptr
                              ? gen_corparam(toml_correlation, "correlation")
                              : CorrelationParameter());
 
-  bool is_real = peps_parameters.is_real;
-  is_real = is_real && ::is_real(simple_updates, tol);
-  is_real = is_real && ::is_real(full_updates, tol);
-  is_real = is_real && ::is_real(onesite_obs, tol);
-  is_real = is_real && ::is_real(twosite_obs, tol);
+  util::OutArchive ops_ar;
+  if (peps_parameters.is_real) {
+    pack_input_operators<double>(ops_ar, input_toml, peps_parameters, lattice,
+                                 reduce);
+  } else {
+    pack_input_operators<std::complex<double>>(ops_ar, input_toml,
+                                               peps_parameters, lattice, reduce);
+  }
+
+  util::OutArchive ar;
+  peps_parameters.pack(ar);
+  lattice.pack(ar);
+  corparam.pack(ar);
+  ar << ops_ar.str();
+  return ar.str();
+}
+
+// reads `input_filename` on the root process of `comm` and broadcasts it
+// `overrides` is used only on the root process
+Input load_input_with_overrides(std::string const &input_filename,
+                                decltype(cpptoml::parse_file("")) overrides,
+                                MPI_Comm comm, PrintLevel print_level) {
+  int mpirank = 0;
+  MPI_Comm_rank(comm, &mpirank);
+
+  // Only the root process reads the input file.
+  // The whole problem (parameters, lattice, and operators) is sent to
+  // the others by one broadcast.
+  std::string buffer;
+  if (mpirank == 0) {
+    buffer = pack_result(
+        [&]() { return read_input(input_filename, overrides, print_level); });
+  }
+  bcast(buffer, 0, comm);
+
+  util::InArchive ar(buffer);
+  util::InArchive problem_ar(unpack_result(ar));
+  Input input;
+  input.peps_parameters.unpack(problem_ar);
+  input.lattice.unpack(problem_ar);
+  input.corparam.unpack(problem_ar);
+  problem_ar >> input.operators;
+  return input;
+}
+
+// reads `input_filename` on the root process of `com` and solves it
+// `overrides` is used only on the root process
+int run_input(std::string const &input_filename,
+              decltype(cpptoml::parse_file("")) overrides, MPI_Comm com,
+              PrintLevel print_level) {
+  const Input input =
+      load_input_with_overrides(input_filename, overrides, com, print_level);
+
+  prepare_outdir(input_filename, input.peps_parameters.outdir, com);
+
+  if (input.peps_parameters.is_real) {
+    Session<real_tensor> session(com, input);
+    return session.run();
+  } else {
+    Session<complex_tensor> session(com, input);
+    return session.run();
+  }
+}
+
+// name of the directory where the tensors of the k-th sweep point are saved
+std::string point_tensor_dir(std::string const &tensor_dir, int k) {
+  return tensor_dir + "/" + std::to_string(k);
+}
+
+// name of the output directory of the k-th sweep point
+// without point.parameter.general.output
+std::string point_outdir(std::string const &output_dir, int k) {
+  return output_dir + "/" + std::to_string(k);
+}
 
-  if(peps_parameters.is_real && !is_real){
+// parameter.general.output of an input file
+std::string input_outdir(std::string const &input_filename) {
+  if (!util::path_exists(input_filename)) {
     std::stringstream ss;
-    ss << "TeNeS invoked in real tensor mode (parameter.general.is_real = true) but some operators are complex.\n";
-    ss << "Consider using larger parameter.general.iszero_tol (present: " << tol << ")";
+    ss << "ERROR: cannot find the input file: " << input_filename << std::endl;
     throw tenes::input_error(ss.str());
   }
+  auto input_toml = cpptoml::parse_file(input_filename);
+  auto output = input_toml->get_qualified_as<std::string>(
+      "parameter.general.output");
+  return output ? *output : PEPS_Parameters().outdir;
+}
 
-  std::string outdir = peps_parameters.outdir;
-  bool is_ok = true;
+// reads the sweep file and serializes the list of points
+std::string read_sweep(std::string const &sweep_filename) {
+  if (!util::path_exists(sweep_filename)) {
+    std::stringstream ss;
+    ss << "ERROR: cannot find the sweep file: " << sweep_filename << std::endl;
+    throw tenes::input_error(ss.str());
+  }
+
+  auto sweep_toml = cpptoml::parse_file(sweep_filename);
+  auto sweep = sweep_toml->get_table("sweep");
+  if (sweep == nullptr) {
+    throw tenes::input_error("[sweep] not found");
+  }
+  const int num_groups = find_or<int>(sweep, "groups", 1);
+  if (num_groups < 1) {
+    throw tenes::input_error("sweep.groups must be >= 1");
+  }
+  const bool chain = find_or<bool>(sweep, "chain", false);
+  const std::string tensor_dir =
+      find_or<std::string>(sweep, "tensor_dir", "sweep_tensors");
+
+  // the model and tau enter only through the operators made by the tools
+  auto check_tool_keys = [](decltype(sweep) point) {
+    if (point->contains("model")) {
+      throw tenes::input_error(
+          "sweep.point.model requires a simple-mode input (use tenes_sweep)");
+    }
+    for (const char *key :
+         {"parameter.simple_update.tau", "parameter.full_update.tau"}) {
+      if (point->get_qualified_as<double>(key)) {
+        std::stringstream ss;
+        ss << "sweep.point." << key
+           << " requires a simple- or standard-mode input (use tenes_sweep)";
+        throw tenes::input_error(ss.str());
+      }
+    }
+  };
+
+  const std::string base_input = find_or<std::string>(sweep, "input", "");
+  std::vector<std::string> inputs;
+  std::vector<std::string> overrides;
+  // output directory of each point, which should differ from each other
+  // since the points may run concurrently
+  std::vector<std::string> outdirs;
+  std::map<std::string, int> outdir_points;
+  auto points = sweep->get_table_array("point");
+  if (points != nullptr) {
+    for (const auto &point : *points) {
+      check_tool_keys(point);
+      const int k = inputs.size();
+      const std::string input = find_or(point, "input", base_input);
+      if (input.empty()) {
+        throw tenes::input_error(
+            detail::msg_cannot_find("input", "sweep.point"));
+      }
+      inputs.push_back(input);
+      std::stringstream ss;
+      auto param = point->get_table("parameter");
+      if (param != nullptr) {
+        ss << *param;
+      }
+      overrides.push_back(ss.str());
+
+      auto output =
+          point->get_qualified_as<std::string>("parameter.general.output");
+      if (output) {
+        outdirs.push_back(*output);
+      } else {
+        // the output directory of the input holds those of the points
+        const std::string parent = input_outdir(input);
+        if (!util::isdir(parent) && !util::mkdir(parent)) {
+          std::stringstream ss;
+          ss << "Cannot mkdir " << parent;
+          throw tenes::runtime_error(ss.str());
+        }
+        outdirs.push_back(point_outdir(parent, k));
+      }
+      auto inserted = outdir_points.emplace(outdirs.back(), k);
+      if (!inserted.second) {
+        std::stringstream ss;
+        ss << "sweep points " << inserted.first->second << " and " << k
+           << " have the same output directory " << outdirs.back();
+        throw tenes::input_error(ss.str());
+      }
+    }
+  }
+  if (inputs.empty()) {
+    throw tenes::input_error(detail::msg_cannot_find("point", "sweep"));
+  }
+
+  if (chain && !util::isdir(tensor_dir) && !util::mkdir(tensor_dir)) {
+    std::stringstream ss;
+    ss << "Cannot mkdir " << tensor_dir;
+    throw tenes::runtime_error(ss.str());
+  }
+
+  util::OutArchive ar;
+  ar << num_groups << chain << tensor_dir << inputs << overrides << outdirs;
+  return ar.str();
+}
+
+// reads the scaling file and serializes the grid of configurations
+// `size` is the number of the processes available
+std::string read_scaling(std::string const &scaling_filename, int size) {
+  if (!util::path_exists(scaling_filename)) {
+    std::stringstream ss;
+    ss << "ERROR: cannot find the scaling file: " << scaling_filename
+       << std::endl;
+    throw tenes::input_error(ss.str());
+  }
+
+  auto scaling_toml = cpptoml::parse_file(scaling_filename);
+  auto scaling = scaling_toml->get_table("scaling");
+  if (scaling == nullptr) {
+    throw tenes::input_error("[scaling] not found");
+  }
+
+  std::vector<int> ranks = {size};
+  std::vector<int> threads = {max_num_threads()};
+  for (auto const &key_list :
+       {std::make_pair("ranks", &ranks), std::make_pair("threads", &threads)}) {
+    if (!scaling->contains(key_list.first)) {
+      continue;
+    }
+    auto arr = scaling->get_array_of<int64_t>(key_list.first);
+    if (!arr || arr->empty()) {
+      std::stringstream ss;
+      ss << "scaling." << key_list.first
+         << " requires a non-empty array of integers";
+      throw tenes::input_error(ss.str());
+    }
+    key_list.second->assign(arr->begin(), arr->end());
+  }
+  for (int r : ranks) {
+    if (r < 1 || r > size) {
+      std::stringstream ss;
+      ss << "scaling.ranks must be in [1, " << size
+         << "] (number of processes), but " << r << " is given";
+      throw tenes::input_error(ss.str());
+    }
+  }
+  for (int t : threads) {
+    if (t < 1) {
+      throw tenes::input_error("scaling.threads must be >= 1");
+    }
+  }
+#ifdef _NO_OMP
+  if (threads.size() > 1 || threads[0] != 1) {
+    throw tenes::input_error(
+        "scaling.threads must be [1] since TeNeS is built without OpenMP");
+  }
+#endif
+
+  // Either one input for all the configurations (strong scaling) or
+  // one input for each entry of `ranks` (weak scaling)
+  std::vector<std::string> inputs;
+  if (scaling->contains("inputs")) {
+    auto arr = scaling->get_array_of<std::string>("inputs");
+    if (arr) {
+      inputs.assign(arr->begin(), arr->end());
+    }
+    if (inputs.size() != ranks.size()) {
+      throw tenes::input_error(
+          "scaling.inputs must have the same length as scaling.ranks");
+    }
+  } else {
+    inputs.assign(ranks.size(), find<std::string>(scaling, "input"));
+  }
+
+  const int repeat = find_or<int>(scaling, "repeat", 1);
+  if (repeat < 1) {
+    throw tenes::input_error("scaling.repeat must be >= 1");
+  }
+  const std::string output =
+      find_or<std::string>(scaling, "output", "scaling.dat");
+  const bool append = find_or<bool>(scaling, "append", false);
+  const std::string output_dir =
+      find_or<std::string>(scaling, "output_dir", "scaling_output");
+  if (!util::isdir(output_dir) && !util::mkdir(output_dir)) {
+    std::stringstream ss;
+    ss << "Cannot mkdir " << output_dir;
+    throw tenes::runtime_error(ss.str());
+  }
+
+  util::OutArchive ar;
+  ar << ranks << threads << inputs << repeat << output << append
+     << output_dir;
+  return ar.str();
+}
+
+// name of the output directory of a configuration of main_scaling
+std::string scaling_outdir(std::string const &output_dir, int ranks,
+                           int threads) {
+  return output_dir + "/r" + std::to_string(ranks) + "_t" +
+         std::to_string(threads);
+}
+
+// reads the elapsed times of the phases from time.dat
+// (all, simple update, full update, environment, and observable)
+std::vector<double> read_time_dat(std::string const &outdir) {
+  const std::string filename = outdir + "/time.dat";
+  std::ifstream ifs(filename.c_str());
+  if (!ifs) {
+    throw tenes::runtime_error("cannot open " + filename);
+  }
+  std::vector<std::string> keys = {"time all", "time simple update",
+                                   "time full update", "time environmnent",
+                                   "time observable"};
+  std::vector<double> times(keys.size(), 0.0);
+  std::string line;
+  while (std::getline(ifs, line)) {
+    const auto pos = line.find('=');
+    if (pos == std::string::npos) {
+      continue;
+    }
+    std::string key = line.substr(0, pos);
+    key.erase(key.find_last_not_of(' ') + 1);
+    auto it = std::find(keys.begin(), keys.end(), key);
+    if (it != keys.end()) {
+      times[it - keys.begin()] = std::stod(line.substr(pos + 1));
+    }
+  }
+  return times;
+}
+
+// reads a job sent to main_serve and serializes it
+// `overrides` receives the [parameter] table of the job
+std::string read_job(std::string const &request,
+                     decltype(cpptoml::parse_file("")) &overrides) {
+  std::istringstream iss(request);
+  cpptoml::parser parser(iss);
+  auto job = parser.parse();
+
+  const bool shutdown = find_or<bool>(job, "shutdown", false);
+  std::string input;
+  if (!shutdown) {
+    input = find<std::string>(job, "input");
+  }
+  const bool warm_start = find_or<bool>(job, "warm_start", false);
+  overrides = job->get_table("parameter");
+
+  util::OutArchive ar;
+  ar << shutdown << input << warm_start;
+  return ar.str();
+}
+
+// one line of the reply to a client of main_serve
+std::string reply(std::string const &kind, std::string const &body) {
+  std::string line = kind + " " + body;
+  std::replace(line.begin(), line.end(), '\n', ' ');
+  return line + "\n";
+}
+
+// solves one job of main_serve and streams the progress to `client`
+// `last` holds the session of the last successful job of the same type
+template <class ptensor>
+void serve_job(Input const &input, bool warm_start,
+               std::unique_ptr<Session<ptensor>> &last, MPI_Comm com,
+               util::Connection &client) {
+  std::unique_ptr<Session<ptensor>> session(new Session<ptensor>(com, input));
+  if (warm_start && last) {
+    session->warm_start(*last);
+    client.send(reply("status", "warm_start"));
+  }
+
+  PEPS_Parameters const &params = session->parameters();
+  session->simple_update(params.num_simple_step);
+  client.send(reply("status", "simple_update"));
+  if (params.num_full_step > 0) {
+    session->full_update(params.num_full_step);
+    client.send(reply("status", "full_update"));
+  }
+  session->save_tensors();
+  if (params.to_measure) {
+    for (auto const &density : session->measure()) {
+      std::stringstream ss;
+      ss << std::setprecision(std::numeric_limits<double>::max_digits10)
+         << density.name << " " << density.value.real() << " "
+         << density.value.imag();
+      client.send(reply("density", ss.str()));
+    }
+  }
+  client.send(
+      reply("ctm_iterations", std::to_string(session->ctm_iterations())));
+  session->summary();
+  last = std::move(session);
+}
+
+// counts the operators which determine the cost of a run
+template <class ptensor>
+OperatorCounts count_operators(Input const &input, MPI_Comm com) {
+  util::InArchive ar(input.operators);
+  auto ops = unpack_operators<ptensor>(ar, com);
+  OperatorCounts counts;
+  for (auto const &up : ops.simple_updates) {
+    if (up.is_threesite()) {
+      ++counts.num_threesite_updates;
+    } else {
+      ++counts.num_simple_updates;
+    }
+  }
+  for (auto const &up : ops.full_updates) {
+    if (up.source_leg % 2 == 0) {
+      ++counts.num_full_column;
+    } else {
+      ++counts.num_full_row;
+    }
+  }
+  counts.num_onesite = ops.onesite_operators.size();
+  counts.num_twosite = ops.twosite_operators.size();
+  return counts;
+}
+
+// multiply-adds per second of the product of two n x n matrices
+// distributed over all the processes
+template <class ptensor> double benchmark_matrix_product(int n, MPI_Comm com) {
+  using value_type = typename ptensor::value_type;
+  ptensor A(com, mptensor::Shape(n, n));
+  fill_local(A, [](mptensor::Index const &index) {
+    return value_type(1.0 / (1.0 + index[0] + index[1]));
+  });
+  ptensor B = A;
+  ptensor AB = mptensor::tensordot(A, B, mptensor::Axes(1), mptensor::Axes(0));
+
+  // repeat for at least 0.2 seconds
+  int count = 0;
+  double elapsed = 0.0;
+  MPI_Barrier(com);
+  Timer<> timer;
+  while (elapsed < 0.2) {
+    AB = mptensor::tensordot(A, B, mptensor::Axes(1), mptensor::Axes(0));
+    ++count;
+    elapsed = timer.elapsed();
+    bcast(elapsed, 0, com);
+  }
+  return static_cast<double>(n) * n * n * count / elapsed;
+}
+
+// physical memory of this node in bytes (0 if unknown)
+double node_memory() {
+  const long pages = sysconf(_SC_PHYS_PAGES);
+  const long page_size = sysconf(_SC_PAGE_SIZE);
+  if (pages <= 0 || page_size <= 0) {
+    return 0.0;
+  }
+  return static_cast<double>(pages) * page_size;
+}
+
+// predicts the cost of `input` and prints it with a recommended layout
+template <class ptensor>
+void print_estimate(std::string const &input_filename, Input const &input,
+                    MPI_Comm com) {
+  int mpisize = 1, mpirank = 0;
+  MPI_Comm_size(com, &mpisize);
+  MPI_Comm_rank(com, &mpirank);
+
+  PEPS_Parameters const &params = input.peps_parameters;
+  const CostEstimate cost = estimate_cost(params, input.lattice, input.corparam,
+                                          count_operators<ptensor>(input, com));
+
+  // calibrated by the matrix product as large as the matrices of CTM
+  const int n = std::max(64, std::min(2048, static_cast<int>(cost.matrix_dim)));
+  const double speed = benchmark_matrix_product<ptensor>(n, com);
+  const int threads = max_num_threads();
+  const double speed_per_core = speed / (mpisize * threads);
+
+  if (mpirank != 0) {
+    return;
+  }
+  // a multiply-add is 2 (real) or 8 (complex) floating-point operations
+  const double flop = params.is_real ? 2.0 : 8.0;
+  const double MB = 1024.0 * 1024.0;
+
+  int D = 1, d = 1;
+  for (int i = 0; i < input.lattice.N_UNIT; ++i) {
+    d = std::max(d, input.lattice.physical_dims[i]);
+    for (int leg = 0; leg < 4; ++leg) {
+      D = std::max(D, input.lattice.virtual_dims[i][leg]);
+    }
+  }
+
+  std::cout << "Estimate for " << input_filename << std::endl;
+  std::cout << "  unit cell: " << input.lattice.N_UNIT << " sites, D = " << D
+            << ", CHI = " << params.CHI << ", physical dim = " << d << ", "
+            << (params.is_real ? "real" : "complex") << std::endl;
+  std::cout << "  projector: "
+            << (params.CTM_Projector_corner ? "corner" : "updown") << ", "
+            << (params.Use_RSVD ? "RSVD" : "full SVD") << std::endl;
+  std::cout << "  matrix product (dim " << n << "): " << speed * flop * 1.0e-9
+            << " GFLOPS with " << mpisize << " processes x " << threads
+            << " threads" << std::endl;
+  std::cout << std::endl;
+
+  std::cout << "Predicted cost [GFLOP] and wall time [sec.]:" << std::endl;
+  const std::vector<std::pair<std::string, double>> phases = {
+      {"simple update", cost.simple_update},
+      {"full update  ", cost.full_update},
+      {"environment  ", cost.environment},
+      {"observable   ", cost.observable},
+      {"all          ", cost.total()}};
+  for (auto const &phase : phases) {
+    std::cout << "  " << phase.first << " = " << phase.second * flop * 1.0e-9
+              << " GFLOP, " << phase.second / speed << " sec." << std::endl;
+  }
+  std::cout << "  (" << params.Max_CTM_Iteration
+            << " CTM iterations, one costs "
+            << cost.ctm_iteration / speed << " sec.)" << std::endl;
+  std::cout << std::endl;
+
+  std::cout << "Peak memory per process [MB]:" << std::endl;
+  std::cout << "  tensors   = " << cost.tensors / mpisize / MB << std::endl;
+  std::cout << "  workspace = " << cost.peak_workspace / mpisize / MB
+            << std::endl;
+  std::cout << "  all       = " << cost.peak_memory() / mpisize / MB
+            << std::endl;
+  std::cout << std::endl;
+
+  const int cores = std::max(1u, std::thread::hardware_concurrency());
+  const Layout layout = recommend_layout(cost, cores, node_memory());
+  std::cout << "Recommended layout (" << cores << " cores per node):"
+            << std::endl;
+  std::cout << "  nodes     = " << layout.nodes << std::endl;
+  std::cout << "  processes = " << layout.ranks << std::endl;
+  std::cout << "  threads   = " << layout.threads << " / process" << std::endl;
+  std::cout << "  wall time = "
+            << cost.total() /
+                   (speed_per_core * layout.ranks * layout.threads)
+            << " sec. (with the linear speedup)" << std::endl;
+  std::cout << "  memory    = " << cost.peak_memory() / layout.ranks / MB
+            << " MB / process" << std::endl;
+}
+} // end of unnamed namespace
+
+Input load_input(std::string const &input_filename, MPI_Comm comm,
+                 PrintLevel print_level) {
+  return load_input_with_overrides(input_filename, nullptr, comm, print_level);
+}
+
+int main_impl(std::string input_filename, MPI_Comm com,
+              PrintLevel print_level = PrintLevel::info) {
+  return run_input(input_filename, nullptr, com, print_level);
+}
+
+int main_sweep(std::string sweep_filename, MPI_Comm com,
+               PrintLevel print_level = PrintLevel::info) {
+  int mpirank = 0;
+  MPI_Comm_rank(com, &mpirank);
+
+  std::string buffer;
   if (mpirank == 0) {
-    if(!util::isdir(outdir)){
-      is_ok = util::mkdir(outdir);
+    buffer = pack_result([&]() { return read_sweep(sweep_filename); });
+  }
+  bcast(buffer, 0, com);
+  util::InArchive ar(buffer);
+  util::InArchive sweep_ar(unpack_result(ar));
+
+  int num_groups = 1;
+  bool chain = false;
+  std::string tensor_dir;
+  std::vector<std::string> inputs;
+  std::vector<std::string> overrides;
+  std::vector<std::string> outdirs;
+  sweep_ar >> num_groups >> chain >> tensor_dir >> inputs >> overrides >>
+      outdirs;
+  const int num_points = inputs.size();
+
+  // Each group of processes solves a contiguous block of points one by one,
+  // so that a chain runs along the block.
+  TaskGroups groups(com, num_groups);
+  const int group = groups.group();
+  const int first = static_cast<long>(num_points) * group / groups.num_groups();
+  const int last =
+      static_cast<long>(num_points) * (group + 1) / groups.num_groups();
+  int group_rank = 0;
+  MPI_Comm_rank(groups.group_comm(), &group_rank);
+
+  // Only the first group shows the messages from the solver
+  const PrintLevel solver_print_level =
+      group == 0 ? print_level : PrintLevel::none;
+
+  int num_failed = 0;
+  for (int k = first; k < last; ++k) {
+    decltype(cpptoml::parse_file("")) point_overrides = nullptr;
+    if (group_rank == 0) {
+      if (print_level >= PrintLevel::info) {
+        std::cout << "Sweep point " << k << " (" << inputs[k]
+                  << ") starts on group " << group << std::endl;
+      }
+      std::istringstream iss(overrides[k]);
+      cpptoml::parser parser(iss);
+      point_overrides = parser.parse();
+      auto general = point_overrides->get_table("general");
+      if (general == nullptr) {
+        general = cpptoml::make_table();
+        point_overrides->insert("general", general);
+      }
+      general->insert("output", cpptoml::make_value(outdirs[k]));
+      if (chain) {
+        general->insert("tensor_save",
+                        cpptoml::make_value(point_tensor_dir(tensor_dir, k)));
+        if (k > first) {
+          general->insert("tensor_load", cpptoml::make_value(point_tensor_dir(
+                                             tensor_dir, k - 1)));
+        }
+      }
+    }
+
+    try {
+      run_input(inputs[k], point_overrides, groups.group_comm(),
+                solver_print_level);
+    } catch (std::exception const &e) {
+      if (group_rank == 0) {
+        std::cerr << "[ERROR] sweep point " << k << " (" << inputs[k] << ")"
+                  << std::endl;
+        std::cerr << e.what() << std::endl;
+        // the rest of the chain cannot start without the tensors
+        num_failed += chain ? last - k : 1;
+      }
+      if (chain) {
+        break;
+      }
     }
   }
-  bcast(is_ok, 0, com);
-  if(!is_ok){
+
+  allreduce_sum(num_failed, com);
+  if (num_failed > 0) {
     std::stringstream ss;
-    ss << "Cannot mkdir " << outdir;
+    ss << num_failed << " of " << num_points << " sweep points failed";
     throw tenes::runtime_error(ss.str());
   }
+  return 0;
+}
+
+int main_scaling(std::string scaling_filename, MPI_Comm com,
+                 PrintLevel print_level = PrintLevel::info) {
+  int mpisize = 1, mpirank = 0;
+  MPI_Comm_size(com, &mpisize);
+  MPI_Comm_rank(com, &mpirank);
 
+  std::string buffer;
   if (mpirank == 0) {
-    std::string basename = util::basename(input_filename);
-    std::ifstream ifs(input_filename.c_str());
-    std::string dst_filename = outdir + "/" + basename;
-    std::ofstream ofs(dst_filename.c_str());
-    std::string line;
-    while (std::getline(ifs, line)){
-      ofs << line << std::endl;
+    buffer = pack_result(
+        [&]() { return read_scaling(scaling_filename, mpisize); });
+  }
+  bcast(buffer, 0, com);
+  util::InArchive ar(buffer);
+  util::InArchive scaling_ar(unpack_result(ar));
+
+  std::vector<int> ranks;
+  std::vector<int> threads;
+  std::vector<std::string> inputs;
+  int repeat = 1;
+  std::string output;
+  bool append = false;
+  std::string output_dir;
+  scaling_ar >> ranks >> threads >> inputs >> repeat >> output >> append >>
+      output_dir;
+
+  std::ofstream ofs;
+  if (mpirank == 0) {
+    const bool write_header = !append || !util::path_exists(output);
+    ofs.open(output.c_str(), append ? std::ios::app : std::ios::out);
+    if (write_header) {
+      ofs << "# $1: ranks\n";
+      ofs << "# $2: threads\n";
+      ofs << "# $3: time all\n";
+      ofs << "# $4: time simple update\n";
+      ofs << "# $5: time full update\n";
+      ofs << "# $6: time environment\n";
+      ofs << "# $7: time observable\n";
+      ofs << "# $8: input\n";
+      ofs << std::endl;
     }
   }
 
-  if(is_real){
-    return tenes(MPI_COMM_WORLD, peps_parameters, lattice, to_real(simple_updates),
-                 to_real(full_updates), to_real(onesite_obs), to_real(twosite_obs),
-                 corparam);
-  }else{
-    return tenes(MPI_COMM_WORLD, peps_parameters, lattice, simple_updates,
-                 full_updates, onesite_obs, twosite_obs,
-                 corparam);
+  const int max_threads = max_num_threads();
+  int num_failed = 0;
+  std::string message;
+  for (size_t ir = 0; ir < ranks.size(); ++ir) {
+    const int nranks = ranks[ir];
+    // the first `nranks` processes solve the input on their own
+    // communicator, which has all the tensors, and the others wait
+    MPI_Comm sub = com;
+#ifndef _NO_MPI
+    if (nranks < mpisize) {
+      MPI_Comm_split(com, mpirank < nranks ? 0 : MPI_UNDEFINED, mpirank, &sub);
+    }
+#endif
+    for (int nthreads : threads) {
+      const std::string outdir = scaling_outdir(output_dir, nranks, nthreads);
+      if (mpirank == 0 && print_level >= PrintLevel::info) {
+        std::cout << "Scaling: " << nranks << " ranks x " << nthreads
+                  << " threads (" << inputs[ir] << ")" << std::endl;
+      }
+#ifndef _NO_OMP
+      omp_set_num_threads(nthreads);
+#endif
+
+      // minimum over the repetitions, phase by phase
+      std::vector<double> best, times;
+      for (int k = 0; k < repeat && num_failed == 0; ++k) {
+        try {
+          if (mpirank < nranks) {
+            decltype(cpptoml::parse_file("")) overrides = nullptr;
+            if (mpirank == 0) {
+              overrides = cpptoml::make_table();
+              auto general = cpptoml::make_table();
+              general->insert("output", cpptoml::make_value(outdir));
+              overrides->insert("general", general);
+            }
+            run_input(inputs[ir], overrides, sub, PrintLevel::none);
+          }
+          if (mpirank == 0) {
+            times = read_time_dat(outdir);
+          }
+        } catch (std::exception const &e) {
+          if (mpirank == 0) {
+            message = e.what();
+          }
+          num_failed = 1;
+        }
+        // the waiting processes learn the failure here
+        allreduce_max(num_failed, com);
+        if (num_failed == 0 && mpirank == 0) {
+          if (best.empty()) {
+            best = times;
+          } else {
+            for (size_t i = 0; i < best.size(); ++i) {
+              best[i] = std::min(best[i], times[i]);
+            }
+          }
+        }
+      }
+
+      if (num_failed > 0) {
+        break;
+      }
+      if (mpirank == 0) {
+        ofs << nranks << " " << nthreads;
+        for (double t : best) {
+          ofs << " " << t;
+        }
+        ofs << " " << inputs[ir] << std::endl;
+        if (print_level >= PrintLevel::info) {
+          std::cout << "  time all = " << best[0] << " [sec.]" << std::endl;
+        }
+      }
+    }
+#ifndef _NO_MPI
+    if (nranks < mpisize && sub != MPI_COMM_NULL) {
+      MPI_Comm_free(&sub);
+    }
+#endif
+    if (num_failed > 0) {
+      break;
+    }
+  }
+#ifndef _NO_OMP
+  omp_set_num_threads(max_threads);
+#endif
+  static_cast<void>(max_threads);
+
+  if (num_failed > 0) {
+    bcast(message, 0, com);
+    throw tenes::runtime_error("scaling run failed: " + message);
+  }
+
+  if (mpirank == 0 && print_level >= PrintLevel::info) {
+    std::cout << "Save elapsed times to " << output << std::endl;
+  }
+  return 0;
+}
+
+int main_estimate(std::string input_filename, MPI_Comm com,
+                  PrintLevel print_level = PrintLevel::info) {
+  const Input input =
+      load_input_with_overrides(input_filename, nullptr, com, print_level);
+  if (input.peps_parameters.is_real) {
+    print_estimate<real_tensor>(input_filename, input, com);
+  } else {
+    print_estimate<complex_tensor>(input_filename, input, com);
+  }
+  return 0;
+}
+
+int main_serve(std::string socket_path, MPI_Comm com,
+               PrintLevel print_level = PrintLevel::info) {
+  int mpirank = 0;
+  MPI_Comm_rank(com, &mpirank);
+
+  std::unique_ptr<util::UnixServer> server;
+  std::string buffer;
+  if (mpirank == 0) {
+    buffer = pack_result([&]() {
+      server.reset(new util::UnixServer(socket_path));
+      return std::string();
+    });
+  }
+  bcast(buffer, 0, com);
+  {
+    util::InArchive ar(buffer);
+    unpack_result(ar);
+  }
+  if (mpirank == 0 && print_level >= PrintLevel::info) {
+    std::cout << "Waiting for jobs on " << socket_path << std::endl;
+  }
+
+  // the sessions of the last jobs are kept for warm starts
+  std::unique_ptr<Session<real_tensor>> last_real;
+  std::unique_ptr<Session<complex_tensor>> last_complex;
+
+  // connected only on the root process, so that the others send nothing
+  util::Connection client;
+  // a client has to send the whole job within this time [sec.]
+  const double request_timeout = 60.0;
+
+  for (int job_id = 0;; ++job_id) {
+    decltype(cpptoml::parse_file("")) overrides = nullptr;
+    std::string job_buffer;
+    if (mpirank == 0) {
+      // malformed or stalled requests are answered without bothering the
+      // others, while a broken server stops all the processes
+      while (true) {
+        bool rejected = false;
+        std::string request_error;
+        job_buffer = pack_result([&]() -> std::string {
+          client = server->accept();
+          try {
+            const std::string request = client.receive_all(request_timeout);
+            return read_job(request, overrides);
+          } catch (std::exception const &e) {
+            rejected = true;
+            request_error = e.what();
+            return std::string();
+          }
+        });
+        if (!rejected) {
+          break;
+        }
+        client.send(reply("error", request_error));
+        client.close();
+      }
+    }
+    bcast(job_buffer, 0, com);
+    util::InArchive ar(job_buffer);
+    util::InArchive job_ar(unpack_result(ar));
+    bool shutdown = false;
+    std::string input_filename;
+    bool warm_start = false;
+    job_ar >> shutdown >> input_filename >> warm_start;
+
+    if (shutdown) {
+      client.send(reply("done", "shutdown"));
+      break;
+    }
+
+    if (mpirank == 0 && print_level >= PrintLevel::info) {
+      std::cout << "Job " << job_id << " (" << input_filename << ") starts"
+                << std::endl;
+    }
+    client.send(reply("accepted", std::to_string(job_id)));
+    try {
+      const Input input = load_input_with_overrides(input_filename, overrides,
+                                                    com, print_level);
+      prepare_outdir(input_filename, input.peps_parameters.outdir, com);
+      if (input.peps_parameters.is_real) {
+        last_complex.reset();
+        serve_job(input, warm_start, last_real, com, client);
+      } else {
+        last_real.reset();
+        serve_job(input, warm_start, last_complex, com, client);
+      }
+      client.send(reply("done", std::to_string(job_id)));
+    } catch (std::exception const &e) {
+      if (mpirank == 0) {
+        std::cerr << "[ERROR] job " << job_id << " (" << input_filename << ")"
+                  << std::endl;
+        std::cerr << e.what() << std::endl;
+      }
+      client.send(reply("error", e.what()));
+    }
+    client.close();
   }
+  return 0;
 }
 
 } // end of namespace tenes
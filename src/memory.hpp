@@ -0,0 +1,273 @@
+/* TeNeS - Massively parallel tensor network solver /
+/ Copyright (C) 2019- The University of Tokyo */
+
+/* This program is free software: you can redistribute it and/or modify /
+/ it under the terms of the GNU General Public License as published by /
+/ the Free Software Foundation, either version 3 of the License, or /
+/ (at your option) any later version. */
+
+/* This program is distributed in the hope that it will be useful, /
+/ but WITHOUT ANY WARRANTY; without even the implied warranty of /
+/ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the /
+/ GNU General Public License for more details. */
+
+/* You should have received a copy of the GNU General Public License /
+/ along with this program. If not, see http://www.gnu.org/licenses/. */
+
+#ifndef TENES_MEMORY_HPP
+#define TENES_MEMORY_HPP
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "mpi.hpp"
+
+namespace tenes {
+
+/*! @brief memory of this process read from /proc/self/status
+ *
+ *  @param[in] key  "VmRSS" (resident memory) or "VmHWM" (its high-water mark)
+ *  @return memory in bytes (0 if unavailable, e.g., other than Linux)
+ */
+inline double proc_status_memory(std::string const &key) {
+  std::ifstream ifs("/proc/self/status");
+  std::string line;
+  while (std::getline(ifs, line)) {
+    if (line.compare(0, key.size() + 1, key + ":") == 0) {
+      std::istringstream iss(line.substr(key.size() + 1));
+      double kb = 0.0;
+      iss >> kb;
+      return 1024.0 * kb;
+    }
+  }
+  return 0.0;
+}
+
+/*! @brief resets the high-water mark of the resident memory (VmHWM)
+ *
+ *  Available since Linux 4.0.
+ *  Otherwise VmHWM keeps the high-water mark since the process started.
+ */
+inline void reset_peak_memory() {
+  std::ofstream ofs("/proc/self/clear_refs");
+  if (ofs) {
+    ofs << "5";
+  }
+}
+
+/*! @brief memory of a tensor */
+struct TensorMemory {
+  std::string name;
+  double local;   // bytes in this process
+  double global;  // bytes of the whole tensor
+};
+
+/*! @brief tensors in `tensors` as name[0], name[1], ...
+ *
+ *  Only the tensors kept over the regions are added
+ *  (temporaries are covered by the resident memory).
+ */
+template <class ptensor>
+void add_tensor_memory(std::vector<TensorMemory> &memory,
+                       std::string const &name,
+                       std::vector<ptensor> const &tensors) {
+  using value_type = typename ptensor::value_type;
+  for (size_t i = 0; i < tensors.size(); ++i) {
+    auto const &A = tensors[i];
+    double size = A.rank() > 0 ? 1.0 : 0.0;
+    for (size_t k = 0; k < A.rank(); ++k) {
+      size *= A.shape()[k];
+    }
+    memory.push_back(TensorMemory{name + "[" + std::to_string(i) + "]",
+                                  1.0 * A.local_size() * sizeof(value_type),
+                                  size * sizeof(value_type)});
+  }
+}
+
+/*! @brief high-water marks of the memory in each region of a run
+ *
+ *  `start` is called at the beginning of a region and `sample` at its end
+ *  with the persistent tensors (site tensors, environment, and CTM buffers).
+ *  `sample` takes the high-water mark of the resident memory since `start`,
+ *  which covers the temporaries inside the region (e.g., the enlarged
+ *  corners of the CTM), and the memory of the persistent tensors.
+ *  Sampling involves no communication, and `write` merges the samples
+ *  of all the processes.
+ */
+class MemoryTracker {
+public:
+  // number of the largest tensors written for each region
+  static constexpr size_t num_largest = 3;
+
+  /*!
+   *  @param[in] regions  names of the regions in the order of the output
+   *                      (every process should pass the same regions)
+   */
+  explicit MemoryTracker(std::vector<std::string> const &regions) {
+    for (auto const &name : regions) {
+      regions_.push_back(Region{name, 0, 0.0, 0.0, {}});
+    }
+    reset_peak_memory();
+  }
+
+  void start() const { reset_peak_memory(); }
+
+  /*!
+   *  @param[in] region   one of the regions passed to the constructor
+   *  @param[in] tensors  tensors alive at the end of the region
+   */
+  void sample(std::string const &region,
+              std::vector<TensorMemory> const &tensors) {
+    const double resident = proc_status_memory("VmHWM");
+    reset_peak_memory();
+
+    auto it = std::find_if(regions_.begin(), regions_.end(),
+                           [&](Region const &r) { return r.name == region; });
+    if (it == regions_.end()) {
+      return;
+    }
+    it->count += 1;
+    it->resident = std::max(it->resident, resident);
+
+    double total = 0.0;
+    for (auto const &t : tensors) {
+      total += t.local;
+    }
+    if (total >= it->tensor) {
+      it->tensor = total;
+      it->largest = tensors;
+      std::sort(it->largest.begin(), it->largest.end(),
+                [](TensorMemory const &a, TensorMemory const &b) {
+                  return a.global > b.global;
+                });
+      if (it->largest.size() > num_largest) {
+        it->largest.resize(num_largest);
+      }
+    }
+  }
+
+  /*! @brief writes the high-water marks merged over the processes
+   *
+   *  This is a collective operation over `comm`
+   *  and only the root process writes the file.
+   *  Regions sampled by no process are omitted.
+   *  The largest tensors are taken over the lists of all the processes.
+   */
+  void write(std::string const &filename, MPI_Comm comm) const {
+    int mpirank = 0;
+    MPI_Comm_rank(comm, &mpirank);
+
+    std::vector<double> send;
+    // names of the largest tensors separated by '\n',
+    // and (region index, size) of each of them
+    std::vector<char> send_names;
+    std::vector<double> send_sizes;
+    for (size_t i = 0; i < regions_.size(); ++i) {
+      auto const &r = regions_[i];
+      send.push_back(r.count);
+      send.push_back(r.resident);
+      send.push_back(r.tensor);
+      for (auto const &t : r.largest) {
+        send_names.insert(send_names.end(), t.name.begin(), t.name.end());
+        send_names.push_back('\n');
+        send_sizes.push_back(i);
+        send_sizes.push_back(t.global);
+      }
+    }
+    std::vector<double> recv;
+    std::vector<char> recv_names;
+    std::vector<double> recv_sizes;
+    gatherv(send, recv, 0, comm);
+    gatherv(send_names, recv_names, 0, comm);
+    gatherv(send_sizes, recv_sizes, 0, comm);
+    if (mpirank != 0) {
+      return;
+    }
+
+    // a tensor distributed over processes appears in several lists
+    std::vector<std::vector<TensorMemory>> largest(regions_.size());
+    auto name_begin = recv_names.begin();
+    for (size_t k = 0; k + 1 < recv_sizes.size(); k += 2) {
+      const auto name_end = std::find(name_begin, recv_names.end(), '\n');
+      const std::string name(name_begin, name_end);
+      name_begin = name_end + 1;
+      auto &list = largest[static_cast<size_t>(recv_sizes[k])];
+      const double global = recv_sizes[k + 1];
+      auto it =
+          std::find_if(list.begin(), list.end(),
+                       [&](TensorMemory const &t) { return t.name == name; });
+      if (it == list.end()) {
+        list.push_back(TensorMemory{name, 0.0, global});
+      } else {
+        it->global = std::max(it->global, global);
+      }
+    }
+    for (auto &list : largest) {
+      std::stable_sort(list.begin(), list.end(),
+                       [](TensorMemory const &a, TensorMemory const &b) {
+                         return a.global > b.global;
+                       });
+      if (list.size() > num_largest) {
+        list.resize(num_largest);
+      }
+    }
+
+    const double MB = 1024.0 * 1024.0;
+    const size_t nvalues = send.size();
+    const size_t nprocs = nvalues > 0 ? recv.size() / nvalues : 0;
+    std::ofstream ofs(filename.c_str());
+    ofs << "# $1: region\n";
+    ofs << "# $2: high-water mark of resident memory, max over processes "
+           "[MB]\n";
+    ofs << "# $3: high-water mark of resident memory, sum over processes "
+           "[MB]\n";
+    ofs << "# $4: memory of persistent tensors (site tensors, environment, "
+           "and CTM buffers), max over processes [MB]\n";
+    ofs << "# $5: memory of persistent tensors, sum over processes [MB]\n";
+    ofs << "# $6-: largest persistent tensors over processes "
+           "(name and size [MB])\n";
+    ofs << std::endl;
+    for (size_t i = 0; i < regions_.size(); ++i) {
+      double count = 0.0;
+      double resident_max = 0.0, resident_sum = 0.0;
+      double tensor_max = 0.0, tensor_sum = 0.0;
+      for (size_t p = 0; p < nprocs; ++p) {
+        const double *v = &recv[p * nvalues + 3 * i];
+        count += v[0];
+        resident_max = std::max(resident_max, v[1]);
+        resident_sum += v[1];
+        tensor_max = std::max(tensor_max, v[2]);
+        tensor_sum += v[2];
+      }
+      if (count == 0.0) {
+        continue;
+      }
+      ofs << regions_[i].name << " " << resident_max / MB << " "
+          << resident_sum / MB << " " << tensor_max / MB << " "
+          << tensor_sum / MB;
+      for (auto const &t : largest[i]) {
+        ofs << " " << t.name << " " << t.global / MB;
+      }
+      ofs << std::endl;
+    }
+  }
+
+private:
+  struct Region {
+    std::string name;
+    int count;        // number of samples
+    double resident;  // high-water mark of the resident memory
+    double tensor;    // largest memory of the persistent tensors
+                      // in this process
+    std::vector<TensorMemory> largest;
+  };
+  std::vector<Region> regions_;
+};
+
+}  // end of namespace tenes
+
+#endif  // TENES_MEMORY_HPP
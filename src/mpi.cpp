@@ -38,12 +38,16 @@ int MPI_Bcast(void*, int, MPI_Datatype, int, MPI_Comm) { return 0; }
 
 namespace tenes{
 
+template <>
+MPI_Datatype get_MPI_Datatype<char>() { return MPI_CHAR; }
 template <>
 MPI_Datatype get_MPI_Datatype<int>() { return MPI_INT; }
 template <>
 MPI_Datatype get_MPI_Datatype<double>() { return MPI_DOUBLE; }
 template <>
 MPI_Datatype get_MPI_Datatype<bool>() { return MPI_INT; }
+template <>
+MPI_Datatype get_MPI_Datatype<long>() { return MPI_LONG; }
 
 int bcast(bool &val, int root, MPI_Comm comm){
   int ret=0;
@@ -30,8 +30,10 @@ using MPI_Datatype = int;
 
 constexpr MPI_Comm MPI_COMM_WORLD = 0;
 constexpr MPI_Datatype MPI_BYTE = 0;
+constexpr MPI_Datatype MPI_CHAR = 0;
 constexpr MPI_Datatype MPI_INT = 0;
 constexpr MPI_Datatype MPI_DOUBLE = 0;
+constexpr MPI_Datatype MPI_LONG = 0;
 
 int MPI_Init(int*, char***);
 int MPI_Barrier(MPI_Comm);
@@ -52,9 +54,11 @@ namespace tenes{
 
 template <class T>
 MPI_Datatype get_MPI_Datatype();
+template <> MPI_Datatype get_MPI_Datatype<char>();
 template <> MPI_Datatype get_MPI_Datatype<int>();
 template <> MPI_Datatype get_MPI_Datatype<double>();
 template <> MPI_Datatype get_MPI_Datatype<bool>();
+template <> MPI_Datatype get_MPI_Datatype<long>();
 
 template <class T>
 int bcast(T &val, int root, MPI_Comm comm){
@@ -171,6 +175,132 @@ int allreduce_sum(std::vector<T> &val, MPI_Comm comm){
   return 0;
 }
 
+template <class T>
+int allreduce_max(T &val, MPI_Comm comm){
+#ifndef _NO_MPI
+  const MPI_Datatype datatype = get_MPI_Datatype<T>();
+  T recv;
+  int ret = MPI_Allreduce(&val, &recv, 1, datatype, MPI_MAX, comm);
+  if(ret!=0){
+    return ret;
+  }
+  val = recv;
+#endif
+  return 0;
+}
+
+/*! @brief gather vectors from all the processes into root
+ *
+ *  recv on root is the concatenation of send in rank order.
+ */
+template <class T>
+int gatherv(std::vector<T> const &send, std::vector<T> &recv, int root,
+            MPI_Comm comm) {
+#ifndef _NO_MPI
+  const MPI_Datatype datatype = get_MPI_Datatype<T>();
+  int rank, size;
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_size(comm, &size);
+  int sz = send.size();
+  std::vector<int> counts(size), displs(size);
+  int ret = MPI_Gather(&sz, 1, MPI_INT, &(counts[0]), 1, MPI_INT, root, comm);
+  if (ret != 0) {
+    return ret;
+  }
+  if (rank == root) {
+    int total = 0;
+    for (int i = 0; i < size; ++i) {
+      displs[i] = total;
+      total += counts[i];
+    }
+    recv.resize(total);
+  }
+  ret = MPI_Gatherv(const_cast<T *>(send.data()), sz, datatype, recv.data(),
+                    &(counts[0]), &(displs[0]), datatype, root, comm);
+  return ret;
+#else
+  recv = send;
+  return 0;
+#endif
+}
+
+/*! @brief gather vectors from all the processes into all the processes
+ *
+ *  recv is the concatenation of send in rank order.
+ */
+template <class T>
+int allgatherv(std::vector<T> const &send, std::vector<T> &recv,
+               MPI_Comm comm) {
+#ifndef _NO_MPI
+  const MPI_Datatype datatype = get_MPI_Datatype<T>();
+  int size;
+  MPI_Comm_size(comm, &size);
+  int sz = send.size();
+  std::vector<int> counts(size), displs(size);
+  int ret = MPI_Allgather(&sz, 1, MPI_INT, &(counts[0]), 1, MPI_INT, comm);
+  if (ret != 0) {
+    return ret;
+  }
+  int total = 0;
+  for (int i = 0; i < size; ++i) {
+    displs[i] = total;
+    total += counts[i];
+  }
+  recv.resize(total);
+  ret = MPI_Allgatherv(const_cast<T *>(send.data()), sz, datatype, recv.data(),
+                       &(counts[0]), &(displs[0]), datatype, comm);
+  return ret;
+#else
+  recv = send;
+  return 0;
+#endif
+}
+
+/*! @brief exchange vectors between all the processes
+ *
+ *  send[r] is sent to the process r, and recv[r] is received from it.
+ */
+template <class T>
+int alltoallv(std::vector<std::vector<T>> const &send,
+              std::vector<std::vector<T>> &recv, MPI_Comm comm) {
+#ifndef _NO_MPI
+  const MPI_Datatype datatype = get_MPI_Datatype<T>();
+  int size;
+  MPI_Comm_size(comm, &size);
+  std::vector<int> send_counts(size), send_displs(size);
+  std::vector<int> recv_counts(size), recv_displs(size);
+  std::vector<T> send_buffer;
+  for (int i = 0; i < size; ++i) {
+    send_counts[i] = send[i].size();
+    send_displs[i] = send_buffer.size();
+    send_buffer.insert(send_buffer.end(), send[i].begin(), send[i].end());
+  }
+  int ret = MPI_Alltoall(&(send_counts[0]), 1, MPI_INT, &(recv_counts[0]), 1,
+                         MPI_INT, comm);
+  if (ret != 0) {
+    return ret;
+  }
+  int total = 0;
+  for (int i = 0; i < size; ++i) {
+    recv_displs[i] = total;
+    total += recv_counts[i];
+  }
+  std::vector<T> recv_buffer(total);
+  ret = MPI_Alltoallv(send_buffer.data(), &(send_counts[0]),
+                      &(send_displs[0]), datatype, recv_buffer.data(),
+                      &(recv_counts[0]), &(recv_displs[0]), datatype, comm);
+  recv.assign(size, std::vector<T>());
+  for (int i = 0; i < size; ++i) {
+    recv[i].assign(recv_buffer.begin() + recv_displs[i],
+                   recv_buffer.begin() + recv_displs[i] + recv_counts[i]);
+  }
+  return ret;
+#else
+  recv = send;
+  return 0;
+#endif
+}
+
 template <class T>
 int allreduce_sum(std::complex<T> /* &val */, MPI_Comm /* comm */){
   throw tenes::unimplemented_error("allreduce for complex is not implemented");
@@ -17,31 +17,169 @@
 #ifndef TENES_OPERATOR_HPP
 #define TENES_OPERATOR_HPP
 
-#include <vector>
+#include <complex>
+#include <functional>
+#include <memory>
 #include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "mpi.hpp"
 
 namespace tenes {
 
+namespace detail {
+inline size_t hash_combine(size_t seed, size_t value) {
+  return seed ^ (value + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2));
+}
+// +0.0 makes -0.0 and 0.0 (equal elements) have the same hash
+inline size_t hash_element(double v) { return std::hash<double>()(v + 0.0); }
+inline size_t hash_element(std::complex<double> v) {
+  return hash_combine(hash_element(v.real()), hash_element(v.imag()));
+}
+} // namespace detail
+
+/*! @brief hash of the shape and the elements of a distributed tensor
+ *
+ *  This is a collective operation over the communicator of `A`.
+ *  Every process returns the same value.
+ */
+template <class tensor> size_t elements_hash(tensor const &A) {
+  size_t h = A.rank();
+  for (size_t i = 0; i < A.rank(); ++i) {
+    h = detail::hash_combine(h, A.shape()[i]);
+  }
+  for (size_t lindex = 0; lindex < A.local_size(); ++lindex) {
+    h = detail::hash_combine(h, detail::hash_element(A[lindex]));
+  }
+  // tensors of the same shape have the same distribution of the elements
+  std::vector<long> local(1, static_cast<long>(h)), all;
+  allgatherv(local, all, A.get_comm());
+  size_t ret = 0;
+  for (long v : all) {
+    ret = detail::hash_combine(ret, static_cast<size_t>(v));
+  }
+  return ret;
+}
+
+/*! @brief whether two distributed tensors have the same shape and elements
+ *
+ *  This is a collective operation over the communicator of `A` and `B`.
+ */
+template <class tensor> bool same_elements(tensor const &A, tensor const &B) {
+  if (A.shape() != B.shape()) {
+    return false;
+  }
+  int num_different = 0;
+  for (size_t lindex = 0; lindex < A.local_size(); ++lindex) {
+    if (A[lindex] != B[lindex]) {
+      ++num_different;
+      break;
+    }
+  }
+  allreduce_sum(num_different, A.get_comm());
+  return num_different == 0;
+}
+
+/*! @brief table of operator tensors deduplicated by their contents
+ *
+ *  Operators with the same elements share one tensor,
+ *  which is referenced by a handle (shared pointer to const tensor).
+ *  Tensors are identified by elements_hash and same_elements,
+ *  that is, by the values loaded, not by how they are written in the input.
+ *  The tensors are distributed over the communicator of the table.
+ */
+template <class tensor> class OperatorTable {
+public:
+  using handle = std::shared_ptr<const tensor>;
+  using comm_type = typename tensor::comm_type;
+
+  explicit OperatorTable(comm_type const &comm = MPI_COMM_WORLD)
+      : comm_(comm) {}
+
+  comm_type const &comm() const { return comm_; }
+
+  /*! @brief returns the registered tensor with the same elements as `A`
+   *
+   *  If no such tensor is registered yet, `A` is registered.
+   *  This is a collective operation over the communicator of the table.
+   */
+  handle intern(tensor const &A) {
+    const size_t hash = elements_hash(A);
+    auto range = tensors.equal_range(hash);
+    for (auto it = range.first; it != range.second; ++it) {
+      // the hashes may collide
+      if (same_elements(*it->second, A)) {
+        return it->second;
+      }
+    }
+    handle h = std::make_shared<const tensor>(A);
+    tensors.emplace(hash, h);
+    return h;
+  }
+
+  /*! @brief returns the registered tensor with the same elements as `make()`
+   *
+   *  `source` is the text from which `make()` loads the elements.
+   *  A source seen before gives the same tensor without calling `make()`
+   *  again; other sources are deduplicated by intern(A).
+   *
+   *  @param[in] source  canonical form of the source of elements
+   *  @param[in] make    function returning a tensor
+   */
+  template <class F> handle intern(std::string const &source, F make) {
+    auto it = sources.find(source);
+    if (it != sources.end()) {
+      return it->second;
+    }
+    handle h = intern(make());
+    sources.emplace(source, h);
+    return h;
+  }
+
+  //! number of distinct tensors
+  size_t size() const { return tensors.size(); }
+
+  /*! @brief maximum absolute value of the imaginary parts of the elements
+   *         read so far (in the local blocks of this process)
+   *
+   *  This is recorded even when tensor is real, so that one can check
+   *  whether the input operators are real without a complex copy.
+   */
+  double max_imag() const { return max_imag_; }
+  double *max_imag_ptr() { return &max_imag_; }
+
+private:
+  comm_type comm_;
+  std::unordered_multimap<size_t, handle> tensors;
+  std::unordered_map<std::string, handle> sources;
+  double max_imag_ = 0.0;
+};
+
 template <class tensor> struct Operator {
   std::string name;
   int group;
   int source_site;
   std::vector<int> dx;
   std::vector<int> dy;
-  tensor op;
+  std::shared_ptr<const tensor> op_ptr;
   std::vector<int> ops_indices;
 
   // onesite
-  Operator(std::string const& name, int group, int site, tensor const &op): name(name), group(group), source_site(site), dx(0), dy(0), op(op){}
+  Operator(std::string const& name, int group, int site, std::shared_ptr<const tensor> const &op): name(name), group(group), source_site(site), dx(0), dy(0), op_ptr(op){}
+  Operator(std::string const& name, int group, int site, tensor const &op): Operator(name, group, site, std::make_shared<const tensor>(op)){}
 
   // twosite
-  Operator(std::string const& name, int group, int source_site, int dx, int dy, tensor const &op): name(name), group(group), source_site(source_site), dx(1, dx), dy(1, dy), op(op) {}
-  Operator(std::string const& name, int group, int source_site, std::vector<int> const &dx, std::vector<int> const &dy, tensor const &op): name(name), group(group), source_site(source_site), dx(dx), dy(dy), op(op) {}
+  Operator(std::string const& name, int group, int source_site, int dx, int dy, std::shared_ptr<const tensor> const &op): name(name), group(group), source_site(source_site), dx(1, dx), dy(1, dy), op_ptr(op) {}
+  Operator(std::string const& name, int group, int source_site, int dx, int dy, tensor const &op): Operator(name, group, source_site, dx, dy, std::make_shared<const tensor>(op)) {}
+  Operator(std::string const& name, int group, int source_site, std::vector<int> const &dx, std::vector<int> const &dy, std::shared_ptr<const tensor> const &op): name(name), group(group), source_site(source_site), dx(dx), dy(dy), op_ptr(op) {}
+  Operator(std::string const& name, int group, int source_site, std::vector<int> const &dx, std::vector<int> const &dy, tensor const &op): Operator(name, group, source_site, dx, dy, std::make_shared<const tensor>(op)) {}
   Operator(std::string const& name, int group, int source_site, int dx, int dy, std::vector<int> const &ops_indices)
       : name(name), group(group), source_site(source_site), dx(1, dx), dy(1, dy), ops_indices(ops_indices) {}
   Operator(std::string const& name, int group, int source_site, std::vector<int> const &dx, std::vector<int> const &dy, std::vector<int> const &ops_indices)
       : name(name), group(group), source_site(source_site), dx(dx), dy(dy), ops_indices(ops_indices) {}
 
+  tensor const& op() const {return *op_ptr;}
   bool is_onesite() const {return dx.empty();}
 };
 
@@ -50,13 +188,27 @@ template <class tensor> using Operators = std::vector<Operator<tensor>>;
 template <class tensor> struct NNOperator {
   int source_site;
   int source_leg;
-  tensor op;
+  // leg from the middle site to the last one of a three-site operator
+  // (-1 for a two-site operator)
+  int next_leg;
+  std::shared_ptr<const tensor> op_ptr;
 
+  NNOperator(int site, int leg, std::shared_ptr<const tensor> const &op)
+      : source_site(site), source_leg(leg), next_leg(-1), op_ptr(op) {}
   NNOperator(int site, int leg, tensor const &op)
-      : source_site(site), source_leg(leg), op(op) {}
+      : NNOperator(site, leg, std::make_shared<const tensor>(op)) {}
+
+  // threesite
+  NNOperator(int site, int leg, int next_leg,
+             std::shared_ptr<const tensor> const &op)
+      : source_site(site), source_leg(leg), next_leg(next_leg), op_ptr(op) {}
+  NNOperator(int site, int leg, int next_leg, tensor const &op)
+      : NNOperator(site, leg, next_leg, std::make_shared<const tensor>(op)) {}
 
+  tensor const &op() const { return *op_ptr; }
   bool is_horizontal() const { return source_leg % 2 == 0; }
   bool is_vertical() const { return !is_horizontal(); }
+  bool is_threesite() const { return next_leg >= 0; }
 };
 
 template <class tensor> using NNOperators = std::vector<NNOperator<tensor>>;
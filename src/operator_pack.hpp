@@ -0,0 +1,384 @@
+/* TeNeS - Massively parallel tensor network solver /
+/ Copyright (C) 2019- The University of Tokyo */
+
+/* This program is free software: you can redistribute it and/or modify /
+/ it under the terms of the GNU General Public License as published by /
+/ the Free Software Foundation, either version 3 of the License, or /
+/ (at your option) any later version. */
+
+/* This program is distributed in the hope that it will be useful, /
+/ but WITHOUT ANY WARRANTY; without even the implied warranty of /
+/ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the /
+/ GNU General Public License for more details. */
+
+/* You should have received a copy of the GNU General Public License /
+/ along with this program. If not, see http://www.gnu.org/licenses/. */
+
+#ifndef TENES_OPERATOR_PACK_HPP
+#define TENES_OPERATOR_PACK_HPP
+
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <mptensor/tensor.hpp>
+
+#include "exception.hpp"
+#include "mpi.hpp"
+#include "operator.hpp"
+#include "tensor.hpp"
+#include "util/archive.hpp"
+#include "util/read_tensor.hpp"
+
+namespace tenes {
+
+/*! @brief dense tensor held by one process
+ *
+ *  This provides the part of the interface of mptensor::Tensor used in
+ *  util::read_tensor and util::read_tensor_file, so that operators can be
+ *  read by one process without any communication and sent to the others
+ *  (see pack_operators).
+ *  Elements are stored in C order (the last index runs fastest).
+ *
+ *  A tensor made by file_reference holds no elements but only the file
+ *  where they are stored, and every process reads its own local block
+ *  from the file when the operators are unpacked.
+ */
+template <class T> class DenseTensor {
+public:
+  using value_type = T;
+  // only for the interface (the whole tensor is in the process)
+  using comm_type = MPI_Comm;
+
+  DenseTensor() {}
+  explicit DenseTensor(mptensor::Shape const &shape)
+      : shape_(shape), strides_(shape.size(), 1) {
+    const size_t rank = shape.size();
+    for (size_t i = rank; i > 1; --i) {
+      strides_[i - 2] = strides_[i - 1] * shape[i - 1];
+    }
+    data_.assign(rank == 0 ? 1 : strides_[0] * shape[0], T(0.0));
+  }
+  DenseTensor(comm_type const &, mptensor::Shape const &shape)
+      : DenseTensor(shape) {}
+
+  //! file where the elements are stored (see util::read_tensor_file)
+  struct FileSource {
+    std::string filename;
+    std::string format;
+    std::string dtype;
+    double atol;
+  };
+
+  /*! @brief tensor whose elements are left in a file
+   *
+   *  Only the header of the file is read to check the shape.
+   */
+  static DenseTensor file_reference(mptensor::Shape const &shape,
+                                    FileSource const &source) {
+    util::open_tensor_file(source.filename, source.format, source.dtype,
+                           shape);
+    DenseTensor ret;
+    ret.shape_ = shape;
+    ret.source_ = std::make_shared<FileSource>(source);
+    return ret;
+  }
+  bool is_file_reference() const { return source_ != nullptr; }
+  FileSource const &source() const { return *source_; }
+
+  size_t rank() const { return shape_.size(); }
+  mptensor::Shape const &shape() const { return shape_; }
+  size_t local_size() const { return data_.size(); }
+
+  mptensor::Index global_index(size_t offset) const {
+    mptensor::Index index;
+    index.resize(rank());
+    for (size_t i = 0; i < rank(); ++i) {
+      index[i] = offset / strides_[i];
+      offset %= strides_[i];
+    }
+    return index;
+  }
+  size_t offset(mptensor::Index const &index) const {
+    size_t ret = 0;
+    for (size_t i = 0; i < rank(); ++i) {
+      ret += index[i] * strides_[i];
+    }
+    return ret;
+  }
+
+  T &operator[](size_t offset) { return data_[offset]; }
+  T const &operator[](size_t offset) const { return data_[offset]; }
+  void set_value(mptensor::Index const &index, T v) { data_[offset(index)] = v; }
+  void get_value(mptensor::Index const &index, T &v) const {
+    v = data_[offset(index)];
+  }
+
+  std::vector<T> const &data() const { return data_; }
+
+private:
+  mptensor::Shape shape_;
+  std::vector<size_t> strides_;
+  std::vector<T> data_;
+  std::shared_ptr<const FileSource> source_;
+};
+
+/*! @brief hash of the shape and the elements of a DenseTensor
+ *
+ *  The elements of a file reference are not loaded,
+ *  so that it is identified by the file (see same_elements).
+ */
+template <class T> size_t elements_hash(DenseTensor<T> const &A) {
+  size_t h = A.rank();
+  for (size_t i = 0; i < A.rank(); ++i) {
+    h = detail::hash_combine(h, A.shape()[i]);
+  }
+  if (A.is_file_reference()) {
+    auto const &source = A.source();
+    std::hash<std::string> hash_string;
+    h = detail::hash_combine(h, hash_string(source.filename));
+    h = detail::hash_combine(h, hash_string(source.format));
+    h = detail::hash_combine(h, hash_string(source.dtype));
+    return detail::hash_combine(h, detail::hash_element(source.atol));
+  }
+  for (T const &v : A.data()) {
+    h = detail::hash_combine(h, detail::hash_element(v));
+  }
+  return h;
+}
+
+//! whether two DenseTensors have the same shape and elements (or file)
+template <class T>
+bool same_elements(DenseTensor<T> const &A, DenseTensor<T> const &B) {
+  if (A.shape() != B.shape() ||
+      A.is_file_reference() != B.is_file_reference()) {
+    return false;
+  }
+  if (A.is_file_reference()) {
+    auto const &a = A.source();
+    auto const &b = B.source();
+    return a.filename == b.filename && a.format == b.format &&
+           a.dtype == b.dtype && a.atol == b.atol;
+  }
+  return A.data() == B.data();
+}
+
+/*! @brief reads operator elements from a file (see util::read_tensor_file)
+ *
+ *  DenseTensor keeps only the reference to the file (see
+ *  DenseTensor::file_reference).
+ */
+template <class tensor> struct TensorFileReader {
+  template <class Source>
+  static tensor read(Source const &source, mptensor::Shape const &shape,
+                     typename tensor::comm_type const &comm,
+                     double *max_imag) {
+    return util::read_tensor_file<tensor>(source.filename, source.format,
+                                          source.dtype, shape, comm,
+                                          source.atol, max_imag);
+  }
+};
+template <class T> struct TensorFileReader<DenseTensor<T>> {
+  template <class Source>
+  static DenseTensor<T> read(Source const &source, mptensor::Shape const &shape,
+                             MPI_Comm const &, double *) {
+    return DenseTensor<T>::file_reference(
+        shape, typename DenseTensor<T>::FileSource{
+                   source.filename, source.format, source.dtype, source.atol});
+  }
+};
+
+/*! @brief throws input_error if some operators are complex in real mode
+ *
+ *  @param[in] max_imag  maximum absolute value of the imaginary parts
+ *  @param[in] tol       tolerance (parameter.general.iszero_tol)
+ */
+inline void check_real_operators(double max_imag, double tol) {
+  if (max_imag > tol) {
+    std::stringstream ss;
+    ss << "TeNeS invoked in real tensor mode (parameter.general.is_real = "
+          "true) but some operators are complex.\n";
+    ss << "Consider using larger parameter.general.iszero_tol (present: "
+       << tol << ")";
+    throw tenes::input_error(ss.str());
+  }
+}
+
+// counterpart of fill_local in tensor.hpp (the whole tensor is local)
+template <class T>
+void fill_local(DenseTensor<T> &A, std::vector<T> const &dense) {
+  for (size_t k = 0; k < A.local_size(); ++k) {
+    A[k] = dense[k];
+  }
+}
+
+/*! @brief all the operators defined in an input file */
+template <class tensor> struct OperatorSet {
+  NNOperators<tensor> simple_updates;
+  NNOperators<tensor> full_updates;
+  Operators<tensor> onesite_operators;
+  Operators<tensor> twosite_operators;
+};
+
+namespace detail {
+template <class T>
+int tensor_id(std::map<DenseTensor<T> const *, int> &ids,
+              std::vector<DenseTensor<T> const *> &tensors,
+              std::shared_ptr<const DenseTensor<T>> const &ptr) {
+  if (!ptr) {
+    return -1;
+  }
+  auto it = ids.find(ptr.get());
+  if (it != ids.end()) {
+    return it->second;
+  }
+  const int id = tensors.size();
+  ids.emplace(ptr.get(), id);
+  tensors.push_back(ptr.get());
+  return id;
+}
+} // end of namespace detail
+
+/*! @brief serialize operators
+ *
+ *  Each tensor shared by several operators is sent only once.
+ *  Tensors made by DenseTensor::file_reference are sent as the references.
+ *
+ *  @param[in,out] ar
+ *  @param[in] ops
+ *  @param[in] imag_tol  if nonnegative, unpack_operators checks by
+ *                       check_real_operators that the tensors read from
+ *                       files are real
+ */
+template <class T>
+void pack_operators(util::OutArchive &ar,
+                    OperatorSet<DenseTensor<T>> const &ops,
+                    double imag_tol = -1.0) {
+  std::map<DenseTensor<T> const *, int> ids;
+  std::vector<DenseTensor<T> const *> tensors;
+
+  util::OutArchive body;
+  for (auto const *updates : {&ops.simple_updates, &ops.full_updates}) {
+    body << static_cast<uint64_t>(updates->size());
+    for (auto const &up : *updates) {
+      body << up.source_site << up.source_leg << up.next_leg
+           << detail::tensor_id(ids, tensors, up.op_ptr);
+    }
+  }
+  for (auto const *obs : {&ops.onesite_operators, &ops.twosite_operators}) {
+    body << static_cast<uint64_t>(obs->size());
+    for (auto const &op : *obs) {
+      body << op.name << op.group << op.source_site << op.dx << op.dy
+           << op.ops_indices << detail::tensor_id(ids, tensors, op.op_ptr);
+    }
+  }
+
+  ar << imag_tol << static_cast<uint64_t>(tensors.size());
+  for (auto const *A : tensors) {
+    std::vector<int> shape(A->rank());
+    for (size_t i = 0; i < shape.size(); ++i) {
+      shape[i] = A->shape()[i];
+    }
+    ar << shape << static_cast<int>(A->is_file_reference());
+    if (A->is_file_reference()) {
+      auto const &source = A->source();
+      ar << source.filename << source.format << source.dtype << source.atol;
+    } else {
+      ar << A->data();
+    }
+  }
+  ar << body.str();
+}
+
+/*! @brief deserialize operators packed by pack_operators
+ *
+ *  Each process fills its own local blocks of the tensors,
+ *  reading them directly from the files for file references.
+ *  The packed tensors are interned through an OperatorTable, so that
+ *  tensors with the same elements (e.g., two files with the same contents,
+ *  which are only known after reading them) share one tensor.
+ *  This is a collective operation over `comm`.
+ *
+ *  @param[in,out] ar
+ *  @param[in] comm  communicator over which the tensors are distributed
+ *  @pre ptensor::value_type is the same as that of the packed tensors
+ */
+template <class ptensor>
+OperatorSet<ptensor> unpack_operators(util::InArchive &ar,
+                                      typename ptensor::comm_type const &comm) {
+  using value_type = typename ptensor::value_type;
+
+  double imag_tol = -1.0;
+  uint64_t ntensors = 0;
+  ar >> imag_tol >> ntensors;
+  OperatorTable<ptensor> table(comm);
+  std::vector<std::shared_ptr<const ptensor>> tensors;
+  bool has_file = false;
+  double max_imag = 0.0;
+  for (uint64_t k = 0; k < ntensors; ++k) {
+    std::vector<int> shape;
+    int is_file = 0;
+    ar >> shape >> is_file;
+    mptensor::Shape mshape;
+    for (int d : shape) {
+      mshape.push(d);
+    }
+    if (is_file != 0) {
+      typename DenseTensor<value_type>::FileSource source;
+      ar >> source.filename >> source.format >> source.dtype >> source.atol;
+      tensors.push_back(table.intern(
+          TensorFileReader<ptensor>::read(source, mshape, comm, &max_imag)));
+      has_file = true;
+    } else {
+      std::vector<value_type> data;
+      ar >> data;
+      ptensor A(comm, mshape);
+      fill_local(A, data);
+      tensors.push_back(table.intern(A));
+    }
+  }
+  if (has_file && imag_tol >= 0.0) {
+    allreduce_max(max_imag, comm);
+    check_real_operators(max_imag, imag_tol);
+  }
+  auto handle = [&](int id) {
+    return id < 0 ? std::shared_ptr<const ptensor>() : tensors[id];
+  };
+
+  std::string body_buffer;
+  ar >> body_buffer;
+  util::InArchive body(body_buffer);
+
+  OperatorSet<ptensor> ret;
+  for (auto *updates : {&ret.simple_updates, &ret.full_updates}) {
+    uint64_t n = 0;
+    body >> n;
+    for (uint64_t k = 0; k < n; ++k) {
+      int source_site, source_leg, next_leg, id;
+      body >> source_site >> source_leg >> next_leg >> id;
+      updates->emplace_back(source_site, source_leg, next_leg, handle(id));
+    }
+  }
+  for (auto *obs : {&ret.onesite_operators, &ret.twosite_operators}) {
+    uint64_t n = 0;
+    body >> n;
+    for (uint64_t k = 0; k < n; ++k) {
+      std::string name;
+      int group, source_site, id;
+      std::vector<int> dx, dy, ops_indices;
+      body >> name >> group >> source_site >> dx >> dy >> ops_indices >> id;
+      if (id < 0) {
+        obs->emplace_back(name, group, source_site, dx, dy, ops_indices);
+      } else {
+        obs->emplace_back(name, group, source_site, dx, dy, handle(id));
+      }
+    }
+  }
+  return ret;
+}
+
+} // end of namespace tenes
+
+#endif // TENES_OPERATOR_PACK_HPP
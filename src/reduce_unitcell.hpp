@@ -0,0 +1,243 @@
+/* TeNeS - Massively parallel tensor network solver /
+/ Copyright (C) 2019- The University of Tokyo */
+
+/* This program is free software: you can redistribute it and/or modify /
+/ it under the terms of the GNU General Public License as published by /
+/ the Free Software Foundation, either version 3 of the License, or /
+/ (at your option) any later version. */
+
+/* This program is distributed in the hope that it will be useful, /
+/ but WITHOUT ANY WARRANTY; without even the implied warranty of /
+/ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the /
+/ GNU General Public License for more details. */
+
+/* You should have received a copy of the GNU General Public License /
+/ along with this program. If not, see http://www.gnu.org/licenses/. */
+
+#ifndef TENES_REDUCE_UNITCELL_HPP
+#define TENES_REDUCE_UNITCELL_HPP
+
+#include <algorithm>
+#include <memory>
+#include <tuple>
+#include <vector>
+
+#include "Lattice.hpp"
+#include "operator_pack.hpp"
+
+namespace tenes {
+
+namespace detail {
+
+/*! @brief map of the sites of `lattice` onto the unit cell of `reduced`
+ *
+ *  Returns an empty vector unless every site of the infinite lattice
+ *  belongs to consistent sites of the both unit cells.
+ */
+inline std::vector<int> map_unitcell(Lattice const &lattice,
+                                     Lattice const &reduced) {
+  std::vector<int> map(lattice.N_UNIT);
+  for (int i = 0; i < lattice.N_UNIT; ++i) {
+    map[i] = reduced.other(0, lattice.x(i), lattice.y(i));
+  }
+  // the infinite lattice is spanned by the neighbors
+  for (int i = 0; i < lattice.N_UNIT; ++i) {
+    for (int d = 0; d < 4; ++d) {
+      if (map[lattice.neighbor(i, d)] != reduced.neighbor(map[i], d)) {
+        return std::vector<int>();
+      }
+    }
+  }
+  return map;
+}
+
+// whether the initial tensor of the site is random,
+// that is, its initial state is random or it has noises
+inline bool is_random_site(Lattice const &lattice, int site) {
+  auto const &dir = lattice.initial_dirs[site];
+  return lattice.noises[site] != 0.0 ||
+         std::all_of(dir.begin(), dir.end(),
+                     [](double x) { return x == 0.0; });
+}
+
+inline bool has_random_site(Lattice const &lattice) {
+  for (int i = 0; i < lattice.N_UNIT; ++i) {
+    if (is_random_site(lattice, i)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// (kind, group or leg, dx, dy, ops_indices, tensor) of an operator
+template <class tensor>
+using SiteOperatorKey =
+    std::tuple<int, int, std::vector<int>, std::vector<int>, std::vector<int>,
+               tensor const *>;
+
+// operators acting on each site, which should be the same in each class
+template <class tensor>
+std::vector<std::vector<SiteOperatorKey<tensor>>>
+site_operators(int N_UNIT, OperatorSet<tensor> const &ops) {
+  std::vector<std::vector<SiteOperatorKey<tensor>>> ret(N_UNIT);
+  const std::vector<int> none;
+  for (auto const &op : ops.simple_updates) {
+    ret[op.source_site].emplace_back(0, op.source_leg,
+                                     std::vector<int>(1, op.next_leg), none,
+                                     none, op.op_ptr.get());
+  }
+  for (auto const &op : ops.full_updates) {
+    ret[op.source_site].emplace_back(1, op.source_leg,
+                                     std::vector<int>(1, op.next_leg), none,
+                                     none, op.op_ptr.get());
+  }
+  for (auto const &op : ops.onesite_operators) {
+    ret[op.source_site].emplace_back(2, op.group, op.dx, op.dy,
+                                     op.ops_indices, op.op_ptr.get());
+  }
+  for (auto const &op : ops.twosite_operators) {
+    ret[op.source_site].emplace_back(3, op.group, op.dx, op.dy,
+                                     op.ops_indices, op.op_ptr.get());
+  }
+  return ret;
+}
+
+template <class Ops, class F> Ops filter_operators(Ops const &ops, F f) {
+  Ops ret;
+  for (auto const &op : ops) {
+    const int site = f(op.source_site);
+    if (site >= 0) {
+      ret.push_back(op);
+      ret.back().source_site = site;
+    }
+  }
+  return ret;
+}
+
+// whether every three-site update acts on three different sites
+template <class tensor>
+bool distinct_sites(Lattice const &lattice,
+                    NNOperators<tensor> const &updates) {
+  for (auto const &up : updates) {
+    if (!up.is_threesite()) {
+      continue;
+    }
+    const int middle = lattice.neighbor(up.source_site, up.source_leg);
+    const int last = lattice.neighbor(middle, up.next_leg);
+    if (middle == up.source_site || last == up.source_site || last == middle) {
+      return false;
+    }
+  }
+  return true;
+}
+
+} // end of namespace detail
+
+/*! @brief reduce the unit cell to the smallest one with the same problem
+ *
+ *  Sites of the unit cell are equivalent when they are connected by a
+ *  translation of a smaller unit cell and have the same tensor settings
+ *  (dimensions and initial states) and operators.
+ *  Sites with random initial tensors (random initial states or noises)
+ *  are never merged since their tensors differ from each other,
+ *  so the unit cell is reduced only when every site has a fixed initial
+ *  state without noise.
+ *  Operators are compared by identity, that is, they should be loaded
+ *  through one OperatorTable.
+ *  Unit cells on which a three-site update would visit a site twice
+ *  are skipped.
+ *  If such a smaller unit cell exists, `lattice` and `ops` are replaced
+ *  by the problem on it, and `lattice.input_site_map` keeps the map of
+ *  the original sites.
+ *
+ *  @return whether the unit cell has been reduced
+ */
+template <class tensor>
+bool reduce_unitcell(Lattice &lattice, OperatorSet<tensor> &ops) {
+  const int N_UNIT = lattice.N_UNIT;
+  // every site of a smaller unit cell merges at least two sites
+  if (detail::has_random_site(lattice)) {
+    return false;
+  }
+  const auto site_ops = detail::site_operators(N_UNIT, ops);
+
+  // candidates of the unit cell (LX, LY, skew) in ascending order of size
+  std::vector<std::tuple<int, int, int>> candidates;
+  for (int LX = 1; LX <= lattice.LX; ++LX) {
+    for (int LY = 1; LY <= lattice.LY; ++LY) {
+      if (LX * LY >= N_UNIT) {
+        continue;
+      }
+      for (int skew = 0; skew < LX; ++skew) {
+        candidates.emplace_back(LX, LY, skew);
+      }
+    }
+  }
+  std::stable_sort(candidates.begin(), candidates.end(),
+                   [](std::tuple<int, int, int> const &a,
+                      std::tuple<int, int, int> const &b) {
+                     return std::get<0>(a) * std::get<1>(a) <
+                            std::get<0>(b) * std::get<1>(b);
+                   });
+
+  for (auto const &candidate : candidates) {
+    Lattice reduced(std::get<0>(candidate), std::get<1>(candidate),
+                    std::get<2>(candidate));
+    const auto map = detail::map_unitcell(lattice, reduced);
+    if (map.empty()) {
+      continue;
+    }
+
+    // the first site of each class represents it
+    std::vector<int> representative(reduced.N_UNIT, -1);
+    for (int i = 0; i < N_UNIT; ++i) {
+      if (representative[map[i]] < 0) {
+        representative[map[i]] = i;
+      }
+    }
+    bool equivalent = true;
+    for (int i = 0; i < N_UNIT && equivalent; ++i) {
+      const int r = representative[map[i]];
+      equivalent = lattice.physical_dims[i] == lattice.physical_dims[r] &&
+                   lattice.virtual_dims[i] == lattice.virtual_dims[r] &&
+                   lattice.initial_dirs[i] == lattice.initial_dirs[r] &&
+                   site_ops[i] == site_ops[r];
+    }
+    if (!equivalent) {
+      continue;
+    }
+
+    for (int r = 0; r < reduced.N_UNIT; ++r) {
+      const int i = representative[r];
+      reduced.physical_dims[r] = lattice.physical_dims[i];
+      reduced.virtual_dims[r] = lattice.virtual_dims[i];
+      reduced.initial_dirs[r] = lattice.initial_dirs[i];
+      reduced.noises[r] = lattice.noises[i];
+    }
+    reduced.input_site_map = map;
+
+    // operators on the representatives act on the reduced unit cell
+    auto to_reduced = [&](int site) {
+      return representative[map[site]] == site ? map[site] : -1;
+    };
+    auto simple_updates =
+        detail::filter_operators(ops.simple_updates, to_reduced);
+    if (!detail::distinct_sites(reduced, simple_updates)) {
+      continue;
+    }
+    ops.simple_updates = simple_updates;
+    ops.full_updates = detail::filter_operators(ops.full_updates, to_reduced);
+    ops.onesite_operators =
+        detail::filter_operators(ops.onesite_operators, to_reduced);
+    ops.twosite_operators =
+        detail::filter_operators(ops.twosite_operators, to_reduced);
+
+    lattice = reduced;
+    return true;
+  }
+  return false;
+}
+
+} // end of namespace tenes
+
+#endif // TENES_REDUCE_UNITCELL_HPP
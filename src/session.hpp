@@ -0,0 +1,189 @@
+/* TeNeS - Massively parallel tensor network solver /
+/ Copyright (C) 2019- The University of Tokyo */
+
+/* This program is free software: you can redistribute it and/or modify /
+/ it under the terms of the GNU General Public License as published by /
+/ the Free Software Foundation, either version 3 of the License, or /
+/ (at your option) any later version. */
+
+/* This program is distributed in the hope that it will be useful, /
+/ but WITHOUT ANY WARRANTY; without even the implied warranty of /
+/ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the /
+/ GNU General Public License for more details. */
+
+/* You should have received a copy of the GNU General Public License /
+/ along with this program. If not, see http://www.gnu.org/licenses/. */
+
+#ifndef TENES_SESSION_HPP
+#define TENES_SESSION_HPP
+
+#include <complex>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Lattice.hpp"
+#include "PEPS_Parameters.hpp"
+#include "correlation.hpp"
+#include "mpi.hpp"
+#include "operator.hpp"
+#include "printlevel.hpp"
+#include "tensor.hpp"
+
+namespace tenes {
+
+/*! @brief problem read from an input file
+ *
+ *  Identical on all the processes.
+ *  Operators are kept serialized (see operator_pack.hpp) until a Session
+ *  builds them as tensors of its type.
+ */
+struct Input {
+  PEPS_Parameters peps_parameters;
+  Lattice lattice{1, 1};
+  CorrelationParameter corparam;
+  std::string operators;
+};
+
+/*! @brief read an input file
+ *
+ *  Only the root process of `comm` reads the file and the others receive
+ *  the problem by one broadcast.
+ *  This is a collective operation over `comm`.
+ *
+ *  @param[in] input_filename
+ *  @param[in] comm
+ *  @param[in] print_level
+ */
+Input load_input(std::string const &input_filename, MPI_Comm comm,
+                 PrintLevel print_level = PrintLevel::info);
+
+/*! @brief observable per site measured by Session::measure */
+struct Density {
+  std::string name;
+  std::complex<double> value;
+};
+
+template <class ptensor> class TeNeS;
+
+/*! @brief stepwise interface of TeNeS
+ *
+ *  A session keeps the iTPS tensors and the CTM environment between the
+ *  steps, so that a driver can run many operations in one process:
+ *
+ *  @code
+ *  auto input = tenes::load_input("input.toml", MPI_COMM_WORLD);
+ *  tenes::Session<tenes::real_tensor> session(MPI_COMM_WORLD, input);
+ *  session.simple_update(100);
+ *  auto densities = session.measure();
+ *  session.full_update(10);
+ *  densities = session.measure();  // CTM starts from the last environment
+ *  @endcode
+ *
+ *  All the member functions except accessors are collective operations over
+ *  the communicator.
+ *
+ *  @tparam ptensor real_tensor or complex_tensor
+ */
+template <class ptensor> class Session {
+public:
+  using tensor_type = ptensor;
+
+  Session(MPI_Comm comm, PEPS_Parameters peps_parameters, Lattice lattice,
+          NNOperators<ptensor> simple_updates,
+          NNOperators<ptensor> full_updates,
+          Operators<ptensor> onesite_operators,
+          Operators<ptensor> twosite_operators,
+          CorrelationParameter corparam);
+
+  /*! @brief build a session from an input loaded by load_input
+   *
+   *  Throws tenes::input_error if the type of tensors does not match
+   *  `parameter.general.is_real`.
+   */
+  Session(MPI_Comm comm, Input const &input);
+
+  ~Session();
+  Session(Session const &) = delete;
+  Session &operator=(Session const &) = delete;
+
+  /*! @brief run the whole calculation as the tenes command does
+   *
+   *  simple update, full update, saving tensors, measurement (if enabled),
+   *  and saving elapsed times
+   */
+  int run();
+
+  /*! @brief apply `num_steps` sweeps of the simple update */
+  void simple_update(int num_steps);
+
+  /*! @brief apply `num_steps` sweeps of the full update
+   *
+   *  The environment is updated before the first step.
+   */
+  void full_update(int num_steps);
+
+  /*! @brief update the CTM environment
+   *
+   *  The CTM starts from the present environment if it has been calculated,
+   *  loaded, or copied by warm_start and fits the site tensors,
+   *  and from the site tensors otherwise.
+   */
+  void update_environment();
+
+  /*! @brief update the environment, measure and save observables
+   *
+   *  @return observables per site (the same on all the processes)
+   */
+  std::vector<Density> measure();
+
+  /*! @brief start from the tensors of another session
+   *
+   *  The site tensors and the mean fields are copied, and so is the
+   *  environment if the bond dimensions of the environments are the same.
+   *  Throws tenes::input_error if the shapes of the site tensors differ.
+   */
+  void warm_start(Session const &other);
+
+  /*! @brief save tensors into `parameter.general.tensor_save` */
+  void save_tensors() const;
+
+  /*! @brief save and print elapsed times */
+  void summary() const;
+
+  PEPS_Parameters const &parameters() const;
+  Lattice const &lattice() const;
+
+  /*! @brief site tensors of the unit cell (bond order: left, top, right,
+   * bottom, physical) */
+  std::vector<ptensor> const &site_tensors() const;
+
+  /*! @brief mean fields on the bonds (lambdas[site][leg][index]) */
+  std::vector<std::vector<std::vector<double>>> const &lambdas() const;
+
+  /*! @brief corner tensors of the environment
+   *
+   *  @param[in] corner  0: left-top (C1), 1: right-top (C2),
+   *                     2: right-bottom (C3), 3: left-bottom (C4)
+   */
+  std::vector<ptensor> const &corner_tensors(int corner) const;
+
+  /*! @brief edge tensors of the environment
+   *
+   *  @param[in] edge  0: left, 1: top, 2: right, 3: bottom
+   */
+  std::vector<ptensor> const &edge_tensors(int edge) const;
+
+  /*! @brief total number of the CTM iterations in the session
+   *
+   *  The CTM of the full update and of measure() are also counted.
+   */
+  int ctm_iterations() const;
+
+private:
+  std::unique_ptr<TeNeS<ptensor>> impl_;
+};
+
+} // end of namespace tenes
+
+#endif // TENES_SESSION_HPP
@@ -0,0 +1,281 @@
+/* TeNeS - Massively parallel tensor network solver /
+/ Copyright (C) 2019- The University of Tokyo */
+
+/* This program is free software: you can redistribute it and/or modify /
+/ it under the terms of the GNU General Public License as published by /
+/ the Free Software Foundation, either version 3 of the License, or /
+/ (at your option) any later version. */
+
+/* This program is distributed in the hope that it will be useful, /
+/ but WITHOUT ANY WARRANTY; without even the implied warranty of /
+/ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the /
+/ GNU General Public License for more details. */
+
+/* You should have received a copy of the GNU General Public License /
+/ along with this program. If not, see http://www.gnu.org/licenses/. */
+
+#ifndef TENES_TASK_GROUPS_HPP
+#define TENES_TASK_GROUPS_HPP
+
+#include <algorithm>
+#include <complex>
+#include <vector>
+
+#include <mptensor/tensor.hpp>
+
+#include "mpi.hpp"
+#include "tensor.hpp"
+#include "util/type_traits.hpp"
+
+namespace tenes {
+
+/*! @brief processes split into groups which run independent tasks
+ *
+ *  The processes in `comm` are split into `num_groups` groups of contiguous
+ *  ranks.
+ *  Tasks (e.g., sites of the unit cell) are assigned to the groups in a
+ *  round-robin manner, and tensors used by a group are distributed only over
+ *  the processes in the group.
+ *  A tensor is moved into a group by copy_to_group,
+ *  and a tensor made in a group is moved back by copy_from_group.
+ */
+class TaskGroups {
+public:
+  /*!
+   *  @param[in] comm
+   *  @param[in] num_groups  number of groups (clipped into [1, size of comm])
+   */
+  TaskGroups(MPI_Comm comm, int num_groups)
+      : comm_(comm), group_comm_(comm), num_groups_(1), group_(0),
+        group_rank_(0) {
+    int size = 1, rank = 0;
+    MPI_Comm_size(comm, &size);
+    MPI_Comm_rank(comm, &rank);
+    num_groups_ = std::max(1, std::min(num_groups, size));
+#ifndef _NO_MPI
+    if (num_groups_ > 1) {
+      group_ = static_cast<long>(rank) * num_groups_ / size;
+      MPI_Comm_split(comm, group_, rank, &group_comm_);
+    }
+#endif
+    MPI_Comm_rank(group_comm_, &group_rank_);
+  }
+  ~TaskGroups() {
+#ifndef _NO_MPI
+    if (num_groups_ > 1) {
+      MPI_Comm_free(&group_comm_);
+    }
+#endif
+  }
+  TaskGroups(TaskGroups const &) = delete;
+  TaskGroups &operator=(TaskGroups const &) = delete;
+
+  MPI_Comm comm() const { return comm_; }
+  MPI_Comm group_comm() const { return group_comm_; }
+  int num_groups() const { return num_groups_; }
+  int group() const { return group_; }
+  bool is_split() const { return num_groups_ > 1; }
+
+  /*! @brief whether the group of this process runs the task */
+  bool owns(int task) const { return task % num_groups_ == group_; }
+
+  /*! @brief whether this process reports the result of the task
+   *
+   *  Only the first process in the owner group reports,
+   *  so that a sum over all the processes gives the result.
+   */
+  bool reports(int task) const { return owns(task) && group_rank_ == 0; }
+
+  /*! @brief copy a tensor distributed over comm() into the group
+   *
+   *  This is a collective operation over comm(),
+   *  and `needed` must be the same in each group.
+   *
+   *  @param[in] A  tensor distributed over comm()
+   *  @param[in] needed  whether the group uses the tensor
+   *                     (if false, an empty tensor is returned
+   *                     and no elements are sent to the group)
+   */
+  template <class ptensor>
+  ptensor copy_to_group(ptensor const &A, bool needed = true) const {
+#ifdef _NO_MPI
+    return A;
+#else
+    if (!is_split()) {
+      return A;
+    }
+    return redistribute(&A, A.shape(), group_comm_, needed);
+#endif
+  }
+
+  /*! @brief copy tensors into the group
+   *
+   *  Only the tensors with `used[i] == true` are copied,
+   *  and the others are left empty.
+   *  `used` must be the same over comm(),
+   *  while `needed` must be the same in each group.
+   *
+   *  This is a collective operation over comm().
+   */
+  template <class ptensor>
+  std::vector<ptensor> copy_to_group(std::vector<ptensor> const &A,
+                                     std::vector<bool> const &used,
+                                     std::vector<bool> const &needed) const {
+    std::vector<ptensor> ret(A.size());
+    for (size_t i = 0; i < A.size(); ++i) {
+      if (used[i]) {
+        ret[i] = copy_to_group(A[i], needed[i]);
+      }
+    }
+    return ret;
+  }
+
+  /*! @brief copy a tensor made in the group running the task to comm()
+   *
+   *  This is a collective operation over comm().
+   *
+   *  @param[in] A  tensor distributed over group_comm()
+   *                (ignored in the other groups than the owner of the task)
+   *  @param[in] task
+   */
+  template <class ptensor>
+  ptensor copy_from_group(ptensor const &A, int task) const {
+#ifdef _NO_MPI
+    return A;
+#else
+    if (!is_split()) {
+      return A;
+    }
+    // only the owner group knows the shape
+    int rank = owns(task) ? static_cast<int>(A.rank()) : 0;
+    allreduce_max(rank, comm_);
+    std::vector<int> dims(rank, 0);
+    if (owns(task)) {
+      for (int i = 0; i < rank; ++i) {
+        dims[i] = A.shape()[i];
+      }
+    }
+    for (int i = 0; i < rank; ++i) {
+      allreduce_max(dims[i], comm_);
+    }
+    mptensor::Shape shape;
+    shape.resize(rank);
+    for (int i = 0; i < rank; ++i) {
+      shape[i] = dims[i];
+    }
+    return redistribute(owns(task) ? &A : nullptr, shape, comm_, true);
+#endif
+  }
+
+private:
+#ifndef _NO_MPI
+  /*
+   *  Elements are redistributed point-to-point in two steps,
+   *  since a process does not know the distributions of the tensor over
+   *  the other communicators.
+   *  First, every element of A is sent to the process in charge of the range
+   *  of the element offsets which includes it.
+   *  Then, every process receiving the tensor asks those processes for the
+   *  elements of its own local block.
+   *  No process holds more than its share of the tensor.
+   *
+   *  A: source tensor (nullptr if this process has no elements to send)
+   *  target: communicator of the returned tensor (a subset of comm_)
+   *  receive: whether this process receives the tensor
+   *           (the same over target)
+   */
+  template <class ptensor>
+  ptensor redistribute(ptensor const *A, mptensor::Shape const &shape,
+                       MPI_Comm target, bool receive) const {
+    using value_type = typename ptensor::value_type;
+    const auto strides = detail::c_order_strides(shape);
+    long size = 1;
+    for (size_t i = 0; i < shape.size(); ++i) {
+      size *= shape[i];
+    }
+    int nprocs = 1, rank = 0;
+    MPI_Comm_size(comm_, &nprocs);
+    MPI_Comm_rank(comm_, &rank);
+
+    // the process `r` is in charge of the offsets [begin(r), begin(r+1))
+    auto begin = [&](int r) -> long {
+      return (static_cast<long>(r) * size + nprocs - 1) / nprocs;
+    };
+    auto in_charge = [&](long offset) -> int {
+      return static_cast<int>(offset * nprocs / size);
+    };
+
+    // 1. (offset, real, imag) records of A to the processes in charge
+    std::vector<std::vector<double>> send_records(nprocs);
+    if (A != nullptr) {
+      const auto records = detail::local_records(*A);
+      for (size_t k = 0; k < records.size(); k += 3) {
+        const int r = in_charge(static_cast<long>(records[k]));
+        send_records[r].insert(send_records[r].end(), records.begin() + k,
+                               records.begin() + k + 3);
+      }
+    }
+    std::vector<std::vector<double>> recv_records;
+    alltoallv(send_records, recv_records, comm_);
+    send_records.clear();
+
+    const long first = begin(rank);
+    std::vector<double> part(2 * (begin(rank + 1) - first));
+    for (int r = 0; r < nprocs; ++r) {
+      for (size_t k = 0; k < recv_records[r].size(); k += 3) {
+        const long pos = static_cast<long>(recv_records[r][k]) - first;
+        part[2 * pos] = recv_records[r][k + 1];
+        part[2 * pos + 1] = recv_records[r][k + 2];
+      }
+    }
+    recv_records.clear();
+
+    // 2. local elements of the copy from the processes in charge
+    ptensor ret;
+    if (receive) {
+      ret = ptensor(target, shape);
+    }
+    std::vector<std::vector<long>> requests(nprocs);
+    std::vector<std::vector<size_t>> requested(nprocs);
+    for (size_t lindex = 0; receive && lindex < ret.local_size(); ++lindex) {
+      const long offset =
+          detail::c_order_offset(ret.global_index(lindex), strides);
+      const int r = in_charge(offset);
+      requests[r].push_back(offset);
+      requested[r].push_back(lindex);
+    }
+    std::vector<std::vector<long>> recv_requests;
+    alltoallv(requests, recv_requests, comm_);
+    requests.clear();
+
+    std::vector<std::vector<double>> replies(nprocs);
+    for (int r = 0; r < nprocs; ++r) {
+      for (long offset : recv_requests[r]) {
+        const long pos = offset - first;
+        replies[r].push_back(part[2 * pos]);
+        replies[r].push_back(part[2 * pos + 1]);
+      }
+    }
+    std::vector<std::vector<double>> recv_replies;
+    alltoallv(replies, recv_replies, comm_);
+
+    for (int r = 0; r < nprocs; ++r) {
+      for (size_t k = 0; k < requested[r].size(); ++k) {
+        ret[requested[r][k]] = convert_complex<value_type>(std::complex<double>(
+            recv_replies[r][2 * k], recv_replies[r][2 * k + 1]));
+      }
+    }
+    return ret;
+  }
+#endif
+
+  MPI_Comm comm_;
+  MPI_Comm group_comm_;
+  int num_groups_;
+  int group_;
+  int group_rank_;
+};
+
+} // end of namespace tenes
+
+#endif // TENES_TASK_GROUPS_HPP
@@ -20,6 +20,7 @@
 #include <ctime>
 #include <limits>
 #include <map>
+#include <memory>
 #include <random>
 #include <sys/stat.h>
 #include <tuple>
@@ -32,20 +33,26 @@ int omp_get_max_threads() { return 1; }
 #endif
 
 #include <mptensor/complex.hpp>
-#include <mptensor/rsvd.hpp>
 #include <mptensor/tensor.hpp>
 
 #include "tensor.hpp"
 
 #include "Lattice.hpp"
 #include "PEPS_Basics.hpp"
+#include "compact_tensor.hpp"
 #include "PEPS_Parameters.hpp"
 #include "Square_lattice_CTM.hpp"
 #include "correlation.hpp"
+#include "memory.hpp"
+#include "operator_pack.hpp"
+#include "session.hpp"
+#include "task_groups.hpp"
 #include "timer.hpp"
 #include "printlevel.hpp"
+#include "util/columnar.hpp"
 #include "util/type_traits.hpp"
 #include "util/file.hpp"
+#include "util/philox.hpp"
 #include "util/string.hpp"
 
 #include "tenes.hpp"
@@ -98,21 +105,33 @@ public:
 
   void initialize_tensors();
   void update_CTM();
-  void simple_update();
-  void full_update();
+  void simple_update(int nsteps);
+  void full_update(int nsteps);
 
   void optimize();
-  void measure();
+  std::vector<Density> measure();
   void summary() const;
-  std::vector<std::vector<tensor_type>> measure_onesite();
-  std::vector<std::map<Bond, tensor_type>> measure_twosite();
-  std::vector<Correlation> measure_correlation();
+  std::vector<std::vector<tensor_type>> measure_onesite(TaskGroups const &groups);
+  std::vector<std::map<Bond, tensor_type>> measure_twosite(TaskGroups const &groups);
+  std::vector<Correlation> measure_correlation(TaskGroups const &groups);
   void save_onesite(std::vector<std::vector<tensor_type>> const &onesite_obs);
   void
   save_twosite(std::vector<std::map<Bond, tensor_type>> const &twosite_obs);
   void save_correlation(std::vector<Correlation> const &correlations);
+  void save_binary(util::ColumnarTable const &table);
   void save_tensors() const;
   void load_tensors();
+  void warm_start(TeNeS const &other);
+
+  PEPS_Parameters const &parameters() const { return peps_parameters; }
+  Lattice const &get_lattice() const { return lattice; }
+  std::vector<ptensor> const &site_tensors() const { return Tn; }
+  std::vector<std::vector<std::vector<double>>> const &lambdas() const {
+    return lambda_tensor;
+  }
+  std::vector<ptensor> const &corner_tensors(int corner) const;
+  std::vector<ptensor> const &edge_tensors(int edge) const;
+  int ctm_iterations() const { return ctm_iteration_count; }
 
 private:
   int siteoperator_index(int site, int group) const {
@@ -125,6 +144,12 @@ private:
 
   void load_tensors_v1();
   void load_tensors_v0();
+  bool environment_fits() const;
+
+  std::vector<std::vector<ptensor> *> measured_tensors();
+  std::vector<bool> group_sites(TaskGroups const &groups) const;
+  void enter_group(TaskGroups const &groups);
+  void leave_group();
 
   static constexpr int nleg = 4;
 
@@ -151,8 +176,20 @@ private:
   std::vector<ptensor> Tn;
   std::vector<ptensor> eTt, eTr, eTb, eTl;
   std::vector<ptensor> C1, C2, C3, C4;
+  CTM_Workspace<ptensor> ctm_workspace;
+  std::unique_ptr<TaskGroups> ctm_groups;  // computing the CTM projectors
   std::vector<std::vector<std::vector<double>>> lambda_tensor;
 
+  // whether the environment has been calculated (or loaded) once,
+  // so that the CTM can start from it instead of the site tensors
+  bool has_environment = false;
+  // number of the CTM iterations so far
+  int ctm_iteration_count = 0;
+
+  // tensors distributed over comm, kept while measuring in task groups
+  std::vector<std::vector<ptensor>> saved_tensors;
+  std::vector<std::shared_ptr<const ptensor>> saved_ops;
+
   int CHI;
   int LX;
   int LY;
@@ -165,6 +202,11 @@ private:
   double time_full_update;
   double time_environment;
   double time_observable;
+  // breakdown of time_observable
+  double time_onesite, time_twosite, time_correlation;
+
+  MemoryTracker memory_tracker;
+  void sample_memory(std::string const &region);
 };
 
 template <class ptensor>
@@ -179,12 +221,18 @@ TeNeS<ptensor>::TeNeS(MPI_Comm comm_, PEPS_Parameters peps_parameters_,
       onesite_operators(onesite_operators_),
       twosite_operators(twosite_operators_), corparam(corparam_),
       outdir("output"), timer_all(), time_simple_update(), time_full_update(),
-      time_environment(), time_observable() {
+      time_environment(), time_observable(), time_onesite(), time_twosite(),
+      time_correlation(),
+      memory_tracker({"initialize", "simple_update", "full_update",
+                      "environment", "observable_onesite",
+                      "observable_twosite", "observable_correlation"}) {
 
   MPI_Comm_size(comm, &mpisize);
   MPI_Comm_rank(comm, &mpirank);
 
-  peps_parameters.Bcast(comm);
+  // peps_parameters and lattice are assumed to be the same
+  // on all the processes (main_impl broadcasts them)
+
   // output debug or warning info only from process 0
   if (mpirank != 0) {
     peps_parameters.print_level = PrintLevel::none;
@@ -202,17 +250,60 @@ TeNeS<ptensor>::TeNeS(MPI_Comm comm_, PEPS_Parameters peps_parameters_,
     }
   }
 
-  CHI = peps_parameters.CHI;
+  if (peps_parameters.CTM_truncation_error > 0.0 && peps_parameters.Use_RSVD) {
+    // the random SVD does not give the discarded weight,
+    // which would keep CHI at the starting value
+    if (peps_parameters.print_level >= PrintLevel::info) {
+      std::cout << "WARNING: ctm.truncation_error is ignored since "
+                   "the discarded weight is not evaluated with use_rsvd = true"
+                << std::endl;
+    }
+    peps_parameters.CTM_truncation_error = 0.0;
+  }
 
-  lattice.Bcast(comm);
+  CHI = peps_parameters.CHI;
+  if (peps_parameters.CTM_truncation_error > 0.0) {
+    // adaptive CHI starts from D^2 and grows up to parameters.ctm.dimension
+    int max_vdim = 1;
+    for (auto const &vdim : lattice.virtual_dims) {
+      max_vdim =
+          std::max(max_vdim, *std::max_element(vdim.begin(), vdim.end()));
+    }
+    CHI = std::min(CHI, max_vdim * max_vdim);
+  }
 
   LX = lattice.LX;
   LY = lattice.LY;
   N_UNIT = lattice.N_UNIT;
+  ctm_workspace.reset(lattice);
+  ctm_groups.reset(new TaskGroups(comm, peps_parameters.CTM_Projector_groups));
+  ctm_workspace.groups = ctm_groups.get();
+
+  for (auto const &up : simple_updates) {
+    if (!up.is_threesite()) {
+      continue;
+    }
+    const int middle = lattice.neighbor(up.source_site, up.source_leg);
+    const int last = lattice.neighbor(middle, up.next_leg);
+    if (middle == up.source_site || last == up.source_site || last == middle) {
+      std::stringstream ss;
+      ss << "three-site simple update from site " << up.source_site
+         << " visits a site twice in the unit cell (enlarge the unit cell)";
+      throw tenes::input_error(ss.str());
+    }
+  }
 
-  // set seed for randomized svd
-  int seed = peps_parameters.seed;
-  random_tensor::set_seed(seed + mpirank);
+  if (peps_parameters.print_level >= PrintLevel::info) {
+    int num_vacancies = 0;
+    for (int i = 0; i < N_UNIT; ++i) {
+      if (lattice.is_vacancy(i)) {
+        ++num_vacancies;
+      }
+    }
+    if (num_vacancies > 0) {
+      std::cout << "Number of vacancies: " << num_vacancies << std::endl;
+    }
+  }
 
   outdir = peps_parameters.outdir;
 
@@ -255,6 +346,7 @@ TeNeS<ptensor>::TeNeS(MPI_Comm comm_, PEPS_Parameters peps_parameters_,
   }
 
   initialize_tensors();
+  sample_memory("initialize");
 
   int maxops = -1;
   size_t maxlength = 0;
@@ -326,20 +418,22 @@ template <class ptensor> void TeNeS<ptensor>::initialize_tensors() {
   C3.clear();
   C4.clear();
   lambda_tensor.clear();
+  has_environment = false;
 
   for (int i = 0; i < N_UNIT; ++i) {
     const auto pdim = lattice.physical_dims[i];
     const auto vdim = lattice.virtual_dims[i];
 
-    Tn.push_back(ptensor(Shape(vdim[0], vdim[1], vdim[2], vdim[3], pdim)));
-    eTt.push_back(ptensor(Shape(CHI, CHI, vdim[1], vdim[1])));
-    eTr.push_back(ptensor(Shape(CHI, CHI, vdim[2], vdim[2])));
-    eTb.push_back(ptensor(Shape(CHI, CHI, vdim[3], vdim[3])));
-    eTl.push_back(ptensor(Shape(CHI, CHI, vdim[0], vdim[0])));
-    C1.push_back(ptensor(Shape(CHI, CHI)));
-    C2.push_back(ptensor(Shape(CHI, CHI)));
-    C3.push_back(ptensor(Shape(CHI, CHI)));
-    C4.push_back(ptensor(Shape(CHI, CHI)));
+    Tn.push_back(
+        ptensor(comm, Shape(vdim[0], vdim[1], vdim[2], vdim[3], pdim)));
+    eTt.push_back(ptensor(comm, Shape(CHI, CHI, vdim[1], vdim[1])));
+    eTr.push_back(ptensor(comm, Shape(CHI, CHI, vdim[2], vdim[2])));
+    eTb.push_back(ptensor(comm, Shape(CHI, CHI, vdim[3], vdim[3])));
+    eTl.push_back(ptensor(comm, Shape(CHI, CHI, vdim[0], vdim[0])));
+    C1.push_back(ptensor(comm, Shape(CHI, CHI)));
+    C2.push_back(ptensor(comm, Shape(CHI, CHI)));
+    C3.push_back(ptensor(comm, Shape(CHI, CHI)));
+    C4.push_back(ptensor(comm, Shape(CHI, CHI)));
 
     std::vector<std::vector<double>> lambda(nleg);
     for (int j = 0; j < nleg; ++j) {
@@ -347,34 +441,35 @@ template <class ptensor> void TeNeS<ptensor>::initialize_tensors() {
     }
     lambda_tensor.push_back(lambda);
 
-    ptensor id(mptensor::Shape(pdim, pdim));
-    for (int j = 0; j < pdim; ++j) {
-      for (int k = 0; k < pdim; ++k) {
-        id.set_value(mptensor::Index(j, k), (j == k ? 1.0 : 0.0));
-      }
-    }
-    op_identity.push_back(id);
+    op_identity.push_back(make_identity<ptensor>(pdim, comm));
   }
 
   std::mt19937 gen(peps_parameters.seed);
   // use another rng for backward compatibility
   std::mt19937 gen_im(peps_parameters.seed * 11 + 137);
   std::uniform_real_distribution<double> dist(-1.0, 1.0);
-  int nr;
+
+  // philox gives each element from (seed, site, element index),
+  // so every process generates only its local block
+  const bool use_philox = peps_parameters.random_generator == "philox";
+  const util::Philox4x32 philox(peps_parameters.seed);
+  enum { stream_element = 0, stream_direction = 1 };
 
   if (peps_parameters.tensor_load_dir.empty()) {
-    Index index;
     for (int i = 0; i < lattice.N_UNIT; ++i) {
       const auto pdim = lattice.physical_dims[i];
       const auto vdim = lattice.virtual_dims[i];
 
       const size_t ndim = vdim[0] * vdim[1] * vdim[2] * vdim[3] * pdim;
-      std::vector<double> ran_re(ndim);
-      std::vector<double> ran_im(ndim);
-
-      for (int j = 0; j < ndim; j++) {
-        ran_re[j] = dist(gen);
-        ran_im[j] = dist(gen_im);
+      std::vector<double> ran_re;
+      std::vector<double> ran_im;
+      if (!use_philox) {
+        ran_re.resize(ndim);
+        ran_im.resize(ndim);
+        for (int j = 0; j < ndim; j++) {
+          ran_re[j] = dist(gen);
+          ran_im[j] = dist(gen_im);
+        }
       }
       auto &dir = lattice.initial_dirs[i];
       std::vector<double> dir_im(pdim);
@@ -383,58 +478,203 @@ template <class ptensor> void TeNeS<ptensor>::initialize_tensors() {
         // random
         dir.resize(pdim);
         for (int j = 0; j < pdim; ++j) {
-          dir[j] = dist(gen);
-          dir_im[j] = dist(gen_im);
+          if (use_philox) {
+            philox.uniform(stream_direction, i, j, dir[j], dir_im[j]);
+          } else {
+            dir[j] = dist(gen);
+            dir_im[j] = dist(gen_im);
+          }
         }
       }
 
-      for (int n = 0; n < Tn[i].local_size(); ++n) {
-        index = Tn[i].global_index(n);
+      const double noise = lattice.noises[i];
+      fill_local(Tn[i], [&](Index const &index) -> tensor_type {
+        std::complex<double> v;
         if (index[0] == 0 && index[1] == 0 && index[2] == 0 && index[3] == 0) {
-          auto v = std::complex<double>(dir[index[4]], dir_im[index[4]]);
-          Tn[i].set_value(index, to_tensor_type(v));
+          v = std::complex<double>(dir[index[4]], dir_im[index[4]]);
         } else {
-          nr = index[0] + index[1] * vdim[0] + index[2] * vdim[0] * vdim[1] +
-               index[3] * vdim[0] * vdim[1] * vdim[2] +
-               index[4] * vdim[0] * vdim[1] * vdim[2] * vdim[3];
-          auto v =
-              lattice.noises[i] * std::complex<double>(ran_re[nr], ran_im[nr]);
-          Tn[i].set_value(index, to_tensor_type(v));
+          const int nr = index[0] + index[1] * vdim[0] +
+                         index[2] * vdim[0] * vdim[1] +
+                         index[3] * vdim[0] * vdim[1] * vdim[2] +
+                         index[4] * vdim[0] * vdim[1] * vdim[2] * vdim[3];
+          double re, im;
+          if (use_philox) {
+            philox.uniform(stream_element, i, nr, re, im);
+          } else {
+            re = ran_re[nr];
+            im = ran_im[nr];
+          }
+          v = noise * std::complex<double>(re, im);
         }
-      }
+        return this->to_tensor_type(v);
+      });
     }
   } else {
     load_tensors();
+    has_environment = true;
     if (peps_parameters.print_level >= PrintLevel::info) {
       std::cout << "Tensors loaded from " << peps_parameters.tensor_load_dir << std::endl;
     }
   } // end of else part of if(load_dir.empty())
 }
 
+template <class ptensor>
+void TeNeS<ptensor>::warm_start(TeNeS const &other) {
+  if (other.N_UNIT != N_UNIT) {
+    std::stringstream ss;
+    ss << "cannot start from the previous tensors: the number of sites differs ("
+       << other.N_UNIT << " vs " << N_UNIT << ")";
+    throw tenes::input_error(ss.str());
+  }
+  for (int i = 0; i < N_UNIT; ++i) {
+    if (other.Tn[i].shape() != Tn[i].shape()) {
+      std::stringstream ss;
+      ss << "cannot start from the previous tensors: the shape of the tensor "
+            "at site "
+         << i << " differs";
+      throw tenes::input_error(ss.str());
+    }
+  }
+  Tn = other.Tn;
+  lambda_tensor = other.lambda_tensor;
+
+  // the environment is reusable only with the same bond dimension
+  has_environment = other.has_environment && other.CHI == CHI;
+  if (has_environment) {
+    C1 = other.C1;
+    C2 = other.C2;
+    C3 = other.C3;
+    C4 = other.C4;
+    eTt = other.eTt;
+    eTr = other.eTr;
+    eTb = other.eTb;
+    eTl = other.eTl;
+  }
+}
+
+template <class ptensor> bool TeNeS<ptensor>::environment_fits() const {
+  // the bond dimensions of the site tensors may have changed since
+  // (e.g., by simple_update.truncation_error)
+  for (int i = 0; i < N_UNIT; ++i) {
+    if (C1[i].shape() != Shape(CHI, CHI) || C2[i].shape() != Shape(CHI, CHI) ||
+        C3[i].shape() != Shape(CHI, CHI) || C4[i].shape() != Shape(CHI, CHI)) {
+      return false;
+    }
+    const int dt = Tn[lattice.NN_Tensor[i][1]].shape()[3];
+    const int dr = Tn[lattice.NN_Tensor[i][2]].shape()[0];
+    const int db = Tn[lattice.NN_Tensor[i][3]].shape()[1];
+    const int dl = Tn[lattice.NN_Tensor[i][0]].shape()[2];
+    if (eTt[i].shape() != Shape(CHI, CHI, dt, dt) ||
+        eTr[i].shape() != Shape(CHI, CHI, dr, dr) ||
+        eTb[i].shape() != Shape(CHI, CHI, db, db) ||
+        eTl[i].shape() != Shape(CHI, CHI, dl, dl)) {
+      return false;
+    }
+  }
+  return true;
+}
+
 template <class ptensor> inline void TeNeS<ptensor>::update_CTM() {
   Timer<> timer;
-  Calc_CTM_Environment(C1, C2, C3, C4, eTt, eTr, eTb, eTl, Tn, peps_parameters,
-                       lattice);
+  memory_tracker.start();
+  // the CTM starts from the last environment, which is much closer to
+  // the fixed point than the one made of the site tensors
+  bool initialize = !(has_environment && environment_fits());
+  const double truncation_error = peps_parameters.CTM_truncation_error;
+  if (truncation_error <= 0.0) {
+    ctm_iteration_count +=
+        Calc_CTM_Environment(C1, C2, C3, C4, eTt, eTr, eTb, eTl, Tn,
+                             peps_parameters, lattice, ctm_workspace,
+                             initialize);
+    has_environment = true;
+    time_environment += timer.elapsed();
+    sample_memory("environment");
+    return;
+  }
+
+  // adaptive CHI: while the projectors discard more weight than allowed,
+  // double CHI (up to parameters.ctm.dimension) and continue the CTM
+  // from the current environment padded with zeros
+  PEPS_Parameters params = peps_parameters;
+  params.CHI = CHI;
+  while (true) {
+    ctm_iteration_count +=
+        Calc_CTM_Environment(C1, C2, C3, C4, eTt, eTr, eTb, eTl, Tn, params,
+                             lattice, ctm_workspace, initialize);
+    const double discarded = ctm_workspace.discarded_weight;
+    if (discarded <= truncation_error || CHI >= peps_parameters.CHI) {
+      break;
+    }
+    const int new_CHI = std::min(2 * CHI, peps_parameters.CHI);
+    if (peps_parameters.print_level >= PrintLevel::info) {
+      std::cout << "CTM: discarded weight " << discarded << " > "
+                << truncation_error << ", CHI = " << CHI << " -> " << new_CHI
+                << std::endl;
+    }
+    CHI = new_CHI;
+    params.CHI = CHI;
+    for (int i = 0; i < N_UNIT; ++i) {
+      C1[i] = resize_tensor(C1[i], Shape(CHI, CHI));
+      C2[i] = resize_tensor(C2[i], Shape(CHI, CHI));
+      C3[i] = resize_tensor(C3[i], Shape(CHI, CHI));
+      C4[i] = resize_tensor(C4[i], Shape(CHI, CHI));
+      eTt[i] = resize_tensor(
+          eTt[i], Shape(CHI, CHI, eTt[i].shape()[2], eTt[i].shape()[3]));
+      eTr[i] = resize_tensor(
+          eTr[i], Shape(CHI, CHI, eTr[i].shape()[2], eTr[i].shape()[3]));
+      eTb[i] = resize_tensor(
+          eTb[i], Shape(CHI, CHI, eTb[i].shape()[2], eTb[i].shape()[3]));
+      eTl[i] = resize_tensor(
+          eTl[i], Shape(CHI, CHI, eTl[i].shape()[2], eTl[i].shape()[3]));
+    }
+    initialize = false;
+  }
+  has_environment = true;
   time_environment += timer.elapsed();
+  sample_memory("environment");
 }
 
-template <class ptensor> void TeNeS<ptensor>::simple_update() {
+template <class ptensor> void TeNeS<ptensor>::simple_update(int nsteps) {
   Timer<> timer;
+  memory_tracker.start();
   ptensor Tn1_new;
   ptensor Tn2_new;
+  ptensor Tn3_new;
   std::vector<double> lambda_c;
-  const int nsteps = peps_parameters.num_simple_step;
+  std::vector<double> lambda_c2;
   double next_report = 10.0;
 
   for (int int_tau = 0; int_tau < nsteps; ++int_tau) {
-    for (auto up : simple_updates) {
+    for (auto const &up : simple_updates) {
       const int source = up.source_site;
       const int source_leg = up.source_leg;
       const int target = lattice.neighbor(source, source_leg);
       const int target_leg = (source_leg + 2) % 4;
+      if (up.is_threesite()) {
+        // source -(source_leg)- target -(next_leg)- last
+        const int next_leg = up.next_leg;
+        const int last = lattice.neighbor(target, next_leg);
+        const int last_leg = (next_leg + 2) % 4;
+        Simple_update_threesite(
+            Tn[source], Tn[target], Tn[last], lambda_tensor[source],
+            lambda_tensor[target], lambda_tensor[last], up.op(), source_leg,
+            next_leg, peps_parameters, Tn1_new, Tn2_new, Tn3_new, lambda_c,
+            lambda_c2, lattice.virtual_dims[source][source_leg],
+            lattice.virtual_dims[target][next_leg]);
+        lambda_tensor[source][source_leg] = lambda_c;
+        lambda_tensor[target][target_leg] = lambda_c;
+        lambda_tensor[target][next_leg] = lambda_c2;
+        lambda_tensor[last][last_leg] = lambda_c2;
+        Tn[source] = Tn1_new;
+        Tn[target] = Tn2_new;
+        Tn[last] = Tn3_new;
+        continue;
+      }
+      // the given virtual dimension caps the adaptive bond dimension
       Simple_update_bond(Tn[source], Tn[target], lambda_tensor[source],
-                         lambda_tensor[target], up.op, source_leg,
-                         peps_parameters, Tn1_new, Tn2_new, lambda_c);
+                         lambda_tensor[target], up.op(), source_leg,
+                         peps_parameters, Tn1_new, Tn2_new, lambda_c,
+                         lattice.virtual_dims[source][source_leg]);
       lambda_tensor[source][source_leg] = lambda_c;
       lambda_tensor[target][target_leg] = lambda_c;
       Tn[source] = Tn1_new;
@@ -455,22 +695,23 @@ template <class ptensor> void TeNeS<ptensor>::simple_update() {
     }
   }
   time_simple_update += timer.elapsed();
+  sample_memory("simple_update");
 }
 
-template <class ptensor> void TeNeS<ptensor>::full_update() {
+template <class ptensor> void TeNeS<ptensor>::full_update(int nsteps) {
   Timer<> timer;
 
   ptensor Tn1_new, Tn2_new;
-  if (peps_parameters.num_full_step > 0) {
+  if (nsteps > 0) {
     update_CTM();
   }
 
-  const int nsteps = peps_parameters.num_full_step;
   double next_report = 10.0;
 
   timer.reset();
+  memory_tracker.start();
   for (int int_tau = 0; int_tau < nsteps; ++int_tau) {
-    for (auto up : full_updates) {
+    for (auto const &up : full_updates) {
       const int source = up.source_site;
       const int source_leg = up.source_leg;
       const int target = lattice.neighbor(source, source_leg);
@@ -493,7 +734,7 @@ template <class ptensor> void TeNeS<ptensor>::full_update() {
         Full_update_bond(C4[source], C2[target], C1[target], C3[source],
                          eTb[source], eTb[target], eTl[target], eTt[target],
                          eTt[source], eTr[source], Tn[source], Tn[target],
-                         up.op, source_leg, peps_parameters, Tn1_new, Tn2_new);
+                         up.op(), source_leg, peps_parameters, Tn1_new, Tn2_new);
       }else if(source_leg == 1){
         /*
          * C1' t' C2'
@@ -512,7 +753,7 @@ template <class ptensor> void TeNeS<ptensor>::full_update() {
         Full_update_bond(C4[source], C1[target], C2[target], C3[source],
                          eTl[source], eTl[target], eTt[target], eTr[target],
                          eTr[source], eTb[source], Tn[source], Tn[target],
-                         up.op, source_leg, peps_parameters, Tn1_new, Tn2_new);
+                         up.op(), source_leg, peps_parameters, Tn1_new, Tn2_new);
       }else if(source_leg == 2){
         /*
          *  C1 t t' C2'
@@ -522,7 +763,7 @@ template <class ptensor> void TeNeS<ptensor>::full_update() {
         Full_update_bond(C1[source], C2[target], C3[target], C4[source],
                          eTt[source], eTt[target], eTr[target], // t  t' r'
                          eTb[target], eTb[source], eTl[source], // b' b  l
-                         Tn[source], Tn[target], up.op, source_leg,
+                         Tn[source], Tn[target], up.op(), source_leg,
                          peps_parameters, Tn1_new, Tn2_new);
       }else{
         /*
@@ -542,41 +783,43 @@ template <class ptensor> void TeNeS<ptensor>::full_update() {
         Full_update_bond(C2[source], C3[target], C4[target], C1[source],
                          eTr[source], eTr[target], eTb[target], eTl[target],
                          eTl[source], eTt[source], Tn[source], Tn[target],
-                         up.op, source_leg, peps_parameters, Tn1_new, Tn2_new);
+                         up.op(), source_leg, peps_parameters, Tn1_new, Tn2_new);
       }
       Tn[source] = Tn1_new;
       Tn[target] = Tn2_new;
+      sample_memory("full_update");
 
       if (peps_parameters.Full_Use_FastFullUpdate) {
         if(source_leg == 0){
           const int source_x = source % LX;
           const int target_x = target % LX;
           Right_move(C1, C2, C3, C4, eTt, eTr, eTb, eTl, Tn, source_x,
-                     peps_parameters, lattice);
+                     peps_parameters, lattice, ctm_workspace);
           Left_move(C1, C2, C3, C4, eTt, eTr, eTb, eTl, Tn, target_x,
-                    peps_parameters, lattice);
+                    peps_parameters, lattice, ctm_workspace);
         }else if(source_leg == 1){
           const int source_y = source / LX;
           const int target_y = target / LX;
           Bottom_move(C1, C2, C3, C4, eTt, eTr, eTb, eTl, Tn, source_y,
-                      peps_parameters, lattice);
+                      peps_parameters, lattice, ctm_workspace);
           Top_move(C1, C2, C3, C4, eTt, eTr, eTb, eTl, Tn, target_y,
-                   peps_parameters, lattice);
+                   peps_parameters, lattice, ctm_workspace);
         }else if(source_leg == 2){
           const int source_x = source % LX;
           const int target_x = target % LX;
           Left_move(C1, C2, C3, C4, eTt, eTr, eTb, eTl, Tn, source_x,
-                    peps_parameters, lattice);
+                    peps_parameters, lattice, ctm_workspace);
           Right_move(C1, C2, C3, C4, eTt, eTr, eTb, eTl, Tn, target_x,
-                     peps_parameters, lattice);
+                     peps_parameters, lattice, ctm_workspace);
         }else{
           const int source_y = source / LX;
           const int target_y = target / LX;
           Top_move(C1, C2, C3, C4, eTt, eTr, eTb, eTl, Tn, source_y,
-                   peps_parameters, lattice);
+                   peps_parameters, lattice, ctm_workspace);
           Bottom_move(C1, C2, C3, C4, eTt, eTr, eTb, eTl, Tn, target_y,
-                      peps_parameters, lattice);
+                      peps_parameters, lattice, ctm_workspace);
         }
+        sample_memory("environment");
       } else {
         update_CTM();
       }
@@ -608,38 +851,73 @@ template <class ptensor> void TeNeS<ptensor>::optimize() {
   if (peps_parameters.print_level >= PrintLevel::info) {
     std::cout << "Start simple update" << std::endl;
   }
-  simple_update();
+  simple_update(peps_parameters.num_simple_step);
 
   if (peps_parameters.num_full_step > 0) {
     if (peps_parameters.print_level >= PrintLevel::info) {
       std::cout << "Start full update" << std::endl;
     }
-    full_update();
+    full_update(peps_parameters.num_full_step);
   }
 }
 
 template <class ptensor>
-auto TeNeS<ptensor>::measure_onesite()
+auto TeNeS<ptensor>::measure_onesite(TaskGroups const &groups)
     -> std::vector<std::vector<typename TeNeS<ptensor>::tensor_type>> {
   Timer<> timer;
+  memory_tracker.start();
   const int nlops = num_onesite_operators;
   std::vector<std::vector<tensor_type>> local_obs(
       nlops, std::vector<tensor_type>(
                  N_UNIT, std::numeric_limits<double>::quiet_NaN()));
 
+  // norms are needed only on the sites with operators
+  // (in particular, vacancies are skipped)
+  std::vector<bool> measured(N_UNIT, false);
+  for (auto const &op : onesite_operators) {
+    measured[op.source_site] = true;
+  }
   std::vector<double> norm(N_UNIT);
   for (int i = 0; i < N_UNIT; ++i) {
+    if (!groups.owns(i) || !measured[i]) {
+      continue;
+    }
     const auto n = Contract_one_site(C1[i], C2[i], C3[i], C4[i], eTt[i], eTr[i],
                                      eTb[i], eTl[i], Tn[i], op_identity[i]);
     norm[i] = std::real(n);
   }
   for (auto const &op : onesite_operators) {
     const int i = op.source_site;
+    if (!groups.owns(i)) {
+      continue;
+    }
     const auto val = Contract_one_site(C1[i], C2[i], C3[i], C4[i], eTt[i],
-                                       eTr[i], eTb[i], eTl[i], Tn[i], op.op);
+                                       eTr[i], eTb[i], eTl[i], Tn[i], op.op());
     local_obs[op.group][i] = val / norm[i];
   }
+
+  if (groups.is_split()) {
+    std::vector<double> buffer(2 * nlops * N_UNIT, 0.0);
+    for (int ilops = 0; ilops < nlops; ++ilops) {
+      for (int i = 0; i < N_UNIT; ++i) {
+        if (groups.reports(i)) {
+          buffer[2 * (ilops * N_UNIT + i)] = std::real(local_obs[ilops][i]);
+          buffer[2 * (ilops * N_UNIT + i) + 1] = std::imag(local_obs[ilops][i]);
+        }
+      }
+    }
+    allreduce_sum(buffer, comm);
+    for (int ilops = 0; ilops < nlops; ++ilops) {
+      for (int i = 0; i < N_UNIT; ++i) {
+        local_obs[ilops][i] = to_tensor_type(
+            std::complex<double>(buffer[2 * (ilops * N_UNIT + i)],
+                                 buffer[2 * (ilops * N_UNIT + i) + 1]));
+      }
+    }
+  }
+  time_onesite += timer.elapsed();
   time_observable += timer.elapsed();
+  sample_memory("observable_onesite");
 
   return local_obs;
 }
@@ -664,28 +942,53 @@ void TeNeS<ptensor>::save_onesite(
   ofs << "# $2: site_index\n";
   ofs << "# $3: real\n";
   ofs << "# $4: imag\n";
-  ofs << std::endl;
+  ofs << "\n";
 
+  // observables are written for the sites of the input unit cell
+  const int num_input_sites = lattice.num_input_sites();
   for (int ilops = 0; ilops < nlops; ++ilops) {
     int num = 0;
     tensor_type sum = 0.0;
-    for (int i = 0; i < N_UNIT; ++i) {
+    for (int site = 0; site < num_input_sites; ++site) {
+      const int i = lattice.site_of_input(site);
       if (std::isnan(std::real(onesite_obs[ilops][i]))) {
         continue;
       }
       num += 1;
       const auto v = onesite_obs[ilops][i];
       sum += v;
-      ofs << ilops << " " << i << " " << std::real(v) << " " << std::imag(v)
-          << std::endl;
+      ofs << ilops << " " << site << " " << std::real(v) << " "
+          << std::imag(v) << "\n";
+    }
+  }
+
+  if (peps_parameters.output_binary) {
+    util::ColumnarTable table("onesite_obs");
+    const auto c_group = table.add_int_column("op_group");
+    const auto c_site = table.add_int_column("site_index");
+    const auto c_real = table.add_real_column("real");
+    const auto c_imag = table.add_real_column("imag");
+    for (int ilops = 0; ilops < nlops; ++ilops) {
+      for (int site = 0; site < num_input_sites; ++site) {
+        const auto v = onesite_obs[ilops][lattice.site_of_input(site)];
+        if (std::isnan(std::real(v))) {
+          continue;
+        }
+        table.push(c_group, ilops);
+        table.push(c_site, site);
+        table.push(c_real, std::real(v));
+        table.push(c_imag, std::imag(v));
+      }
     }
+    save_binary(table);
   }
 }
 
 template <class ptensor>
-auto TeNeS<ptensor>::measure_twosite()
+auto TeNeS<ptensor>::measure_twosite(TaskGroups const &groups)
     -> std::vector<std::map<Bond, typename TeNeS<ptensor>::tensor_type>> {
   Timer<> timer;
+  memory_tracker.start();
 
   const int nlops = num_twosite_operators;
   std::vector<std::map<Bond, tensor_type>> ret(nlops);
@@ -694,7 +997,16 @@ auto TeNeS<ptensor>::measure_twosite()
 
   std::map<std::tuple<int, int, int>, double> norms;
 
-  for (const auto &op : twosite_operators) {
+  // NaN means not measured
+  const int nops = twosite_operators.size();
+  std::vector<tensor_type> values(nops,
+                                  std::numeric_limits<double>::quiet_NaN());
+
+  for (int iop = 0; iop < nops; ++iop) {
+    if (!groups.owns(iop)) {
+      continue;
+    }
+    const auto &op = twosite_operators[iop];
     const int source = op.source_site;
     /*
     const int x_source = lattice.x(source);
@@ -804,8 +1116,8 @@ auto TeNeS<ptensor>::measure_twosite()
           const int top = indices[0][0];
           const int bottom = indices[1][0];
           ptensor o =
-              (top == source ? op.op
-                             : mptensor::transpose(op.op, {1, 0, 3, 2}));
+              (top == source ? op.op()
+                             : mptensor::transpose(op.op(), {1, 0, 3, 2}));
           value = Contract_two_sites_vertical_op12(
               C1[top], C2[top], C3[bottom], C4[bottom], eTt[top], eTr[top],
               eTr[bottom], eTb[bottom], eTl[bottom], eTl[top], Tn[top],
@@ -814,8 +1126,8 @@ auto TeNeS<ptensor>::measure_twosite()
           const int left = indices[0][0];
           const int right = indices[0][1];
           ptensor o =
-              (left == source ? op.op
-                              : mptensor::transpose(op.op, {1, 0, 3, 2}));
+              (left == source ? op.op()
+                              : mptensor::transpose(op.op(), {1, 0, 3, 2}));
           value = Contract_two_sites_horizontal_op12(
               C1[left], C2[right], C3[right], C4[left], eTt[left], eTt[right],
               eTr[right], eTb[right], eTb[left], eTl[left], Tn[left], Tn[right],
@@ -824,7 +1136,7 @@ auto TeNeS<ptensor>::measure_twosite()
       } else {
         ptensor U, VT;
         std::vector<double> s;
-        mptensor::svd(op.op, {0, 2}, {1, 3}, U, s, VT);
+        mptensor::svd(op.op(), {0, 2}, {1, 3}, U, s, VT);
         const int ns = s.size();
         for (int is = 0; is < ns; ++is) {
           ptensor source_op =
@@ -841,18 +1153,42 @@ auto TeNeS<ptensor>::measure_twosite()
       op_[source_row][source_col] =
           &(onesite_operators[siteoperator_index(op.source_site,
                                                  op.ops_indices[0])]
-                .op);
+                .op());
       const int target_site = lattice.other(op.source_site, dx, dy);
       op_[target_row][target_col] = &(
           onesite_operators[siteoperator_index(target_site, op.ops_indices[1])]
-              .op);
+              .op());
       auto localvalue = Contract(C_, eTt_, eTr_, eTb_, eTl_, Tn_, op_);
       value += localvalue;
     }
-    ret[op.group][{op.source_site, op.dx[0], op.dy[0]}] = value / norm;
+    values[iop] = value / norm;
   }
 
+  if (groups.is_split()) {
+    std::vector<double> buffer(2 * nops, 0.0);
+    for (int iop = 0; iop < nops; ++iop) {
+      if (groups.reports(iop)) {
+        buffer[2 * iop] = std::real(values[iop]);
+        buffer[2 * iop + 1] = std::imag(values[iop]);
+      }
+    }
+    allreduce_sum(buffer, comm);
+    for (int iop = 0; iop < nops; ++iop) {
+      values[iop] = to_tensor_type(
+          std::complex<double>(buffer[2 * iop], buffer[2 * iop + 1]));
+    }
+  }
+  for (int iop = 0; iop < nops; ++iop) {
+    if (std::isnan(std::real(values[iop]))) {
+      continue;
+    }
+    const auto &op = twosite_operators[iop];
+    ret[op.group][{op.source_site, op.dx[0], op.dy[0]}] = values[iop];
+  }
+
+  time_twosite += timer.elapsed();
   time_observable += timer.elapsed();
+  sample_memory("observable_twosite");
   return ret;
 }
 
@@ -878,25 +1214,62 @@ void TeNeS<ptensor>::save_twosite(
   ofs << "# $4: dy\n";
   ofs << "# $5: real\n";
   ofs << "# $6: imag\n";
-  ofs << std::endl;
+  ofs << "\n";
+
+  // observables are written for the sites of the input unit cell
+  const int num_input_sites = lattice.num_input_sites();
   for (int ilops = 0; ilops < nlops; ++ilops) {
     tensor_type sum = 0.0;
     int num = 0;
-    for (const auto &r : twosite_obs[ilops]) {
-      auto bond = r.first;
-      auto value = r.second;
-      sum += value;
-      num += 1;
-      ofs << ilops << " " << bond.source_site << " " << bond.dx << " "
-          << bond.dy << " " << std::real(value) << " " << std::imag(value)
-          << std::endl;
+    for (int site = 0; site < num_input_sites; ++site) {
+      const int source_site = lattice.site_of_input(site);
+      for (const auto &r : twosite_obs[ilops]) {
+        auto bond = r.first;
+        auto value = r.second;
+        if (bond.source_site != source_site) {
+          continue;
+        }
+        sum += value;
+        num += 1;
+        ofs << ilops << " " << site << " " << bond.dx << " " << bond.dy << " "
+            << std::real(value) << " " << std::imag(value) << "\n";
+      }
+    }
+  }
+
+  if (peps_parameters.output_binary) {
+    util::ColumnarTable table("twosite_obs");
+    const auto c_group = table.add_int_column("op_group");
+    const auto c_site = table.add_int_column("source_site");
+    const auto c_dx = table.add_int_column("dx");
+    const auto c_dy = table.add_int_column("dy");
+    const auto c_real = table.add_real_column("real");
+    const auto c_imag = table.add_real_column("imag");
+    for (int ilops = 0; ilops < nlops; ++ilops) {
+      for (int site = 0; site < num_input_sites; ++site) {
+        const int source_site = lattice.site_of_input(site);
+        for (const auto &r : twosite_obs[ilops]) {
+          if (r.first.source_site != source_site) {
+            continue;
+          }
+          table.push(c_group, ilops);
+          table.push(c_site, site);
+          table.push(c_dx, r.first.dx);
+          table.push(c_dy, r.first.dy);
+          table.push(c_real, std::real(r.second));
+          table.push(c_imag, std::imag(r.second));
+        }
+      }
     }
+    save_binary(table);
   }
 }
 
 template <class ptensor>
-std::vector<Correlation> TeNeS<ptensor>::measure_correlation() {
+std::vector<Correlation>
+TeNeS<ptensor>::measure_correlation(TaskGroups const &groups) {
   Timer<> timer;
+  memory_tracker.start();
 
   const int nlops = num_onesite_operators;
   const int r_max = corparam.r_max;
@@ -907,9 +1280,12 @@ std::vector<Correlation> TeNeS<ptensor>::measure_correlation() {
 
   std::vector<Correlation> correlations;
   for (int left_index = 0; left_index < N_UNIT; ++left_index) {
-    const auto vdim = lattice.virtual_dims[left_index];
-    ptensor correlation_T(Shape(CHI, CHI, vdim[0], vdim[0]));
-    ptensor correlation_norm(Shape(CHI, CHI, vdim[0], vdim[0]));
+    if (!groups.owns(left_index)) {
+      continue;
+    }
+    // initialized by StartCorrelation
+    ptensor correlation_T;
+    ptensor correlation_norm;
     for (int left_ilop = 0; left_ilop < nlops; ++left_ilop) {
       if (r_ops[left_ilop].empty()) {
         continue;
@@ -920,7 +1296,7 @@ std::vector<Correlation> TeNeS<ptensor>::measure_correlation() {
         if (left_op_index < 0) {
           continue;
         }
-        const auto left_op = onesite_operators[left_op_index].op;
+        auto const &left_op = onesite_operators[left_op_index].op();
         StartCorrelation(correlation_T, C1[left_index], C4[left_index],
                          eTt[left_index], eTb[left_index], eTl[left_index],
                          Tn[left_index], left_op);
@@ -931,16 +1307,23 @@ std::vector<Correlation> TeNeS<ptensor>::measure_correlation() {
         int right_index = left_index;
         for (int r = 0; r < r_max; ++r) {
           right_index = lattice.right(right_index);
-          double norm = std::real(FinishCorrelation(
-              correlation_norm, C2[right_index], C3[right_index],
-              eTt[right_index], eTr[right_index], eTb[right_index],
-              Tn[right_index], op_identity[right_index]));
+          // the norm is calculated lazily
+          // since the right site (e.g., a vacancy) may have no operators
+          double norm = 0.0;
+          bool norm_calculated = false;
           for (auto right_ilop : r_ops[left_ilop]) {
             int right_op_index = siteoperator_index(right_index, right_ilop);
             if (right_op_index < 0) {
               continue;
             }
-            const auto right_op = onesite_operators[right_op_index].op;
+            if (!norm_calculated) {
+              norm = std::real(FinishCorrelation(
+                  correlation_norm, C2[right_index], C3[right_index],
+                  eTt[right_index], eTr[right_index], eTb[right_index],
+                  Tn[right_index], op_identity[right_index]));
+              norm_calculated = true;
+            }
+            auto const &right_op = onesite_operators[right_op_index].op();
             auto val = FinishCorrelation(correlation_T, C2[right_index],
                                          C3[right_index], eTt[right_index],
                                          eTr[right_index], eTb[right_index],
@@ -962,7 +1345,7 @@ std::vector<Correlation> TeNeS<ptensor>::measure_correlation() {
         if (left_op_index < 0) {
           continue;
         }
-        const auto left_op = onesite_operators[left_op_index].op;
+        auto const &left_op = onesite_operators[left_op_index].op();
         ptensor tn = transpose(Tn[left_index], Axes(3, 0, 1, 2, 4));
         StartCorrelation(correlation_T, C4[left_index], C3[left_index],
                          eTl[left_index], eTr[left_index], eTb[left_index], tn,
@@ -975,16 +1358,21 @@ std::vector<Correlation> TeNeS<ptensor>::measure_correlation() {
         for (int r = 0; r < r_max; ++r) {
           right_index = lattice.top(right_index);
           tn = transpose(Tn[right_index], Axes(3, 0, 1, 2, 4));
-          double norm = std::real(FinishCorrelation(
-              correlation_norm, C1[right_index], C2[right_index],
-              eTl[right_index], eTt[right_index], eTr[right_index], tn,
-              op_identity[right_index]));
+          double norm = 0.0;
+          bool norm_calculated = false;
           for (auto right_ilop : r_ops[left_ilop]) {
             int right_op_index = siteoperator_index(right_index, right_ilop);
             if (right_op_index < 0) {
               continue;
             }
-            const auto right_op = onesite_operators[right_op_index].op;
+            if (!norm_calculated) {
+              norm = std::real(FinishCorrelation(
+                  correlation_norm, C1[right_index], C2[right_index],
+                  eTl[right_index], eTt[right_index], eTr[right_index], tn,
+                  op_identity[right_index]));
+              norm_calculated = true;
+            }
+            auto const &right_op = onesite_operators[right_op_index].op();
             auto val = FinishCorrelation(correlation_T, C1[right_index],
                                          C2[right_index], eTl[right_index],
                                          eTt[right_index], eTr[right_index], tn,
@@ -1002,7 +1390,36 @@ std::vector<Correlation> TeNeS<ptensor>::measure_correlation() {
     }
   }
 
+  if (groups.is_split()) {
+    // gather the results into the rank 0 process
+    // (only the first process in each group sends them)
+    constexpr int nfields = 7;
+    std::vector<double> send, recv;
+    for (auto const &c : correlations) {
+      if (groups.reports(c.left_index)) {
+        send.insert(send.end(),
+                    {double(c.left_index), double(c.right_dx),
+                     double(c.right_dy), double(c.left_op), double(c.right_op),
+                     c.real, c.imag});
+      }
+    }
+    gatherv(send, recv, 0, comm);
+    correlations.clear();
+    for (size_t k = 0; k + nfields <= recv.size(); k += nfields) {
+      correlations.push_back(Correlation{
+          static_cast<int>(recv[k]), static_cast<int>(recv[k + 1]),
+          static_cast<int>(recv[k + 2]), static_cast<int>(recv[k + 3]),
+          static_cast<int>(recv[k + 4]), recv[k + 5], recv[k + 6]});
+    }
+    std::stable_sort(correlations.begin(), correlations.end(),
+                     [](Correlation const &a, Correlation const &b) {
+                       return a.left_index < b.left_index;
+                     });
+  }
+
+  time_correlation += timer.elapsed();
   time_observable += timer.elapsed();
+  sample_memory("observable_correlation");
   return correlations;
 }
 
@@ -1027,64 +1444,286 @@ void TeNeS<ptensor>::save_correlation(
   ofs << "# $5: right_dy\n";
   ofs << "# $6: real\n";
   ofs << "# $7: imag\n";
-  ofs << std::endl;
-  for (auto const &cor : correlations) {
+  ofs << "\n";
+
+  // correlations are written for the sites of the input unit cell
+  std::vector<Correlation> input_correlations;
+  for (int site = 0; site < lattice.num_input_sites(); ++site) {
+    const int left_index = lattice.site_of_input(site);
+    for (auto const &cor : correlations) {
+      if (cor.left_index == left_index) {
+        input_correlations.push_back(cor);
+        input_correlations.back().left_index = site;
+      }
+    }
+  }
+
+  for (auto const &cor : input_correlations) {
     ofs << cor.left_op << " " << cor.left_index << " " << cor.right_op << " "
         << cor.right_dx << " " << cor.right_dy << " " << cor.real << " "
-        << cor.imag << " " << std::endl;
+        << cor.imag << " " << "\n";
+  }
+
+  if (peps_parameters.output_binary) {
+    util::ColumnarTable table("correlation");
+    const auto c_left_op = table.add_int_column("left_op");
+    const auto c_left_site = table.add_int_column("left_site");
+    const auto c_right_op = table.add_int_column("right_op");
+    const auto c_right_dx = table.add_int_column("right_dx");
+    const auto c_right_dy = table.add_int_column("right_dy");
+    const auto c_real = table.add_real_column("real");
+    const auto c_imag = table.add_real_column("imag");
+    for (auto const &cor : input_correlations) {
+      table.push(c_left_op, cor.left_op);
+      table.push(c_left_site, cor.left_index);
+      table.push(c_right_op, cor.right_op);
+      table.push(c_right_dx, cor.right_dx);
+      table.push(c_right_dy, cor.right_dy);
+      table.push(c_real, cor.real);
+      table.push(c_imag, cor.imag);
+    }
+    save_binary(table);
   }
 }
 
-template <class ptensor> void TeNeS<ptensor>::measure() {
+template <class ptensor>
+void TeNeS<ptensor>::save_binary(util::ColumnarTable const &table) {
+  std::string filename = outdir + "/" + table.name() + ".bin";
+  if (peps_parameters.print_level >= PrintLevel::info) {
+    std::cout << "    Save " << table.name() << " in binary format to "
+              << filename << std::endl;
+  }
+  table.save(filename);
+}
+
+template <class ptensor>
+std::vector<std::vector<ptensor> *> TeNeS<ptensor>::measured_tensors() {
+  return {&Tn, &eTt, &eTr, &eTb, &eTl, &C1, &C2, &C3, &C4, &op_identity};
+}
+
+template <class ptensor>
+void TeNeS<ptensor>::sample_memory(std::string const &region) {
+  std::vector<TensorMemory> tensors;
+  add_tensor_memory(tensors, "Tn", Tn);
+  add_tensor_memory(tensors, "C1", C1);
+  add_tensor_memory(tensors, "C2", C2);
+  add_tensor_memory(tensors, "C3", C3);
+  add_tensor_memory(tensors, "C4", C4);
+  add_tensor_memory(tensors, "eTt", eTt);
+  add_tensor_memory(tensors, "eTr", eTr);
+  add_tensor_memory(tensors, "eTb", eTb);
+  add_tensor_memory(tensors, "eTl", eTl);
+  add_tensor_memory(tensors, "op_identity", op_identity);
+  add_tensor_memory(tensors, "PU", ctm_workspace.PUs);
+  add_tensor_memory(tensors, "PL", ctm_workspace.PLs);
+  add_tensor_memory(tensors, "slot_corner1", ctm_workspace.corner1.tensors());
+  add_tensor_memory(tensors, "slot_corner2", ctm_workspace.corner2.tensors());
+  add_tensor_memory(tensors, "slot_edge", ctm_workspace.edge.tensors());
+  for (size_t k = 0; k < saved_tensors.size(); ++k) {
+    add_tensor_memory(tensors, "saved" + std::to_string(k), saved_tensors[k]);
+  }
+  memory_tracker.sample(region, tensors);
+}
+
+template <class ptensor>
+std::vector<bool> TeNeS<ptensor>::group_sites(TaskGroups const &groups) const {
+  // sites touched by the measurement tasks of the group
+  std::vector<bool> sites(N_UNIT, false);
+
+  // onesite
+  for (auto const &op : onesite_operators) {
+    if (groups.owns(op.source_site)) {
+      sites[op.source_site] = true;
+    }
+  }
+
+  // twosite (the rectangle spanned by the bond)
+  const int nops = twosite_operators.size();
+  for (int iop = 0; iop < nops; ++iop) {
+    if (!groups.owns(iop)) {
+      continue;
+    }
+    const auto &op = twosite_operators[iop];
+    const int dx = op.dx[0];
+    const int dy = op.dy[0];
+    for (int y = std::min(0, dy); y <= std::max(0, dy); ++y) {
+      for (int x = std::min(0, dx); x <= std::max(0, dx); ++x) {
+        sites[lattice.other(op.source_site, x, y)] = true;
+      }
+    }
+  }
+
+  // correlation (the sites along the row and the column from the left site)
+  const int r_max = corparam.r_max;
+  if (r_max > 0) {
+    std::vector<bool> has_right_ops(num_onesite_operators, false);
+    for (auto ops : corparam.operators) {
+      has_right_ops[std::get<0>(ops)] = true;
+    }
+    for (int left_index = 0; left_index < N_UNIT; ++left_index) {
+      if (!groups.owns(left_index)) {
+        continue;
+      }
+      bool measured = false;
+      for (int ilop = 0; ilop < num_onesite_operators; ++ilop) {
+        if (has_right_ops[ilop] && siteoperator_index(left_index, ilop) >= 0) {
+          measured = true;
+        }
+      }
+      if (!measured) {
+        continue;
+      }
+      sites[left_index] = true;
+      int right_index = left_index;
+      int top_index = left_index;
+      for (int r = 0; r < r_max; ++r) {
+        right_index = lattice.right(right_index);
+        top_index = lattice.top(top_index);
+        sites[right_index] = true;
+        sites[top_index] = true;
+      }
+    }
+  }
+  return sites;
+}
+
+template <class ptensor>
+void TeNeS<ptensor>::enter_group(TaskGroups const &groups) {
+  // copy into the group only the tensors on the sites its tasks touch
+  // (collective over comm)
+  const std::vector<bool> all(N_UNIT, true);
+  const std::vector<bool> needed = group_sites(groups);
+  for (auto *tensors : measured_tensors()) {
+    std::vector<ptensor> local = groups.copy_to_group(*tensors, all, needed);
+    std::swap(*tensors, local);
+    saved_tensors.push_back(std::move(local));
+  }
+
+  // operators used by the group: onesite operators on the touched sites
+  // (also used by twosite operators and correlations) and own bonds
+  std::map<const ptensor *, bool> op_needed;
+  for (auto const &op : onesite_operators) {
+    if (op.op_ptr) {
+      op_needed[op.op_ptr.get()] |= needed[op.source_site];
+    }
+  }
+  const int nops = twosite_operators.size();
+  for (int iop = 0; iop < nops; ++iop) {
+    auto const &op = twosite_operators[iop];
+    if (op.op_ptr) {
+      op_needed[op.op_ptr.get()] |= groups.owns(iop);
+    }
+  }
+
+  // shared operators are copied only once
+  // (in the same order over comm, since the operators are)
+  std::map<const ptensor *, std::shared_ptr<const ptensor>> copies;
+  for (auto *ops : {&onesite_operators, &twosite_operators}) {
+    for (auto &op : *ops) {
+      saved_ops.push_back(op.op_ptr);
+      if (!op.op_ptr) {
+        continue;
+      }
+      auto it = copies.find(op.op_ptr.get());
+      if (it == copies.end()) {
+        auto A = std::make_shared<const ptensor>(
+            groups.copy_to_group(op.op(), op_needed[op.op_ptr.get()]));
+        it = copies.emplace(op.op_ptr.get(), A).first;
+      }
+      op.op_ptr = it->second;
+    }
+  }
+}
+
+template <class ptensor> void TeNeS<ptensor>::leave_group() {
+  auto lists = measured_tensors();
+  for (size_t k = 0; k < lists.size(); ++k) {
+    std::swap(*lists[k], saved_tensors[k]);
+  }
+  saved_tensors.clear();
+
+  size_t k = 0;
+  for (auto *ops : {&onesite_operators, &twosite_operators}) {
+    for (auto &op : *ops) {
+      op.op_ptr = saved_ops[k++];
+    }
+  }
+  saved_ops.clear();
+}
+
+template <class ptensor> std::vector<Density> TeNeS<ptensor>::measure() {
   if (peps_parameters.print_level >= PrintLevel::info) {
     std::cout << "Start calculating observables" << std::endl;
     std::cout << "  Start updating environment" << std::endl;
   }
   update_CTM();
 
+  // sites and bonds are measured by groups of processes in parallel
+  TaskGroups groups(comm, peps_parameters.measure_groups);
+  if (groups.is_split()) {
+    if (peps_parameters.print_level >= PrintLevel::info) {
+      std::cout << "  Split processes into " << groups.num_groups()
+                << " groups" << std::endl;
+    }
+    enter_group(groups);
+  }
+
   if (peps_parameters.print_level >= PrintLevel::info) {
     std::cout << "  Start calculating onesite operators" << std::endl;
   }
-  auto onesite_obs = measure_onesite();
+  auto onesite_obs = measure_onesite(groups);
   save_onesite(onesite_obs);
 
   if (peps_parameters.print_level >= PrintLevel::info) {
     std::cout << "  Start calculating twosite operators" << std::endl;
   }
-  auto twosite_obs = measure_twosite();
+  auto twosite_obs = measure_twosite(groups);
   save_twosite(twosite_obs);
 
   if (corparam.r_max > 0) {
     if (peps_parameters.print_level >= PrintLevel::info) {
       std::cout << "  Start calculating long range correlation" << std::endl;
     }
-    auto correlations = measure_correlation();
+    auto correlations = measure_correlation(groups);
     save_correlation(correlations);
   }
 
-  if (mpirank == 0) {
-    std::vector<tensor_type> loc_obs(num_onesite_operators);
-    int numsites = 0;
-    for (int i = 0; i < N_UNIT; ++i) {
-      if(lattice.physical_dims[i] > 1){
-        ++numsites;
-        for (int ilops = 0; ilops < num_onesite_operators; ++ilops) {
-          loc_obs[ilops] += onesite_obs[ilops][i];
-        }
+  if (groups.is_split()) {
+    leave_group();
+  }
+
+  // all the processes have the observables
+  std::vector<tensor_type> loc_obs(num_onesite_operators);
+  int numsites = 0;
+  for (int i = 0; i < N_UNIT; ++i) {
+    if(lattice.physical_dims[i] > 1){
+      ++numsites;
+      for (int ilops = 0; ilops < num_onesite_operators; ++ilops) {
+        loc_obs[ilops] += onesite_obs[ilops][i];
       }
     }
-    std::vector<tensor_type> two_obs(num_twosite_operators);
-    for (int iops = 0; iops < num_twosite_operators; ++iops) {
-      for (const auto &obs : twosite_obs[iops]) {
-        two_obs[iops] += obs.second;
-      }
+  }
+  std::vector<tensor_type> two_obs(num_twosite_operators);
+  for (int iops = 0; iops < num_twosite_operators; ++iops) {
+    for (const auto &obs : twosite_obs[iops]) {
+      two_obs[iops] += obs.second;
     }
+  }
 
-    auto energy = 0.0;
-    for (const auto &obs : twosite_obs[0]) {
-      energy += std::real(obs.second);
+  std::vector<Density> densities;
+  {
+    const double invV = 1.0 / numsites;
+    for (int ilops = 0; ilops < num_onesite_operators; ++ilops) {
+      densities.push_back(Density{onesite_operator_names[ilops],
+                                  std::complex<double>(loc_obs[ilops] * invV)});
     }
+    for (int ilops = 0; ilops < num_twosite_operators; ++ilops) {
+      densities.push_back(Density{twosite_operator_names[ilops],
+                                  std::complex<double>(two_obs[ilops] * invV)});
+    }
+  }
 
+  if (mpirank == 0) {
     {
       const double invV = 1.0 / numsites;
       std::string filename = outdir + "/density.dat";
@@ -1103,7 +1742,7 @@ template <class ptensor> void TeNeS<ptensor>::measure() {
           if (std::imag(v) >= 0.0) {
             ofs << " ";
           }
-          ofs << std::imag(v) << std::endl;
+          ofs << std::imag(v) << "\n";
         }
 
         for (int ilops = 0; ilops < num_twosite_operators; ++ilops) {
@@ -1116,7 +1755,7 @@ template <class ptensor> void TeNeS<ptensor>::measure() {
           if (std::imag(v) >= 0.0) {
             ofs << " ";
           }
-          ofs << std::imag(v) << std::endl;
+          ofs << std::imag(v) << "\n";
         }
         std::cout << "    Save observable densities to " << filename
                   << std::endl;
@@ -1147,9 +1786,17 @@ template <class ptensor> void TeNeS<ptensor>::measure() {
       }
     }
   } // end of if(mpirank == 0)
+  return densities;
 }
 
 template <class ptensor> void TeNeS<ptensor>::summary() const {
+  {
+    std::string filename = outdir + "/memory.dat";
+    memory_tracker.write(filename, comm);
+    if (peps_parameters.print_level >= PrintLevel::info) {
+      std::clog << "    Save memory usage to " << filename << std::endl;
+    }
+  }
   if(mpirank == 0){
     const double time_all = timer_all.elapsed();
     {
@@ -1160,6 +1807,9 @@ template <class ptensor> void TeNeS<ptensor>::summary() const {
       ofs << "time full update   = " << time_full_update << std::endl;
       ofs << "time environmnent  = " << time_environment << std::endl;
       ofs << "time observable    = " << time_observable << std::endl;
+      ofs << "time onesite       = " << time_onesite << std::endl;
+      ofs << "time twosite       = " << time_twosite << std::endl;
+      ofs << "time correlation   = " << time_correlation << std::endl;
       if (peps_parameters.print_level >= PrintLevel::info) {
         std::clog << "    Save elapsed times to " << filename << std::endl;
       }
@@ -1181,41 +1831,65 @@ template <class ptensor> void TeNeS<ptensor>::save_tensors() const {
   if (save_dir.empty()) {
     return;
   }
-  {
+  const auto env_precision =
+      parse_storage_precision(peps_parameters.tensor_save_env_precision);
+  const bool is_compact =
+      env_precision != StoragePrecision::double_precision;
+  if (mpirank == 0) {
     // metadata
     std::string filename = save_dir + "/params.dat";
     std::ofstream ofs(filename.c_str());
 
-    constexpr int tensor_format_version = 1;
+    // version 1 has all the tensors in mptensor's own format, and
+    // version 2 has the environment tensors as compact files
+    // in the precision given by Env_Precision (see save_compact)
+    // (version 3, all the tensors as compact files, is only read)
+    const int tensor_format_version = is_compact ? 2 : 1;
     ofs << tensor_format_version << " # Format_Version\n";
     ofs << N_UNIT << " # N_UNIT\n";
     ofs << CHI << " # CHI\n";
+    if (is_compact) {
+      ofs << storage_precision_name(env_precision) << " # Env_Precision\n";
+    }
     for (int i = 0; i < N_UNIT; ++i) {
       for (int j = 0; j < nleg; ++j) {
-        ofs << lattice.virtual_dims[i][j] << " ";
+        ofs << Tn[i].shape()[j] << " ";
       }
       ofs << lattice.physical_dims[i] << " # Shape of Tn[" << i << "]\n";
     }
   }
+  // the site tensors are always in mptensor's own format, so that
+  // checkpoints with the default precision are read by released versions
   for (int i = 0; i < N_UNIT; ++i) {
     std::string filename = save_dir + "/";
     std::string suffix = "_" + std::to_string(i) + ".dat";
     Tn[i].save((filename + "T" + suffix).c_str());
-    eTt[i].save((filename + "Et" + suffix).c_str());
-    eTr[i].save((filename + "Er" + suffix).c_str());
-    eTb[i].save((filename + "Eb" + suffix).c_str());
-    eTl[i].save((filename + "El" + suffix).c_str());
-    C1[i].save((filename + "C1" + suffix).c_str());
-    C2[i].save((filename + "C2" + suffix).c_str());
-    C3[i].save((filename + "C3" + suffix).c_str());
-    C4[i].save((filename + "C4" + suffix).c_str());
+    if (is_compact) {
+      save_compact(eTt[i], filename + "Et" + suffix, env_precision);
+      save_compact(eTr[i], filename + "Er" + suffix, env_precision);
+      save_compact(eTb[i], filename + "Eb" + suffix, env_precision);
+      save_compact(eTl[i], filename + "El" + suffix, env_precision);
+      save_compact(C1[i], filename + "C1" + suffix, env_precision);
+      save_compact(C2[i], filename + "C2" + suffix, env_precision);
+      save_compact(C3[i], filename + "C3" + suffix, env_precision);
+      save_compact(C4[i], filename + "C4" + suffix, env_precision);
+    } else {
+      eTt[i].save((filename + "Et" + suffix).c_str());
+      eTr[i].save((filename + "Er" + suffix).c_str());
+      eTb[i].save((filename + "Eb" + suffix).c_str());
+      eTl[i].save((filename + "El" + suffix).c_str());
+      C1[i].save((filename + "C1" + suffix).c_str());
+      C2[i].save((filename + "C2" + suffix).c_str());
+      C3[i].save((filename + "C3" + suffix).c_str());
+      C4[i].save((filename + "C4" + suffix).c_str());
+    }
   }
   if (mpirank == 0) {
     for (int i = 0; i < N_UNIT; ++i) {
       std::ofstream ofs(save_dir + "/lambda_" + std::to_string(i) + ".dat");
       for (int j = 0; j < nleg; ++j) {
-        for (int k = 0; k < lattice.virtual_dims[i][j]; ++k) {
-          ofs << lambda_tensor[i][j][k] << std::endl;
+        for (int k = 0; k < lambda_tensor[i][j].size(); ++k) {
+          ofs << lambda_tensor[i][j][k] << "\n";
         }
       }
     }
@@ -1246,7 +1920,7 @@ template <class ptensor> void TeNeS<ptensor>::load_tensors() {
   bcast(tensor_format_version, 0, comm);
   if (tensor_format_version == 0) {
     load_tensors_v0();
-  } else if (tensor_format_version == 1) {
+  } else if (1 <= tensor_format_version && tensor_format_version <= 3) {
     load_tensors_v1();
   } else {
     std::stringstream ss;
@@ -1258,108 +1932,186 @@ template <class ptensor> void TeNeS<ptensor>::load_tensors() {
 template <class ptensor> void TeNeS<ptensor>::load_tensors_v1() {
   std::string const &load_dir = peps_parameters.tensor_load_dir;
 
-  int loaded_CHI = 1;
-  std::vector<std::vector<int>> loaded_shape(N_UNIT, std::vector<int>(nleg+1));
-  if (mpirank == 0) {
-    std::string filename = load_dir + "/params.dat";
-    std::string line;
-    std::ifstream ifs(filename.c_str());
-    std::getline(ifs, line);
-
-    std::getline(ifs, line);
-    const int loaded_N_UNIT = std::stoi(util::drop_comment(line));
-    if (N_UNIT != loaded_N_UNIT) {
-      std::stringstream ss;
-      ss << "ERROR: N_UNIT is " << N_UNIT << " but loaded N_UNIT has "
-         << loaded_N_UNIT << std::endl;
-      throw tenes::load_error(ss.str());
+  std::vector<ptensor *> targets;
+  std::vector<std::string> files;
+  for (int i = 0; i < N_UNIT; ++i) {
+    const std::string prefix = load_dir + "/";
+    const std::string suffix = "_" + std::to_string(i) + ".dat";
+    const std::pair<ptensor *, std::string> tensors[] = {
+        {&Tn[i], "T"},   {&eTl[i], "El"}, {&eTt[i], "Et"},
+        {&eTr[i], "Er"}, {&eTb[i], "Eb"}, {&C1[i], "C1"},
+        {&C2[i], "C2"},  {&C3[i], "C3"},  {&C4[i], "C4"}};
+    for (auto const &t : tensors) {
+      targets.push_back(t.first);
+      files.push_back(prefix + t.second + suffix);
     }
+  }
 
-    std::getline(ifs, line);
-    loaded_CHI = std::stoi(util::drop_comment(line));
-    if (CHI != loaded_CHI) {
-      if (peps_parameters.print_level >= PrintLevel::info) {
-        std::cout << "WARNING: parameters.ctm.dimension is " << CHI
-                  << " but loaded tensors have CHI = " << loaded_CHI
-                  << std::endl;
+  // The rank 0 process reads params.dat and all the lambda files,
+  // and broadcasts them at once as
+  //   [version, CHI, whether each file is compact (size of files),
+  //    shapes of Tn (N_UNIT*(nleg+1)), lambdas]
+  std::vector<double> meta;
+  std::string errmsg;
+  if (mpirank == 0) {
+    try {
+      std::string filename = load_dir + "/params.dat";
+      std::string line;
+      std::ifstream ifs(filename.c_str());
+      std::getline(ifs, line);
+      const int tensor_format_version = std::stoi(util::drop_comment(line));
+
+      std::getline(ifs, line);
+      const int loaded_N_UNIT = std::stoi(util::drop_comment(line));
+      if (N_UNIT != loaded_N_UNIT) {
+        std::stringstream ss;
+        ss << "ERROR: N_UNIT is " << N_UNIT << " but loaded N_UNIT has "
+           << loaded_N_UNIT << std::endl;
+        throw tenes::load_error(ss.str());
       }
-    }
 
-    for (int i = 0; i < N_UNIT; ++i) {
       std::getline(ifs, line);
-      const auto shape = util::split(util::drop_comment(line));
-      for (int j = 0; j < nleg; ++j) {
-        loaded_shape[i][j] = std::stoi(shape[j]);
-        const int vd_param = lattice.virtual_dims[i][j];
-        if (vd_param != loaded_shape[i][j]) {
-          if (peps_parameters.print_level >= PrintLevel::info) {
-            std::cout << "WARNING: virtual dimension of the leg " << j
-                      << " of the tensor " << i << " is " << vd_param
-                      << " but loaded tensor has " << loaded_shape[i][j]
-                      << std::endl;
+      const int loaded_CHI = std::stoi(util::drop_comment(line));
+      if (CHI != loaded_CHI) {
+        if (peps_parameters.print_level >= PrintLevel::info) {
+          std::cout << "WARNING: parameters.ctm.dimension is " << CHI
+                    << " but loaded tensors have CHI = " << loaded_CHI
+                    << std::endl;
+        }
+      }
+
+      if (tensor_format_version >= 2) {
+        // the precision of the environment, which each file also has
+        std::getline(ifs, line);
+        parse_storage_precision(util::strip(util::drop_comment(line)));
+      }
+
+      meta.push_back(tensor_format_version);
+      meta.push_back(loaded_CHI);
+      // Each file is in mptensor's own format or a compact file
+      // (see save_tensors), which is told from the file itself.
+      // This also reads the intermediate layouts of version 2 and 3,
+      // which had the site tensors as compact files.
+      for (auto const &file : files) {
+        meta.push_back(is_compact_file(file) ? 1.0 : 0.0);
+      }
+
+      std::vector<std::vector<int>> loaded_shape(N_UNIT,
+                                                 std::vector<int>(nleg + 1));
+      for (int i = 0; i < N_UNIT; ++i) {
+        std::getline(ifs, line);
+        const auto shape = util::split(util::drop_comment(line));
+        for (int j = 0; j < nleg; ++j) {
+          loaded_shape[i][j] = std::stoi(shape[j]);
+          const int vd_param = lattice.virtual_dims[i][j];
+          if (vd_param != loaded_shape[i][j]) {
+            if (peps_parameters.print_level >= PrintLevel::info) {
+              std::cout << "WARNING: virtual dimension of the leg " << j
+                        << " of the tensor " << i << " is " << vd_param
+                        << " but loaded tensor has " << loaded_shape[i][j]
+                        << std::endl;
+            }
           }
         }
+        loaded_shape[i][nleg] = std::stoi(shape[nleg]);
+        const int pdim = lattice.physical_dims[i];
+        if (pdim != loaded_shape[i][nleg]) {
+          std::stringstream ss;
+          ss << "ERROR: dimension of the physical bond of the tensor " << i
+             << " is " << pdim << " but loaded tensor has "
+             << loaded_shape[i][nleg] << std::endl;
+          throw tenes::load_error(ss.str());
+        }
+        meta.insert(meta.end(), loaded_shape[i].begin(), loaded_shape[i].end());
       }
-      loaded_shape[i][nleg] = std::stoi(shape[nleg]);
-      const int pdim = lattice.physical_dims[i];
-      if (pdim != loaded_shape[i][nleg]) {
-        std::stringstream ss;
-        ss << "ERROR: dimension of the physical bond of the tensor " << i
-           << " is " << pdim << " but loaded tensor has " << loaded_shape[i][nleg]
-           << std::endl;
-        throw tenes::load_error(ss.str());
+
+      for (int i = 0; i < N_UNIT; ++i) {
+        std::ifstream ifs(load_dir + "/lambda_" + std::to_string(i) + ".dat");
+        for (int j = 0; j < nleg; ++j) {
+          for (int k = 0; k < loaded_shape[i][j]; ++k) {
+            double temp = 0.0;
+            ifs >> temp;
+            meta.push_back(temp);
+          }
+        }
       }
+    } catch (std::exception const &e) {
+      errmsg = e.what();
+      meta.clear();
     }
   }
-  for(int i=0; i<N_UNIT; ++i){
-    bcast(loaded_shape[i], 0, comm);
+  bcast(meta, 0, comm);
+  if (meta.empty()) {
+    bcast(errmsg, 0, comm);
+    throw tenes::load_error(errmsg);
   }
 
-#define LOAD_TENSOR_(A, name) \
-  do{\
-    ptensor temp; \
-    temp.load((filename + name + suffix).c_str()); \
-    A = resize_tensor(temp, A.shape()); \
-  }while(false)
-
+  size_t pos = 2;
+  std::vector<bool> is_compact(files.size());
+  for (size_t t = 0; t < files.size(); ++t) {
+    is_compact[t] = meta[pos++] != 0.0;
+  }
+  std::vector<std::vector<int>> loaded_shape(N_UNIT, std::vector<int>(nleg + 1));
   for (int i = 0; i < N_UNIT; ++i) {
-    std::string filename = load_dir + "/";
-    std::string suffix = "_" + std::to_string(i) + ".dat";
+    for (int j = 0; j <= nleg; ++j) {
+      loaded_shape[i][j] = static_cast<int>(meta[pos++]);
+    }
+  }
 
-    LOAD_TENSOR_(Tn[i], "T");
-    LOAD_TENSOR_(eTl[i], "El");
-    LOAD_TENSOR_(eTt[i], "Et");
-    LOAD_TENSOR_(eTr[i], "Er");
-    LOAD_TENSOR_(eTb[i], "Eb");
-    LOAD_TENSOR_(C1[i], "C1");
-    LOAD_TENSOR_(C2[i], "C2");
-    LOAD_TENSOR_(C3[i], "C3");
-    LOAD_TENSOR_(C4[i], "C4");
+  // Tensors in mptensor's own format may be redistributed.
+  for (size_t t = 0; t < targets.size(); ++t) {
+    if (is_compact[t]) {
+      continue;
+    }
+    ptensor temp(comm, targets[t]->shape());
+    temp.load(files[t].c_str());
+    if (same_shape(temp.shape(), targets[t]->shape())) {
+      *targets[t] = std::move(temp);
+    } else {
+      *targets[t] = resize_tensor(temp, targets[t]->shape());
+    }
   }
-#undef LOAD_TENSOR_
 
-  std::vector<double> ls;
-  if (mpirank == 0) {
-    for (int i = 0; i < N_UNIT; ++i) {
-      std::ifstream ifs(load_dir + "/lambda_" + std::to_string(i) + ".dat");
-      for (int j = 0; j < nleg; ++j) {
-        for (int k = 0; k < loaded_shape[i][j]; ++k) {
-          double temp = 0.0;
-          ifs >> temp;
-          ls.push_back(temp);
+  // Compact files are read directly into the local blocks in any shape and
+  // any number of processes. The files are assigned to the groups,
+  // which read them concurrently, and then the tensors are sent to all
+  // the processes.
+  if (std::find(is_compact.begin(), is_compact.end(), true) !=
+      is_compact.end()) {
+    TaskGroups groups(comm, peps_parameters.tensor_load_groups);
+    std::vector<ptensor> loaded(targets.size());
+    errmsg.clear();
+    try {
+      for (size_t t = 0; t < targets.size(); ++t) {
+        if (is_compact[t] && groups.owns(t)) {
+          loaded[t] = load_compact<ptensor>(files[t], targets[t]->shape(),
+                                            groups.group_comm());
         }
       }
+    } catch (tenes::load_error const &e) {
+      errmsg = e.what();
+    }
+    int failed = errmsg.empty() ? 0 : 1;
+    allreduce_sum(failed, comm);
+    if (failed) {
+      throw tenes::load_error(errmsg.empty()
+                                  ? "cannot load tensors from " + load_dir
+                                  : errmsg);
+    }
+    for (size_t t = 0; t < targets.size(); ++t) {
+      if (is_compact[t]) {
+        *targets[t] = groups.copy_from_group(loaded[t], t);
+        loaded[t] = ptensor();
+      }
     }
   }
-  bcast(ls, 0, comm);
-  int index = 0;
+
   for (int i = 0; i < N_UNIT; ++i) {
     const auto vdim = lattice.virtual_dims[i];
     for (int j = 0; j < nleg; ++j) {
       lambda_tensor[i][j].clear();
       for (int k = 0; k < loaded_shape[i][j]; ++k) {
-        lambda_tensor[i][j].push_back(ls[index]);
-        ++index;
+        lambda_tensor[i][j].push_back(meta[pos++]);
       }
       lambda_tensor[i][j].resize(vdim[j]);
     }
@@ -1446,22 +2198,162 @@ template <class ptensor> void TeNeS<ptensor>::load_tensors_v0() {
   }
 }
 
+template <class ptensor>
+std::vector<ptensor> const &TeNeS<ptensor>::corner_tensors(int corner) const {
+  switch (corner) {
+  case 0:
+    return C1;
+  case 1:
+    return C2;
+  case 2:
+    return C3;
+  case 3:
+    return C4;
+  }
+  std::stringstream ss;
+  ss << "corner index must be in [0, 3] (given " << corner << ")";
+  throw tenes::logic_error(ss.str());
+}
+
+template <class ptensor>
+std::vector<ptensor> const &TeNeS<ptensor>::edge_tensors(int edge) const {
+  switch (edge) {
+  case 0:
+    return eTl;
+  case 1:
+    return eTt;
+  case 2:
+    return eTr;
+  case 3:
+    return eTb;
+  }
+  std::stringstream ss;
+  ss << "edge index must be in [0, 3] (given " << edge << ")";
+  throw tenes::logic_error(ss.str());
+}
+
+template <class ptensor>
+Session<ptensor>::Session(MPI_Comm comm, PEPS_Parameters peps_parameters,
+                          Lattice lattice, NNOperators<ptensor> simple_updates,
+                          NNOperators<ptensor> full_updates,
+                          Operators<ptensor> onesite_operators,
+                          Operators<ptensor> twosite_operators,
+                          CorrelationParameter corparam)
+    : impl_(new TeNeS<ptensor>(comm, peps_parameters, lattice, simple_updates,
+                               full_updates, onesite_operators,
+                               twosite_operators, corparam)) {}
+
+namespace {
+template <class ptensor>
+TeNeS<ptensor> *make_tenes(MPI_Comm comm, Input const &input) {
+  const bool is_real =
+      std::is_floating_point<typename ptensor::value_type>::value;
+  if (input.peps_parameters.is_real != is_real) {
+    std::stringstream ss;
+    ss << "parameter.general.is_real = "
+       << (input.peps_parameters.is_real ? "true" : "false")
+       << " but the session uses " << (is_real ? "real" : "complex")
+       << " tensors";
+    throw tenes::input_error(ss.str());
+  }
+  util::InArchive ar(input.operators);
+  auto ops = unpack_operators<ptensor>(ar, comm);
+  return new TeNeS<ptensor>(comm, input.peps_parameters, input.lattice,
+                            ops.simple_updates, ops.full_updates,
+                            ops.onesite_operators, ops.twosite_operators,
+                            input.corparam);
+}
+} // end of unnamed namespace
+
+template <class ptensor>
+Session<ptensor>::Session(MPI_Comm comm, Input const &input)
+    : impl_(make_tenes<ptensor>(comm, input)) {}
+
+template <class ptensor> Session<ptensor>::~Session() = default;
+
+template <class ptensor> int Session<ptensor>::run() {
+  impl_->optimize();
+  impl_->save_tensors();
+  if (impl_->parameters().to_measure) {
+    impl_->measure();
+  }
+  impl_->summary();
+  return 0;
+}
+
+template <class ptensor> void Session<ptensor>::simple_update(int num_steps) {
+  impl_->simple_update(num_steps);
+}
+
+template <class ptensor> void Session<ptensor>::full_update(int num_steps) {
+  impl_->full_update(num_steps);
+}
+
+template <class ptensor> void Session<ptensor>::update_environment() {
+  impl_->update_CTM();
+}
+
+template <class ptensor> std::vector<Density> Session<ptensor>::measure() {
+  return impl_->measure();
+}
+
+template <class ptensor>
+void Session<ptensor>::warm_start(Session const &other) {
+  impl_->warm_start(*other.impl_);
+}
+
+template <class ptensor> void Session<ptensor>::save_tensors() const {
+  impl_->save_tensors();
+}
+
+template <class ptensor> void Session<ptensor>::summary() const {
+  impl_->summary();
+}
+
+template <class ptensor>
+PEPS_Parameters const &Session<ptensor>::parameters() const {
+  return impl_->parameters();
+}
+
+template <class ptensor> Lattice const &Session<ptensor>::lattice() const {
+  return impl_->get_lattice();
+}
+
+template <class ptensor>
+std::vector<ptensor> const &Session<ptensor>::site_tensors() const {
+  return impl_->site_tensors();
+}
+
+template <class ptensor>
+std::vector<std::vector<std::vector<double>>> const &
+Session<ptensor>::lambdas() const {
+  return impl_->lambdas();
+}
+
+template <class ptensor>
+std::vector<ptensor> const &
+Session<ptensor>::corner_tensors(int corner) const {
+  return impl_->corner_tensors(corner);
+}
+
+template <class ptensor>
+std::vector<ptensor> const &Session<ptensor>::edge_tensors(int edge) const {
+  return impl_->edge_tensors(edge);
+}
+
+template <class ptensor> int Session<ptensor>::ctm_iterations() const {
+  return impl_->ctm_iterations();
+}
+
 template <class tensor>
 int tenes(MPI_Comm comm, PEPS_Parameters peps_parameters, Lattice lattice,
           NNOperators<tensor> simple_updates, NNOperators<tensor> full_updates,
           Operators<tensor> onesite_operators,
           Operators<tensor> twosite_operators, CorrelationParameter corparam) {
-
-  TeNeS<tensor> tns(comm, peps_parameters, lattice, simple_updates,
-                    full_updates, onesite_operators, twosite_operators,
-                    corparam);
-  tns.optimize();
-  tns.save_tensors();
-  if(peps_parameters.to_measure){
-    tns.measure();
-  }
-  tns.summary();
-  return 0;
+  Session<tensor> session(comm, peps_parameters, lattice, simple_updates,
+                          full_updates, onesite_operators, twosite_operators,
+                          corparam);
+  return session.run();
 }
 
 // template specialization
@@ -1481,4 +2373,7 @@ template int tenes<complex_tensor>(MPI_Comm comm, PEPS_Parameters peps_parameter
                                    Operators<complex_tensor> twosite_operators,
                                    CorrelationParameter corparam);
 
+template class Session<real_tensor>;
+template class Session<complex_tensor>;
+
 } // end of namespace tenes
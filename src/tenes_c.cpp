@@ -0,0 +1,338 @@
+/* TeNeS - Massively parallel tensor network solver /
+/ Copyright (C) 2019- The University of Tokyo */
+
+/* This program is free software: you can redistribute it and/or modify /
+/ it under the terms of the GNU General Public License as published by /
+/ the Free Software Foundation, either version 3 of the License, or /
+/ (at your option) any later version. */
+
+/* This program is distributed in the hope that it will be useful, /
+/ but WITHOUT ANY WARRANTY; without even the implied warranty of /
+/ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the /
+/ GNU General Public License for more details. */
+
+/* You should have received a copy of the GNU General Public License /
+/ along with this program. If not, see http://www.gnu.org/licenses/. */
+
+#include "tenes_c.h"
+
+#include <complex>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "exception.hpp"
+#include "mpi.hpp"
+#include "session.hpp"
+#include "tensor.hpp"
+
+struct tenes_session {
+  // only one of them is used
+  std::unique_ptr<tenes::Session<tenes::real_tensor>> real;
+  std::unique_ptr<tenes::Session<tenes::complex_tensor>> complex;
+
+  // observables measured by the last tenes_measure
+  std::vector<tenes::Density> densities;
+};
+
+namespace {
+
+thread_local std::string last_error;
+
+// invalid arguments passed through the C interface
+class argument_error : public tenes::logic_error {
+public:
+  argument_error(const std::string &what_arg) : tenes::logic_error(what_arg) {}
+};
+
+// calls `f` and converts an exception into an error code
+template <class F> int guard(F f) {
+  try {
+    f();
+    last_error.clear();
+    return TENES_OK;
+  } catch (argument_error const &e) {
+    last_error = e.what();
+    return TENES_ERROR_ARGUMENT;
+  } catch (tenes::input_error const &e) {
+    last_error = e.what();
+    return TENES_ERROR_INPUT;
+  } catch (tenes::load_error const &e) {
+    last_error = e.what();
+    return TENES_ERROR_LOAD;
+  } catch (std::logic_error const &e) {
+    last_error = e.what();
+    return TENES_ERROR_LOGIC;
+  } catch (std::exception const &e) {
+    last_error = e.what();
+    return TENES_ERROR_RUNTIME;
+  }
+}
+
+void check_session(tenes_session const *session) {
+  if (session == nullptr) {
+    throw argument_error("session is NULL");
+  }
+}
+
+template <class T> void check_pointer(T const *ptr, const char *name) {
+  if (ptr == nullptr) {
+    std::stringstream ss;
+    ss << name << " is NULL";
+    throw argument_error(ss.str());
+  }
+}
+
+int create_session(const char *input_filename, const char *output_dir,
+                   MPI_Comm comm, int quiet, tenes_session **session) {
+  return guard([&]() {
+    check_pointer(input_filename, "input_filename");
+    check_pointer(session, "session");
+    *session = nullptr;
+    auto input = tenes::load_input(
+        input_filename, comm,
+        quiet ? tenes::PrintLevel::none : tenes::PrintLevel::info);
+    if (output_dir != nullptr) {
+      input.peps_parameters.outdir = output_dir;
+    }
+    std::unique_ptr<tenes_session> ret(new tenes_session);
+    if (input.peps_parameters.is_real) {
+      ret->real.reset(new tenes::Session<tenes::real_tensor>(comm, input));
+    } else {
+      ret->complex.reset(
+          new tenes::Session<tenes::complex_tensor>(comm, input));
+    }
+    *session = ret.release();
+  });
+}
+
+template <class ptensor>
+ptensor const &select_tensor(tenes::Session<ptensor> const &session, int kind,
+                             int index, int site) {
+  const int N_UNIT = session.lattice().N_UNIT;
+  if (site < 0 || N_UNIT <= site) {
+    std::stringstream ss;
+    ss << "site must be in [0, " << N_UNIT - 1 << "] (given " << site << ")";
+    throw argument_error(ss.str());
+  }
+  if (kind != TENES_TENSOR_SITE && (index < 0 || 3 < index)) {
+    std::stringstream ss;
+    ss << "index must be in [0, 3] (given " << index << ")";
+    throw argument_error(ss.str());
+  }
+  switch (kind) {
+  case TENES_TENSOR_SITE:
+    return session.site_tensors()[site];
+  case TENES_TENSOR_CORNER:
+    return session.corner_tensors(index)[site];
+  case TENES_TENSOR_EDGE:
+    return session.edge_tensors(index)[site];
+  }
+  std::stringstream ss;
+  ss << "unknown kind of tensors: " << kind;
+  throw argument_error(ss.str());
+}
+
+template <class ptensor>
+void tensor_shape(tenes::Session<ptensor> const &session, int kind, int index,
+                  int site, int *rank, int *shape) {
+  const auto &A = select_tensor(session, kind, index, site);
+  const auto s = A.shape();
+  *rank = s.size();
+  for (size_t i = 0; i < s.size(); ++i) {
+    shape[i] = s[i];
+  }
+}
+
+template <class ptensor>
+void tensor_elements(tenes::Session<ptensor> const &session, int kind,
+                     int index, int site, double *values, size_t capacity) {
+  const auto &A = select_tensor(session, kind, index, site);
+  const bool is_complex =
+      !std::is_floating_point<typename ptensor::value_type>::value;
+  const size_t ncomp = is_complex ? 2 : 1;
+
+  // (offset, real, imag) records of the local block are gathered directly
+  // into the root process, which scatters them into values
+  std::vector<double> all_records;
+  tenes::gatherv(tenes::detail::local_records(A), all_records, 0,
+                 A.get_comm());
+
+  int rank = 0;
+#ifndef _NO_MPI
+  MPI_Comm_rank(A.get_comm(), &rank);
+#endif
+  if (rank != 0) {
+    return;
+  }
+  const size_t size = ncomp * all_records.size() / 3;
+  if (capacity < size) {
+    std::stringstream ss;
+    ss << "capacity is too small: " << capacity << " < " << size;
+    throw argument_error(ss.str());
+  }
+  for (size_t i = 0; i < all_records.size(); i += 3) {
+    const size_t offset = static_cast<size_t>(all_records[i]);
+    for (size_t c = 0; c < ncomp; ++c) {
+      values[ncomp * offset + c] = all_records[i + 1 + c];
+    }
+  }
+}
+
+} // end of unnamed namespace
+
+extern "C" {
+
+const char *tenes_last_error(void) { return last_error.c_str(); }
+
+int tenes_session_create(const char *input_filename, int quiet,
+                         tenes_session **session) {
+  return create_session(input_filename, nullptr, MPI_COMM_WORLD, quiet,
+                        session);
+}
+
+int tenes_session_create_fcomm(const char *input_filename, int fortran_comm,
+                               int quiet, tenes_session **session) {
+  return tenes_session_create_output(input_filename, nullptr, fortran_comm,
+                                     quiet, session);
+}
+
+int tenes_session_create_output(const char *input_filename,
+                                const char *output_dir, int fortran_comm,
+                                int quiet, tenes_session **session) {
+#ifdef _NO_MPI
+  const MPI_Comm comm = MPI_COMM_WORLD;
+#else
+  const MPI_Comm comm = MPI_Comm_f2c(fortran_comm);
+#endif
+  return create_session(input_filename, output_dir, comm, quiet, session);
+}
+
+int tenes_session_destroy(tenes_session *session) {
+  return guard([&]() { delete session; });
+}
+
+int tenes_is_complex(tenes_session *session, int *is_complex) {
+  return guard([&]() {
+    check_session(session);
+    check_pointer(is_complex, "is_complex");
+    *is_complex = session->complex ? 1 : 0;
+  });
+}
+
+int tenes_get_num_sites(tenes_session *session, int *num_sites) {
+  return guard([&]() {
+    check_session(session);
+    check_pointer(num_sites, "num_sites");
+    *num_sites = session->real ? session->real->lattice().N_UNIT
+                               : session->complex->lattice().N_UNIT;
+  });
+}
+
+int tenes_run_simple(tenes_session *session, int num_steps) {
+  return guard([&]() {
+    check_session(session);
+    if (session->real) {
+      session->real->simple_update(num_steps);
+    } else {
+      session->complex->simple_update(num_steps);
+    }
+  });
+}
+
+int tenes_run_full(tenes_session *session, int num_steps) {
+  return guard([&]() {
+    check_session(session);
+    if (session->real) {
+      session->real->full_update(num_steps);
+    } else {
+      session->complex->full_update(num_steps);
+    }
+  });
+}
+
+int tenes_update_environment(tenes_session *session) {
+  return guard([&]() {
+    check_session(session);
+    if (session->real) {
+      session->real->update_environment();
+    } else {
+      session->complex->update_environment();
+    }
+  });
+}
+
+int tenes_measure(tenes_session *session, int *num_densities) {
+  return guard([&]() {
+    check_session(session);
+    session->densities = session->real ? session->real->measure()
+                                       : session->complex->measure();
+    if (num_densities != nullptr) {
+      *num_densities = session->densities.size();
+    }
+  });
+}
+
+int tenes_get_density(tenes_session *session, double *values,
+                      size_t capacity) {
+  return guard([&]() {
+    check_session(session);
+    check_pointer(values, "values");
+    const size_t n = session->densities.size();
+    if (capacity < 2 * n) {
+      std::stringstream ss;
+      ss << "capacity is too small: " << capacity << " < " << 2 * n;
+      throw argument_error(ss.str());
+    }
+    for (size_t i = 0; i < n; ++i) {
+      values[2 * i] = std::real(session->densities[i].value);
+      values[2 * i + 1] = std::imag(session->densities[i].value);
+    }
+  });
+}
+
+int tenes_get_density_name(tenes_session *session, int index,
+                           const char **name) {
+  return guard([&]() {
+    check_session(session);
+    check_pointer(name, "name");
+    const int n = session->densities.size();
+    if (index < 0 || n <= index) {
+      std::stringstream ss;
+      ss << "index must be in [0, " << n - 1 << "] (given " << index << ")";
+      throw argument_error(ss.str());
+    }
+    *name = session->densities[index].name.c_str();
+  });
+}
+
+int tenes_get_tensor_shape(tenes_session *session, int kind, int index,
+                           int site, int *rank, int *shape) {
+  return guard([&]() {
+    check_session(session);
+    check_pointer(rank, "rank");
+    check_pointer(shape, "shape");
+    if (session->real) {
+      tensor_shape(*session->real, kind, index, site, rank, shape);
+    } else {
+      tensor_shape(*session->complex, kind, index, site, rank, shape);
+    }
+  });
+}
+
+int tenes_get_tensor(tenes_session *session, int kind, int index, int site,
+                     double *values, size_t capacity) {
+  return guard([&]() {
+    check_session(session);
+    check_pointer(values, "values");
+    if (session->real) {
+      tensor_elements(*session->real, kind, index, site, values, capacity);
+    } else {
+      tensor_elements(*session->complex, kind, index, site, values, capacity);
+    }
+  });
+}
+
+} // extern "C"
@@ -0,0 +1,170 @@
+/* TeNeS - Massively parallel tensor network solver /
+/ Copyright (C) 2019- The University of Tokyo */
+
+/* This program is free software: you can redistribute it and/or modify /
+/ it under the terms of the GNU General Public License as published by /
+/ the Free Software Foundation, either version 3 of the License, or /
+/ (at your option) any later version. */
+
+/* This program is distributed in the hope that it will be useful, /
+/ but WITHOUT ANY WARRANTY; without even the implied warranty of /
+/ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the /
+/ GNU General Public License for more details. */
+
+/* You should have received a copy of the GNU General Public License /
+/ along with this program. If not, see http://www.gnu.org/licenses/. */
+
+/*
+ * C interface of libtenes
+ *
+ * A thin wrapper of tenes::Session (session.hpp) for drivers written in C
+ * or other languages with C FFI.
+ * All the functions return TENES_OK on success or one of the error codes,
+ * and tenes_last_error() returns the message of the last error.
+ * Data are written into buffers provided by the caller.
+ * All the functions except tenes_last_error are collective operations over
+ * the MPI communicator of the session.
+ */
+
+#ifndef TENES_C_H
+#define TENES_C_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* error codes */
+#define TENES_OK 0
+#define TENES_ERROR_INPUT 1
+#define TENES_ERROR_LOAD 2
+#define TENES_ERROR_RUNTIME 3
+#define TENES_ERROR_LOGIC 4
+#define TENES_ERROR_ARGUMENT 5
+
+/* kinds of tensors */
+#define TENES_TENSOR_SITE 0
+#define TENES_TENSOR_CORNER 1
+#define TENES_TENSOR_EDGE 2
+
+/* maximum rank of tensors */
+#define TENES_MAX_RANK 5
+
+typedef struct tenes_session tenes_session;
+
+/*
+ * message of the last error in this thread ("" if none)
+ */
+const char *tenes_last_error(void);
+
+/*
+ * create a session from an input file in the standard format
+ * over MPI_COMM_WORLD
+ *
+ * quiet: nonzero suppresses messages to the standard output
+ */
+int tenes_session_create(const char *input_filename, int quiet,
+                         tenes_session **session);
+
+/*
+ * create a session over a communicator given as a Fortran handle
+ * (MPI_Comm_c2f), ignored when libtenes is built without MPI
+ */
+int tenes_session_create_fcomm(const char *input_filename, int fortran_comm,
+                               int quiet, tenes_session **session);
+
+/*
+ * create a session over a communicator given as a Fortran handle
+ * writing into output_dir instead of parameter.general.output
+ * (the input value is used if output_dir is NULL)
+ */
+int tenes_session_create_output(const char *input_filename,
+                                const char *output_dir, int fortran_comm,
+                                int quiet, tenes_session **session);
+
+/*
+ * destroy a session (NULL is allowed)
+ */
+int tenes_session_destroy(tenes_session *session);
+
+/*
+ * whether the tensors are complex (1) or real (0)
+ */
+int tenes_is_complex(tenes_session *session, int *is_complex);
+
+/*
+ * number of sites in the unit cell
+ */
+int tenes_get_num_sites(tenes_session *session, int *num_sites);
+
+/*
+ * apply num_steps steps of the simple / full update
+ */
+int tenes_run_simple(tenes_session *session, int num_steps);
+int tenes_run_full(tenes_session *session, int num_steps);
+
+/*
+ * update the CTM environment starting from the present one
+ * (from the site tensors if there is no environment yet)
+ */
+int tenes_update_environment(tenes_session *session);
+
+/*
+ * update the environment, measure and save observables
+ *
+ * num_densities: number of the observables per site (can be NULL)
+ */
+int tenes_measure(tenes_session *session, int *num_densities);
+
+/*
+ * observables per site measured by the last tenes_measure
+ *
+ * values: buffer of capacity doubles, filled with (real, imag) pairs
+ * capacity: number of doubles in values,
+ *           must be at least twice the number of the observables
+ */
+int tenes_get_density(tenes_session *session, double *values,
+                      size_t capacity);
+
+/*
+ * name of the index-th observable measured by the last tenes_measure
+ *
+ * name: points to a string owned by the session,
+ *       valid until the next tenes_measure
+ */
+int tenes_get_density_name(tenes_session *session, int index,
+                           const char **name);
+
+/*
+ * shape of a tensor
+ *
+ * kind: TENES_TENSOR_SITE, TENES_TENSOR_CORNER, or TENES_TENSOR_EDGE
+ * index: 0--3 for corners (left-top, right-top, right-bottom, left-bottom)
+ *        and edges (left, top, right, bottom), ignored for site tensors
+ * site: index of the site in the unit cell
+ * rank: rank of the tensor
+ * shape: buffer of TENES_MAX_RANK ints
+ */
+int tenes_get_tensor_shape(tenes_session *session, int kind, int index,
+                           int site, int *rank, int *shape);
+
+/*
+ * elements of a tensor in row-major (C) order
+ *
+ * This is a collective operation over the communicator of the session.
+ * The elements are gathered only into the root process (rank 0),
+ * and values on the other processes are left untouched.
+ *
+ * values: buffer of capacity doubles on the root process
+ *         real tensors need the number of elements,
+ *         complex tensors twice it for (real, imag) pairs
+ */
+int tenes_get_tensor(tenes_session *session, int kind, int index, int site,
+                     double *values, size_t capacity);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TENES_C_H */
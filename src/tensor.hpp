@@ -17,7 +17,9 @@
 #ifndef TENSOR_HPP
 #define TENSOR_HPP
 
+#include <complex>
 #include <sstream>
+#include <vector>
 
 #include <mptensor/tensor.hpp>
 
@@ -35,6 +37,109 @@ template <class T> using mptensor_tensor_type = mptensor::Tensor<mptensor_matrix
 using real_tensor = mptensor_tensor_type<double>;
 using complex_tensor = mptensor_tensor_type<std::complex<double>>;
 
+namespace detail {
+// strides of the row-major (C order) layout
+inline std::vector<long> c_order_strides(mptensor::Shape const &shape) {
+  const size_t rank = shape.size();
+  std::vector<long> strides(rank, 1);
+  for (size_t i = rank; i > 1; --i) {
+    strides[i - 2] = strides[i - 1] * shape[i - 1];
+  }
+  return strides;
+}
+
+inline long c_order_offset(mptensor::Index const &index,
+                           std::vector<long> const &strides) {
+  long ret = 0;
+  for (size_t i = 0; i < strides.size(); ++i) {
+    ret += index[i] * strides[i];
+  }
+  return ret;
+}
+
+// (offset in C order, real, imag) of each element in the local block of A
+template <template <typename> class Matrix, class C>
+std::vector<double> local_records(mptensor::Tensor<Matrix, C> const &A) {
+  const auto strides = c_order_strides(A.shape());
+  const size_t n = A.local_size();
+  std::vector<double> records(3 * n);
+  for (size_t lindex = 0; lindex < n; ++lindex) {
+    records[3 * lindex] =
+        static_cast<double>(c_order_offset(A.global_index(lindex), strides));
+    records[3 * lindex + 1] = std::real(A[lindex]);
+    records[3 * lindex + 2] = std::imag(A[lindex]);
+  }
+  return records;
+}
+} // end of namespace detail
+
+/*! @brief set each element in the local block of `A` to `f(index)`
+ *
+ *  The local elements are visited in the storage order by OpenMP threads,
+ *  so `f` should be thread safe.
+ *
+ *  @param[in,out] A
+ *  @param[in]     f  function from the global index to the element
+ */
+template <template <typename> class Matrix, class C, class F>
+void fill_local(mptensor::Tensor<Matrix, C> &A, F f) {
+  const long n = A.local_size();
+#ifndef _NO_OMP
+#pragma omp parallel
+#endif
+  {
+    mptensor::Index index;
+    index.resize(A.rank());
+#ifndef _NO_OMP
+#pragma omp for
+#endif
+    for (long lindex = 0; lindex < n; ++lindex) {
+      A.global_index_fast(lindex, index);
+      A[lindex] = f(index);
+    }
+  }
+}
+
+/*! @brief set the local block of `A` from all the elements in C order
+ *
+ *  @param[in,out] A
+ *  @param[in]     dense  all the elements of `A` in the row-major order
+ */
+template <template <typename> class Matrix, class C>
+void fill_local(mptensor::Tensor<Matrix, C> &A, std::vector<C> const &dense) {
+  const auto strides = detail::c_order_strides(A.shape());
+  fill_local(A, [&](mptensor::Index const &index) {
+    return dense[detail::c_order_offset(index, strides)];
+  });
+}
+
+/*! @brief identity matrix of size `n`
+ *
+ *  @param[in] n
+ *  @param[in] comm  communicator over which the matrix is distributed
+ */
+template <class ptensor>
+ptensor make_identity(int n, typename ptensor::comm_type const &comm) {
+  using value_type = typename ptensor::value_type;
+  ptensor ret(comm, mptensor::Shape(n, n));
+  fill_local(ret, [](mptensor::Index const &index) {
+    return index[0] == index[1] ? value_type(1.0) : value_type(0.0);
+  });
+  return ret;
+}
+
+inline bool same_shape(mptensor::Shape const &a, mptensor::Shape const &b) {
+  if (a.size() != b.size()) {
+    return false;
+  }
+  for (size_t i = 0; i < a.size(); ++i) {
+    if (a[i] != b[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
 template <class T>
 mptensor_tensor_type<T> resize_tensor(mptensor_tensor_type<T> const& src, mptensor::Shape target_shape){
   mptensor::Shape shape = src.shape();
@@ -0,0 +1,162 @@
+/* TeNeS - Massively parallel tensor network solver /
+/ Copyright (C) 2019- The University of Tokyo */
+
+/* This program is free software: you can redistribute it and/or modify /
+/ it under the terms of the GNU General Public License as published by /
+/ the Free Software Foundation, either version 3 of the License, or /
+/ (at your option) any later version. */
+
+/* This program is distributed in the hope that it will be useful, /
+/ but WITHOUT ANY WARRANTY; without even the implied warranty of /
+/ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the /
+/ GNU General Public License for more details. */
+
+/* You should have received a copy of the GNU General Public License /
+/ along with this program. If not, see http://www.gnu.org/licenses/. */
+
+#ifndef UTIL_ARCHIVE_HPP
+#define UTIL_ARCHIVE_HPP
+
+#include <array>
+#include <complex>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+#include "../exception.hpp"
+
+namespace tenes {
+namespace util {
+
+/*! @brief binary buffer into which values are serialized
+ *
+ *  Supported types are arithmetic types, std::complex, std::string,
+ *  std::tuple<int, int>, std::array, and std::vector of them.
+ *  The buffer is meant to be sent to processes of the same executable,
+ *  so the native byte order and type sizes are used.
+ */
+class OutArchive {
+ public:
+  template <class T>
+  typename std::enable_if<std::is_arithmetic<T>::value, OutArchive &>::type
+  operator<<(T const &v) {
+    const size_t pos = buffer_.size();
+    buffer_.resize(pos + sizeof(T));
+    std::memcpy(&buffer_[pos], &v, sizeof(T));
+    return *this;
+  }
+  template <class T> OutArchive &operator<<(std::complex<T> const &v) {
+    return *this << std::real(v) << std::imag(v);
+  }
+  OutArchive &operator<<(std::string const &v) {
+    *this << static_cast<uint64_t>(v.size());
+    buffer_.append(v);
+    return *this;
+  }
+  template <class T, class U>
+  OutArchive &operator<<(std::tuple<T, U> const &v) {
+    return *this << std::get<0>(v) << std::get<1>(v);
+  }
+  template <class T, size_t N> OutArchive &operator<<(std::array<T, N> const &v) {
+    for (auto const &x : v) {
+      *this << x;
+    }
+    return *this;
+  }
+  template <class T> OutArchive &operator<<(std::vector<T> const &v) {
+    *this << static_cast<uint64_t>(v.size());
+    for (auto const &x : v) {
+      *this << x;
+    }
+    return *this;
+  }
+  OutArchive &operator<<(std::vector<bool> const &v) {
+    *this << static_cast<uint64_t>(v.size());
+    for (bool x : v) {
+      *this << x;
+    }
+    return *this;
+  }
+
+  std::string const &str() const { return buffer_; }
+
+ private:
+  std::string buffer_;
+};
+
+/*! @brief reads values serialized by OutArchive in the same order */
+class InArchive {
+ public:
+  explicit InArchive(std::string const &buffer) : buffer_(buffer), pos_(0) {}
+
+  template <class T>
+  typename std::enable_if<std::is_arithmetic<T>::value, InArchive &>::type
+  operator>>(T &v) {
+    std::memcpy(&v, take(sizeof(T)), sizeof(T));
+    return *this;
+  }
+  template <class T> InArchive &operator>>(std::complex<T> &v) {
+    T re, im;
+    *this >> re >> im;
+    v = std::complex<T>(re, im);
+    return *this;
+  }
+  InArchive &operator>>(std::string &v) {
+    uint64_t n = 0;
+    *this >> n;
+    v.assign(take(n), n);
+    return *this;
+  }
+  template <class T, class U> InArchive &operator>>(std::tuple<T, U> &v) {
+    return *this >> std::get<0>(v) >> std::get<1>(v);
+  }
+  template <class T, size_t N> InArchive &operator>>(std::array<T, N> &v) {
+    for (auto &x : v) {
+      *this >> x;
+    }
+    return *this;
+  }
+  template <class T> InArchive &operator>>(std::vector<T> &v) {
+    uint64_t n = 0;
+    *this >> n;
+    v.resize(n);
+    for (auto &x : v) {
+      *this >> x;
+    }
+    return *this;
+  }
+  InArchive &operator>>(std::vector<bool> &v) {
+    uint64_t n = 0;
+    *this >> n;
+    v.resize(n);
+    for (size_t i = 0; i < n; ++i) {
+      bool x;
+      *this >> x;
+      v[i] = x;
+    }
+    return *this;
+  }
+
+  bool eof() const { return pos_ == buffer_.size(); }
+
+ private:
+  const char *take(size_t n) {
+    if (pos_ + n > buffer_.size()) {
+      throw tenes::logic_error("InArchive: read beyond the end of buffer");
+    }
+    const char *p = buffer_.data() + pos_;
+    pos_ += n;
+    return p;
+  }
+
+  std::string const &buffer_;
+  size_t pos_;
+};
+
+}  // end of namespace util
+}  // end of namespace tenes
+
+#endif  // UTIL_ARCHIVE_HPP
@@ -0,0 +1,367 @@
+/* TeNeS - Massively parallel tensor network solver /
+/ Copyright (C) 2019- The University of Tokyo */
+
+/* This program is free software: you can redistribute it and/or modify /
+/ it under the terms of the GNU General Public License as published by /
+/ the Free Software Foundation, either version 3 of the License, or /
+/ (at your option) any later version. */
+
+/* This program is distributed in the hope that it will be useful, /
+/ but WITHOUT ANY WARRANTY; without even the implied warranty of /
+/ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the /
+/ GNU General Public License for more details. */
+
+/* You should have received a copy of the GNU General Public License /
+/ along with this program. If not, see http://www.gnu.org/licenses/. */
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <limits>
+#include <sstream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../exception.hpp"
+#include "float16.hpp"
+#include "string.hpp"
+
+#include "binary_array.hpp"
+
+namespace tenes {
+namespace util {
+
+namespace {
+bool host_is_little_endian() {
+  const uint16_t one = 1;
+  char c;
+  std::memcpy(&c, &one, 1);
+  return c == 1;
+}
+
+template <class T> T read_value(const char *p, bool swap) {
+  T v;
+  if (swap) {
+    char buf[sizeof(T)];
+    std::reverse_copy(p, p + sizeof(T), buf);
+    std::memcpy(&v, buf, sizeof(T));
+  } else {
+    std::memcpy(&v, p, sizeof(T));
+  }
+  return v;
+}
+
+double read_real(const char *p, BinaryArray::dtype type, bool swap) {
+  switch (type) {
+  case BinaryArray::dtype::float16:
+  case BinaryArray::dtype::complex32:
+    return half_to_float(read_value<uint16_t>(p, swap));
+  case BinaryArray::dtype::float32:
+  case BinaryArray::dtype::complex64:
+    return read_value<float>(p, swap);
+  default:
+    return read_value<double>(p, swap);
+  }
+}
+
+std::string npy_error(std::string const &filename, std::string const &what) {
+  return std::string("cannot read ") + filename + ": " + what;
+}
+
+// returns the value of `key` in the header dict of npy file
+// (the substring just after "'key':", with leading spaces stripped)
+std::string npy_header_value(std::string const &header,
+                             std::string const &key,
+                             std::string const &filename) {
+  const std::string pattern = "'" + key + "'";
+  auto pos = header.find(pattern);
+  if (pos == std::string::npos) {
+    throw tenes::input_error(
+        npy_error(filename, "'" + key + "' not found in npy header"));
+  }
+  pos = header.find(':', pos + pattern.size());
+  if (pos == std::string::npos) {
+    throw tenes::input_error(npy_error(filename, "broken npy header"));
+  }
+  return strip(header.substr(pos + 1));
+}
+}  // end of unnamed namespace
+
+class BinaryArray::Mapping {
+ public:
+  explicit Mapping(std::string const &filename) : addr_(nullptr), length_(0) {
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+      throw tenes::input_error(npy_error(filename, "cannot open file"));
+    }
+    struct stat st;
+    if (::fstat(fd, &st) != 0) {
+      ::close(fd);
+      throw tenes::input_error(npy_error(filename, "cannot stat file"));
+    }
+    length_ = static_cast<size_t>(st.st_size);
+    if (length_ > 0) {
+      void *addr = ::mmap(nullptr, length_, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (addr == MAP_FAILED) {
+        ::close(fd);
+        throw tenes::input_error(npy_error(filename, "cannot map file"));
+      }
+      addr_ = static_cast<const char *>(addr);
+    }
+    ::close(fd);
+  }
+  ~Mapping() {
+    if (addr_ != nullptr) {
+      ::munmap(const_cast<char *>(addr_), length_);
+    }
+  }
+  Mapping(Mapping const &) = delete;
+  Mapping &operator=(Mapping const &) = delete;
+
+  const char *data() const { return addr_; }
+  size_t length() const { return length_; }
+
+ private:
+  const char *addr_;
+  size_t length_;
+};
+
+BinaryArray::dtype BinaryArray::parse_dtype(std::string const &name) {
+  if (name == "float64" || name == "f8" || name == "double") {
+    return dtype::float64;
+  } else if (name == "complex128" || name == "c16" || name == "complex") {
+    return dtype::complex128;
+  } else if (name == "float32" || name == "f4") {
+    return dtype::float32;
+  } else if (name == "complex64" || name == "c8") {
+    return dtype::complex64;
+  } else if (name == "float16" || name == "f2") {
+    return dtype::float16;
+  }
+  throw tenes::input_error(
+      std::string("unknown dtype: ") + name +
+      " (float16, float32, float64, complex64, or complex128 is supported)");
+}
+
+size_t BinaryArray::element_size(dtype type) {
+  switch (type) {
+  case dtype::float16:
+    return 2;
+  case dtype::float32:
+  case dtype::complex32:
+    return 4;
+  case dtype::float64:
+  case dtype::complex64:
+    return 8;
+  case dtype::complex128:
+    return 16;
+  }
+  return 0;
+}
+
+BinaryArray BinaryArray::open_npy(std::string const &filename) {
+  BinaryArray ret;
+  ret.filename_ = filename;
+  ret.mapping_ = std::make_shared<Mapping>(filename);
+  const char *p = ret.mapping_->data();
+  const size_t length = ret.mapping_->length();
+
+  const char magic[] = "\x93NUMPY";
+  const size_t magic_len = 6;
+  if (length < magic_len + 4 || std::memcmp(p, magic, magic_len) != 0) {
+    throw tenes::input_error(npy_error(filename, "not a npy file"));
+  }
+  const int major = static_cast<unsigned char>(p[magic_len]);
+  size_t header_len = 0;
+  size_t offset = 0;
+  if (major == 1) {
+    header_len = static_cast<unsigned char>(p[8]) |
+                 (static_cast<size_t>(static_cast<unsigned char>(p[9])) << 8);
+    offset = 10;
+  } else if (major == 2 || major == 3) {
+    if (length < 12) {
+      throw tenes::input_error(npy_error(filename, "broken npy header"));
+    }
+    for (int i = 0; i < 4; ++i) {
+      header_len |= static_cast<size_t>(static_cast<unsigned char>(p[8 + i]))
+                    << (8 * i);
+    }
+    offset = 12;
+  } else {
+    std::stringstream ss;
+    ss << "unsupported npy version " << major;
+    throw tenes::input_error(npy_error(filename, ss.str()));
+  }
+  if (offset + header_len > length) {
+    throw tenes::input_error(npy_error(filename, "broken npy header"));
+  }
+  const std::string header(p + offset, header_len);
+
+  // descr
+  std::string descr = npy_header_value(header, "descr", filename);
+  if (descr.size() < 2 || (descr[0] != '\'' && descr[0] != '"')) {
+    throw tenes::input_error(npy_error(filename, "broken npy header"));
+  }
+  descr = descr.substr(1, descr.find(descr[0], 1) - 1);
+  bool file_is_little = true;
+  if (descr[0] == '<' || descr[0] == '>' || descr[0] == '=' ||
+      descr[0] == '|') {
+    file_is_little = descr[0] != '>';
+    descr = descr.substr(1);
+  }
+  if (descr == "f2" || descr == "f4" || descr == "f8" || descr == "c8" ||
+      descr == "c16") {
+    ret.type_ = parse_dtype(descr);
+  } else {
+    throw tenes::input_error(
+        npy_error(filename, "unsupported dtype " + descr +
+                                " (f2, f4, f8, c8, or c16 is supported)"));
+  }
+  ret.swap_ = (file_is_little != host_is_little_endian());
+
+  // fortran_order
+  const std::string order = npy_header_value(header, "fortran_order", filename);
+  ret.fortran_order_ = order.compare(0, 4, "True") == 0;
+
+  // shape
+  const std::string shape_str = npy_header_value(header, "shape", filename);
+  const auto close = shape_str.find(')');
+  if (shape_str.empty() || shape_str[0] != '(' || close == std::string::npos) {
+    throw tenes::input_error(npy_error(filename, "broken npy header"));
+  }
+  std::string dims = shape_str.substr(1, close - 1);
+  std::replace(dims.begin(), dims.end(), ',', ' ');
+  ret.size_ = 1;
+  for (auto const &d : split(dims)) {
+    ret.shape_.push_back(std::stoul(d));
+    ret.size_ *= ret.shape_.back();
+  }
+
+  ret.data_ = p + offset + header_len;
+  if (offset + header_len + ret.size_ * element_size(ret.type_) > length) {
+    throw tenes::input_error(npy_error(filename, "file is too short"));
+  }
+  return ret;
+}
+
+BinaryArray BinaryArray::open_raw(std::string const &filename, dtype type,
+                                  std::vector<size_t> const &shape) {
+  BinaryArray ret;
+  ret.filename_ = filename;
+  ret.mapping_ = std::make_shared<Mapping>(filename);
+  ret.type_ = type;
+  ret.swap_ = !host_is_little_endian();
+  ret.shape_ = shape;
+  ret.size_ = 1;
+  for (auto d : shape) {
+    ret.size_ *= d;
+  }
+  const size_t expected = ret.size_ * element_size(type);
+  if (ret.mapping_->length() != expected) {
+    std::stringstream ss;
+    ss << "file size (" << ret.mapping_->length()
+       << " bytes) differs from the expected one (" << expected << " bytes)";
+    throw tenes::input_error(npy_error(filename, ss.str()));
+  }
+  ret.data_ = ret.mapping_->data();
+  return ret;
+}
+
+BinaryArray BinaryArray::open_compact(std::string const &filename) {
+  BinaryArray ret;
+  ret.filename_ = filename;
+  ret.mapping_ = std::make_shared<Mapping>(filename);
+  const char *p = ret.mapping_->data();
+  const size_t length = ret.mapping_->length();
+
+  const char *eol =
+      static_cast<const char *>(std::memchr(p, '\n', std::min<size_t>(length, 4096)));
+  if (eol == nullptr) {
+    throw tenes::load_error(npy_error(filename, "not a compact tensor file"));
+  }
+  std::stringstream ss(std::string(p, eol));
+  std::string magic, precision, kind, endian;
+  int version = 0;
+  size_t rank = 0;
+  ss >> magic >> version >> precision >> kind >> endian >> rank;
+  if (magic != "tenes-compact-tensor" || version != 1) {
+    throw tenes::load_error(npy_error(filename, "not a compact tensor file"));
+  }
+  const bool is_complex = kind == "complex";
+  if (precision == "double") {
+    ret.type_ = is_complex ? dtype::complex128 : dtype::float64;
+  } else if (precision == "single") {
+    ret.type_ = is_complex ? dtype::complex64 : dtype::float32;
+  } else if (precision == "half") {
+    ret.type_ = is_complex ? dtype::complex32 : dtype::float16;
+  } else {
+    throw tenes::load_error(
+        npy_error(filename, "unknown precision " + precision));
+  }
+  ret.swap_ = (endian == "little") != host_is_little_endian();
+  ret.size_ = 1;
+  for (size_t i = 0; i < rank; ++i) {
+    size_t d = 0;
+    ss >> d;
+    ret.shape_.push_back(d);
+    ret.size_ *= d;
+  }
+  ss >> ret.scale_;
+  if (!ss) {
+    throw tenes::load_error(npy_error(filename, "broken header"));
+  }
+  const size_t offset = eol - p + 1;
+  if (offset + ret.size_ * element_size(ret.type_) > length) {
+    throw tenes::load_error(npy_error(filename, "file is too short"));
+  }
+  ret.data_ = p + offset;
+  return ret;
+}
+
+std::string compact_header(std::string const &precision, bool is_complex,
+                           std::vector<size_t> const &shape, double scale) {
+  std::stringstream ss;
+  ss << std::setprecision(std::numeric_limits<double>::max_digits10);
+  ss << "tenes-compact-tensor 1 " << precision
+     << (is_complex ? " complex " : " real ")
+     << (host_is_little_endian() ? "little " : "big ") << shape.size();
+  for (auto d : shape) {
+    ss << " " << d;
+  }
+  ss << " " << scale << "\n";
+  return ss.str();
+}
+
+std::vector<size_t> BinaryArray::strides() const {
+  const size_t rank = shape_.size();
+  std::vector<size_t> ret(rank, 1);
+  if (fortran_order_) {
+    for (size_t i = 1; i < rank; ++i) {
+      ret[i] = ret[i - 1] * shape_[i - 1];
+    }
+  } else {
+    for (size_t i = rank; i > 1; --i) {
+      ret[i - 2] = ret[i - 1] * shape_[i - 1];
+    }
+  }
+  return ret;
+}
+
+std::complex<double> BinaryArray::at(size_t offset) const {
+  const size_t elemsize = element_size(type_);
+  const char *p = data_ + elemsize * offset;
+  if (is_complex()) {
+    return scale_ * std::complex<double>(
+                        read_real(p, type_, swap_),
+                        read_real(p + elemsize / 2, type_, swap_));
+  } else {
+    return std::complex<double>(scale_ * read_real(p, type_, swap_), 0.0);
+  }
+}
+
+}  // end of namespace util
+}  // end of namespace tenes
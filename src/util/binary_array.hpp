@@ -0,0 +1,126 @@
+/* TeNeS - Massively parallel tensor network solver /
+/ Copyright (C) 2019- The University of Tokyo */
+
+/* This program is free software: you can redistribute it and/or modify /
+/ it under the terms of the GNU General Public License as published by /
+/ the Free Software Foundation, either version 3 of the License, or /
+/ (at your option) any later version. */
+
+/* This program is distributed in the hope that it will be useful, /
+/ but WITHOUT ANY WARRANTY; without even the implied warranty of /
+/ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the /
+/ GNU General Public License for more details. */
+
+/* You should have received a copy of the GNU General Public License /
+/ along with this program. If not, see http://www.gnu.org/licenses/. */
+
+#ifndef UTIL_BINARY_ARRAY_HPP
+#define UTIL_BINARY_ARRAY_HPP
+
+#include <complex>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace tenes {
+namespace util {
+
+/*! @brief read-only view of a dense array stored in a binary file
+ *
+ *  The file is mapped into memory (mmap) and the elements are read directly
+ *  from the mapped pages, so that no intermediate copy of the whole array is
+ *  made.
+ *  Supported formats are NumPy ``.npy`` (version 1.0, 2.0, and 3.0),
+ *  raw little-endian arrays without header, and compact tensor files
+ *  (see compact_header).
+ *  Supported element types are float16, float32, float64, and complex
+ *  numbers of them.
+ */
+class BinaryArray {
+ public:
+  enum class dtype { float16, float32, float64, complex32, complex64, complex128 };
+
+  BinaryArray() = default;
+
+  /*! @brief open a NumPy .npy file
+   *
+   *  @param[in] filename
+   */
+  static BinaryArray open_npy(std::string const &filename);
+
+  /*! @brief open a raw array
+   *
+   *  @param[in] filename
+   *  @param[in] type     element type
+   *  @param[in] shape    shape of the array (C order)
+   */
+  static BinaryArray open_raw(std::string const &filename, dtype type,
+                              std::vector<size_t> const &shape);
+
+  /*! @brief open a compact tensor file
+   *
+   *  @param[in] filename
+   */
+  static BinaryArray open_compact(std::string const &filename);
+
+  /*! @brief parse dtype name (e.g., "float64" or "complex128") */
+  static dtype parse_dtype(std::string const &name);
+
+  /*! @brief size of an element in bytes */
+  static size_t element_size(dtype type);
+
+  std::vector<size_t> const &shape() const { return shape_; }
+  size_t size() const { return size_; }
+  bool is_complex() const {
+    return type_ == dtype::complex32 || type_ == dtype::complex64 ||
+           type_ == dtype::complex128;
+  }
+  dtype type() const { return type_; }
+  bool fortran_order() const { return fortran_order_; }
+  std::string const &filename() const { return filename_; }
+
+  /*! @brief strides (in elements) of each index */
+  std::vector<size_t> strides() const;
+
+  /*! @brief element at the given offset (in elements) */
+  std::complex<double> at(size_t offset) const;
+
+ private:
+  class Mapping;
+
+  std::string filename_;
+  std::shared_ptr<Mapping> mapping_;
+  const char *data_ = nullptr;
+  dtype type_ = dtype::float64;
+  bool fortran_order_ = false;
+  bool swap_ = false;
+  double scale_ = 1.0;
+  std::vector<size_t> shape_;
+  size_t size_ = 0;
+};
+
+/*! @brief header line of a compact tensor file
+ *
+ *  A compact tensor file is a dense array in C order (the last index runs
+ *  fastest) following a one-line text header:
+ *
+ *  ``tenes-compact-tensor 1 <precision> <real|complex> <little|big> <rank>
+ *  <dim_0> ... <dim_{rank-1}> <scale>``
+ *
+ *  where precision is double, single, or half.
+ *  Each element is stored as value/scale in the given precision,
+ *  and complex elements as pairs of real and imaginary parts.
+ *
+ *  @param[in] precision "double", "single", or "half"
+ *  @param[in] is_complex
+ *  @param[in] shape
+ *  @param[in] scale
+ */
+std::string compact_header(std::string const &precision, bool is_complex,
+                           std::vector<size_t> const &shape, double scale);
+
+}  // end of namespace util
+}  // end of namespace tenes
+
+#endif  // UTIL_BINARY_ARRAY_HPP
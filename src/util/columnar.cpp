@@ -0,0 +1,102 @@
+/* TeNeS - Massively parallel tensor network solver /
+/ Copyright (C) 2019- The University of Tokyo */
+
+/* This program is free software: you can redistribute it and/or modify /
+/ it under the terms of the GNU General Public License as published by /
+/ the Free Software Foundation, either version 3 of the License, or /
+/ (at your option) any later version. */
+
+/* This program is distributed in the hope that it will be useful, /
+/ but WITHOUT ANY WARRANTY; without even the implied warranty of /
+/ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the /
+/ GNU General Public License for more details. */
+
+/* You should have received a copy of the GNU General Public License /
+/ along with this program. If not, see http://www.gnu.org/licenses/. */
+
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+#include "../exception.hpp"
+
+#include "columnar.hpp"
+
+namespace tenes {
+namespace util {
+
+size_t ColumnarTable::add_int_column(std::string const &name) {
+  columns_.push_back(Column{name, true, {}, {}});
+  return columns_.size() - 1;
+}
+
+size_t ColumnarTable::add_real_column(std::string const &name) {
+  columns_.push_back(Column{name, false, {}, {}});
+  return columns_.size() - 1;
+}
+
+void ColumnarTable::push(size_t icol, int value) {
+  columns_[icol].ints.push_back(static_cast<int32_t>(value));
+}
+
+void ColumnarTable::push(size_t icol, double value) {
+  columns_[icol].reals.push_back(value);
+}
+
+size_t ColumnarTable::num_rows() const {
+  if (columns_.empty()) {
+    return 0;
+  }
+  auto const &c = columns_[0];
+  return c.is_int ? c.ints.size() : c.reals.size();
+}
+
+void ColumnarTable::save(std::string const &filename) const {
+  const size_t nrows = num_rows();
+  for (auto const &c : columns_) {
+    if ((c.is_int ? c.ints.size() : c.reals.size()) != nrows) {
+      throw tenes::logic_error("ColumnarTable: columns have different lengths");
+    }
+  }
+
+  const uint16_t one = 1;
+  char first_byte;
+  std::memcpy(&first_byte, &one, 1);
+  const char endian = (first_byte == 1) ? '<' : '>';
+
+  std::stringstream header;
+  header << "{\"format\": \"tenes-columnar\", \"version\": 1, \"name\": \""
+         << name_ << "\", \"nrows\": " << nrows << ", \"columns\": [";
+  for (size_t i = 0; i < columns_.size(); ++i) {
+    header << (i == 0 ? "" : ", ") << "{\"name\": \"" << columns_[i].name
+           << "\", \"dtype\": \"" << endian
+           << (columns_[i].is_int ? "i4" : "f8") << "\"}";
+  }
+  header << "]}\n";
+
+  std::string buffer = header.str();
+  size_t offset = buffer.size();
+  size_t nbytes = 0;
+  for (auto const &c : columns_) {
+    nbytes += nrows * (c.is_int ? sizeof(int32_t) : sizeof(double));
+  }
+  buffer.resize(offset + nbytes);
+  for (auto const &c : columns_) {
+    const size_t n = nrows * (c.is_int ? sizeof(int32_t) : sizeof(double));
+    if (n > 0) {
+      const void *src = c.is_int ? static_cast<const void *>(c.ints.data())
+                                 : static_cast<const void *>(c.reals.data());
+      std::memcpy(&buffer[offset], src, n);
+    }
+    offset += n;
+  }
+
+  std::ofstream ofs(filename.c_str(), std::ios::binary);
+  ofs.write(buffer.data(), buffer.size());
+  if (!ofs) {
+    throw tenes::runtime_error("cannot write " + filename);
+  }
+}
+
+}  // end of namespace util
+}  // end of namespace tenes
@@ -0,0 +1,75 @@
+/* TeNeS - Massively parallel tensor network solver /
+/ Copyright (C) 2019- The University of Tokyo */
+
+/* This program is free software: you can redistribute it and/or modify /
+/ it under the terms of the GNU General Public License as published by /
+/ the Free Software Foundation, either version 3 of the License, or /
+/ (at your option) any later version. */
+
+/* This program is distributed in the hope that it will be useful, /
+/ but WITHOUT ANY WARRANTY; without even the implied warranty of /
+/ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the /
+/ GNU General Public License for more details. */
+
+/* You should have received a copy of the GNU General Public License /
+/ along with this program. If not, see http://www.gnu.org/licenses/. */
+
+#ifndef UTIL_COLUMNAR_HPP
+#define UTIL_COLUMNAR_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace tenes {
+namespace util {
+
+/*! @brief table of fixed-type columns saved as a binary file
+ *
+ *  File format:
+ *
+ *  - The first line is a JSON header terminated by '\n', e.g.,
+ *    ``{"format": "tenes-columnar", "version": 1, "name": "onesite_obs",
+ *    "nrows": 4, "columns": [{"name": "op_group", "dtype": "<i4"}, ...]}``
+ *  - Then the columns follow one by one.
+ *    Each column is a contiguous array of ``nrows`` elements
+ *    whose type is given by ``dtype`` (numpy's notation).
+ */
+class ColumnarTable {
+ public:
+  explicit ColumnarTable(std::string const &name) : name_(name) {}
+
+  /*! @brief add a column of int32 and returns its index */
+  size_t add_int_column(std::string const &name);
+
+  /*! @brief add a column of float64 and returns its index */
+  size_t add_real_column(std::string const &name);
+
+  void push(size_t icol, int value);
+  void push(size_t icol, double value);
+
+  std::string const &name() const { return name_; }
+  size_t num_columns() const { return columns_.size(); }
+  size_t num_rows() const;
+
+  /*! @brief save the table by one write
+   *
+   *  @pre all the columns have the same length
+   */
+  void save(std::string const &filename) const;
+
+ private:
+  struct Column {
+    std::string name;
+    bool is_int;
+    std::vector<int32_t> ints;
+    std::vector<double> reals;
+  };
+  std::string name_;
+  std::vector<Column> columns_;
+};
+
+}  // end of namespace util
+}  // end of namespace tenes
+
+#endif  // UTIL_COLUMNAR_HPP
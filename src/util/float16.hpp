@@ -0,0 +1,98 @@
+/* TeNeS - Massively parallel tensor network solver /
+/ Copyright (C) 2019- The University of Tokyo */
+
+/* This program is free software: you can redistribute it and/or modify /
+/ it under the terms of the GNU General Public License as published by /
+/ the Free Software Foundation, either version 3 of the License, or /
+/ (at your option) any later version. */
+
+/* This program is distributed in the hope that it will be useful, /
+/ but WITHOUT ANY WARRANTY; without even the implied warranty of /
+/ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the /
+/ GNU General Public License for more details. */
+
+/* You should have received a copy of the GNU General Public License /
+/ along with this program. If not, see http://www.gnu.org/licenses/. */
+
+#ifndef UTIL_FLOAT16_HPP
+#define UTIL_FLOAT16_HPP
+
+#include <cstdint>
+#include <cstring>
+
+namespace tenes {
+namespace util {
+
+/*! @brief convert float into IEEE 754 binary16 (round to nearest even) */
+inline uint16_t float_to_half(float value) {
+  uint32_t x;
+  std::memcpy(&x, &value, sizeof(x));
+  const uint16_t sign = static_cast<uint16_t>((x >> 16) & 0x8000u);
+  const uint32_t absx = x & 0x7fffffffu;
+
+  if (absx >= 0x7f800000u) {
+    // inf or nan
+    return sign | 0x7c00u | (absx > 0x7f800000u ? 0x0200u : 0u);
+  }
+  if (absx >= 0x477ff000u) {
+    // overflow (>= 65520 after rounding)
+    return sign | 0x7c00u;
+  }
+  if (absx < 0x38800000u) {
+    // subnormal or zero in binary16
+    if (absx < 0x33000000u) {
+      return sign;
+    }
+    const uint32_t exponent = absx >> 23;
+    const uint32_t mantissa = (absx & 0x7fffffu) | 0x800000u;
+    const uint32_t shift = 126 - exponent;  // 14 <= shift <= 24
+    uint32_t h = mantissa >> shift;
+    const uint32_t rem = mantissa & ((1u << shift) - 1);
+    const uint32_t half = 1u << (shift - 1);
+    if (rem > half || (rem == half && (h & 1u))) {
+      ++h;
+    }
+    return sign | static_cast<uint16_t>(h);
+  }
+  // normal
+  uint32_t h = ((absx >> 13) - (112u << 10));
+  const uint32_t rem = absx & 0x1fffu;
+  if (rem > 0x1000u || (rem == 0x1000u && (h & 1u))) {
+    ++h;
+  }
+  return sign | static_cast<uint16_t>(h);
+}
+
+/*! @brief convert IEEE 754 binary16 into float */
+inline float half_to_float(uint16_t h) {
+  const uint32_t sign = static_cast<uint32_t>(h & 0x8000u) << 16;
+  uint32_t exponent = (h >> 10) & 0x1fu;
+  uint32_t mantissa = h & 0x3ffu;
+  uint32_t x;
+  if (exponent == 0x1fu) {
+    x = sign | 0x7f800000u | (mantissa << 13);
+  } else if (exponent == 0) {
+    if (mantissa == 0) {
+      x = sign;
+    } else {
+      // subnormal
+      exponent = 113;
+      while ((mantissa & 0x400u) == 0) {
+        mantissa <<= 1;
+        --exponent;
+      }
+      mantissa &= 0x3ffu;
+      x = sign | (exponent << 23) | (mantissa << 13);
+    }
+  } else {
+    x = sign | ((exponent + 112) << 23) | (mantissa << 13);
+  }
+  float value;
+  std::memcpy(&value, &x, sizeof(value));
+  return value;
+}
+
+}  // end of namespace util
+}  // end of namespace tenes
+
+#endif  // UTIL_FLOAT16_HPP
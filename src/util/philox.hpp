@@ -0,0 +1,91 @@
+/* TeNeS - Massively parallel tensor network solver /
+/ Copyright (C) 2019- The University of Tokyo */
+
+/* This program is free software: you can redistribute it and/or modify /
+/ it under the terms of the GNU General Public License as published by /
+/ the Free Software Foundation, either version 3 of the License, or /
+/ (at your option) any later version. */
+
+/* This program is distributed in the hope that it will be useful, /
+/ but WITHOUT ANY WARRANTY; without even the implied warranty of /
+/ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the /
+/ GNU General Public License for more details. */
+
+/* You should have received a copy of the GNU General Public License /
+/ along with this program. If not, see http://www.gnu.org/licenses/. */
+
+#ifndef UTIL_PHILOX_HPP
+#define UTIL_PHILOX_HPP
+
+#include <array>
+#include <cstdint>
+
+namespace tenes {
+namespace util {
+
+/*! @brief counter-based random number generator Philox4x32-10
+ *
+ *  J. K. Salmon, M. A. Moraes, R. O. Dror, and D. E. Shaw,
+ *  "Parallel random numbers: as easy as 1, 2, 3", SC11 (2011).
+ *
+ *  A random number is a function of the key and the counter,
+ *  so any element can be generated independently of the others
+ *  (and of the number of processes and threads).
+ */
+class Philox4x32 {
+ public:
+  using counter_type = std::array<uint32_t, 4>;
+  using key_type = std::array<uint32_t, 2>;
+
+  explicit Philox4x32(key_type const &key) : key_(key) {}
+  explicit Philox4x32(uint64_t seed)
+      : key_{{static_cast<uint32_t>(seed), static_cast<uint32_t>(seed >> 32)}} {}
+
+  counter_type operator()(counter_type ctr) const {
+    key_type key = key_;
+    for (int r = 0; r < 10; ++r) {
+      if (r > 0) {
+        key[0] += 0x9E3779B9u;
+        key[1] += 0xBB67AE85u;
+      }
+      const uint64_t p0 = static_cast<uint64_t>(0xD2511F53u) * ctr[0];
+      const uint64_t p1 = static_cast<uint64_t>(0xCD9E8D57u) * ctr[2];
+      ctr = counter_type{{static_cast<uint32_t>(p1 >> 32) ^ ctr[1] ^ key[0],
+                          static_cast<uint32_t>(p1),
+                          static_cast<uint32_t>(p0 >> 32) ^ ctr[3] ^ key[1],
+                          static_cast<uint32_t>(p0)}};
+    }
+    return ctr;
+  }
+
+  /*! @brief two uniform random numbers in [-1, 1)
+   *
+   *  @param[in]  stream  kind of the random numbers
+   *  @param[in]  id      e.g., site index
+   *  @param[in]  n       e.g., element index
+   *  @param[out] x
+   *  @param[out] y
+   */
+  void uniform(uint32_t stream, uint32_t id, uint64_t n, double &x,
+               double &y) const {
+    const counter_type r = (*this)(counter_type{
+        {static_cast<uint32_t>(n), static_cast<uint32_t>(n >> 32), id, stream}});
+    x = 2.0 * to_unit(r[0], r[1]) - 1.0;
+    y = 2.0 * to_unit(r[2], r[3]) - 1.0;
+  }
+
+ private:
+  // 53 bits from (hi, lo) into [0, 1)
+  static double to_unit(uint32_t hi, uint32_t lo) {
+    const uint64_t bits =
+        ((static_cast<uint64_t>(hi) << 32) | lo) >> 11;
+    return bits * (1.0 / 9007199254740992.0);
+  }
+
+  key_type key_;
+};
+
+}  // end of namespace util
+}  // end of namespace tenes
+
+#endif  // UTIL_PHILOX_HPP
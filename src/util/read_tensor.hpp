@@ -23,20 +23,37 @@
 #include <string>
 #include <vector>
 
+#include "binary_array.hpp"
 #include "string.hpp"
 #include "type_traits.hpp"
 #include "../exception.hpp"
+#include "../tensor.hpp"
 
 namespace tenes {
 
 namespace util {
 
+/*! @brief read tensor from a string
+ *
+ *  Each line of `str` has indices and real and imaginary parts of an element.
+ *
+ *  @param[in] str
+ *  @param[in] dims     shape of tensor
+ *  @param[in] comm     communicator over which the tensor is distributed
+ *  @param[in] atol     elements whose absolute value is less than atol are
+ *                      regarded as zero
+ *  @param[in,out] max_imag  if not null, updated to the maximum absolute value
+ *                           of the imaginary parts (even when ptensor is real)
+ */
 template <class ptensor>
 ptensor read_tensor(std::string const &str, mptensor::Shape dims,
-                    double atol = 0.0) {
+                    typename ptensor::comm_type const &comm,
+                    double atol = 0.0, double *max_imag = nullptr) {
   using value_type = typename ptensor::value_type;
-  ptensor ret(dims);
+  ptensor ret(comm, dims);
   const size_t rank = ret.rank();
+  const auto strides = detail::c_order_strides(dims);
+  std::vector<value_type> dense(rank == 0 ? 1 : strides[0] * dims[0]);
 
   const static std::string delim = " \t";
   std::string line;
@@ -75,16 +92,121 @@ ptensor read_tensor(std::string const &str, mptensor::Shape dims,
     }
 
     for (size_t i = 0; i < rank; ++i) {
-      index[i] = std::stoi(fields[i]);
+      const int k = std::stoi(fields[i]);
+      if (k < 0 || k >= static_cast<int>(dims[i])) {
+        std::stringstream msg;
+        msg << "cannot parse tensor; index " << k << " is out of range in line "
+            << linenum << ": " << line;
+        throw tenes::input_error(msg.str());
+      }
+      index[i] = k;
     }
     double re = std::stod(fields[rank]);
     re = (std::abs(re) >= atol) ? re : 0.0;
     double im = std::stod(fields[rank + 1]);
     im = (std::abs(im) >= atol) ? im : 0.0;
-    ret.set_value(index,
-                  convert_complex<value_type>(std::complex<double>(re, im)));
+    if (max_imag != nullptr) {
+      *max_imag = std::max(*max_imag, std::abs(im));
+    }
+    dense[detail::c_order_offset(index, strides)] =
+        convert_complex<value_type>(std::complex<double>(re, im));
     ++linenum;
   }
+  fill_local(ret, dense);
+  return ret;
+}
+
+/*! @brief open a binary file (npy or raw) of a tensor and check its shape
+ *
+ *  Only the header is read; the elements stay in the mapped file.
+ *
+ *  @param[in] filename
+ *  @param[in] format   "npy" or "raw"
+ *  @param[in] dtype    element type of raw file ("float64" or "complex128");
+ *                      ignored for npy
+ *  @param[in] dims     shape of tensor
+ */
+inline BinaryArray open_tensor_file(std::string const &filename,
+                                    std::string const &format,
+                                    std::string const &dtype,
+                                    mptensor::Shape const &dims) {
+  const size_t rank = dims.size();
+  std::vector<size_t> shape(rank);
+  for (size_t i = 0; i < rank; ++i) {
+    shape[i] = dims[i];
+  }
+
+  BinaryArray arr;
+  if (format == "npy") {
+    arr = BinaryArray::open_npy(filename);
+  } else if (format == "raw") {
+    arr = BinaryArray::open_raw(filename, BinaryArray::parse_dtype(dtype),
+                                shape);
+  } else {
+    throw tenes::input_error(std::string("unknown file format: ") + format +
+                             " (npy or raw is supported)");
+  }
+  if (arr.shape() != shape) {
+    std::stringstream msg;
+    msg << "shape of the array in " << filename << " is [";
+    for (size_t i = 0; i < arr.shape().size(); ++i) {
+      msg << (i == 0 ? "" : ", ") << arr.shape()[i];
+    }
+    msg << "] but [";
+    for (size_t i = 0; i < rank; ++i) {
+      msg << (i == 0 ? "" : ", ") << shape[i];
+    }
+    msg << "] is expected";
+    throw tenes::input_error(msg.str());
+  }
+  return arr;
+}
+
+/*! @brief read tensor from a binary file (npy or raw)
+ *
+ *  Each process reads only the elements of its own local block
+ *  directly from the memory-mapped file.
+ *
+ *  @param[in] filename
+ *  @param[in] format   "npy" or "raw"
+ *  @param[in] dtype    element type of raw file ("float64" or "complex128");
+ *                      ignored for npy
+ *  @param[in] dims     shape of tensor
+ *  @param[in] comm     communicator over which the tensor is distributed
+ *  @param[in] atol     elements whose absolute value is less than atol are
+ *                      regarded as zero
+ *  @param[in,out] max_imag  if not null, updated to the maximum absolute value
+ *                           of the imaginary parts in the local block
+ */
+template <class ptensor>
+ptensor read_tensor_file(std::string const &filename,
+                         std::string const &format, std::string const &dtype,
+                         mptensor::Shape dims,
+                         typename ptensor::comm_type const &comm,
+                         double atol = 0.0, double *max_imag = nullptr) {
+  using value_type = typename ptensor::value_type;
+  ptensor ret(comm, dims);
+  const size_t rank = ret.rank();
+  const BinaryArray arr = open_tensor_file(filename, format, dtype, dims);
+
+  const auto strides = arr.strides();
+  const size_t n = ret.local_size();
+  for (size_t lindex = 0; lindex < n; ++lindex) {
+    const mptensor::Index index = ret.global_index(lindex);
+    size_t offset = 0;
+    for (size_t i = 0; i < rank; ++i) {
+      offset += index[i] * strides[i];
+    }
+    std::complex<double> v = arr.at(offset);
+    double re = std::real(v);
+    re = (std::abs(re) >= atol) ? re : 0.0;
+    double im = std::imag(v);
+    im = (std::abs(im) >= atol) ? im : 0.0;
+    if (max_imag != nullptr) {
+      *max_imag = std::max(*max_imag, std::abs(im));
+    }
+    ret[lindex] = convert_complex<value_type>(std::complex<double>(re, im));
+  }
   return ret;
 }
 
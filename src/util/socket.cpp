@@ -0,0 +1,172 @@
+/* TeNeS - Massively parallel tensor network solver /
+/ Copyright (C) 2019- The University of Tokyo */
+
+/* This program is free software: you can redistribute it and/or modify /
+/ it under the terms of the GNU General Public License as published by /
+/ the Free Software Foundation, either version 3 of the License, or /
+/ (at your option) any later version. */
+
+/* This program is distributed in the hope that it will be useful, /
+/ but WITHOUT ANY WARRANTY; without even the implied warranty of /
+/ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the /
+/ GNU General Public License for more details. */
+
+/* You should have received a copy of the GNU General Public License /
+/ along with this program. If not, see http://www.gnu.org/licenses/. */
+
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <sstream>
+#include <string>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "../exception.hpp"
+
+#include "socket.hpp"
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+namespace tenes {
+namespace util {
+
+namespace {
+std::string error_message(std::string const &what, std::string const &path) {
+  std::stringstream ss;
+  ss << what << " " << path << ": " << std::strerror(errno);
+  return ss.str();
+}
+} // end of unnamed namespace
+
+Connection::~Connection() { close(); }
+
+Connection &Connection::operator=(Connection &&other) {
+  if (this != &other) {
+    close();
+    fd_ = other.fd_;
+    other.fd_ = -1;
+  }
+  return *this;
+}
+
+std::string Connection::receive_all(double timeout) {
+  using clock = std::chrono::steady_clock;
+  const auto deadline =
+      clock::now() + std::chrono::duration_cast<clock::duration>(
+                         std::chrono::duration<double>(timeout));
+  std::string ret;
+  char buffer[4096];
+  while (is_open()) {
+    if (timeout > 0.0) {
+      const auto rest = std::chrono::duration_cast<std::chrono::milliseconds>(
+          deadline - clock::now());
+      pollfd pfd;
+      pfd.fd = fd_;
+      pfd.events = POLLIN;
+      pfd.revents = 0;
+      const int r =
+          rest.count() > 0 ? ::poll(&pfd, 1, static_cast<int>(rest.count()))
+                           : 0;
+      if (r < 0 && errno == EINTR) {
+        continue;
+      }
+      if (r < 0) {
+        throw tenes::runtime_error(error_message("Cannot wait for", "request"));
+      }
+      if (r == 0) {
+        std::stringstream ss;
+        ss << "request is not completed in " << timeout << " seconds";
+        throw tenes::runtime_error(ss.str());
+      }
+    }
+    const ssize_t n = ::read(fd_, buffer, sizeof(buffer));
+    if (n > 0) {
+      ret.append(buffer, n);
+    } else if (n < 0 && errno == EINTR) {
+      continue;
+    } else if (n < 0) {
+      throw tenes::runtime_error(error_message("Cannot read", "request"));
+    } else {
+      break;
+    }
+  }
+  return ret;
+}
+
+bool Connection::send(std::string const &data) {
+  size_t offset = 0;
+  while (is_open() && offset < data.size()) {
+    const ssize_t n =
+        ::send(fd_, data.data() + offset, data.size() - offset, MSG_NOSIGNAL);
+    if (n >= 0) {
+      offset += n;
+    } else if (errno != EINTR) {
+      close();
+    }
+  }
+  return is_open();
+}
+
+void Connection::close() {
+  if (fd_ >= 0) {
+    ::close(fd_);
+    fd_ = -1;
+  }
+}
+
+UnixServer::UnixServer(std::string const &path) : path_(path), fd_(-1) {
+  sockaddr_un addr;
+  std::memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (path.size() >= sizeof(addr.sun_path)) {
+    throw tenes::runtime_error("socket path is too long: " + path);
+  }
+  std::strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+
+  // a socket left by a previous server
+  struct stat status;
+  if (lstat(path.c_str(), &status) == 0) {
+    if (!S_ISSOCK(status.st_mode)) {
+      throw tenes::runtime_error("not a socket: " + path);
+    }
+    ::unlink(path.c_str());
+  }
+
+  fd_ = ::socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd_ < 0) {
+    throw tenes::runtime_error(error_message("Cannot create socket", path));
+  }
+  if (::bind(fd_, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0 ||
+      ::listen(fd_, 8) != 0) {
+    const std::string msg = error_message("Cannot listen", path);
+    ::close(fd_);
+    throw tenes::runtime_error(msg);
+  }
+}
+
+UnixServer::~UnixServer() {
+  ::close(fd_);
+  ::unlink(path_.c_str());
+}
+
+Connection UnixServer::accept() {
+  while (true) {
+    const int fd = ::accept(fd_, nullptr, nullptr);
+    if (fd >= 0) {
+      return Connection(fd);
+    }
+    if (errno != EINTR && errno != ECONNABORTED) {
+      throw tenes::runtime_error(error_message("Cannot accept", path_));
+    }
+  }
+}
+
+} // end of namespace util
+} // end of namespace tenes
@@ -0,0 +1,85 @@
+/* TeNeS - Massively parallel tensor network solver /
+/ Copyright (C) 2019- The University of Tokyo */
+
+/* This program is free software: you can redistribute it and/or modify /
+/ it under the terms of the GNU General Public License as published by /
+/ the Free Software Foundation, either version 3 of the License, or /
+/ (at your option) any later version. */
+
+/* This program is distributed in the hope that it will be useful, /
+/ but WITHOUT ANY WARRANTY; without even the implied warranty of /
+/ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the /
+/ GNU General Public License for more details. */
+
+/* You should have received a copy of the GNU General Public License /
+/ along with this program. If not, see http://www.gnu.org/licenses/. */
+
+#ifndef UTIL_SOCKET_HPP
+#define UTIL_SOCKET_HPP
+
+#include <string>
+
+namespace tenes {
+namespace util {
+
+/*! @brief connection accepted by UnixServer */
+class Connection {
+public:
+  explicit Connection(int fd = -1) : fd_(fd) {}
+  ~Connection();
+  Connection(Connection &&other) : fd_(other.fd_) { other.fd_ = -1; }
+  Connection &operator=(Connection &&other);
+  Connection(Connection const &) = delete;
+  Connection &operator=(Connection const &) = delete;
+
+  bool is_open() const { return fd_ >= 0; }
+
+  /*! @brief read until the peer shuts down its writing side
+   *
+   *  Throws tenes::runtime_error if the peer does not finish in `timeout`
+   *  seconds (no limit if `timeout` is not positive) or reading fails.
+   */
+  std::string receive_all(double timeout = 0.0);
+
+  /*! @brief write `data`
+   *
+   *  Returns false and closes the connection if the peer has gone.
+   */
+  bool send(std::string const &data);
+
+  void close();
+
+private:
+  int fd_;
+};
+
+/*! @brief listening socket in the UNIX domain
+ *
+ *  The socket file is removed on destruction.
+ */
+class UnixServer {
+public:
+  /*! @brief bind and listen `path`
+   *
+   *  A stale socket file at `path` is replaced.
+   *  Throws tenes::runtime_error on failure.
+   */
+  explicit UnixServer(std::string const &path);
+  ~UnixServer();
+  UnixServer(UnixServer const &) = delete;
+  UnixServer &operator=(UnixServer const &) = delete;
+
+  /*! @brief wait for a client */
+  Connection accept();
+
+  std::string const &path() const { return path_; }
+
+private:
+  std::string path_;
+  int fd_;
+};
+
+} // end of namespace util
+} // end of namespace tenes
+
+#endif // UTIL_SOCKET_HPP
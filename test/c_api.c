@@ -0,0 +1,241 @@
+/* TeNeS - Massively parallel tensor network solver /
+/ Copyright (C) 2019- The University of Tokyo */
+
+/* This program is free software: you can redistribute it and/or modify /
+/ it under the terms of the GNU General Public License as published by /
+/ the Free Software Foundation, either version 3 of the License, or /
+/ (at your option) any later version. */
+
+/* This program is distributed in the hope that it will be useful, /
+/ but WITHOUT ANY WARRANTY; without even the implied warranty of /
+/ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the /
+/ GNU General Public License for more details. */
+
+/* You should have received a copy of the GNU General Public License /
+/ along with this program. If not, see http://www.gnu.org/licenses/. */
+
+/* test of the C interface, written in C on purpose */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _NO_MPI
+#include <mpi.h>
+#endif
+
+#include <tenes_c.h>
+
+static int num_failures = 0;
+
+#define CHECK(cond)                                                          \
+  do {                                                                       \
+    if (!(cond)) {                                                           \
+      fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__,       \
+              #cond);                                                        \
+      ++num_failures;                                                        \
+    }                                                                        \
+  } while (0)
+
+#define CHECK_OK(expr)                                                       \
+  do {                                                                       \
+    int err_ = (expr);                                                       \
+    if (err_ != TENES_OK) {                                                  \
+      fprintf(stderr, "%s:%d: %s returned %d: %s\n", __FILE__, __LINE__,     \
+              #expr, err_, tenes_last_error());                              \
+      ++num_failures;                                                        \
+    }                                                                        \
+  } while (0)
+
+/* reads a tensor and returns the largest absolute value of the elements
+   (-1 on failure) */
+static double max_abs_tensor(tenes_session *session, int kind, int index,
+                             int site) {
+  int rank = 0;
+  int shape[TENES_MAX_RANK];
+  double *values = NULL;
+  double ret = 0.0;
+  size_t size = 1;
+  size_t i;
+  int k;
+  if (tenes_get_tensor_shape(session, kind, index, site, &rank, shape) !=
+      TENES_OK) {
+    return -1.0;
+  }
+  for (k = 0; k < rank; ++k) {
+    size *= shape[k];
+  }
+  values = (double *)malloc(size * sizeof(double));
+  for (i = 0; i < size; ++i) {
+    values[i] = NAN;
+  }
+  if (tenes_get_tensor(session, kind, index, site, values, size) != TENES_OK) {
+    free(values);
+    return -1.0;
+  }
+  for (i = 0; i < size; ++i) {
+    /* every element is written */
+    if (isnan(values[i])) {
+      ret = -1.0;
+      break;
+    }
+    if (fabs(values[i]) > ret) {
+      ret = fabs(values[i]);
+    }
+  }
+  free(values);
+  return ret;
+}
+
+int main(int argc, char **argv) {
+  tenes_session *session = NULL;
+  int is_complex = -1;
+  int num_sites = 0;
+  int num_densities = 0;
+  int rank = 0;
+  int shape[TENES_MAX_RANK];
+  double densities[2 * 16];
+  double *values = NULL;
+  double *values2 = NULL;
+  size_t size = 1;
+  size_t k;
+  const char *name = NULL;
+  int fcomm = 0;
+  int i;
+
+#ifndef _NO_MPI
+  MPI_Init(&argc, &argv);
+#else
+  (void)argc;
+  (void)argv;
+#endif
+
+  /* missing input */
+  CHECK(tenes_session_create("data/not_found.toml", 1, &session) ==
+        TENES_ERROR_INPUT);
+  CHECK(session == NULL);
+  CHECK(strlen(tenes_last_error()) > 0);
+
+  /* the same steps as the tenes command with
+     data/AntiferroHeisenberg_real.toml, on a communicator split from
+     MPI_COMM_WORLD */
+#ifndef _NO_MPI
+  {
+    MPI_Comm comm;
+    MPI_Comm_rank(MPI_COMM_WORLD, &i);
+    MPI_Comm_split(MPI_COMM_WORLD, i, 0, &comm);
+    fcomm = MPI_Comm_c2f(comm);
+  }
+#endif
+  CHECK_OK(tenes_session_create_output("data/AntiferroHeisenberg_real.toml",
+                                       "output_c_api", fcomm, 1, &session));
+  CHECK(strlen(tenes_last_error()) == 0);
+  CHECK_OK(tenes_is_complex(session, &is_complex));
+  CHECK(is_complex == 0);
+  CHECK_OK(tenes_get_num_sites(session, &num_sites));
+  CHECK(num_sites == 4);
+  CHECK_OK(tenes_run_simple(session, 100));
+  CHECK_OK(tenes_run_full(session, 1));
+  CHECK_OK(tenes_measure(session, &num_densities));
+  CHECK(0 < num_densities && num_densities <= 16);
+
+  /* data/output_AntiferroHeisenberg_real/density.dat */
+  CHECK_OK(tenes_get_density(session, densities,
+                              sizeof densities / sizeof(double)));
+  for (i = 0; i < num_densities; ++i) {
+    CHECK_OK(tenes_get_density_name(session, i, &name));
+    if (strcmp(name, "hamiltonian") == 0) {
+      const double ref = -5.43684776153081639e-01;
+      CHECK(fabs(densities[2 * i] - ref) <= 1e-4 + 1e-3 * fabs(ref));
+      CHECK(densities[2 * i + 1] == 0.0);
+    }
+  }
+  CHECK(tenes_get_density(session, densities, 0) == TENES_ERROR_ARGUMENT);
+  /* capacity counts doubles, not (real, imag) pairs */
+  CHECK(tenes_get_density(session, densities, num_densities) ==
+        TENES_ERROR_ARGUMENT);
+  CHECK(tenes_get_density_name(session, num_densities, &name) ==
+        TENES_ERROR_ARGUMENT);
+
+  /* site tensor: (left, top, right, bottom, physical) */
+  CHECK_OK(tenes_get_tensor_shape(session, TENES_TENSOR_SITE, 0, 0, &rank,
+                                  shape));
+  CHECK(rank == 5);
+  for (i = 0; i < rank; ++i) {
+    CHECK(shape[i] == 2);
+    size *= shape[i];
+  }
+  values = (double *)malloc(size * sizeof(double));
+  values2 = (double *)malloc(size * sizeof(double));
+  for (k = 0; k < size; ++k) {
+    values[k] = NAN;
+    values2[k] = NAN;
+  }
+  CHECK(tenes_get_tensor(session, TENES_TENSOR_SITE, 0, 0, values,
+                         size - 1) == TENES_ERROR_ARGUMENT);
+  CHECK_OK(tenes_get_tensor(session, TENES_TENSOR_SITE, 0, 0, values, size));
+  CHECK_OK(tenes_get_tensor(session, TENES_TENSOR_SITE, 0, 0, values2, size));
+  {
+    /* every element is written, and the same elements are read twice */
+    double norm = 0.0;
+    for (k = 0; k < size; ++k) {
+      CHECK(!isnan(values[k]));
+      CHECK(values[k] == values2[k]);
+      norm += values[k] * values[k];
+    }
+    CHECK(norm > 0.0);
+  }
+  /* another site tensor (from another random initial tensor) differs */
+  CHECK_OK(tenes_get_tensor(session, TENES_TENSOR_SITE, 0, 1, values2, size));
+  {
+    int same = 1;
+    for (k = 0; k < size; ++k) {
+      same = same && values[k] == values2[k];
+    }
+    CHECK(!same);
+  }
+  free(values);
+  free(values2);
+
+  /* corner tensor: CHI x CHI */
+  CHECK_OK(tenes_get_tensor_shape(session, TENES_TENSOR_CORNER, 3, 1, &rank,
+                                  shape));
+  CHECK(rank == 2);
+  CHECK(shape[0] == 5 && shape[1] == 5);
+
+  /* the CTM normalizes the corner and edge tensors by the largest
+     absolute value of the elements */
+  for (i = 0; i < 4; ++i) {
+    CHECK(fabs(max_abs_tensor(session, TENES_TENSOR_CORNER, i, 1) - 1.0) <=
+          1e-12);
+    CHECK(fabs(max_abs_tensor(session, TENES_TENSOR_EDGE, i, 1) - 1.0) <=
+          1e-12);
+  }
+
+  /* edge tensor: CHI x CHI x D x D */
+  CHECK_OK(tenes_get_tensor_shape(session, TENES_TENSOR_EDGE, 1, 1, &rank,
+                                  shape));
+  CHECK(rank == 4);
+
+  CHECK(tenes_get_tensor_shape(session, TENES_TENSOR_CORNER, 4, 0, &rank,
+                               shape) == TENES_ERROR_ARGUMENT);
+  CHECK(tenes_get_tensor_shape(session, TENES_TENSOR_SITE, 0, num_sites,
+                               &rank, shape) == TENES_ERROR_ARGUMENT);
+
+  CHECK_OK(tenes_session_destroy(session));
+
+#ifndef _NO_MPI
+  {
+    MPI_Comm comm = MPI_Comm_f2c(fcomm);
+    MPI_Comm_free(&comm);
+  }
+  MPI_Finalize();
+#endif
+
+  if (num_failures > 0) {
+    fprintf(stderr, "%d check(s) failed\n", num_failures);
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,122 @@
+/* TeNeS - Massively parallel tensor network solver /
+/ Copyright (C) 2019- The University of Tokyo */
+
+/* This program is free software: you can redistribute it and/or modify /
+/ it under the terms of the GNU General Public License as published by /
+/ the Free Software Foundation, either version 3 of the License, or /
+/ (at your option) any later version. */
+
+/* This program is distributed in the hope that it will be useful, /
+/ but WITHOUT ANY WARRANTY; without even the implied warranty of /
+/ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the /
+/ GNU General Public License for more details. */
+
+/* You should have received a copy of the GNU General Public License /
+/ along with this program. If not, see http://www.gnu.org/licenses/. */
+
+
+#define DOCTEST_CONFIG_IMPLEMENT
+#include "doctest.h"
+
+#include <cmath>
+#include <complex>
+#include <initializer_list>
+#include <string>
+#include <vector>
+
+#include <util/binary_array.cpp>
+#include <compact_tensor.hpp>
+#include <mpi.cpp>
+
+int main(int argc, char **argv) {
+  MPI_Init(&argc, &argv);
+  doctest::Context context(argc, argv);
+  const int res = context.run();
+  MPI_Finalize();
+  return res;
+}
+
+TEST_CASE("float16") {
+  using tenes::util::float_to_half;
+  using tenes::util::half_to_float;
+
+  // exactly representable values
+  for (float x : {0.0f, 1.0f, -2.0f, 0.5f, 0.099975586f, 65504.0f,
+                  6.1035156e-05f, 5.9604645e-08f}) {
+    CHECK(half_to_float(float_to_half(x)) == x);
+  }
+  CHECK(float_to_half(1.0f) == 0x3c00u);
+  CHECK(float_to_half(-2.0f) == 0xc000u);
+  CHECK(std::isinf(half_to_float(float_to_half(65520.0f))));
+
+  // relative error of normal numbers is at most 2^-11
+  const double eps = std::ldexp(1.0, -11);
+  for (int n = -1000; n <= 1000; ++n) {
+    const float x = 0.001f * n + 0.000123f;
+    const double y = half_to_float(float_to_half(x));
+    CHECK(std::abs(y - x) <= eps * std::abs(x));
+  }
+}
+
+TEST_CASE("compact tensor") {
+  using namespace tenes;
+#ifdef _NO_MPI
+  using ptensor =
+      mptensor::Tensor<mptensor::lapack::Matrix, std::complex<double>>;
+#else
+  using ptensor =
+      mptensor::Tensor<mptensor::scalapack::Matrix, std::complex<double>>;
+#endif
+  using mptensor::Index;
+  using mptensor::Shape;
+
+  auto element = [](Index const &index) -> std::complex<double> {
+    const int n = index[0] * 20 + index[1] * 5 + index[2];
+    return std::complex<double>(std::sin(0.7 * n), 0.5 * std::cos(1.3 * n));
+  };
+  ptensor A(MPI_COMM_WORLD, Shape(3, 4, 5));
+  fill_local(A, element);
+  const double maxabs = 1.0;
+
+  struct Case {
+    StoragePrecision precision;
+    double tol;
+  };
+  // half precision stores the elements divided by their maximum
+  const std::vector<Case> cases = {
+      {StoragePrecision::double_precision, 0.0},
+      {StoragePrecision::single_precision, std::ldexp(maxabs, -24)},
+      {StoragePrecision::half_precision, std::ldexp(maxabs, -11)},
+  };
+
+  for (auto const &c : cases) {
+    const std::string name = storage_precision_name(c.precision);
+    CAPTURE(name);
+    const std::string filename = "compact_tensor_" + name + ".dat";
+    save_compact(A, filename, c.precision);
+
+    {
+      ptensor B = load_compact<ptensor>(filename, MPI_COMM_WORLD);
+      REQUIRE(B.shape()[0] == 3);
+      REQUIRE(B.shape()[1] == 4);
+      REQUIRE(B.shape()[2] == 5);
+      for (size_t i = 0; i < B.local_size(); ++i) {
+        const auto expected = element(B.global_index(i));
+        CHECK(std::abs(B[i].real() - expected.real()) <= c.tol);
+        CHECK(std::abs(B[i].imag() - expected.imag()) <= c.tol);
+      }
+    }
+
+    {
+      // the first leg is padded with zeros and the last one is truncated
+      ptensor B =
+          load_compact<ptensor>(filename, Shape(4, 4, 3), MPI_COMM_WORLD);
+      for (size_t i = 0; i < B.local_size(); ++i) {
+        const Index index = B.global_index(i);
+        const auto expected =
+            index[0] < 3 ? element(index) : std::complex<double>(0.0);
+        CHECK(std::abs(B[i] - expected) <= std::sqrt(2.0) * c.tol);
+      }
+    }
+  }
+}
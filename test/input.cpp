@@ -17,15 +17,22 @@
 #define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
 #include "doctest.h"
 
+#include <cstdio>
 #include <fstream>
 #include <sstream>
 #include <string>
 #include <vector>
 
+#include <unistd.h>
+
 #include <util/string.cpp>
+#include <util/binary_array.cpp>
 #include <Lattice.cpp>
 #include <PEPS_Parameters.cpp>
 #include <load_toml.cpp>
+#include <operator_pack.hpp>
+#include <reduce_unitcell.hpp>
+#include <estimate.hpp>
 #include <mpi.cpp>
 
 auto parse_str(std::string const &str) -> decltype(cpptoml::parse_file("")) {
@@ -35,12 +42,44 @@ auto parse_str(std::string const &str) -> decltype(cpptoml::parse_file("")) {
   return p.parse();
 }
 
+// file in the working directory with a name unique to the process,
+// removed when it goes out of scope
+struct TemporaryFile {
+  std::string name;
+  explicit TemporaryFile(std::string const &suffix)
+      : name("test_input_" + std::to_string(getpid()) + "_" + suffix) {}
+  ~TemporaryFile() { std::remove(name.c_str()); }
+};
+
+// writes a complex128 .npy file of shape (2, 2, 2, 2)
+void write_npy(std::string const &filename,
+               std::vector<std::complex<double>> const &data,
+               bool fortran_order) {
+  std::string header = std::string("{'descr': '<c16', 'fortran_order': ") +
+                       (fortran_order ? "True" : "False") +
+                       ", 'shape': (2, 2, 2, 2), }";
+  while ((10 + header.size() + 1) % 64 != 0) {
+    header += ' ';
+  }
+  header += '\n';
+  std::ofstream ofs(filename, std::ios::binary);
+  ofs.write("\x93NUMPY\x01\x00", 8);
+  const char len[2] = {static_cast<char>(header.size() & 0xff),
+                       static_cast<char>(header.size() >> 8)};
+  ofs.write(len, 2);
+  ofs << header;
+  ofs.write(reinterpret_cast<const char *>(data.data()),
+            sizeof(std::complex<double>) * data.size());
+}
+
 TEST_CASE("input") {
   using namespace tenes;
 #ifdef _NO_MPI
   using ptensor = mptensor::Tensor<mptensor::lapack::Matrix, std::complex<double>>;
+  using rtensor = mptensor::Tensor<mptensor::lapack::Matrix, double>;
 #else
   using ptensor = mptensor::Tensor<mptensor::scalapack::Matrix, std::complex<double>>;
+  using rtensor = mptensor::Tensor<mptensor::scalapack::Matrix, double>;
 #endif
 
 
@@ -69,14 +108,31 @@ TEST_CASE("input") {
     CHECK(peps_parameters.CTM_Projector_corner == true);
     CHECK(peps_parameters.Use_RSVD == false);
     CHECK(peps_parameters.RSVD_Oversampling_factor == 2.0);
+    CHECK(peps_parameters.CTM_truncation_error == 0.0);
+    CHECK(peps_parameters.CTM_Projector_groups == 1);
+    CHECK(peps_parameters.Simple_truncation_error == 0.0);
 
     CHECK(peps_parameters.seed == 11);
+    CHECK(peps_parameters.random_generator == "mt19937");
+
+    CHECK(peps_parameters.output_binary == false);
+    CHECK(peps_parameters.tensor_save_env_precision == "double");
+    CHECK(peps_parameters.measure_groups == 1);
+    CHECK(peps_parameters.tensor_load_groups == 1);
+    CHECK(peps_parameters.local_tensor_threshold == 4096);
   }
 
   SUBCASE("parameter") {
     INFO("parameter");
     auto toml = parse_str(R"(
 [parameter]
+[parameter.general]
+output_binary = true
+tensor_save_env_precision = "half"
+measure_groups = 4
+tensor_load_groups = 2
+local_tensor_threshold = 0
+
 [parameter.tensor]
 save_dir = "checkpoint"
 load_dir = "checkpoint"
@@ -84,6 +140,7 @@ load_dir = "checkpoint"
 [parameter.simple_update]
 num_step = 1000
 lambda_cutoff = 1e-10
+truncation_error = 1e-6
 
 [parameter.full_update]
 num_step = 1
@@ -102,6 +159,8 @@ iteration_max = 10
 projector_corner = false
 use_rsvd = true
 rsvd_oversampling_factor = 3.0
+truncation_error = 1e-8
+projector_groups = 2
 
 [parameter.random]
 seed = 42)");
@@ -127,8 +186,72 @@ seed = 42)");
     CHECK(peps_parameters.CTM_Projector_corner == false);
     CHECK(peps_parameters.Use_RSVD == true);
     CHECK(peps_parameters.RSVD_Oversampling_factor == 3.0);
+    CHECK(peps_parameters.CTM_truncation_error == 1e-8);
+    CHECK(peps_parameters.CTM_Projector_groups == 2);
+    CHECK(peps_parameters.Simple_truncation_error == 1e-6);
 
     CHECK(peps_parameters.seed == 42);
+    CHECK(peps_parameters.random_generator == "mt19937");
+
+    CHECK(peps_parameters.output_binary == true);
+    CHECK(peps_parameters.tensor_save_env_precision == "half");
+    CHECK(peps_parameters.measure_groups == 4);
+    CHECK(peps_parameters.tensor_load_groups == 2);
+    CHECK(peps_parameters.local_tensor_threshold == 0);
+
+    auto toml_invalid = parse_str(R"(
+[parameter]
+[parameter.general]
+tensor_save_env_precision = "quad"
+)");
+    CHECK_THROWS_AS(gen_param(toml_invalid->get_table("parameter")), tenes::input_error);
+
+    auto toml_philox = parse_str(R"(
+[parameter]
+[parameter.random]
+generator = "philox"
+)");
+    CHECK(gen_param(toml_philox->get_table("parameter")).random_generator ==
+          "philox");
+  }
+
+  SUBCASE("parameter override") {
+    INFO("parameter override");
+    auto toml = parse_str(R"(
+[parameter]
+[parameter.general]
+output = "output"
+tensor_save = "save"
+
+[parameter.ctm]
+dimension = 16
+)");
+    auto overrides = parse_str(R"(
+[general]
+output = "output_h0.5"
+[ctm]
+iteration_max = 20
+[random]
+seed = 7
+)");
+    merge_parameter(toml, overrides);
+    PEPS_Parameters peps_parameters = gen_param(toml->get_table("parameter"));
+    CHECK(peps_parameters.outdir == "output_h0.5");
+    CHECK(peps_parameters.tensor_save_dir == "save");
+    CHECK(peps_parameters.CHI == 16);
+    CHECK(peps_parameters.Max_CTM_Iteration == 20);
+    CHECK(peps_parameters.seed == 7);
+
+    auto toml_noparam = parse_str(R"(
+[tensor]
+)");
+    merge_parameter(toml_noparam, overrides);
+    CHECK(gen_param(toml_noparam->get_table("parameter")).seed == 7);
+
+    auto invalid = parse_str(R"(
+seed = 7
+)");
+    CHECK_THROWS_AS(merge_parameter(toml, invalid), tenes::input_error);
   }
 
   SUBCASE("tensor") {
@@ -156,6 +279,80 @@ noise = 0.01
     CHECK(lattice.skew == 2);
   }
 
+  SUBCASE("vacancy") {
+    auto toml = parse_str(R"(
+[tensor]
+L_sub = [2, 2]
+[[tensor.unitcell]]
+index = 0
+physical_dim = 2
+virtual_dim = [3, 3, 3, 3]
+initial_state = [1.0, 0.0]
+[[tensor.unitcell]]
+index = 1
+physical_dim = 2
+virtual_dim = [3, 1, 3, 1]
+initial_state = [1.0, 0.0]
+[[tensor.unitcell]]
+index = 2
+physical_dim = 2
+virtual_dim = [1, 3, 1, 3]
+initial_state = [1.0, 0.0]
+[[tensor.unitcell]]
+index = 3
+physical_dim = 1
+virtual_dim = [1, 1, 1, 1]
+initial_state = [1.0]
+    )");
+    Lattice lattice = gen_lattice(toml->get_table("tensor"));
+    CHECK_FALSE(lattice.is_vacancy(0));
+    CHECK_FALSE(lattice.is_vacancy(1));
+    CHECK_FALSE(lattice.is_vacancy(2));
+    CHECK(lattice.is_vacancy(3));
+  }
+
+  SUBCASE("lattice schedules") {
+    Lattice lattice(3, 2, 1);
+
+    // other by walking neighbor by neighbor
+    auto walk = [&](int index, int dx, int dy) {
+      for (; dx > 0; --dx) index = lattice.right(index);
+      for (; dx < 0; ++dx) index = lattice.left(index);
+      for (; dy > 0; --dy) index = lattice.top(index);
+      for (; dy < 0; ++dy) index = lattice.bottom(index);
+      return index;
+    };
+    for (int i = 0; i < lattice.N_UNIT; ++i) {
+      for (int dx = -7; dx <= 7; ++dx) {
+        for (int dy = -7; dy <= 7; ++dy) {
+          CHECK(lattice.other(i, dx, dy) == walk(i, dx, dy));
+        }
+      }
+    }
+
+    for (int direction = 0; direction < 4; ++direction) {
+      const int nlines = direction % 2 == 0 ? lattice.LX : lattice.LY;
+      REQUIRE(static_cast<int>(lattice.move_lines[direction].size()) == nlines);
+      for (int line = 0; line < nlines; ++line) {
+        for (int pos = 0; pos < lattice.move_length(direction); ++pos) {
+          auto const &p = lattice.move_plaquette(direction, line, pos);
+          CHECK(p.j == lattice.right(p.i));
+          CHECK(p.k == lattice.bottom(p.j));
+          CHECK(p.l == lattice.left(p.k));
+          CHECK(p.i == lattice.top(p.l));
+        }
+      }
+    }
+    CHECK(lattice.move_plaquette(0, 2, 1).i == lattice.index(2, 1));
+    CHECK(lattice.move_plaquette(1, 1, 2).j == lattice.index(2, 1));
+    CHECK(lattice.move_plaquette(2, 2, 1).k == lattice.index(2, 1));
+    CHECK(lattice.move_plaquette(3, 1, 2).l == lattice.index(2, 1));
+    CHECK(lattice.move_lines[0] == std::vector<int>{0, 1, 2});
+    CHECK(lattice.move_lines[2] == std::vector<int>{1, 0, 2});
+    CHECK(lattice.move_lines[1] == std::vector<int>{1, 0});
+    CHECK(lattice.move_lines[3] == std::vector<int>{0, 1});
+  }
+
   SUBCASE("evolution") {
     {
       INFO("simple_update");
@@ -172,7 +369,7 @@ elements = """
       const auto simple_updates = tenes::load_simple_updates<ptensor>(toml);
       CHECK(simple_updates[0].source_site == 0);
       CHECK(simple_updates[0].source_leg == 2);
-      auto &op = simple_updates[0].op;
+      auto &op = simple_updates[0].op();
       CHECK(op.shape() == mptensor::Shape{2, 2, 2, 4});
       std::complex<double> v = 0.0;
       op.get_value({0, 0, 0, 0}, v);
@@ -194,13 +391,542 @@ elements = """
       const auto full_updates = tenes::load_full_updates<ptensor>(toml);
       CHECK(full_updates[0].source_site == 0);
       CHECK(full_updates[0].source_leg == 2);
-      auto &op = full_updates[0].op;
+      auto &op = full_updates[0].op();
       CHECK(op.shape() == mptensor::Shape{2, 2, 2, 4});
       std::complex<double> v = 0.0;
       op.get_value({0, 0, 0, 0}, v);
       CHECK(std::real(v) == 0.0);
       CHECK(std::imag(v) == 1.0);
     }
+    {
+      INFO("threesite simple_update");
+      auto toml = parse_str(R"(
+[evolution]
+[[evolution.simple]]
+source_site = 0
+source_leg = 2
+next_leg = 1
+dimensions = [2,2,2,2,2,2]
+elements = """
+0 1 0 1 1 0 1.0 0.0
+"""
+      )");
+      const auto simple_updates = tenes::load_simple_updates<ptensor>(toml);
+      CHECK(simple_updates[0].is_threesite());
+      CHECK(simple_updates[0].source_leg == 2);
+      CHECK(simple_updates[0].next_leg == 1);
+      auto &op = simple_updates[0].op();
+      CHECK(op.shape() == mptensor::Shape{2, 2, 2, 2, 2, 2});
+      std::complex<double> v = 0.0;
+      op.get_value({0, 1, 0, 1, 1, 0}, v);
+      CHECK(std::real(v) == 1.0);
+    }
+    {
+      INFO("threesite errors");
+      // back to the source site
+      auto toml = parse_str(R"(
+[evolution]
+[[evolution.simple]]
+source_site = 0
+source_leg = 2
+next_leg = 0
+dimensions = [2,2,2,2,2,2]
+elements = ""
+      )");
+      CHECK_THROWS_AS(tenes::load_simple_updates<ptensor>(toml),
+                      tenes::input_error);
+      // rank mismatch
+      toml = parse_str(R"(
+[evolution]
+[[evolution.simple]]
+source_site = 0
+source_leg = 2
+next_leg = 1
+dimensions = [2,2,2,2]
+elements = ""
+      )");
+      CHECK_THROWS_AS(tenes::load_simple_updates<ptensor>(toml),
+                      tenes::input_error);
+      // only for simple update
+      toml = parse_str(R"(
+[evolution]
+[[evolution.full]]
+source_site = 0
+source_leg = 2
+next_leg = 1
+dimensions = [2,2,2,2,2,2]
+elements = ""
+      )");
+      CHECK_THROWS_AS(tenes::load_full_updates<ptensor>(toml),
+                      tenes::input_error);
+    }
+  }
+
+  SUBCASE("shared operators") {
+    auto toml = parse_str(R"(
+[evolution]
+[[evolution.simple]]
+source_site = 0
+source_leg = 2
+dimensions = [2,2,2,2]
+elements = """
+0 0 0 0 1.0 0.0
+1 1 1 1 1.0 0.0
+"""
+[[evolution.simple]]
+source_site = 1
+source_leg = 2
+dimensions = [2,2,2,2]
+elements = """
+0 0 0 0  1.0 0.0  # comments and spaces are ignored
+1 1 1 1  1.0 0.0
+"""
+[[evolution.simple]]
+source_site = 0
+source_leg = 1
+dimensions = [2,2,2,2]
+elements = """
+0 0 0 0 2.0 0.0
+"""
+[[evolution.simple]]
+source_site = 1
+source_leg = 1
+dimensions = [2,2,2,2]
+elements = """
+1 1 1 1 1e0 0.0
+0 0 0 0 1.00 -0.0
+0 1 1 0 0.0 0.0
+"""
+[[evolution.full]]
+source_site = 0
+source_leg = 2
+dimensions = [2,2,2,2]
+elements = """
+0 0 0 0 1.0 0.0
+1 1 1 1 1.0 0.0
+"""
+      )");
+    OperatorTable<ptensor> optable;
+    const auto simple_updates = tenes::load_simple_updates<ptensor>(toml, 0.0, &optable);
+    const auto full_updates = tenes::load_full_updates<ptensor>(toml, 0.0, &optable);
+    CHECK(optable.size() == 2);
+    CHECK(simple_updates[0].op_ptr == simple_updates[1].op_ptr);
+    CHECK(simple_updates[0].op_ptr != simple_updates[2].op_ptr);
+    // the same values written differently
+    CHECK(simple_updates[0].op_ptr == simple_updates[3].op_ptr);
+    CHECK(simple_updates[0].op_ptr == full_updates[0].op_ptr);
+
+    // tensors are identified by the values, not by the hash only
+    OperatorTable<ptensor> table;
+    ptensor A(MPI_COMM_WORLD, mptensor::Shape(2, 2));
+    ptensor B(MPI_COMM_WORLD, mptensor::Shape(2, 2));
+    ptensor C(MPI_COMM_WORLD, mptensor::Shape(4));
+    A.set_value({0, 1}, 1.0);
+    B.set_value({0, 1}, 1.0);
+    B.set_value({1, 1}, 1.0e-300);
+    const auto ha = table.intern(A);
+    CHECK(table.intern(A) == ha);
+    CHECK(table.intern(B) != ha);
+    CHECK(table.intern(C) != ha);
+    CHECK(table.size() == 3);
+  }
+
+  SUBCASE("real operators") {
+    auto toml = parse_str(R"(
+[observable]
+[[observable.onesite]]
+name = "Sz"
+group = 0
+sites = []
+dim = 2
+elements = """
+0 0 0.5 0.0
+1 1 -0.5 0.0
+"""
+[[observable.onesite]]
+name = "Sy"
+group = 1
+sites = []
+dim = 2
+elements = """
+0 1 0.0 -0.5
+1 0 0.0 0.5
+"""
+      )");
+    {
+      INFO("real");
+      auto t = parse_str(R"(
+[observable]
+[[observable.onesite]]
+group = 0
+sites = []
+dim = 2
+elements = """
+0 0 0.5 1e-16
+"""
+      )");
+      OperatorTable<rtensor> optable;
+      auto onesites = load_operators<rtensor>(t, 2, 1, 0.0, "observable.onesite", &optable);
+      CHECK(optable.max_imag() == 1e-16);
+      double v = 0.0;
+      onesites[0].op().get_value({0, 0}, v);
+      CHECK(v == 0.5);
+    }
+    {
+      INFO("complex");
+      OperatorTable<rtensor> optable;
+      auto onesites = load_operators<rtensor>(toml, 2, 1, 0.0, "observable.onesite", &optable);
+      CHECK(optable.max_imag() == 0.5);
+    }
+  }
+
+  SUBCASE("pack") {
+    auto toml = parse_str(R"(
+[parameter]
+[parameter.general]
+is_real = false
+output = "packed"
+[parameter.full_update]
+num_step = 3
+[parameter.ctm]
+dimension = 7
+
+[tensor]
+L_sub = [2, 1]
+skew = 1
+[[tensor.unitcell]]
+index = []
+physical_dim = 2
+virtual_dim = [3, 2, 3, 2]
+initial_state = [1.0, 0.0]
+noise = 0.1
+
+[evolution]
+[[evolution.simple]]
+source_site = 0
+source_leg = 2
+dimensions = [2,2,2,2]
+elements = """
+0 0 0 0 1.0 0.0
+1 0 0 1 0.0 0.5
+"""
+[[evolution.full]]
+source_site = 1
+source_leg = 2
+dimensions = [2,2,2,2]
+elements = """
+0 0 0 0 1.0 0.0
+1 0 0 1 0.0 0.5
+"""
+
+[observable]
+[[observable.onesite]]
+name = "Sz"
+group = 0
+sites = []
+dim = 2
+elements = """
+0 0 0.5 0.0
+1 1 -0.5 0.0
+"""
+[[observable.twosite]]
+name = "SzSz"
+group = 0
+bonds = """
+0 1 0
+"""
+ops = [0, 0]
+      )");
+    PEPS_Parameters peps_parameters = gen_param(toml->get_table("parameter"));
+    Lattice lattice = gen_lattice(toml->get_table("tensor"));
+    using dense = DenseTensor<std::complex<double>>;
+    OperatorTable<dense> optable;
+    OperatorSet<dense> ops;
+    ops.simple_updates = load_simple_updates<dense>(toml, 0.0, &optable);
+    ops.full_updates = load_full_updates<dense>(toml, 0.0, &optable);
+    ops.onesite_operators = load_operators<dense>(toml, lattice.N_UNIT, 1, 0.0, "observable.onesite", &optable);
+    ops.twosite_operators = load_operators<dense>(toml, lattice.N_UNIT, 2, 0.0, "observable.twosite", &optable);
+
+    util::OutArchive out;
+    peps_parameters.pack(out);
+    lattice.pack(out);
+    pack_operators(out, ops);
+
+    util::InArchive in(out.str());
+    PEPS_Parameters p2;
+    p2.unpack(in);
+    Lattice l2(1, 1);
+    l2.unpack(in);
+    auto ops2 = unpack_operators<ptensor>(in, MPI_COMM_WORLD);
+    CHECK(in.eof());
+
+    CHECK(p2.CHI == 7);
+    CHECK(p2.num_full_step == 3);
+    CHECK(p2.outdir == "packed");
+    CHECK(l2.LX == 2);
+    CHECK(l2.LY == 1);
+    CHECK(l2.skew == 1);
+    CHECK(l2.N_UNIT == 2);
+    CHECK(l2.virtual_dims[1][0] == 3);
+    CHECK(l2.initial_dirs[0] == std::vector<double>{1.0, 0.0});
+    CHECK(l2.noises[1] == 0.1);
+    CHECK(l2.NN_Tensor == lattice.NN_Tensor);
+
+    REQUIRE(ops2.simple_updates.size() == 1);
+    REQUIRE(ops2.full_updates.size() == 1);
+    CHECK(ops2.full_updates[0].source_site == 1);
+    CHECK(!ops2.simple_updates[0].is_threesite());
+    CHECK(ops2.simple_updates[0].op_ptr == ops2.full_updates[0].op_ptr);
+    std::complex<double> v;
+    ops2.simple_updates[0].op().get_value({1, 0, 0, 1}, v);
+    CHECK(v == std::complex<double>(0.0, 0.5));
+
+    REQUIRE(ops2.onesite_operators.size() == 2);
+    CHECK(ops2.onesite_operators[1].name == "Sz");
+    CHECK(ops2.onesite_operators[1].source_site == 1);
+    CHECK(ops2.onesite_operators[1].is_onesite());
+    ops2.onesite_operators[1].op().get_value({1, 1}, v);
+    CHECK(v == -0.5);
+
+    REQUIRE(ops2.twosite_operators.size() == 1);
+    CHECK(ops2.twosite_operators[0].dx == std::vector<int>{1});
+    CHECK(ops2.twosite_operators[0].ops_indices == std::vector<int>{0, 0});
+    CHECK(!ops2.twosite_operators[0].op_ptr);
+  }
+
+  SUBCASE("reduce unitcell") {
+    // 4x2 unit cell holding a checkerboard pattern
+    auto toml = parse_str(R"(
+[tensor]
+L_sub = [4, 2]
+[[tensor.unitcell]]
+index = [0, 2, 5, 7]
+physical_dim = 2
+virtual_dim = 2
+initial_state = [1.0, 0.0]
+[[tensor.unitcell]]
+index = [1, 3, 4, 6]
+physical_dim = 2
+virtual_dim = 2
+initial_state = [0.0, 1.0]
+
+[observable]
+[[observable.onesite]]
+name = "Sz"
+group = 0
+sites = []
+dim = 2
+elements = """
+0 0 0.5 0.0
+1 1 -0.5 0.0
+"""
+[[observable.twosite]]
+name = "SzSz"
+group = 0
+bonds = """
+0 1 0
+1 1 0
+2 1 0
+3 1 0
+4 1 0
+5 1 0
+6 1 0
+7 1 0
+"""
+ops = [0, 0]
+      )");
+    Lattice lattice = gen_lattice(toml->get_table("tensor"));
+    using dense = DenseTensor<double>;
+    OperatorTable<dense> optable;
+    OperatorSet<dense> ops;
+    ops.onesite_operators = load_operators<dense>(toml, lattice.N_UNIT, 1, 0.0, "observable.onesite", &optable);
+    ops.twosite_operators = load_operators<dense>(toml, lattice.N_UNIT, 2, 0.0, "observable.twosite", &optable);
+
+    SUBCASE("reduced") {
+      REQUIRE(reduce_unitcell(lattice, ops));
+      CHECK(lattice.LX == 2);
+      CHECK(lattice.LY == 1);
+      CHECK(lattice.skew == 1);
+      CHECK(lattice.N_UNIT == 2);
+      CHECK(lattice.initial_dirs[0] == std::vector<double>{1.0, 0.0});
+      CHECK(lattice.initial_dirs[1] == std::vector<double>{0.0, 1.0});
+      CHECK(lattice.input_site_map == std::vector<int>{0, 1, 0, 1, 1, 0, 1, 0});
+      CHECK(lattice.num_input_sites() == 8);
+      CHECK(lattice.site_of_input(4) == 1);
+
+      REQUIRE(ops.onesite_operators.size() == 2);
+      CHECK(ops.onesite_operators[0].source_site == 0);
+      CHECK(ops.onesite_operators[1].source_site == 1);
+      REQUIRE(ops.twosite_operators.size() == 2);
+      CHECK(ops.twosite_operators[1].source_site == 1);
+      CHECK(ops.twosite_operators[1].dx == std::vector<int>{1});
+
+      util::OutArchive out;
+      lattice.pack(out);
+      util::InArchive in(out.str());
+      Lattice l2(1, 1);
+      l2.unpack(in);
+      CHECK(l2.input_site_map == lattice.input_site_map);
+    }
+
+    SUBCASE("not reduced") {
+      lattice.initial_dirs[3] = std::vector<double>{0.6, 0.8};
+      CHECK(!reduce_unitcell(lattice, ops));
+      CHECK(lattice.N_UNIT == 8);
+      CHECK(lattice.input_site_map.empty());
+      CHECK(ops.twosite_operators.size() == 8);
+    }
+
+    SUBCASE("noisy") {
+      for (int i = 0; i < lattice.N_UNIT; ++i) {
+        lattice.noises[i] = 0.01;
+      }
+      CHECK(!reduce_unitcell(lattice, ops));
+      CHECK(lattice.N_UNIT == 8);
+      CHECK(lattice.input_site_map.empty());
+    }
+  }
+
+  SUBCASE("reduce unitcell with random sites") {
+    // random initial tensors differ from each other
+    auto toml = parse_str(R"(
+[tensor]
+L_sub = [2, 2]
+[[tensor.unitcell]]
+index = []
+physical_dim = 2
+virtual_dim = 2
+initial_state = [0.0]
+      )");
+    Lattice lattice = gen_lattice(toml->get_table("tensor"));
+    OperatorSet<DenseTensor<double>> ops;
+    CHECK(!reduce_unitcell(lattice, ops));
+    CHECK(lattice.N_UNIT == 4);
+    CHECK(lattice.input_site_map.empty());
+  }
+
+  SUBCASE("elements_file") {
+    // op[i][j][k][l] = (8i+4j+2k+l) + 0.5i
+    std::vector<std::complex<double>> data(16);
+    for (int n = 0; n < 16; ++n) {
+      data[n] = std::complex<double>(n, 0.5);
+    }
+    // the same array stored in Fortran order (the first index runs fastest)
+    std::vector<std::complex<double>> data_f(16);
+    for (int i = 0; i < 2; ++i) {
+      for (int j = 0; j < 2; ++j) {
+        for (int k = 0; k < 2; ++k) {
+          for (int l = 0; l < 2; ++l) {
+            data_f[i + 2 * j + 4 * k + 8 * l] = data[8 * i + 4 * j + 2 * k + l];
+          }
+        }
+      }
+    }
+    TemporaryFile npy("elements.npy");
+    TemporaryFile npy_f("elements_f.npy");
+    TemporaryFile raw("elements.dat");
+    write_npy(npy.name, data, false);
+    write_npy(npy_f.name, data_f, true);
+    {
+      std::ofstream ofs(raw.name, std::ios::binary);
+      for (auto v : data) {
+        double re = std::real(v);
+        ofs.write(reinterpret_cast<const char *>(&re), sizeof(double));
+      }
+    }
+    auto simple_update_toml = [](std::string const &dims,
+                                 std::string const &filename) {
+      return parse_str(R"(
+[evolution]
+[[evolution.simple]]
+source_site = 0
+source_leg = 2
+dimensions = )" + dims + R"(
+elements_file = ")" + filename + R"("
+      )");
+    };
+    for (auto const *file : {&npy, &npy_f}) {
+      INFO(file->name);
+      auto toml = simple_update_toml("[2,2,2,2]", file->name);
+      const auto simple_updates = tenes::load_simple_updates<ptensor>(toml);
+      auto &op = simple_updates[0].op();
+      CHECK(op.shape() == mptensor::Shape{2, 2, 2, 2});
+      std::complex<double> v = 0.0;
+      op.get_value({1, 0, 1, 1}, v);
+      CHECK(std::real(v) == 11.0);
+      CHECK(std::imag(v) == 0.5);
+      op.get_value({0, 1, 1, 0}, v);
+      CHECK(std::real(v) == 6.0);
+      CHECK(std::imag(v) == 0.5);
+    }
+    {
+      INFO("raw");
+      auto toml = parse_str(R"(
+[observable]
+[[observable.twosite]]
+group = 0
+dim = [2,2]
+bonds = """
+0 1 0
+"""
+elements_file = ")" + raw.name + R"("
+elements_dtype = "float64"
+      )");
+      auto twosites = load_operators<ptensor>(toml, 2, 2, 0.0, "observable.twosite");
+      auto const& on = twosites[0];
+      CHECK(on.op().shape() == mptensor::Shape{2,2,2,2});
+      std::complex<double> v = 0.0;
+      on.op().get_value({0, 1, 1, 0}, v);
+      CHECK(std::real(v) == 6.0);
+      CHECK(std::imag(v) == 0.0);
+    }
+    {
+      INFO("wrong shape");
+      auto toml = simple_update_toml("[2,2,2,4]", npy.name);
+      CHECK_THROWS_AS(tenes::load_simple_updates<ptensor>(toml), tenes::input_error);
+    }
+    {
+      INFO("packed as a reference");
+      auto toml = simple_update_toml("[2,2,2,2]", npy.name);
+      using dense = DenseTensor<std::complex<double>>;
+      OperatorTable<dense> optable;
+      OperatorSet<dense> ops;
+      ops.simple_updates = load_simple_updates<dense>(toml, 0.0, &optable);
+      // only the reference to the file is held and sent
+      CHECK(ops.simple_updates[0].op().is_file_reference());
+      CHECK(ops.simple_updates[0].op().local_size() == 0);
+      util::OutArchive out;
+      pack_operators(out, ops);
+      CHECK(out.str().size() < sizeof(std::complex<double>) * data.size());
+
+      util::InArchive in(out.str());
+      auto ops2 = unpack_operators<ptensor>(in, MPI_COMM_WORLD);
+      CHECK(in.eof());
+      std::complex<double> v = 0.0;
+      ops2.simple_updates[0].op().get_value({1, 0, 1, 1}, v);
+      CHECK(std::real(v) == 11.0);
+      CHECK(std::imag(v) == 0.5);
+
+      // complex elements are found when unpacked in real mode
+      util::OutArchive out_real;
+      pack_operators(out_real, ops, 1e-10);
+      util::InArchive in_real(out_real.str());
+      CHECK_THROWS_AS(unpack_operators<ptensor>(in_real, MPI_COMM_WORLD),
+                      tenes::input_error);
+
+      // two files with the same contents share one tensor once read
+      auto more = load_simple_updates<dense>(
+          simple_update_toml("[2,2,2,2]", npy_f.name), 0.0, &optable);
+      ops.simple_updates.insert(ops.simple_updates.end(), more.begin(),
+                                more.end());
+      CHECK(&ops.simple_updates[0].op() != &ops.simple_updates[1].op());
+      util::OutArchive out_both;
+      pack_operators(out_both, ops);
+      util::InArchive in_both(out_both.str());
+      auto ops3 = unpack_operators<ptensor>(in_both, MPI_COMM_WORLD);
+      REQUIRE(ops3.simple_updates.size() == 2);
+      CHECK(&ops3.simple_updates[0].op() == &ops3.simple_updates[1].op());
+    }
   }
 
   SUBCASE("observable") {
@@ -224,9 +950,9 @@ elements = """
         CHECK(on.group == 0);
         CHECK(on.source_site == i);
         CHECK(on.is_onesite());
-        CHECK(on.op.shape() == mptensor::Shape{2,2});
+        CHECK(on.op().shape() == mptensor::Shape{2,2});
         std::complex<double> v = 0.0;
-        on.op.get_value({0, 0}, v);
+        on.op().get_value({0, 0}, v);
         CHECK(std::real(v) == 1.0);
         CHECK(std::imag(v) == 0.0);
       }
@@ -255,14 +981,74 @@ elements = """
         CHECK(on.source_site == i);
         CHECK(on.dx == std::vector<int>{i+1});
         CHECK(on.dy == std::vector<int>{i});
-        CHECK(on.op.shape() == mptensor::Shape{2,2,2,2});
+        CHECK(on.op().shape() == mptensor::Shape{2,2,2,2});
         std::complex<double> v = 0.0;
-        on.op.get_value({0, 0, 0, 0}, v);
+        on.op().get_value({0, 0, 0, 0}, v);
         CHECK(std::real(v) == 0.0);
         CHECK(std::imag(v) == 1.0);
       }
     }
   }
 
+  SUBCASE("estimate") {
+    INFO("estimate");
+    // the kernels reproduce the cpu_cost comments in PEPS_Basics.hpp
+    // (CHI = 100, D = 10, and d = 2)
+    CHECK(estimate::enlarged_corner(100, 10, 2) == doctest::Approx(5.01e10));
+    CHECK(estimate::next_edge(100, 10, 2) == doctest::Approx(6e10));
+
+    auto toml = parse_str(R"(
+[parameter]
+[parameter.simple_update]
+num_step = 10
+[parameter.ctm]
+dimension = 8
+[tensor]
+L_sub = [2, 2]
+[[tensor.unitcell]]
+index = []
+physical_dim = 2
+virtual_dim = [3, 3, 3, 3]
+initial_state = [1.0, 0.0]
+    )");
+    PEPS_Parameters peps_parameters = gen_param(toml->get_table("parameter"));
+    Lattice lattice = gen_lattice(toml->get_table("tensor"));
+    OperatorCounts counts;
+    counts.num_simple_updates = 4;
+    counts.num_onesite = 4;
+
+    CostEstimate cost =
+        estimate_cost(peps_parameters, lattice, CorrelationParameter(), counts);
+    CHECK(cost.simple_update ==
+          doctest::Approx(10 * 4 * estimate::simple_update_bond(3, 2)));
+    CHECK(cost.full_update == 0.0);
+    CHECK(cost.environment ==
+          doctest::Approx(peps_parameters.Max_CTM_Iteration *
+                          cost.ctm_iteration));
+    CHECK(cost.observable > 0.0);
+    CHECK(cost.matrix_dim == 72);
+
+    peps_parameters.Use_RSVD = true;
+    CHECK(estimate_cost(peps_parameters, lattice, CorrelationParameter(),
+                        counts)
+              .ctm_iteration < cost.ctm_iteration);
+
+    // small matrices are not worth distributing
+    Layout layout = recommend_layout(cost, 8, 0.0);
+    CHECK(layout.nodes == 1);
+    CHECK(layout.ranks == 1);
+    CHECK(layout.threads == 8);
+
+    cost.matrix_dim = 1.0e4;
+    layout = recommend_layout(cost, 8, 0.0);
+    CHECK(layout.ranks == 8);
+    CHECK(layout.threads == 1);
+
+    // twice as much memory as a node needs three nodes (80% of each)
+    layout = recommend_layout(cost, 8, 0.5 * cost.peak_memory());
+    CHECK(layout.nodes == 3);
+    CHECK(layout.ranks == 24);
+  }
+
   SUBCASE("correlation") {}
 }
@@ -0,0 +1,83 @@
+/* TeNeS - Massively parallel tensor network solver /
+/ Copyright (C) 2019- The University of Tokyo */
+
+/* This program is free software: you can redistribute it and/or modify /
+/ it under the terms of the GNU General Public License as published by /
+/ the Free Software Foundation, either version 3 of the License, or /
+/ (at your option) any later version. */
+
+/* This program is distributed in the hope that it will be useful, /
+/ but WITHOUT ANY WARRANTY; without even the implied warranty of /
+/ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the /
+/ GNU General Public License for more details. */
+
+/* You should have received a copy of the GNU General Public License /
+/ along with this program. If not, see http://www.gnu.org/licenses/. */
+
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest.h"
+
+#include <cstdint>
+
+#include <util/philox.hpp>
+
+TEST_CASE("Philox4x32-10") {
+  using tenes::util::Philox4x32;
+  using counter = Philox4x32::counter_type;
+  using key = Philox4x32::key_type;
+
+  SUBCASE("known answers") {
+    // kat_vectors of Random123 (philox4x32_10)
+    struct KAT {
+      counter ctr;
+      key k;
+      counter answer;
+    };
+    const KAT kats[] = {
+        {counter{{0x00000000u, 0x00000000u, 0x00000000u, 0x00000000u}},
+         key{{0x00000000u, 0x00000000u}},
+         counter{{0x6627e8d5u, 0xe169c58du, 0xbc57ac4cu, 0x9b00dbd8u}}},
+        {counter{{0xffffffffu, 0xffffffffu, 0xffffffffu, 0xffffffffu}},
+         key{{0xffffffffu, 0xffffffffu}},
+         counter{{0x408f276du, 0x41c83b0eu, 0xa20bc7c6u, 0x6d5451fdu}}},
+        {counter{{0x243f6a88u, 0x85a308d3u, 0x13198a2eu, 0x03707344u}},
+         key{{0xa4093822u, 0x299f31d0u}},
+         counter{{0xd16cfe09u, 0x94fdccebu, 0x5001e420u, 0x24126ea1u}}},
+    };
+    for (auto const &kat : kats) {
+      const counter result = Philox4x32(kat.k)(kat.ctr);
+      for (int i = 0; i < 4; ++i) {
+        CHECK(result[i] == kat.answer[i]);
+      }
+    }
+  }
+
+  SUBCASE("seed") {
+    // the lower 32 bits of the seed are the first word of the key
+    const uint64_t seed = 0x299f31d0a4093822ull;
+    const counter ctr{{0x243f6a88u, 0x85a308d3u, 0x13198a2eu, 0x03707344u}};
+    const counter result = Philox4x32(seed)(ctr);
+    const counter answer{{0xd16cfe09u, 0x94fdccebu, 0x5001e420u, 0x24126ea1u}};
+    for (int i = 0; i < 4; ++i) {
+      CHECK(result[i] == answer[i]);
+    }
+  }
+
+  SUBCASE("uniform") {
+    const Philox4x32 philox(11);
+    for (uint64_t n = 0; n < 1000; ++n) {
+      double x, y;
+      philox.uniform(0, 3, n, x, y);
+      CHECK(x >= -1.0);
+      CHECK(x < 1.0);
+      CHECK(y >= -1.0);
+      CHECK(y < 1.0);
+
+      // a function of the arguments only
+      double x2, y2;
+      philox.uniform(0, 3, n, x2, y2);
+      CHECK(x2 == x);
+      CHECK(y2 == y);
+    }
+  }
+}
@@ -0,0 +1,286 @@
+/* TeNeS - Massively parallel tensor network solver /
+/ Copyright (C) 2019- The University of Tokyo */
+
+/* This program is free software: you can redistribute it and/or modify /
+/ it under the terms of the GNU General Public License as published by /
+/ the Free Software Foundation, either version 3 of the License, or /
+/ (at your option) any later version. */
+
+/* This program is distributed in the hope that it will be useful, /
+/ but WITHOUT ANY WARRANTY; without even the implied warranty of /
+/ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the /
+/ GNU General Public License for more details. */
+
+/* You should have received a copy of the GNU General Public License /
+/ along with this program. If not, see http://www.gnu.org/licenses/. */
+
+#define DOCTEST_CONFIG_IMPLEMENT
+#include "doctest.h"
+
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <session.hpp>
+
+int main(int argc, char **argv) {
+  MPI_Init(&argc, &argv);
+  doctest::Context context(argc, argv);
+  const int res = context.run();
+  MPI_Finalize();
+  return res;
+}
+
+// data/output_AntiferroHeisenberg_real/density.dat
+void check_densities(std::vector<tenes::Density> const &densities) {
+  const std::vector<std::pair<std::string, double>> ref = {
+      {"Sz", 6.11647102532908438e-03},
+      {"Sx", -1.18125085038094907e-01},
+      {"hamiltonian", -5.43684776153081639e-01},
+      {"SzSz", -3.16323622995942133e-01},
+      {"SxSx", -8.55704529153783616e-02},
+      {"SySy", -1.41790700241760936e-01},
+  };
+  const double atol = 1.0e-4;
+  const double rtol = 1.0e-3;
+  REQUIRE(densities.size() == ref.size());
+  for (size_t i = 0; i < ref.size(); ++i) {
+    INFO(ref[i].first);
+    CHECK(densities[i].name == ref[i].first);
+    CHECK(std::abs(densities[i].value - ref[i].second) <=
+          atol + rtol * std::abs(ref[i].second));
+  }
+}
+
+// elements of a distributed tensor in C order, the same on all the processes
+template <class tensor>
+std::vector<double> all_elements(tensor const &T) {
+  const mptensor::Shape shape = T.shape();
+  size_t size = 1;
+  for (size_t k = 0; k < shape.size(); ++k) {
+    size *= shape[k];
+  }
+  std::vector<double> ret(size, 0.0);
+  for (size_t lindex = 0; lindex < T.local_size(); ++lindex) {
+    const mptensor::Index index = T.global_index(lindex);
+    size_t offset = 0;
+    for (size_t k = 0; k < shape.size(); ++k) {
+      offset = offset * shape[k] + index[k];
+    }
+    ret[offset] = T[lindex];
+  }
+  tenes::allreduce_sum(ret, T.get_comm());
+  return ret;
+}
+
+TEST_CASE("session") {
+  using namespace tenes;
+
+  auto input = load_input("data/AntiferroHeisenberg_real.toml", MPI_COMM_WORLD,
+                          PrintLevel::none);
+  input.peps_parameters.outdir = "output_session";
+  REQUIRE(input.peps_parameters.is_real);
+
+  SUBCASE("steps") {
+    Session<real_tensor> session(MPI_COMM_WORLD, input);
+
+    // the same steps as the tenes command with the input,
+    // with the simple update divided into two calls
+    session.simple_update(40);
+    session.simple_update(60);
+    session.full_update(1);
+    check_densities(session.measure());
+
+    const int N_UNIT = session.lattice().N_UNIT;
+    CHECK(session.site_tensors().size() == N_UNIT);
+    CHECK(session.lambdas().size() == N_UNIT);
+    for (int k = 0; k < 4; ++k) {
+      CHECK(session.corner_tensors(k).size() == N_UNIT);
+      CHECK(session.edge_tensors(k).size() == N_UNIT);
+    }
+    CHECK(session.corner_tensors(0)[0].shape() ==
+          mptensor::Shape(input.peps_parameters.CHI, input.peps_parameters.CHI));
+    CHECK_THROWS_AS(session.corner_tensors(4), tenes::logic_error);
+  }
+
+  SUBCASE("environment reuse") {
+    // the CTM continues from the converged environment
+    // instead of starting from the site tensors again
+    Session<real_tensor> session(MPI_COMM_WORLD, input);
+    session.simple_update(100);
+    session.update_environment();
+    const int cold = session.ctm_iterations();
+    session.full_update(1);
+    check_densities(session.measure());
+    const int before = session.ctm_iterations();
+    session.update_environment();
+    CHECK(session.ctm_iterations() - before < cold);
+
+    // also from the environment copied by warm_start
+    auto next_input = input;
+    next_input.peps_parameters.outdir = "output_session_warm";
+    Session<real_tensor> next(MPI_COMM_WORLD, next_input);
+    next.warm_start(session);
+    check_densities(next.measure());
+    CHECK(next.ctm_iterations() > 0);
+    CHECK(next.ctm_iterations() < cold);
+  }
+
+  SUBCASE("memory") {
+    Session<real_tensor> session(MPI_COMM_WORLD, input);
+    session.simple_update(10);
+    session.full_update(1);
+    session.summary();
+
+    int mpirank = 0;
+    MPI_Comm_rank(MPI_COMM_WORLD, &mpirank);
+    if (mpirank == 0) {
+      std::ifstream ifs("output_session/memory.dat");
+      REQUIRE(ifs);
+      std::vector<std::string> regions;
+      std::string line;
+      while (std::getline(ifs, line)) {
+        if (line.empty() || line[0] == '#') {
+          continue;
+        }
+        std::istringstream iss(line);
+        std::string region, largest;
+        double resident_max, resident_sum, tensor_max, tensor_sum, size;
+        iss >> region >> resident_max >> resident_sum >> tensor_max >>
+            tensor_sum >> largest >> size;
+        INFO(line);
+        CHECK(resident_sum >= resident_max);
+        CHECK(tensor_max > 0.0);
+        CHECK(tensor_sum >= tensor_max);
+        CHECK(size > 0.0);
+        regions.push_back(region);
+      }
+      const std::vector<std::string> ref = {"initialize", "simple_update",
+                                            "full_update", "environment"};
+      CHECK(regions == ref);
+    }
+  }
+
+  SUBCASE("split communicator") {
+    // every process runs its own session on a communicator of one process
+    // (test_session_np2 runs this with two processes)
+    int rank = 0;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm comm = MPI_COMM_WORLD;
+#ifndef _NO_MPI
+    MPI_Comm_split(MPI_COMM_WORLD, rank, 0, &comm);
+#endif
+    {
+      auto split_input = load_input("data/AntiferroHeisenberg_real.toml",
+                                    comm, PrintLevel::none);
+      split_input.peps_parameters.outdir =
+          "output_session_split_" + std::to_string(rank);
+      Session<real_tensor> session(comm, split_input);
+      session.simple_update(100);
+      session.full_update(1);
+      check_densities(session.measure());
+    }
+#ifndef _NO_MPI
+    MPI_Comm_free(&comm);
+#endif
+  }
+
+  SUBCASE("measure groups") {
+    // tensors are copied into the groups of processes for measurement
+    // (test_session_np2 runs this with two groups of one process)
+    input.peps_parameters.measure_groups = 2;
+    input.peps_parameters.outdir = "output_session_groups";
+    Session<real_tensor> session(MPI_COMM_WORLD, input);
+    session.simple_update(100);
+    session.full_update(1);
+    check_densities(session.measure());
+  }
+
+  SUBCASE("projector groups") {
+    // the projectors of each CTM move are computed by groups of processes
+    // (test_session_np2 runs this with two groups of one process)
+    input.peps_parameters.CTM_Projector_groups = 2;
+    input.peps_parameters.outdir = "output_session_projector_groups";
+    Session<real_tensor> session(MPI_COMM_WORLD, input);
+    session.simple_update(100);
+    session.full_update(1);
+    check_densities(session.measure());
+  }
+
+  SUBCASE("philox") {
+    // the initial tensors are the same for any number of processes
+    // (test_session_np2 compares two processes with one)
+    input.peps_parameters.random_generator = "philox";
+    input.peps_parameters.outdir = "output_session_philox";
+    int rank = 0;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm comm = MPI_COMM_WORLD;
+#ifndef _NO_MPI
+    MPI_Comm_split(MPI_COMM_WORLD, rank, 0, &comm);
+#endif
+    {
+      Session<real_tensor> whole(MPI_COMM_WORLD, input);
+      auto split_input = input;
+      split_input.peps_parameters.outdir =
+          "output_session_philox_" + std::to_string(rank);
+      Session<real_tensor> split(comm, split_input);
+      const auto &Tw = whole.site_tensors();
+      const auto &Ts = split.site_tensors();
+      REQUIRE(Tw.size() == Ts.size());
+      for (size_t i = 0; i < Tw.size(); ++i) {
+        INFO("site " << i);
+        REQUIRE(Tw[i].shape() == Ts[i].shape());
+        const auto ew = all_elements(Tw[i]);
+        const auto es = all_elements(Ts[i]);
+        for (size_t j = 0; j < ew.size(); ++j) {
+          CHECK(ew[j] == es[j]);
+        }
+      }
+    }
+#ifndef _NO_MPI
+    MPI_Comm_free(&comm);
+#endif
+  }
+
+  SUBCASE("philox rsvd") {
+    // the random matrices of the random SVD are the same
+    // for any number of processes
+    // (test_session_np2 compares two processes with one)
+    input.peps_parameters.random_generator = "philox";
+    input.peps_parameters.Use_RSVD = true;
+    input.peps_parameters.outdir = "output_session_philox_rsvd";
+    int rank = 0;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm comm = MPI_COMM_WORLD;
+#ifndef _NO_MPI
+    MPI_Comm_split(MPI_COMM_WORLD, rank, 0, &comm);
+#endif
+    {
+      Session<real_tensor> whole(MPI_COMM_WORLD, input);
+      auto split_input = input;
+      split_input.peps_parameters.outdir =
+          "output_session_philox_rsvd_" + std::to_string(rank);
+      Session<real_tensor> split(comm, split_input);
+      whole.simple_update(100);
+      split.simple_update(100);
+      const auto dw = whole.measure();
+      const auto ds = split.measure();
+      REQUIRE(dw.size() == ds.size());
+      for (size_t i = 0; i < dw.size(); ++i) {
+        INFO(dw[i].name);
+        CHECK(std::abs(dw[i].value - ds[i].value) <= 1.0e-8);
+      }
+    }
+#ifndef _NO_MPI
+    MPI_Comm_free(&comm);
+#endif
+  }
+
+  SUBCASE("tensor type") {
+    CHECK_THROWS_AS(Session<complex_tensor>(MPI_COMM_WORLD, input),
+                    tenes::input_error);
+  }
+}
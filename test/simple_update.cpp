@@ -17,7 +17,9 @@
 #define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
 #include "doctest.h"
 
+#include <cmath>
 #include <fstream>
+#include <initializer_list>
 #include <vector>
 
 #include <PEPS_Basics.hpp>
@@ -156,3 +158,265 @@ TEST_CASE("testing simple update") {
   }
   ofs << std::endl;
 }
+
+TEST_CASE("testing adaptive bond dimension") {
+  const std::vector<double> s = {1.0, 0.1, 0.01, 0.001};
+
+  // discarded weights of squares: 1e-6, 1e-4 + 1e-6, 1e-2 + 1e-4 + 1e-6
+  CHECK(tenes::truncated_dimension(s, 1.0e-3, 4) == 2);
+  CHECK(tenes::truncated_dimension(s, 1.0e-5, 4) == 3);
+  CHECK(tenes::truncated_dimension(s, 1.0e-8, 4) == 4);
+  CHECK(tenes::truncated_dimension(s, 1.0e-8, 2) == 2);
+  CHECK(tenes::truncated_dimension(s, 0.5, 4) == 1);
+
+  CHECK(tenes::discarded_weight(s, 4, true) == 0.0);
+  CHECK(tenes::discarded_weight(s, 2, false) ==
+        doctest::Approx(0.011 / 1.111));
+}
+
+namespace {
+// deterministic elements for tests
+template <class tensor> tensor test_tensor(mptensor::Shape const &shape, double seed) {
+  tensor A(shape);
+  const auto strides = tenes::detail::c_order_strides(shape);
+  tenes::fill_local(A, [&](mptensor::Index const &index) -> double {
+    const long n = tenes::detail::c_order_offset(index, strides);
+    return std::sin(seed + 0.37 * n) + 0.5 * std::cos(1.3 * seed * n);
+  });
+  return A;
+}
+
+// normalized state psi(u2, m1, m2, m3) of the chain T1 -(2)- T2 -(2)- T3,
+// where only the leg 1 of T2 (weighted by lambda2) is open
+template <class tensor>
+std::vector<double> chain_state(tensor const &T1, tensor const &T2,
+                                tensor const &T3,
+                                std::vector<double> const &lambda2) {
+  using mptensor::Index;
+  const int D12 = T1.shape()[2];
+  const int D23 = T2.shape()[2];
+  const int U = T2.shape()[1];
+  const int p = T1.shape()[4];
+  std::vector<double> psi;
+  double norm = 0.0;
+  for (int u = 0; u < U; ++u)
+    for (int m1 = 0; m1 < p; ++m1)
+      for (int m2 = 0; m2 < p; ++m2)
+        for (int m3 = 0; m3 < p; ++m3) {
+          double v = 0.0;
+          for (int a = 0; a < D12; ++a)
+            for (int b = 0; b < D23; ++b) {
+              double t1, t2, t3;
+              T1.get_value(Index(0, 0, a, 0, m1), t1);
+              T2.get_value(Index(a, u, b, 0, m2), t2);
+              T3.get_value(Index(b, 0, 0, 0, m3), t3);
+              v += t1 * lambda2[u] * t2 * t3;
+            }
+          psi.push_back(v);
+          norm += v * v;
+        }
+  for (auto &v : psi) {
+    v /= std::sqrt(norm);
+  }
+  return psi;
+}
+
+void check_same_state(std::vector<double> const &result,
+                      std::vector<double> const &answer, double tol) {
+  REQUIRE(result.size() == answer.size());
+  double overlap = 0.0;
+  for (size_t i = 0; i < answer.size(); ++i) {
+    overlap += result[i] * answer[i];
+  }
+  const double sign = overlap < 0.0 ? -1.0 : 1.0;
+  for (size_t i = 0; i < answer.size(); ++i) {
+    CHECK(sign * result[i] == doctest::Approx(answer[i]).epsilon(tol));
+  }
+}
+} // namespace
+
+TEST_CASE("testing three-site simple update") {
+#ifdef _NO_MPI
+  using tensor = mptensor::Tensor<mptensor::lapack::Matrix, double>;
+#else
+  using tensor = mptensor::Tensor<mptensor::scalapack::Matrix, double>;
+#endif
+  using mptensor::Index;
+  using mptensor::Shape;
+
+  // chain T1 -(leg 2)- T2 -(leg 2)- T3 with one more open leg on T2
+  // bond dimensions are large enough to keep the states without truncation
+  const int p = 2;
+  const int D = 2;
+  const tensor T1 = test_tensor<tensor>(Shape(1, 1, D, 1, p), 0.1);
+  const tensor T2 = test_tensor<tensor>(Shape(D, 2, D, 1, p), 0.2);
+  const tensor T3 = test_tensor<tensor>(Shape(D, 1, 1, 1, p), 0.3);
+  const std::vector<double> one(1, 1.0);
+  const std::vector<double> lambda12 = {0.8, 0.5};
+  const std::vector<double> lambda23 = {0.9, 0.3};
+  const std::vector<double> lambda_up = {0.9, 0.4};
+  std::vector<std::vector<double>> lambda1 = {one, one, lambda12, one};
+  std::vector<std::vector<double>> lambda2 = {lambda12, lambda_up, lambda23,
+                                              one};
+  std::vector<std::vector<double>> lambda3 = {lambda23, one, one, one};
+
+  // op123 = G23 * G12, that is, G12 on (1, 2) is applied first
+  const tensor G12 = test_tensor<tensor>(Shape(p, p, p, p), 0.4);
+  const tensor G23 = test_tensor<tensor>(Shape(p, p, p, p), 0.5);
+  const tensor op123 = tensordot(G12, G23, mptensor::Axes(3), mptensor::Axes(0))
+                           .transpose(mptensor::Axes(0, 1, 3, 2, 4, 5));
+
+  // exact state
+  const auto psi = chain_state(T1, T2, T3, lambda_up);
+  std::vector<double> answer(psi.size(), 0.0);
+  for (int u = 0; u < 2; ++u)
+    for (int o = 0; o < p * p * p; ++o)
+      for (int i = 0; i < p * p * p; ++i) {
+        double g;
+        op123.get_value(Index(i / 4, (i / 2) % 2, i % 2, o / 4, (o / 2) % 2,
+                              o % 2),
+                        g);
+        answer[u * 8 + o] += g * psi[u * 8 + i];
+      }
+  double norm = 0.0;
+  for (double v : answer) {
+    norm += v * v;
+  }
+  for (auto &v : answer) {
+    v /= std::sqrt(norm);
+  }
+
+  const double tol = 1.0e-8;
+  tenes::PEPS_Parameters peps_parameters;
+
+  SUBCASE("three-site operator") {
+    // the local (replicated) and the distributed paths of
+    // Simple_update_threesite_theta
+    for (int threshold : {0, 1 << 20}) {
+      CAPTURE(threshold);
+      peps_parameters.local_tensor_threshold = threshold;
+      tensor N1, N2, N3;
+      std::vector<double> new_lambda12, new_lambda23;
+      Simple_update_threesite(T1, T2, T3, lambda1, lambda2, lambda3, op123, 2,
+                              2, peps_parameters, N1, N2, N3, new_lambda12,
+                              new_lambda23);
+      CHECK(new_lambda12.size() == D);
+      CHECK(new_lambda23.size() == D);
+      check_same_state(chain_state(N1, N2, N3, lambda_up), answer, tol);
+    }
+  }
+
+  SUBCASE("chain of two-site operators") {
+    tensor A1, A2, B2, B3;
+    std::vector<double> lambda_c;
+    Simple_update_bond(T1, T2, lambda1, lambda2, G12, 2, peps_parameters, A1,
+                       A2, lambda_c);
+    lambda1[2] = lambda_c;
+    lambda2[0] = lambda_c;
+    Simple_update_bond(A2, T3, lambda2, lambda3, G23, 2, peps_parameters, B2,
+                       B3, lambda_c);
+    check_same_state(chain_state(A1, B2, B3, lambda_up), answer, tol);
+  }
+}
+
+TEST_CASE("testing small tensors computed by one process") {
+#ifdef _NO_MPI
+  using tensor = mptensor::Tensor<mptensor::lapack::Matrix, double>;
+#else
+  using tensor = mptensor::Tensor<mptensor::scalapack::Matrix, double>;
+#endif
+  using mptensor::Shape;
+
+  const int p = 2;
+  const int D = 2;
+  const tensor T1 = test_tensor<tensor>(Shape(1, 1, D, 1, p), 0.6);
+  const tensor T2 = test_tensor<tensor>(Shape(D, 2, D, 1, p), 0.7);
+  const tensor T3 = test_tensor<tensor>(Shape(D, 1, 1, 1, p), 0.8);
+  const tensor op12 = test_tensor<tensor>(Shape(p, p, p, p), 0.9);
+  const std::vector<double> one(1, 1.0);
+  const std::vector<double> lambda12 = {0.8, 0.5};
+  const std::vector<double> lambda23 = {0.9, 0.3};
+  const std::vector<double> lambda_up = {0.9, 0.4};
+  const std::vector<std::vector<double>> lambda1 = {one, one, lambda12, one};
+  const std::vector<std::vector<double>> lambda2 = {lambda12, lambda_up,
+                                                    lambda23, one};
+
+  // the same update by ScaLAPACK (threshold = 0)
+  // and by LAPACK on the root process
+  tenes::PEPS_Parameters peps_parameters;
+  std::vector<std::vector<double>> states, lambdas;
+  for (int threshold : {0, 1 << 20}) {
+    peps_parameters.local_tensor_threshold = threshold;
+    tensor A1, A2;
+    std::vector<double> lambda_c;
+    Simple_update_bond(T1, T2, lambda1, lambda2, op12, 2, peps_parameters, A1,
+                       A2, lambda_c);
+    states.push_back(chain_state(A1, A2, T3, lambda_up));
+    lambdas.push_back(lambda_c);
+  }
+
+  const double tol = 1.0e-10;
+  REQUIRE(lambdas[0].size() == lambdas[1].size());
+  for (size_t i = 0; i < lambdas[0].size(); ++i) {
+    CHECK(lambdas[1][i] == doctest::Approx(lambdas[0][i]).epsilon(tol));
+  }
+  check_same_state(states[1], states[0], tol);
+}
+
+TEST_CASE("testing shortcuts through vacancies") {
+#ifdef _NO_MPI
+  using tensor = mptensor::Tensor<mptensor::lapack::Matrix, double>;
+#else
+  using tensor = mptensor::Tensor<mptensor::scalapack::Matrix, double>;
+#endif
+  using mptensor::Index;
+  using mptensor::Shape;
+
+  // a vacancy and the same site with a physical dimension 2 in the state |0>,
+  // which takes the general contractions
+  const double a = 0.7;
+  tensor vacancy(Shape(1, 1, 1, 1, 1));
+  vacancy.set_value(Index(0, 0, 0, 0, 0), a);
+  tensor site(Shape(1, 1, 1, 1, 2));
+  site.set_value(Index(0, 0, 0, 0, 0), a);
+  site.set_value(Index(0, 0, 0, 0, 1), 0.0);
+  REQUIRE(tenes::is_vacancy(vacancy));
+  REQUIRE(!tenes::is_vacancy(site));
+
+  const double tol = 1.0e-12;
+  auto check_same = [&](tensor const &result, tensor const &answer) {
+    REQUIRE(result.shape() == answer.shape());
+    const Shape shape = answer.shape();
+    for (int i = 0; i < shape[0]; ++i)
+      for (int j = 0; j < shape[1]; ++j)
+        for (int k = 0; k < shape[2]; ++k)
+          for (int l = 0; l < shape[3]; ++l) {
+            double r, v;
+            result.get_value(Index(i, j, k, l), r);
+            answer.get_value(Index(i, j, k, l), v);
+            CHECK(r == doctest::Approx(v).epsilon(tol));
+          }
+  };
+
+  // bonds to a vacancy have the dimension 1,
+  // and the other dimensions differ from each other to fix the leg orders
+  SUBCASE("Calc_Next_eT") {
+    const tensor eT = test_tensor<tensor>(Shape(3, 4, 1, 1), 0.1);
+    const tensor PU = test_tensor<tensor>(Shape(3, 1, 1, 2), 0.2);
+    const tensor PL = test_tensor<tensor>(Shape(4, 1, 1, 5), 0.3);
+    tensor result, answer;
+    tenes::Calc_Next_eT(eT, vacancy, PU, PL, result);
+    tenes::Calc_Next_eT(eT, site, PU, PL, answer);
+    check_same(result, answer);
+  }
+
+  SUBCASE("Transfer") {
+    const tensor eT1 = test_tensor<tensor>(Shape(3, 4, 1, 1), 0.4);
+    const tensor eT3 = test_tensor<tensor>(Shape(5, 2, 1, 1), 0.5);
+    tensor result = test_tensor<tensor>(Shape(3, 2, 1, 1), 0.6);
+    tensor answer = result;
+    tenes::Transfer(result, eT1, eT3, vacancy);
+    tenes::Transfer(answer, eT1, eT3, site);
+    check_same(result, answer);
+  }
+}
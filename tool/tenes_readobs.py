@@ -0,0 +1,99 @@
+# TeNeS - Massively parallel tensor network solver
+# Copyright (C) 2019- The University of Tokyo
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program. If not, see http://www.gnu.org/licenses
+
+import json
+
+from collections import OrderedDict
+from typing import Any, Dict, TextIO
+
+import numpy as np
+
+
+def load_header(f) -> Dict[str, Any]:
+    header = json.loads(f.readline().decode("utf-8"))
+    if header.get("format") != "tenes-columnar":
+        raise RuntimeError("not a binary observable file of TeNeS")
+    if header.get("version") != 1:
+        raise RuntimeError(
+            "unsupported version of binary observable file: {}".format(
+                header.get("version")
+            )
+        )
+    return header
+
+
+def load_columnar(filename: str) -> "OrderedDict[str, np.ndarray]":
+    """Load a binary observable file (e.g., onesite_obs.bin)
+
+    Returns an ordered dictionary mapping a column name
+    to a numpy array of the column.
+    """
+    ret = OrderedDict()  # type: OrderedDict[str, np.ndarray]
+    with open(filename, "rb") as f:
+        header = load_header(f)
+        nrows = header["nrows"]
+        for column in header["columns"]:
+            dtype = np.dtype(column["dtype"])
+            data = np.frombuffer(f.read(dtype.itemsize * nrows), dtype=dtype)
+            if data.size != nrows:
+                raise RuntimeError("{} is too short".format(filename))
+            ret[column["name"]] = data
+    return ret
+
+
+def dump_text(table: "OrderedDict[str, np.ndarray]", f: TextIO) -> None:
+    """Write a table in the same format as the text output (e.g., onesite_obs.dat)"""
+    for i, name in enumerate(table.keys()):
+        f.write("# ${}: {}\n".format(i + 1, name))
+    f.write("\n")
+    columns = list(table.values())
+    nrows = len(columns[0]) if columns else 0
+    for irow in range(nrows):
+        words = []
+        for column in columns:
+            v = column[irow]
+            if column.dtype.kind == "f":
+                words.append("{:.17e}".format(v))
+            else:
+                words.append(str(v))
+        f.write(" ".join(words) + "\n")
+
+
+if __name__ == "__main__":
+    import argparse
+    import sys
+
+    parser = argparse.ArgumentParser(
+        description="Converter of binary observable files of TeNeS into text",
+        add_help=True,
+    )
+
+    parser.add_argument("input", help="Binary file (e.g., output/onesite_obs.bin)")
+    parser.add_argument(
+        "-o", "--output", dest="output", default="", help="Output text file (default: stdout)"
+    )
+    parser.add_argument(
+        "-v", "--version", dest="version", action="version", version="1.1.0"
+    )
+
+    args = parser.parse_args()
+
+    table = load_columnar(args.input)
+    if args.output:
+        with open(args.output, "w") as f:
+            dump_text(table, f)
+    else:
+        dump_text(table, sys.stdout)
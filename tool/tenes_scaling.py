@@ -0,0 +1,303 @@
+# TeNeS - Massively parallel tensor network solver
+# Copyright (C) 2019- The University of Tokyo
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program. If not, see http://www.gnu.org/licenses
+
+
+"""Scaling study of TeNeS over MPI processes and OpenMP threads
+
+``tenes_scaling run`` solves an input on every combination of the numbers of
+MPI processes and OpenMP threads by ``tenes --scaling`` in one MPI launch and
+``tenes_scaling report`` shows the tables of the parallel efficiency made
+from the elapsed times (scaling.dat).
+"""
+
+import os
+import shlex
+import subprocess
+import sys
+from typing import Dict, List, NamedTuple, TextIO
+
+import toml
+
+PHASES = ["all", "simple_update", "full_update", "environment", "observable"]
+
+
+class Record(NamedTuple):
+    ranks: int
+    threads: int
+    times: Dict[str, float]
+    input: str
+
+    @property
+    def cores(self) -> int:
+        return self.ranks * self.threads
+
+
+def load_scaling(filename: str) -> List[Record]:
+    """Load scaling.dat written by ``tenes --scaling``"""
+    records = []
+    with open(filename) as f:
+        for line in f:
+            words = line.split()
+            if len(words) == 0 or words[0].startswith("#"):
+                continue
+            times = {p: float(w) for p, w in zip(PHASES, words[2:7])}
+            records.append(
+                Record(int(words[0]), int(words[1]), times, " ".join(words[7:]))
+            )
+    if len(records) == 0:
+        raise RuntimeError("no records in {}".format(filename))
+    return records
+
+
+def reference(records: List[Record], record: Record, weak: bool) -> Record:
+    """Record to which the speedup of `record` is compared
+
+    For the strong scaling, the record with the fewest cores.
+    For the weak scaling, the record with the fewest processes among
+    those with the same number of threads as `record`.
+    """
+    if weak:
+        candidates = [r for r in records if r.threads == record.threads]
+        return min(candidates, key=lambda r: (r.ranks, r.times["all"]))
+    return min(records, key=lambda r: (r.cores, r.times["all"]))
+
+
+def efficiency(records: List[Record], record: Record, phase: str, weak: bool):
+    """Speedup and parallel efficiency of `record` in `phase`"""
+    ref = reference(records, record, weak)
+    t = record.times[phase]
+    t_ref = ref.times[phase]
+    if t <= 0.0 or t_ref <= 0.0:
+        return float("nan"), float("nan")
+    speedup = t_ref / t
+    if weak:
+        return speedup, speedup
+    return speedup, speedup * ref.cores / record.cores
+
+
+def report(
+    records: List[Record],
+    f: TextIO,
+    phase: str = "all",
+    weak: bool = False,
+    tolerance: float = 0.1,
+) -> None:
+    """Write the scaling table and the best configurations into `f`"""
+    records = sorted(records, key=lambda r: (r.cores, r.ranks))
+    kind = "weak" if weak else "strong"
+    f.write("# {} scaling of the time of {} [sec.]\n".format(kind, phase))
+    f.write(
+        "{:>6} {:>8} {:>6}".format("ranks", "threads", "cores")
+        + "".join(" {:>14}".format(p) for p in PHASES)
+        + " {:>8} {:>10}\n".format("speedup", "efficiency")
+    )
+    for r in records:
+        speedup, eff = efficiency(records, r, phase, weak)
+        f.write(
+            "{:>6} {:>8} {:>6}".format(r.ranks, r.threads, r.cores)
+            + "".join(" {:>14.6g}".format(r.times[p]) for p in PHASES)
+            + " {:>8.3f} {:>10.3f}\n".format(speedup, eff)
+        )
+
+    if weak:
+        # the most cores whose efficiency is at least 1 - `tolerance`
+        accepted = [
+            r
+            for r in records
+            if efficiency(records, r, phase, weak)[1] >= 1.0 - tolerance
+        ]
+        if accepted:
+            best = max(accepted, key=lambda r: (r.cores, -r.times[phase]))
+            f.write(
+                "# most cores with efficiency >= {:.2f}: {} ranks x {} threads"
+                " ({:.3f})\n".format(
+                    1.0 - tolerance,
+                    best.ranks,
+                    best.threads,
+                    efficiency(records, best, phase, weak)[1],
+                )
+            )
+        return
+
+    fastest = min(records, key=lambda r: r.times[phase])
+    f.write(
+        "# fastest: {} ranks x {} threads ({:.6g} sec.)\n".format(
+            fastest.ranks, fastest.threads, fastest.times[phase]
+        )
+    )
+    # the fewest cores which are slower than the fastest by at most `tolerance`
+    limit = fastest.times[phase] * (1.0 + tolerance)
+    cheapest = min(
+        (r for r in records if r.times[phase] <= limit),
+        key=lambda r: (r.cores, r.times[phase]),
+    )
+    f.write(
+        "# fewest cores within {:.0f}% of the fastest: {} ranks x {} threads"
+        " ({:.6g} sec.)\n".format(
+            100 * tolerance, cheapest.ranks, cheapest.threads, cheapest.times[phase]
+        )
+    )
+
+
+def tool_command(name: str) -> List[str]:
+    """Command of another tool of TeNeS (installed next to this script)"""
+    path = os.path.join(os.path.dirname(os.path.abspath(__file__)), name)
+    if os.path.exists(path):
+        return [path]
+    return [name]
+
+
+def weak_inputs(inputfile: str, ranks: List[int], workdir: str) -> List[str]:
+    """Make the inputs of the weak scaling from a simple-mode input
+
+    The lattice length ``L`` is multiplied by ``ranks[i] / ranks[0]``
+    so that the number of sites in the unit cell grows with the processes.
+    """
+    param = toml.load(inputfile)
+    if "lattice" not in param:
+        raise RuntimeError(
+            "weak scaling requires an input file for tenes_simple ([lattice] table)"
+        )
+    L0 = param["lattice"]["L"]
+    inputs = []
+    for r in ranks:
+        if r % ranks[0] != 0:
+            raise RuntimeError(
+                "every entry of ranks must be a multiple of the first one ({})".format(
+                    ranks[0]
+                )
+            )
+        param["lattice"]["L"] = L0 * r // ranks[0]
+        simple = os.path.join(workdir, "simple_r{}.toml".format(r))
+        std = os.path.join(workdir, "std_r{}.toml".format(r))
+        result = os.path.join(workdir, "input_r{}.toml".format(r))
+        with open(simple, "w") as f:
+            toml.dump(param, f)
+        subprocess.run(tool_command("tenes_simple") + [simple, "-o", std], check=True)
+        subprocess.run(tool_command("tenes_std") + [std, "-o", result], check=True)
+        inputs.append(result)
+    return inputs
+
+
+def run(args) -> int:
+    os.makedirs(args.output_dir, exist_ok=True)
+    if args.weak:
+        inputs = weak_inputs(args.input, args.ranks, args.output_dir)
+    else:
+        inputs = [args.input]
+
+    # the first r processes of the launch solve the input for r ranks
+    scaling = {
+        "ranks": args.ranks,
+        "threads": args.threads,
+        "repeat": args.repeat,
+        "output": args.output,
+        "output_dir": args.output_dir,
+    }
+    if args.weak:
+        scaling["inputs"] = inputs
+    else:
+        scaling["input"] = inputs[0]
+    scalingfile = os.path.join(args.output_dir, "scaling.toml")
+    with open(scalingfile, "w") as f:
+        toml.dump({"scaling": scaling}, f)
+
+    cmd = shlex.split(args.mpiexec.format(np=max(args.ranks)))
+    cmd += shlex.split(args.tenes) + ["--scaling", scalingfile]
+    print(" ".join(cmd))
+    ret = subprocess.run(cmd).returncode
+    if ret != 0:
+        return ret
+
+    report(load_scaling(args.output), sys.stdout, args.phase, args.weak, args.tolerance)
+    return 0
+
+
+if __name__ == "__main__":
+    import argparse
+
+    parser = argparse.ArgumentParser(
+        description="Scaling study of TeNeS over MPI processes and OpenMP threads",
+        add_help=True,
+    )
+    parser.add_argument(
+        "-v", "--version", dest="version", action="version", version="1.1.0"
+    )
+    subparsers = parser.add_subparsers(dest="command")
+    subparsers.required = True
+
+    def add_report_options(p):
+        p.add_argument(
+            "--weak",
+            action="store_true",
+            help="Weak scaling (the problem grows with the processes)",
+        )
+        p.add_argument(
+            "--phase",
+            default="all",
+            choices=PHASES,
+            help="Phase whose time is used for the efficiency (default: all)",
+        )
+        p.add_argument(
+            "--tolerance",
+            type=float,
+            default=0.1,
+            help="Accepted slowdown from the fastest (strong) or"
+            " loss of efficiency (weak) (default: 0.1)",
+        )
+
+    p_run = subparsers.add_parser("run", help="Run tenes and report the scaling")
+    p_run.add_argument(
+        "input",
+        help="Input TOML file for tenes (for tenes_simple with --weak)",
+    )
+    p_run.add_argument(
+        "--ranks", type=int, nargs="+", default=[1], help="Numbers of MPI processes"
+    )
+    p_run.add_argument(
+        "--threads", type=int, nargs="+", default=[1], help="Numbers of OpenMP threads"
+    )
+    p_run.add_argument(
+        "--repeat", type=int, default=1, help="Repetitions of each configuration"
+    )
+    p_run.add_argument(
+        "--mpiexec",
+        default="mpiexec -np {np}",
+        help='MPI launcher ({np} is replaced by the number of processes;'
+        ' default: "mpiexec -np {np}")',
+    )
+    p_run.add_argument("--tenes", default="tenes", help="tenes command")
+    p_run.add_argument(
+        "-o", "--output", default="scaling.dat", help="Output file of the timings"
+    )
+    p_run.add_argument(
+        "--output-dir",
+        dest="output_dir",
+        default="scaling_output",
+        help="Directory where the outputs of the configurations are saved",
+    )
+    add_report_options(p_run)
+
+    p_report = subparsers.add_parser("report", help="Report the scaling in a file")
+    p_report.add_argument("input", help="Timing file (e.g., scaling.dat)")
+    add_report_options(p_report)
+
+    args = parser.parse_args()
+
+    if args.command == "run":
+        sys.exit(run(args))
+    else:
+        report(load_scaling(args.input), sys.stdout, args.phase, args.weak, args.tolerance)
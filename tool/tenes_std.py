@@ -448,9 +448,16 @@ class LatticeGraph:
 
 class NNOperator:
     def __init__(
-        self, bond: Bond, *, elements: np.ndarray = None, ops: List[int] = None
+        self,
+        bond: Bond,
+        *,
+        elements: np.ndarray = None,
+        ops: List[int] = None,
+        next_bond: Bond = None,
     ):
         self.bond = bond
+        # second hop of a three-site operator
+        self.next_bond = next_bond
         if elements is not None:
             self.elements = elements
             self.ops = None
@@ -462,6 +469,8 @@ class NNOperator:
         ret = []
         ret.append("source_site = {}".format(self.bond.source_site))
         ret.append("source_leg = {}".format(unitcell.bond_direction(self.bond)))
+        if self.next_bond is not None:
+            ret.append("next_leg = {}".format(unitcell.bond_direction(self.next_bond)))
         if self.elements is not None:
             ret.append("dimensions = {}".format(list(self.elements.shape)))
             it = np.nditer(
@@ -592,6 +601,7 @@ def make_evolution(
     graph: LatticeGraph,
     tau: float,
     result_cutoff: float = 1e-15,
+    threesite: bool = False,
 ) -> List[NNOperator]:
     dims = hamiltonian.elements.shape[0:2]
     H = hamiltonian.elements.reshape((dims[0] * dims[1], dims[0] * dims[1]))
@@ -619,6 +629,13 @@ def make_evolution(
     I = np.eye(np.prod(mdofs)).reshape(mdofs + mdofs)
     A = np.einsum("ijkl,...->ijkl...", evo, I).transpose(index)
 
+    # a path of two hops through three different sites is applied at once
+    if threesite and nhops == 2:
+        sites = [bonds[0].source_site, bonds[1].source_site]
+        sites.append(unitcell.target_site(bonds[1]))
+        if len(set(sites)) == 3:
+            return [NNOperator(bonds[0], elements=A, next_bond=bonds[1])]
+
     dofs = [dims[0]] + mdofs + [dims[1]]
 
     ret = []
@@ -641,7 +658,7 @@ def make_evolution(
 
 
 class Model:
-    def __init__(self, param: dict, atol: float = 1e-15):
+    def __init__(self, param: dict, atol: float = 1e-15, threesite: bool = False):
         param = lower_dict(param)
         self.param = param
         self.parameter = param["parameter"]
@@ -725,7 +742,9 @@ class Model:
         self.full_updates = []
 
         for ham in self.hamiltonians:
-            for evo in make_evolution(ham, self.graph, self.simple_tau):
+            for evo in make_evolution(
+                ham, self.graph, self.simple_tau, threesite=threesite
+            ):
                 self.simple_updates.append(evo)
             for evo in make_evolution(ham, self.graph, self.full_tau):
                 self.full_updates.append(evo)
@@ -812,6 +831,12 @@ if __name__ == "__main__":
     parser.add_argument(
         "-o", "--output", dest="output", default="input.toml", help="Output TOML file"
     )
+    parser.add_argument(
+        "--threesite",
+        dest="threesite",
+        action="store_true",
+        help="Apply two-hop interactions as three-site simple updates",
+    )
     parser.add_argument(
         "-v", "--version", dest="version", action="version", version="1.1.0"
     )
@@ -823,7 +848,7 @@ if __name__ == "__main__":
         sys.exit(1)
 
     param = toml.load(args.input)
-    model = Model(param)
+    model = Model(param, threesite=args.threesite)
 
     with open(args.output, "w") as f:
         model.to_toml(f)
@@ -0,0 +1,179 @@
+# TeNeS - Massively parallel tensor network solver
+# Copyright (C) 2019- The University of Tokyo
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program. If not, see http://www.gnu.org/licenses
+
+
+
+"""Parameter sweep of TeNeS over the model parameters
+
+``tenes_sweep`` takes a sweep file whose points override the model
+parameters (e.g., the field and the couplings) of a simple-mode input or
+``tau`` of a simple- or standard-mode input,
+makes the input of every point by ``tenes_simple`` and ``tenes_std``,
+and solves all the points in a single launch of ``tenes --sweep``.
+"""
+
+import copy
+import os
+import shlex
+import subprocess
+import sys
+from typing import List
+
+import toml
+
+
+def tool_command(name: str) -> List[str]:
+    """Command of another tool of TeNeS (installed next to this script)"""
+    path = os.path.join(os.path.dirname(os.path.abspath(__file__)), name)
+    if os.path.exists(path):
+        return [path]
+    return [name]
+
+
+def merge(dst: dict, src: dict) -> dict:
+    """Merge the tables of src into dst recursively"""
+    for key, value in src.items():
+        if isinstance(value, dict) and isinstance(dst.get(key), dict):
+            merge(dst[key], value)
+        else:
+            dst[key] = copy.deepcopy(value)
+    return dst
+
+
+def input_mode(param: dict) -> str:
+    """Mode of an input file: "simple", "std", or "tenes" """
+    if "model" in param:
+        return "simple"
+    if "hamiltonian" in param:
+        return "std"
+    return "tenes"
+
+
+def make_point_input(base: dict, point: dict, workdir: str, k: int) -> str:
+    """Make the input file for tenes of the k-th point
+
+    ``point.model`` is merged into the ``model`` table of a simple-mode input
+    and ``point.parameter`` into the ``parameter`` table.
+    """
+    param = copy.deepcopy(base)
+    mode = input_mode(param)
+    if "model" in point:
+        if mode != "simple":
+            raise RuntimeError(
+                "point {}: model requires a simple-mode input".format(k)
+            )
+        merge(param["model"], point["model"])
+    if mode == "tenes":
+        for section in ("simple_update", "full_update"):
+            if "tau" in point.get("parameter", {}).get(section, {}):
+                raise RuntimeError(
+                    "point {}: tau requires a simple- or standard-mode input".format(k)
+                )
+    merge(param.setdefault("parameter", {}), point.get("parameter", {}))
+
+    if mode == "tenes":
+        result = os.path.join(workdir, "input_{}.toml".format(k))
+        with open(result, "w") as f:
+            toml.dump(param, f)
+        return result
+
+    std = os.path.join(workdir, "std_{}.toml".format(k))
+    if mode == "simple":
+        simple = os.path.join(workdir, "simple_{}.toml".format(k))
+        with open(simple, "w") as f:
+            toml.dump(param, f)
+        subprocess.run(tool_command("tenes_simple") + [simple, "-o", std], check=True)
+    else:
+        with open(std, "w") as f:
+            toml.dump(param, f)
+    result = os.path.join(workdir, "input_{}.toml".format(k))
+    subprocess.run(tool_command("tenes_std") + [std, "-o", result], check=True)
+    return result
+
+
+def expand(sweepfile: str, workdir: str) -> str:
+    """Make the inputs of the points and the sweep file for ``tenes --sweep``
+
+    Returns the name of the sweep file.
+    """
+    sweep = toml.load(sweepfile)["sweep"]
+    points = sweep.pop("point", [])
+    if len(points) == 0:
+        raise RuntimeError("no sweep.point in {}".format(sweepfile))
+    base_input = sweep.pop("input", None)
+
+    os.makedirs(workdir, exist_ok=True)
+    expanded = []
+    for k, point in enumerate(points):
+        inputfile = point.get("input", base_input)
+        if inputfile is None:
+            raise RuntimeError("point {}: input is not given".format(k))
+        base = toml.load(inputfile)
+        entry = {"input": make_point_input(base, point, workdir, k)}
+        # tenes --sweep gives <output>/<k> to a point without its own output
+        output = point.get("parameter", {}).get("general", {}).get("output")
+        if output is not None:
+            entry["parameter"] = {"general": {"output": output}}
+        expanded.append(entry)
+
+    sweep["point"] = expanded
+    result = os.path.join(workdir, "sweep.toml")
+    with open(result, "w") as f:
+        toml.dump({"sweep": sweep}, f)
+    return result
+
+
+if __name__ == "__main__":
+    import argparse
+
+    parser = argparse.ArgumentParser(
+        description="Parameter sweep of TeNeS over the model parameters",
+        add_help=True,
+    )
+    parser.add_argument(
+        "-v", "--version", dest="version", action="version", version="1.1.0"
+    )
+    parser.add_argument("input", help="Sweep TOML file")
+    parser.add_argument(
+        "--np", type=int, default=1, help="Number of MPI processes (default: 1)"
+    )
+    parser.add_argument(
+        "--mpiexec",
+        default="mpiexec -np {np}",
+        help='MPI launcher ({np} is replaced by the number of processes;'
+        ' default: "mpiexec -np {np}")',
+    )
+    parser.add_argument("--tenes", default="tenes", help="tenes command")
+    parser.add_argument(
+        "--workdir",
+        default="sweep_inputs",
+        help="Directory where the inputs of the points are made"
+        ' (default: "sweep_inputs")',
+    )
+    parser.add_argument(
+        "--dry-run",
+        dest="dry_run",
+        action="store_true",
+        help="Only make the inputs and the sweep file",
+    )
+    args = parser.parse_args()
+
+    sweepfile = expand(args.input, args.workdir)
+    cmd = shlex.split(args.mpiexec.format(np=args.np))
+    cmd += shlex.split(args.tenes) + ["--sweep", sweepfile]
+    print(" ".join(cmd))
+    if not args.dry_run:
+        sys.exit(subprocess.run(cmd).returncode)